@@ -122,6 +122,7 @@ typedef struct BenchmarkTimeStamps {
 static BenchmarkTimeStamps get_benchmark_time_stamps(void);
 static int64_t getmaxrss(void);
 static int ifilter_has_all_input_formats(FilterGraph *fg);
+static int enc_thread_stop(OutputStream *ost);
 
 static int64_t nb_frames_dup = 0;
 static uint64_t dup_warning = 1000;
@@ -540,6 +541,13 @@ static void ffmpeg_cleanup(int ret)
     }
     av_freep(&filtergraphs);
 
+    /* stop the encoding threads before the encoders are freed */
+    for (i = 0; i < nb_output_files; i++) {
+        OutputFile *of = output_files[i];
+        for (j = 0; j < of->nb_streams; j++)
+            enc_thread_stop(of->streams[j]);
+    }
+
     /* close files */
     for (i = 0; i < nb_output_files; i++)
         of_close(&output_files[i]);
@@ -654,7 +662,7 @@ static void update_benchmark(const char *fmt, ...)
 static void close_output_stream(OutputStream *ost)
 {
     OutputFile *of = output_files[ost->file_index];
-    ost->finished |= ENCODER_FINISHED;
+    atomic_fetch_or(&ost->finished, ENCODER_FINISHED);
 
     if (ost->sq_idx_encode >= 0)
         sq_send(of->sq_encode, ost->sq_idx_encode, SQFRAME(NULL));
@@ -748,44 +756,44 @@ static void update_video_stats(OutputStream *ost, const AVPacket *pkt, int write
     const uint8_t *sd = av_packet_get_side_data(pkt, AV_PKT_DATA_QUALITY_STATS,
                                                 NULL);
     AVCodecContext *enc = ost->enc_ctx;
+    const int quality   = sd ? AV_RL32(sd) : -1;
+    const int pict_type = sd ? sd[4] : AV_PICTURE_TYPE_NONE;
+    int64_t error[FF_ARRAY_ELEMS(ost->error)];
     int64_t frame_number;
     double ti1, bitrate, avg_bitrate;
+    AVBPrint buf;
 
-    ost->quality   = sd ? AV_RL32(sd) : -1;
-    ost->pict_type = sd ? sd[4] : AV_PICTURE_TYPE_NONE;
+    atomic_store(&ost->quality,   quality);
+    atomic_store(&ost->pict_type, pict_type);
 
     for (int i = 0; i<FF_ARRAY_ELEMS(ost->error); i++) {
         if (sd && i < sd[5])
-            ost->error[i] = AV_RL64(sd + 8 + 8*i);
+            error[i] = AV_RL64(sd + 8 + 8*i);
         else
-            ost->error[i] = -1;
+            error[i] = -1;
+        atomic_store(&ost->error[i], error[i]);
     }
 
     if (!write_vstats)
         return;
 
-    /* this is executed just the first time update_video_stats is called */
-    if (!vstats_file) {
-        vstats_file = fopen(vstats_filename, "w");
-        if (!vstats_file) {
-            perror("fopen");
-            exit_program(1);
-        }
-    }
+    /* build the whole line first, so that lines written concurrently from
+     * several encoding threads do not get interleaved */
+    av_bprint_init(&buf, 0, AV_BPRINT_SIZE_AUTOMATIC);
 
     frame_number = ost->packets_encoded;
     if (vstats_version <= 1) {
-        fprintf(vstats_file, "frame= %5"PRId64" q= %2.1f ", frame_number,
-                ost->quality / (float)FF_QP2LAMBDA);
+        av_bprintf(&buf, "frame= %5"PRId64" q= %2.1f ", frame_number,
+                   quality / (float)FF_QP2LAMBDA);
     } else  {
-        fprintf(vstats_file, "out= %2d st= %2d frame= %5"PRId64" q= %2.1f ", ost->file_index, ost->index, frame_number,
-                ost->quality / (float)FF_QP2LAMBDA);
+        av_bprintf(&buf, "out= %2d st= %2d frame= %5"PRId64" q= %2.1f ", ost->file_index, ost->index, frame_number,
+                   quality / (float)FF_QP2LAMBDA);
     }
 
-    if (ost->error[0]>=0 && (enc->flags & AV_CODEC_FLAG_PSNR))
-        fprintf(vstats_file, "PSNR= %6.2f ", psnr(ost->error[0] / (enc->width * enc->height * 255.0 * 255.0)));
+    if (error[0]>=0 && (enc->flags & AV_CODEC_FLAG_PSNR))
+        av_bprintf(&buf, "PSNR= %6.2f ", psnr(error[0] / (enc->width * enc->height * 255.0 * 255.0)));
 
-    fprintf(vstats_file,"f_size= %6d ", pkt->size);
+    av_bprintf(&buf, "f_size= %6d ", pkt->size);
     /* compute pts value */
     ti1 = pkt->dts * av_q2d(ost->mux_timebase);
     if (ti1 < 0.01)
@@ -793,9 +801,12 @@ static void update_video_stats(OutputStream *ost, const AVPacket *pkt, int write
 
     bitrate     = (pkt->size * 8) / av_q2d(enc->time_base) / 1000.0;
     avg_bitrate = (double)(ost->data_size_enc * 8) / ti1 / 1000.0;
-    fprintf(vstats_file, "s_size= %8.0fkB time= %0.3f br= %7.1fkbits/s avg_br= %7.1fkbits/s ",
-           (double)ost->data_size_enc / 1024, ti1, bitrate, avg_bitrate);
-    fprintf(vstats_file, "type= %c\n", av_get_picture_type_char(ost->pict_type));
+    av_bprintf(&buf, "s_size= %8.0fkB time= %0.3f br= %7.1fkbits/s avg_br= %7.1fkbits/s ",
+               (double)ost->data_size_enc / 1024, ti1, bitrate, avg_bitrate);
+    av_bprintf(&buf, "type= %c\n", av_get_picture_type_char(pict_type));
+
+    fputs(buf.str, vstats_file);
+    av_bprint_finalize(&buf, NULL);
 }
 
 static int encode_frame(OutputFile *of, OutputStream *ost, AVFrame *frame)
@@ -810,6 +821,9 @@ static int encode_frame(OutputFile *of, OutputStream *ost, AVFrame *frame)
         ost->frames_encoded++;
         ost->samples_encoded += frame->nb_samples;
 
+        if (enc->codec_type == AVMEDIA_TYPE_VIDEO && !ost->frame_aspect_ratio.num)
+            enc->sample_aspect_ratio = frame->sample_aspect_ratio;
+
         if (debug_ts) {
             av_log(NULL, AV_LOG_INFO, "encoder <- type:%s "
                    "frame_pts:%s frame_pts_time:%s time_base:%d/%d\n",
@@ -841,8 +855,8 @@ static int encode_frame(OutputFile *of, OutputStream *ost, AVFrame *frame)
             av_assert0(frame); // should never happen during flushing
             return 0;
         } else if (ret == AVERROR_EOF) {
-            of_output_packet(of, pkt, ost, 1);
-            return ret;
+            ret = of_submit_packet(of, pkt, ost, 1);
+            return ret < 0 && exit_on_error ? ret : AVERROR_EOF;
         } else if (ret < 0) {
             av_log(NULL, AV_LOG_ERROR, "%s encoding failed\n", type_desc);
             return ret;
@@ -877,19 +891,175 @@ static int encode_frame(OutputFile *of, OutputStream *ost, AVFrame *frame)
 
         ost->packets_encoded++;
 
-        of_output_packet(of, pkt, ost, 0);
+        /* this may run on an encoding thread, so leave acting on -xerror to
+         * the main thread */
+        ret = of_submit_packet(of, pkt, ost, 0);
+        if (ret < 0 && exit_on_error)
+            return ret;
     }
 
     av_assert0(0);
 }
 
+static void *encoder_thread(void *arg)
+{
+    OutputStream *ost = arg;
+    OutputFile    *of = output_files[ost->file_index];
+    AVFrame    *frame = NULL;
+    char name[16];
+    int ret = 0;
+
+    frame = av_frame_alloc();
+    if (!frame) {
+        ret = AVERROR(ENOMEM);
+        goto finish;
+    }
+
+    snprintf(name, sizeof(name), "enc%d:%d:%s", ost->file_index, ost->index,
+             ost->enc_ctx->codec->name);
+    ff_thread_setname(name);
+
+    while (1) {
+        int stream_idx;
+
+        ret = tq_receive(ost->enc_tq, &stream_idx, frame);
+        if (ret < 0) {
+            /* the main thread is done sending frames, flush the encoder */
+            ret = encode_frame(of, ost, NULL);
+            if (ret == AVERROR_EOF)
+                ret = 0;
+            break;
+        }
+
+        ret = encode_frame(of, ost, frame);
+        av_frame_unref(frame);
+        if (ret < 0) {
+            av_log(NULL, AV_LOG_ERROR, "Error encoding a frame for output "
+                   "stream #%d:%d\n", ost->file_index, ost->index);
+            break;
+        }
+    }
+
+finish:
+    av_frame_free(&frame);
+
+    tq_receive_finish(ost->enc_tq, 0);
+
+    av_log(NULL, AV_LOG_VERBOSE, "Terminating encoder thread %d:%d\n",
+           ost->file_index, ost->index);
+
+    return (void*)(intptr_t)ret;
+}
+
+static void frame_move(void *dst, void *src)
+{
+    av_frame_move_ref(dst, src);
+}
+
+static int enc_thread_start(OutputStream *ost)
+{
+    ObjPool *op;
+    int ret;
+
+    ost->enc_tq_frame = av_frame_alloc();
+    if (!ost->enc_tq_frame)
+        return AVERROR(ENOMEM);
+
+    op = objpool_alloc_frames();
+    if (!op) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    ost->enc_tq = tq_alloc(1, 8, op, frame_move, TQ_FLAG_SPSC);
+    if (!ost->enc_tq) {
+        objpool_free(&op);
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+
+    ret = pthread_create(&ost->enc_thread, NULL, encoder_thread, ost);
+    if (ret) {
+        tq_free(&ost->enc_tq);
+        ret = AVERROR(ret);
+        goto fail;
+    }
+
+    return 0;
+fail:
+    av_frame_free(&ost->enc_tq_frame);
+    return ret;
+}
+
+static int enc_thread_stop(OutputStream *ost)
+{
+    void *ret;
+
+    if (!ost->enc_tq)
+        return 0;
+
+    tq_send_finish(ost->enc_tq, 0);
+
+    pthread_join(ost->enc_thread, &ret);
+
+    tq_free(&ost->enc_tq);
+    av_frame_free(&ost->enc_tq_frame);
+    ost->enc_thread_done = 1;
+
+    return (int)(intptr_t)ret;
+}
+
+/*
+ * Send a frame to the encoder, or flush it when frame is NULL. With
+ * -threaded_encoding, the frames are handed to a per-stream encoding thread
+ * once the muxer has been initialized; before that (and after the thread was
+ * stopped) the encoder is run synchronously.
+ */
+static int enc_send_frame(OutputFile *of, OutputStream *ost, AVFrame *frame)
+{
+    int ret;
+
+    if (!threaded_encoding)
+        return encode_frame(of, ost, frame);
+
+    if (!ost->enc_tq) {
+        if (ost->enc_thread_done || !frame || !of_muxer_ready(of))
+            return encode_frame(of, ost, frame);
+
+        ret = enc_thread_start(ost);
+        if (ret < 0) {
+            av_log(NULL, AV_LOG_ERROR, "Error starting encoder thread for "
+                   "output stream #%d:%d\n", ost->file_index, ost->index);
+            return ret;
+        }
+    }
+
+    if (frame) {
+        ret = av_frame_ref(ost->enc_tq_frame, frame);
+        if (ret < 0)
+            return ret;
+
+        ret = tq_send(ost->enc_tq, 0, ost->enc_tq_frame);
+        if (ret >= 0)
+            return 0;
+
+        av_frame_unref(ost->enc_tq_frame);
+        if (ret != AVERROR_EOF)
+            return ret;
+    }
+
+    /* either flushing or the encoding thread terminated */
+    ret = enc_thread_stop(ost);
+    return ret < 0 ? ret : AVERROR_EOF;
+}
+
 static int submit_encode_frame(OutputFile *of, OutputStream *ost,
                                AVFrame *frame)
 {
     int ret;
 
     if (ost->sq_idx_encode < 0)
-        return encode_frame(of, ost, frame);
+        return enc_send_frame(of, ost, frame);
 
     if (frame) {
         ret = av_frame_ref(ost->sq_frame, frame);
@@ -918,7 +1088,7 @@ static int submit_encode_frame(OutputFile *of, OutputStream *ost,
             return (ret == AVERROR(EAGAIN)) ? 0 : ret;
         }
 
-        ret = encode_frame(of, ost, enc_frame);
+        ret = enc_send_frame(of, ost, enc_frame);
         if (enc_frame)
             av_frame_unref(enc_frame);
         if (ret < 0) {
@@ -1309,9 +1479,6 @@ static int reap_filters(int flush)
 
             switch (av_buffersink_get_type(filter)) {
             case AVMEDIA_TYPE_VIDEO:
-                if (!ost->frame_aspect_ratio.num)
-                    enc->sample_aspect_ratio = filtered_frame->sample_aspect_ratio;
-
                 do_video_out(of, ost, filtered_frame);
                 break;
             case AVMEDIA_TYPE_AUDIO:
@@ -1491,7 +1658,8 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
     av_bprint_init(&buf_script, 0, AV_BPRINT_SIZE_AUTOMATIC);
     for (OutputStream *ost = ost_iter(NULL); ost; ost = ost_iter(ost)) {
         const AVCodecContext * const enc = ost->enc_ctx;
-        const float q = enc ? ost->quality / (float) FF_QP2LAMBDA : -1;
+        const float q = enc ? atomic_load(&ost->quality) / (float) FF_QP2LAMBDA : -1;
+        int64_t last_mux_dts;
 
         if (vid && ost->st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
             av_bprintf(&buf, "q=%2.1f ", q);
@@ -1521,7 +1689,7 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
             }
 
             if (enc && (enc->flags & AV_CODEC_FLAG_PSNR) &&
-                (ost->pict_type != AV_PICTURE_TYPE_NONE || is_last_report)) {
+                (atomic_load(&ost->pict_type) != AV_PICTURE_TYPE_NONE || is_last_report)) {
                 int j;
                 double error, error_sum = 0;
                 double scale, scale_sum = 0;
@@ -1533,7 +1701,7 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
                         error = enc->error[j];
                         scale = enc->width * enc->height * 255.0 * 255.0 * frame_number;
                     } else {
-                        error = ost->error[j];
+                        error = atomic_load(&ost->error[j]);
                         scale = enc->width * enc->height * 255.0 * 255.0;
                     }
                     if (j)
@@ -1553,8 +1721,9 @@ static void print_report(int is_last_report, int64_t timer_start, int64_t cur_ti
             vid = 1;
         }
         /* compute min output value */
-        if (ost->last_mux_dts != AV_NOPTS_VALUE) {
-            pts = FFMAX(pts, ost->last_mux_dts);
+        last_mux_dts = atomic_load(&ost->last_mux_dts);
+        if (last_mux_dts != AV_NOPTS_VALUE) {
+            pts = FFMAX(pts, last_mux_dts);
             if (copy_ts) {
                 if (copy_ts_first_pts == AV_NOPTS_VALUE && pts > 1)
                     copy_ts_first_pts = pts;
@@ -2094,7 +2263,10 @@ static int decode_video(InputStream *ist, AVPacket *pkt, int *got_output, int64_
     }
 
     update_benchmark(NULL);
-    ret = decode(ist->dec_ctx, decoded_frame, got_output, pkt);
+    if (ist->segdec)
+        ret = segdec_decode(ist->segdec, decoded_frame, got_output, pkt, eof);
+    else
+        ret = decode(ist->dec_ctx, decoded_frame, got_output, pkt);
     update_benchmark("decode_video %d.%d", ist->file_index, ist->st->index);
     if (ret < 0)
         *decode_failed = 1;
@@ -2562,6 +2734,16 @@ static int init_input_stream(InputStream *ist, char *error, int error_len)
             return ret;
         }
 
+        if (ist->segment_parallel > 1) {
+            ret = segdec_open(ist);
+            if (ret < 0) {
+                snprintf(error, error_len, "Error starting segment-parallel "
+                         "decoding for input stream #%d:%d : %s",
+                         ist->file_index, ist->st->index, av_err2str(ret));
+                return ret;
+            }
+        }
+
         if ((ret = avcodec_open2(ist->dec_ctx, codec, &ist->decoder_opts)) < 0) {
             if (ret == AVERROR_EXPERIMENTAL)
                 abort_codec_experimental(codec, 0);
@@ -2967,6 +3149,13 @@ static int init_output_stream(OutputStream *ost, AVFrame *frame,
                     ost->file_index, ost->index);
             return ret;
         }
+        if (codec->type == AVMEDIA_TYPE_VIDEO && vstats_filename && !vstats_file) {
+            vstats_file = fopen(vstats_filename, "w");
+            if (!vstats_file) {
+                perror("fopen");
+                exit_program(1);
+            }
+        }
         if (codec->type == AVMEDIA_TYPE_AUDIO &&
             !(codec->capabilities & AV_CODEC_CAP_VARIABLE_FRAME_SIZE))
             av_buffersink_set_frame_size(ost->filter->filter,
@@ -3208,12 +3397,13 @@ static OutputStream *choose_output(void)
         if (ost->filter && ost->last_filter_pts != AV_NOPTS_VALUE) {
             opts = ost->last_filter_pts;
         } else {
-            opts = ost->last_mux_dts == AV_NOPTS_VALUE ?
-                   INT64_MIN : ost->last_mux_dts;
-            if (ost->last_mux_dts == AV_NOPTS_VALUE)
+            int64_t last_mux_dts = atomic_load(&ost->last_mux_dts);
+            opts = last_mux_dts == AV_NOPTS_VALUE ?
+                   INT64_MIN : last_mux_dts;
+            if (last_mux_dts == AV_NOPTS_VALUE)
                 av_log(NULL, AV_LOG_DEBUG,
                     "cur_dts is invalid st:%d (%d) [init:%d i_done:%d finish:%d] (this is harmless if it occurs once at the start per stream)\n",
-                    ost->st->index, ost->st->id, ost->initialized, ost->inputs_done, ost->finished);
+                    ost->st->index, ost->st->id, ost->initialized, ost->inputs_done, atomic_load(&ost->finished));
         }
 
         if (!ost->initialized && !ost->inputs_done)
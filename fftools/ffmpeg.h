@@ -28,6 +28,7 @@
 
 #include "cmdutils.h"
 #include "sync_queue.h"
+#include "thread_queue.h"
 
 #include "libavformat/avformat.h"
 #include "libavformat/avio.h"
@@ -222,6 +223,8 @@ typedef struct OptionsContext {
     int        nb_filter_scripts;
     SpecifierOpt *reinit_filters;
     int        nb_reinit_filters;
+    SpecifierOpt *segment_parallel;
+    int        nb_segment_parallel;
     SpecifierOpt *fix_sub_duration;
     int        nb_fix_sub_duration;
     SpecifierOpt *canvas_sizes;
@@ -311,6 +314,9 @@ typedef struct FilterGraph {
     // true when the filtergraph contains only meta filters
     // that do not modify the frame data
     int is_meta;
+    // true when the graph replaces simple filtergraphs fed by the same
+    // input stream, running their common leading filters only once
+    int shared_prefix;
 
     InputFilter   **inputs;
     int          nb_inputs;
@@ -318,6 +324,8 @@ typedef struct FilterGraph {
     int         nb_outputs;
 } FilterGraph;
 
+typedef struct SegmentDecoder SegmentDecoder;
+
 typedef struct InputStream {
     int file_index;
     AVStream *st;
@@ -402,6 +410,10 @@ typedef struct InputStream {
 
     int reinit_filters;
 
+    /* number of workers decoding segments of the stream in parallel */
+    int segment_parallel;
+    SegmentDecoder *segdec;
+
     /* hwaccel options */
     enum HWAccelID hwaccel_id;
     enum AVHWDeviceType hwaccel_device_type;
@@ -435,6 +447,8 @@ typedef struct InputFile {
     int index;
 
     AVFormatContext *ctx;
+    /* options the input was opened with, to open it again */
+    AVDictionary *format_opts;
     int eof_reached;      /* true if eof reached */
     int eagain;           /* true if last read attempt returned EAGAIN */
     int64_t input_ts_offset;
@@ -523,8 +537,9 @@ typedef struct OutputStream {
     /* predicted pts of the next frame to be encoded
      * audio/video encoding only */
     int64_t next_pts;
-    /* dts of the last packet sent to the muxing queue, in AV_TIME_BASE_Q */
-    int64_t last_mux_dts;
+    /* dts of the last packet sent to the muxing queue, in AV_TIME_BASE_Q;
+     * may be updated from the encoding thread */
+    atomic_int_least64_t last_mux_dts;
     /* pts of the last frame received from the filters, in AV_TIME_BASE_Q */
     int64_t last_filter_pts;
 
@@ -584,7 +599,7 @@ typedef struct OutputStream {
     AVDictionary *sws_dict;
     AVDictionary *swr_opts;
     char *apad;
-    OSTFinished finished;        /* no more packets should be written for this stream */
+    atomic_int finished;         /* no more packets should be written for this stream, see OSTFinished */
     int unavailable;                     /* true if the steram is unavailable (possibly temporarily) */
 
     // init_output_stream() has been called for this stream
@@ -614,17 +629,27 @@ typedef struct OutputStream {
     // number of packets received from the encoder
     uint64_t packets_encoded;
 
+    /* the following are updated by the encoding thread with
+     * -threaded_encoding and read by print_report() */
     /* packet quality factor */
-    int quality;
+    atomic_int quality;
 
     /* packet picture type */
-    int pict_type;
+    atomic_int pict_type;
 
     /* frame encode sum of squared error values */
-    int64_t error[4];
+    atomic_int_least64_t error[4];
 
     int sq_idx_encode;
     int sq_idx_mux;
+
+    /* encoding thread, only used with -threaded_encoding;
+     * frames are sent to it through enc_tq once the muxer is initialized */
+    pthread_t    enc_thread;
+    ThreadQueue *enc_tq;
+    AVFrame     *enc_tq_frame;
+    /* the encoding thread has been started and joined */
+    int          enc_thread_done;
 } OutputStream;
 
 typedef struct OutputFile {
@@ -682,6 +707,8 @@ extern float max_error_rate;
 
 extern char *filter_nbthreads;
 extern int filter_complex_nbthreads;
+extern int filter_complex_parallel;
+extern int filter_share_prefix;
 extern int vstats_version;
 extern int auto_conversion_filters;
 
@@ -697,6 +724,7 @@ extern int ignore_unknown_streams;
 extern int copy_unknown_streams;
 
 extern int recast_media;
+extern int threaded_encoding;
 
 #if FFMPEG_OPT_PSNR
 extern int do_psnr;
@@ -720,6 +748,7 @@ int configure_filtergraph(FilterGraph *fg);
 void check_filter_outputs(void);
 int filtergraph_is_simple(FilterGraph *fg);
 int init_simple_filtergraph(InputStream *ist, OutputStream *ost);
+int filtergraph_share_prefixes(void);
 int init_complex_filtergraph(FilterGraph *fg);
 
 void sub2video_update(InputStream *ist, int64_t heartbeat_pts, AVSubtitle *sub);
@@ -738,6 +767,21 @@ int hw_device_setup_for_filter(FilterGraph *fg);
 
 int hwaccel_decode_init(AVCodecContext *avctx);
 
+/*
+ * Start decoding the stream with ist->segment_parallel workers, each decoding
+ * whole segments of the stream cut at keyframes of the demuxer index. Sets
+ * ist->segdec, unless the stream cannot be decoded that way.
+ */
+int segdec_open(InputStream *ist);
+/*
+ * Same as decode(), returning the frames of all segments in order. The
+ * packet is not decoded, it only tells whether the caller may wait for
+ * the next frame.
+ */
+int segdec_decode(SegmentDecoder *sd, AVFrame *frame, int *got_frame,
+                  const AVPacket *pkt, int eof);
+void segdec_free(SegmentDecoder **psd);
+
 /*
  * Initialize muxing state for the given stream, should be called
  * after the codec/streamcopy setup has been done.
@@ -746,6 +790,11 @@ int hwaccel_decode_init(AVCodecContext *avctx);
  */
 int of_stream_init(OutputFile *of, OutputStream *ost);
 int of_write_trailer(OutputFile *of);
+/*
+ * Return 1 when the muxer for this file has been initialized and
+ * packets are sent directly to the muxing thread, 0 otherwise.
+ */
+int of_muxer_ready(OutputFile *of);
 int of_open(const OptionsContext *o, const char *filename);
 void of_close(OutputFile **pof);
 
@@ -761,6 +810,11 @@ void of_close(OutputFile **pof);
  * must be supplied in this case.
  */
 void of_output_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost, int eof);
+/*
+ * Same as of_output_packet(), but return errors instead of exiting with
+ * -xerror; safe to call from the encoding threads.
+ */
+int of_submit_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost, int eof);
 int64_t of_filesize(OutputFile *of);
 
 int ifile_open(const OptionsContext *o, const char *filename);
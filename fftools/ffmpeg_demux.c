@@ -40,6 +40,7 @@
 
 static const char *const opt_name_discard[]                   = {"discard", NULL};
 static const char *const opt_name_reinit_filters[]            = {"reinit_filter", NULL};
+static const char *const opt_name_segment_parallel[]          = {"segment_parallel", NULL};
 static const char *const opt_name_fix_sub_duration[]          = {"fix_sub_duration", NULL};
 static const char *const opt_name_canvas_sizes[]              = {"canvas_size", NULL};
 static const char *const opt_name_guess_layout_max[]          = {"guess_layout_max", NULL};
@@ -461,6 +462,7 @@ static void ist_free(InputStream **pist)
     if (!ist)
         return;
 
+    segdec_free(&ist->segdec);
     av_frame_free(&ist->decoded_frame);
     av_packet_free(&ist->pkt);
     av_dict_free(&ist->decoder_opts);
@@ -491,6 +493,7 @@ void ifile_close(InputFile **pf)
     av_freep(&f->streams);
 
     avformat_close_input(&f->ctx);
+    av_dict_free(&f->format_opts);
 
     av_freep(pf);
 }
@@ -770,6 +773,16 @@ static void add_input_streams(const OptionsContext *o, Demuxer *d)
 
             ist->framerate_guessed = av_guess_frame_rate(ic, st, NULL);
 
+            MATCH_PER_STREAM_OPT(segment_parallel, i, ist->segment_parallel, ic, st);
+            if (ist->segment_parallel > 1 &&
+                (o->start_time != AV_NOPTS_VALUE || o->start_time_eof != AV_NOPTS_VALUE ||
+                 o->loop)) {
+                av_log(NULL, AV_LOG_WARNING, "Segment-parallel decoding is not "
+                       "supported with input seeking or looping, disabling it "
+                       "for stream #%d:%d\n", f->index, st->index);
+                ist->segment_parallel = 0;
+            }
+
             break;
         case AVMEDIA_TYPE_AUDIO:
             ist->guess_layout_max = INT_MAX;
@@ -847,7 +860,7 @@ int ifile_open(const OptionsContext *o, const char *filename)
     const AVInputFormat *file_iformat = NULL;
     int err, i, ret;
     int64_t timestamp;
-    AVDictionary *unused_opts = NULL;
+    AVDictionary *unused_opts = NULL, *format_opts = NULL;
     const AVDictionaryEntry *e = NULL;
     char *   video_codec_name = NULL;
     char *   audio_codec_name = NULL;
@@ -958,6 +971,9 @@ int ifile_open(const OptionsContext *o, const char *filename)
         av_dict_set(&o->g->format_opts, "scan_all_pmts", "1", AV_DICT_DONT_OVERWRITE);
         scan_all_pmts_set = 1;
     }
+    /* keep the options for opening the input again */
+    if (av_dict_copy(&format_opts, o->g->format_opts, 0) < 0)
+        report_and_exit(AVERROR(ENOMEM));
     /* open the input file with generic avformat function */
     err = avformat_open_input(&ic, filename, file_iformat, &o->g->format_opts);
     if (err < 0) {
@@ -1048,6 +1064,7 @@ int ifile_open(const OptionsContext *o, const char *filename)
     f = &d->f;
 
     f->ctx        = ic;
+    f->format_opts = format_opts;
     f->index      = nb_input_files - 1;
     f->start_time = start_time;
     f->recording_time = recording_time;
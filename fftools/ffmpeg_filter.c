@@ -352,6 +352,345 @@ fail:
     return ret;
 }
 
+/* Split a simple filtergraph description into its filters. Returns 0 and
+ * sets *pnb to 0 if the description is not a plain unlabeled chain. */
+static int split_filter_chain(const char *desc, char ***pfilters, int *pnb)
+{
+    const char *start = desc, *p;
+    int quoted = 0;
+
+    *pnb = 0;
+    for (p = desc; ; p++) {
+        char *filter;
+        size_t len;
+
+        if (*p == '\\' && p[1]) {
+            p++;
+            continue;
+        }
+        if (*p == '\'')
+            quoted = !quoted;
+        if (*p && (quoted || *p != ',')) {
+            if (*p == '[' || *p == ';')
+                goto not_chain;
+            continue;
+        }
+
+        while (av_isspace(*start))
+            start++;
+        len = p - start;
+        while (len && av_isspace(start[len - 1]))
+            len--;
+        if (!len)
+            goto not_chain;
+
+        filter = av_strndup(start, len);
+        if (!filter)
+            return AVERROR(ENOMEM);
+        if (av_dynarray_add_nofree(pfilters, pnb, filter) < 0) {
+            av_free(filter);
+            return AVERROR(ENOMEM);
+        }
+
+        if (!*p)
+            break;
+        start = p + 1;
+    }
+    return 0;
+
+not_chain:
+    while (*pnb)
+        av_freep(&(*pfilters)[--*pnb]);
+    return 0;
+}
+
+static int same_dict(const AVDictionary *a, const AVDictionary *b)
+{
+    const AVDictionaryEntry *e = NULL, *f;
+
+    if (av_dict_count(a) != av_dict_count(b))
+        return 0;
+    while ((e = av_dict_iterate(a, e)))
+        if (!(f = av_dict_get(b, e->key, NULL, 0)) || strcmp(e->value, f->value))
+            return 0;
+    return 1;
+}
+
+typedef struct ChainCandidate {
+    FilterGraph *fg;
+    char       **filters;
+    int          nb_filters;
+    /* conversions inserted after the filters, see output_conversions() */
+    char        *conv;
+} ChainCandidate;
+
+/* Describe as a filter chain the scaling and format conversions that
+ * configure_output_*_filter() inserts for the output of a simple filtergraph.
+ * The chain is left empty if these conversions cannot run before a split. */
+static int output_conversions(OutputFilter *ofilter, char **pconv)
+{
+    OutputStream *ost = ofilter->ost;
+    enum AVMediaType type = ost->st->codecpar->codec_type;
+    AVBPrint conv, fmts;
+
+    av_bprint_init(&conv, 0, AV_BPRINT_SIZE_UNLIMITED);
+    av_bprint_init(&fmts, 0, AV_BPRINT_SIZE_UNLIMITED);
+
+    if (type == AVMEDIA_TYPE_VIDEO && !ost->keep_pix_fmt) {
+        const AVDictionaryEntry *e = NULL;
+        const char *pix_fmts;
+
+        if ((ofilter->width || ofilter->height) && ost->autoscale) {
+            av_bprintf(&conv, "scale=%d:%d", ofilter->width, ofilter->height);
+            while ((e = av_dict_iterate(ost->sws_dict, e)))
+                av_bprintf(&conv, ":%s=%s", e->key, e->value);
+        }
+        if ((pix_fmts = choose_pix_fmts(ofilter, &fmts)))
+            av_bprintf(&conv, "%sformat=pix_fmts=%s", conv.len ? "," : "", pix_fmts);
+#if FFMPEG_OPT_MAP_CHANNEL
+    } else if (type == AVMEDIA_TYPE_AUDIO && !ost->audio_channels_mapped) {
+#else
+    } else if (type == AVMEDIA_TYPE_AUDIO) {
+#endif
+        choose_sample_fmts(ofilter,     &fmts);
+        choose_sample_rates(ofilter,    &fmts);
+        choose_channel_layouts(ofilter, &fmts);
+        /* drop the trailing ':' */
+        if (fmts.len)
+            av_bprintf(&conv, "aformat=%.*s", (int)fmts.len - 1, fmts.str);
+    }
+
+    av_bprint_finalize(&fmts, NULL);
+    return av_bprint_finalize(&conv, pconv);
+}
+
+static int can_share_prefix(const ChainCandidate *a, const ChainCandidate *b)
+{
+    const OutputStream *oa = a->fg->outputs[0]->ost, *ob = b->fg->outputs[0]->ost;
+
+    return a->nb_filters && b->nb_filters &&
+           !strcmp(a->filters[0], b->filters[0]) &&
+           same_dict(oa->sws_dict, ob->sws_dict) &&
+           same_dict(oa->swr_opts, ob->swr_opts);
+}
+
+/* replace the simple filtergraphs of group by a single one, in which the
+ * filters of their common prefix are only run once */
+static int merge_simple_filtergraphs(InputStream *ist, ChainCandidate **group,
+                                     int nb_group, int nb_prefix, const char *conv)
+{
+    enum AVMediaType type = ist->st->codecpar->codec_type;
+    FilterGraph *fg, *first = group[0]->fg;
+    AVFilterGraph *graph;
+    AVFilterInOut *inputs = NULL, *outputs = NULL, *cur;
+    InputFilter *ifilter = first->inputs[0];
+    AVBPrint desc;
+    int ret, pos;
+
+    av_bprint_init(&desc, 0, AV_BPRINT_SIZE_UNLIMITED);
+    for (int i = 0; i < nb_prefix; i++)
+        av_bprintf(&desc, "%s,", group[0]->filters[i]);
+    if (conv)
+        av_bprintf(&desc, "%s,", conv);
+    av_bprintf(&desc, "%s=%d", type == AVMEDIA_TYPE_AUDIO ? "asplit" : "split", nb_group);
+    for (int i = 0; i < nb_group; i++)
+        av_bprintf(&desc, "[s%d]", i);
+    for (int i = 0; i < nb_group; i++) {
+        av_bprintf(&desc, ";[s%d]", i);
+        if (group[i]->nb_filters == nb_prefix)
+            av_bprintf(&desc, "%s", type == AVMEDIA_TYPE_AUDIO ? "anull" : "null");
+        for (int j = nb_prefix; j < group[i]->nb_filters; j++)
+            av_bprintf(&desc, "%s%s", j > nb_prefix ? "," : "", group[i]->filters[j]);
+        av_bprintf(&desc, "[o%d]", i);
+    }
+
+    fg = av_mallocz(sizeof(*fg));
+    if (!fg) {
+        av_bprint_finalize(&desc, NULL);
+        return AVERROR(ENOMEM);
+    }
+    ret = av_bprint_finalize(&desc, (char **)&fg->graph_desc);
+    if (ret < 0)
+        goto fail;
+    fg->index         = first->index;
+    fg->shared_prefix = 1;
+
+    /* as in init_complex_filtergraph(), only used for naming the links */
+    graph = avfilter_graph_alloc();
+    if (!graph) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    graph->nb_threads = 1;
+
+    ret = avfilter_graph_parse2(graph, fg->graph_desc, &inputs, &outputs);
+    if (ret < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Error sharing the filters common to the "
+               "filtergraphs of input stream #%d:%d: %s\n",
+               ist->file_index, ist->st->index, av_err2str(ret));
+        avfilter_graph_free(&graph);
+        goto fail;
+    }
+    av_assert0(inputs && !inputs->next);
+
+    ifilter->graph = fg;
+    ifilter->type  = type;
+    ifilter->name  = describe_filter_link(fg, inputs, 1);
+    GROW_ARRAY(fg->inputs, fg->nb_inputs);
+    fg->inputs[0] = ifilter;
+
+    for (cur = outputs; cur; cur = cur->next) {
+        OutputFilter *ofilter = group[atoi(cur->name + 1)]->fg->outputs[0];
+
+        ofilter->graph = fg;
+        ofilter->type  = type;
+        ofilter->name  = describe_filter_link(fg, cur, 0);
+        GROW_ARRAY(fg->outputs, fg->nb_outputs);
+        fg->outputs[fg->nb_outputs - 1] = ofilter;
+    }
+    avfilter_inout_free(&inputs);
+    avfilter_inout_free(&outputs);
+    avfilter_graph_free(&graph);
+
+    /* drop the replaced graphs and the inputs they no longer need */
+    for (int i = 0; i < nb_group; i++) {
+        FilterGraph *old = group[i]->fg;
+
+        for (int j = 0; j < old->nb_inputs; j++) {
+            InputFilter *unused = old->inputs[j];
+
+            if (unused == ifilter)
+                continue;
+            for (int k = 0; k < ist->nb_filters; k++)
+                if (ist->filters[k] == unused)
+                    memmove(&ist->filters[k], &ist->filters[k + 1],
+                            (--ist->nb_filters - k) * sizeof(*ist->filters));
+            av_fifo_freep2(&unused->frame_queue);
+            av_freep(&unused);
+        }
+
+        for (pos = 0; filtergraphs[pos] != old; pos++)
+            ;
+        if (old == first) {
+            filtergraphs[pos] = fg;
+        } else {
+            memmove(&filtergraphs[pos], &filtergraphs[pos + 1],
+                    (--nb_filtergraphs - pos) * sizeof(*filtergraphs));
+        }
+
+        av_freep(&old->inputs);
+        av_freep(&old->outputs);
+        av_freep(&old);
+    }
+    for (int i = 0; i < nb_filtergraphs; i++)
+        filtergraphs[i]->index = i;
+
+    av_log(NULL, AV_LOG_VERBOSE, "Input stream #%d:%d: sharing %d filter(s) "
+           "between %d filtergraphs: %s\n", ist->file_index, ist->st->index,
+           nb_prefix, nb_group, fg->graph_desc);
+
+    return 0;
+fail:
+    av_freep(&fg->graph_desc);
+    av_freep(&fg);
+    return ret;
+}
+
+int filtergraph_share_prefixes(void)
+{
+    for (InputStream *ist = ist_iter(NULL); ist; ist = ist_iter(ist)) {
+        enum AVMediaType type = ist->st->codecpar->codec_type;
+        ChainCandidate *cands = NULL, **group = NULL;
+        int nb_cands = 0, ret = 0;
+
+        if (type != AVMEDIA_TYPE_VIDEO && type != AVMEDIA_TYPE_AUDIO)
+            continue;
+
+        cands = av_calloc(ist->nb_filters, sizeof(*cands));
+        group = av_calloc(ist->nb_filters, sizeof(*group));
+        if (!cands || !group) {
+            ret = AVERROR(ENOMEM);
+            goto next;
+        }
+
+        for (int i = 0; i < ist->nb_filters; i++) {
+            FilterGraph *fg = ist->filters[i]->graph;
+            ChainCandidate *c = &cands[nb_cands];
+
+            if (!filtergraph_is_simple(fg) || !fg->outputs[0]->ost ||
+                !fg->outputs[0]->ost->avfilter)
+                continue;
+            ret = split_filter_chain(fg->outputs[0]->ost->avfilter,
+                                     &c->filters, &c->nb_filters);
+            if (ret >= 0)
+                ret = output_conversions(fg->outputs[0], &c->conv);
+            if (ret < 0)
+                goto next;
+            c->fg = fg;
+            nb_cands++;
+        }
+
+        for (int i = 0; i < nb_cands; i++) {
+            int nb_group = 0, nb_prefix;
+            const char *conv;
+
+            if (!cands[i].fg)
+                continue;
+
+            nb_prefix = cands[i].nb_filters;
+            for (int j = i; j < nb_cands; j++) {
+                if (!cands[j].fg || (j > i && !can_share_prefix(&cands[i], &cands[j])))
+                    continue;
+                if (j > i) {
+                    int n = 0;
+                    while (n < nb_prefix && n < cands[j].nb_filters &&
+                           !strcmp(cands[i].filters[n], cands[j].filters[n]))
+                        n++;
+                    nb_prefix = n;
+                }
+                group[nb_group++] = &cands[j];
+            }
+            if (!cands[i].nb_filters || nb_group < 2)
+                continue;
+
+            /* when the whole chains are the same, the conversions to the
+             * encoder size and formats are the same as well if they have
+             * the same parameters, so they can be run before the split */
+            conv = cands[i].conv[0] ? cands[i].conv : NULL;
+            for (int j = 0; j < nb_group && conv; j++)
+                if (group[j]->nb_filters != nb_prefix || strcmp(group[j]->conv, conv))
+                    conv = NULL;
+
+            /* sharing pass-through filters gains nothing */
+            while (nb_prefix && (!strcmp(cands[i].filters[nb_prefix - 1], "null") ||
+                                 !strcmp(cands[i].filters[nb_prefix - 1], "anull")))
+                nb_prefix--;
+            if (!nb_prefix && !conv)
+                continue;
+
+            ret = merge_simple_filtergraphs(ist, group, nb_group, nb_prefix, conv);
+            if (ret < 0)
+                goto next;
+            for (int j = 0; j < nb_group; j++)
+                group[j]->fg = NULL;
+        }
+
+next:
+        for (int i = 0; i < nb_cands; i++) {
+            for (int j = 0; j < cands[i].nb_filters; j++)
+                av_freep(&cands[i].filters[j]);
+            av_freep(&cands[i].filters);
+            av_freep(&cands[i].conv);
+        }
+        av_freep(&cands);
+        av_freep(&group);
+        if (ret < 0)
+            return ret;
+    }
+
+    return 0;
+}
+
 static int insert_trim(int64_t start_time, int64_t duration,
                        AVFilterContext **last_filter, int *pad_idx,
                        const char *filter_name)
@@ -970,7 +1309,7 @@ int configure_filtergraph(FilterGraph *fg)
     if (!(fg->graph = avfilter_graph_alloc()))
         return AVERROR(ENOMEM);
 
-    if (simple) {
+    if (simple || fg->shared_prefix) {
         OutputStream *ost = fg->outputs[0]->ost;
 
         if (filter_nbthreads) {
@@ -1002,6 +1341,8 @@ int configure_filtergraph(FilterGraph *fg)
         }
     } else {
         fg->graph->nb_threads = filter_complex_nbthreads;
+        if (filter_complex_parallel)
+            fg->graph->thread_type |= AVFILTER_THREAD_GRAPH;
     }
 
     if ((ret = avfilter_graph_parse2(fg->graph, graph_desc, &inputs, &outputs)) < 0)
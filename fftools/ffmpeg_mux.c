@@ -253,7 +253,7 @@ finish:
     if (pkt)
         av_packet_unref(pkt);
 
-    ost->finished |= MUXER_FINISHED;
+    atomic_fetch_or(&ost->finished, MUXER_FINISHED);
     tq_send_finish(mux->tq, ost->index);
     return ret == AVERROR_EOF ? 0 : ret;
 }
@@ -319,7 +319,7 @@ static int submit_packet(Muxer *mux, AVPacket *pkt, OutputStream *ost)
     return 0;
 }
 
-void of_output_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost, int eof)
+int of_submit_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost, int eof)
 {
     Muxer *mux = mux_from_of(of);
     MuxStream *ms = ms_from_ost(ost);
@@ -327,7 +327,8 @@ void of_output_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost, int eof)
     int ret = 0;
 
     if (!eof && pkt->dts != AV_NOPTS_VALUE)
-        ost->last_mux_dts = av_rescale_q(pkt->dts, ost->mux_timebase, AV_TIME_BASE_Q);
+        atomic_store(&ost->last_mux_dts,
+                     av_rescale_q(pkt->dts, ost->mux_timebase, AV_TIME_BASE_Q));
 
     /* apply the output bitstream filters */
     if (ms->bsf_ctx) {
@@ -342,7 +343,7 @@ void of_output_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost, int eof)
         while (!bsf_eof) {
             ret = av_bsf_receive_packet(ms->bsf_ctx, pkt);
             if (ret == AVERROR(EAGAIN))
-                return;
+                return 0;
             else if (ret == AVERROR_EOF)
                 bsf_eof = 1;
             else if (ret < 0) {
@@ -360,7 +361,7 @@ void of_output_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost, int eof)
             goto mux_fail;
     }
 
-    return;
+    return 0;
 
 mux_fail:
     err_msg = "submitting a packet to the muxer";
@@ -368,9 +369,13 @@ mux_fail:
 fail:
     av_log(NULL, AV_LOG_ERROR, "Error %s for output stream #%d:%d.\n",
            err_msg, ost->file_index, ost->index);
-    if (exit_on_error)
-        exit_program(1);
+    return ret;
+}
 
+void of_output_packet(OutputFile *of, AVPacket *pkt, OutputStream *ost, int eof)
+{
+    if (of_submit_packet(of, pkt, ost, eof) < 0 && exit_on_error)
+        exit_program(1);
 }
 
 static int thread_stop(Muxer *mux)
@@ -405,7 +410,9 @@ static int thread_start(Muxer *mux)
     if (!op)
         return AVERROR(ENOMEM);
 
-    mux->tq = tq_alloc(fc->nb_streams, mux->thread_queue_size, op, pkt_move);
+    /* with threaded encoding, packets are sent from several threads */
+    mux->tq = tq_alloc(fc->nb_streams, mux->thread_queue_size, op, pkt_move,
+                       threaded_encoding ? 0 : TQ_FLAG_SPSC);
     if (!mux->tq) {
         objpool_free(&op);
         return AVERROR(ENOMEM);
@@ -730,6 +737,11 @@ void of_close(OutputFile **pof)
     av_freep(pof);
 }
 
+int of_muxer_ready(OutputFile *of)
+{
+    return !!mux_from_of(of)->tq;
+}
+
 int64_t of_filesize(OutputFile *of)
 {
     Muxer *mux = mux_from_of(of);
@@ -356,7 +356,7 @@ static OutputStream *new_output_stream(Muxer *mux, const OptionsContext *o,
         ost->ist->discard = 0;
         ost->ist->st->discard = ost->ist->user_set_discard;
     }
-    ost->last_mux_dts = AV_NOPTS_VALUE;
+    atomic_init(&ost->last_mux_dts, AV_NOPTS_VALUE);
     ost->last_filter_pts = AV_NOPTS_VALUE;
 
     MATCH_PER_STREAM_OPT(copy_initial_nonkeyframes, i,
@@ -777,7 +777,7 @@ static OutputStream *new_unknown_stream(Muxer *mux, const OptionsContext *o, Inp
 static OutputStream *new_attachment_stream(Muxer *mux, const OptionsContext *o, InputStream *ist)
 {
     OutputStream *ost = new_output_stream(mux, o, AVMEDIA_TYPE_ATTACHMENT, ist);
-    ost->finished    = 1;
+    atomic_store(&ost->finished, 1);
     return ost;
 }
 
@@ -85,6 +85,8 @@ int stdin_interaction = 1;
 float max_error_rate  = 2.0/3;
 char *filter_nbthreads;
 int filter_complex_nbthreads = 0;
+int filter_complex_parallel = 0;
+int filter_share_prefix = 0;
 int vstats_version = 2;
 int auto_conversion_filters = 1;
 int64_t stats_period = 500000;
@@ -98,6 +100,7 @@ int do_psnr            = 0;
 int ignore_unknown_streams = 0;
 int copy_unknown_streams = 0;
 int recast_media = 0;
+int threaded_encoding = 0;
 
 static void uninit_options(OptionsContext *o)
 {
@@ -1305,6 +1308,14 @@ int ffmpeg_parse_options(int argc, char **argv)
 
     check_filter_outputs();
 
+    if (filter_share_prefix) {
+        ret = filtergraph_share_prefixes();
+        if (ret < 0) {
+            av_log(NULL, AV_LOG_FATAL, "Error sharing filters between filtergraphs: ");
+            goto fail;
+        }
+    }
+
 fail:
     uninit_parse_context(&octx);
     if (ret < 0) {
@@ -1502,10 +1513,17 @@ const OptionDef options[] = {
         "read stream filtergraph description from a file", "filename" },
     { "reinit_filter",  HAS_ARG | OPT_INT | OPT_SPEC | OPT_INPUT,    { .off = OFFSET(reinit_filters) },
         "reinit filtergraph on input parameter changes", "" },
+    { "segment_parallel", OPT_VIDEO | HAS_ARG | OPT_INT | OPT_SPEC |
+                          OPT_EXPERT | OPT_INPUT,                                { .off = OFFSET(segment_parallel) },
+        "decode segments of the stream with this many parallel decoders", "workers" },
     { "filter_complex", HAS_ARG | OPT_EXPERT,                        { .func_arg = opt_filter_complex },
         "create a complex filtergraph", "graph_description" },
     { "filter_complex_threads", HAS_ARG | OPT_INT,                   { &filter_complex_nbthreads },
         "number of threads for -filter_complex" },
+    { "filter_complex_parallel", OPT_BOOL | OPT_EXPERT,              { &filter_complex_parallel },
+        "run independent filters of -filter_complex graphs concurrently" },
+    { "filter_share_prefix", OPT_BOOL | OPT_EXPERT,                  { &filter_share_prefix },
+        "run the leading filters common to the simple filtergraphs of an input stream only once" },
     { "lavfi",          HAS_ARG | OPT_EXPERT,                        { .func_arg = opt_filter_complex },
         "create a complex filtergraph", "graph_description" },
     { "filter_complex_script", HAS_ARG | OPT_EXPERT,                 { .func_arg = opt_filter_complex_script },
@@ -1537,6 +1555,8 @@ const OptionDef options[] = {
     { "thread_queue_size", HAS_ARG | OPT_INT | OPT_OFFSET | OPT_EXPERT | OPT_INPUT | OPT_OUTPUT,
                                                                      { .off = OFFSET(thread_queue_size) },
         "set the maximum number of queued packets from the demuxer" },
+    { "threaded_encoding", OPT_BOOL | OPT_EXPERT,                     { &threaded_encoding },
+        "run every audio/video encoder in a separate thread" },
     { "find_stream_info", OPT_BOOL | OPT_INPUT | OPT_EXPERT | OPT_OFFSET, { .off = OFFSET(find_stream_info) },
         "read and decode the streams to fill missing information with heuristics" },
     { "bits_per_raw_sample", OPT_INT | HAS_ARG | OPT_EXPERT | OPT_SPEC | OPT_OUTPUT,
@@ -0,0 +1,575 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/*
+ * Segment-parallel decoding: the stream is cut at keyframes listed in the
+ * demuxer index, and the segments are decoded by independent workers, each
+ * with its own demuxer and decoder. Segments are assigned to the workers
+ * round-robin, and their frames are merged back in order, so that the rest
+ * of the pipeline sees the same frames as with a single decoder.
+ *
+ * A segment starts with the first keyframe packet whose timestamp is not
+ * lower than the index entry it was planned from. It owns the frames whose
+ * pts lies between the pts of that packet and the pts of the keyframe
+ * starting the next segment, so the worker of a segment keeps decoding past
+ * its end until it has output the leading frames of an open GOP, and the
+ * worker of the next segment drops them.
+ */
+
+#include "libavutil/avassert.h"
+#include "libavutil/avstring.h"
+#include "libavutil/fifo.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+
+#include "libavformat/avformat.h"
+
+#include "ffmpeg.h"
+
+/* minimum duration of a segment, in seconds */
+#define SEGMENT_MIN_DURATION 2
+/* number of decoded frames a worker may queue ahead of the consumer */
+#define SEGMENT_QUEUE_SIZE   64
+
+typedef struct SegmentWorker {
+    struct SegmentDecoder *sd;
+    int              index;
+
+    pthread_t        thread;
+    int              thread_started;
+
+    AVFormatContext *fmt;
+    AVCodecContext  *dec;
+    AVPacket        *pkt;
+    AVFrame         *frame;
+
+    /* decoded frames, a NULL entry marks the end of a segment */
+    AVFifo          *queue;
+    int              err;
+    int              finished;
+} SegmentWorker;
+
+struct SegmentDecoder {
+    InputStream     *ist;
+
+    SegmentWorker   *workers;
+    int              nb_workers;
+
+    /* index timestamp of the first keyframe of each segment; the first
+     * segment starts at the beginning of the file */
+    int64_t         *seg_start;
+    int              nb_segments;
+    /* segment the consumer is reading frames from */
+    int              cur_segment;
+
+    pthread_mutex_t  lock;
+    pthread_cond_t   cond;
+    int              abort;
+
+    AVDictionary    *dec_opts;
+};
+
+static int queue_frame(SegmentWorker *w, AVFrame *frame)
+{
+    SegmentDecoder *sd = w->sd;
+    AVFrame *f = NULL;
+    int ret;
+
+    if (frame) {
+        f = av_frame_alloc();
+        if (!f)
+            return AVERROR(ENOMEM);
+        av_frame_move_ref(f, frame);
+    }
+
+    pthread_mutex_lock(&sd->lock);
+    while (!sd->abort && av_fifo_can_read(w->queue) >= SEGMENT_QUEUE_SIZE)
+        pthread_cond_wait(&sd->cond, &sd->lock);
+    ret = sd->abort ? AVERROR_EXIT : av_fifo_write(w->queue, &f, 1);
+    pthread_cond_broadcast(&sd->cond);
+    pthread_mutex_unlock(&sd->lock);
+
+    if (ret < 0)
+        av_frame_free(&f);
+    return ret;
+}
+
+/* decode errors are not fatal unless requested, like in decode() */
+static int check_error(SegmentWorker *w, int ret)
+{
+    if (ret >= 0 || ret == AVERROR(EAGAIN) || ret == AVERROR_EOF)
+        return 0;
+    if (ret == AVERROR(ENOMEM) || exit_on_error)
+        return ret;
+
+    av_log(NULL, AV_LOG_ERROR, "Error while decoding stream #%d:%d: %s\n",
+           w->sd->ist->file_index, w->sd->ist->st->index, av_err2str(ret));
+    return 0;
+}
+
+static int receive_frames(SegmentWorker *w, int64_t start_pts, int64_t end_pts,
+                          int *done)
+{
+    int ret;
+
+    while (1) {
+        int64_t pts;
+
+        ret = avcodec_receive_frame(w->dec, w->frame);
+        if (ret < 0)
+            return check_error(w, ret);
+
+        pts = w->frame->best_effort_timestamp;
+        if (pts != AV_NOPTS_VALUE && end_pts != AV_NOPTS_VALUE && pts >= end_pts) {
+            /* frames are output in pts order, the next segment owns the rest */
+            av_frame_unref(w->frame);
+            *done = 1;
+            return 0;
+        }
+        if (pts != AV_NOPTS_VALUE && start_pts != AV_NOPTS_VALUE && pts < start_pts) {
+            /* leading frames of an open GOP, output by the previous segment */
+            av_frame_unref(w->frame);
+            continue;
+        }
+
+        ret = queue_frame(w, w->frame);
+        if (ret < 0)
+            return ret;
+    }
+}
+
+static int decode_segment(SegmentWorker *w, int seg)
+{
+    SegmentDecoder *sd = w->sd;
+    int stream_index = sd->ist->st->index;
+    int64_t start = seg ? sd->seg_start[seg] : AV_NOPTS_VALUE;
+    int64_t end   = seg + 1 < sd->nb_segments ? sd->seg_start[seg + 1] : AV_NOPTS_VALUE;
+    int64_t start_pts = AV_NOPTS_VALUE, end_pts = AV_NOPTS_VALUE;
+    int started = !seg, past_end = 0, done = 0;
+    int ret;
+
+    if (seg) {
+        ret = av_seek_frame(w->fmt, stream_index, start, AVSEEK_FLAG_BACKWARD);
+        if (ret < 0)
+            return ret;
+    }
+    avcodec_flush_buffers(w->dec);
+
+    while (!done) {
+        int64_t ts;
+        int key;
+
+        ret = av_read_frame(w->fmt, w->pkt);
+        if (ret == AVERROR_EOF)
+            break;
+        if (ret < 0)
+            return ret;
+
+        if (w->pkt->stream_index != stream_index) {
+            av_packet_unref(w->pkt);
+            continue;
+        }
+
+        key = w->pkt->flags & AV_PKT_FLAG_KEY;
+        ts  = w->pkt->dts != AV_NOPTS_VALUE ? w->pkt->dts : w->pkt->pts;
+
+        if (!started) {
+            if (!key || ts == AV_NOPTS_VALUE || ts < start) {
+                av_packet_unref(w->pkt);
+                continue;
+            }
+            started   = 1;
+            start_pts = w->pkt->pts;
+        } else if (end != AV_NOPTS_VALUE && key && ts != AV_NOPTS_VALUE && ts >= end) {
+            /* without a pts at the boundary, cut at the boundary packet;
+             * otherwise stop at the next keyframe at the latest */
+            if (past_end || w->pkt->pts == AV_NOPTS_VALUE) {
+                av_packet_unref(w->pkt);
+                break;
+            }
+            past_end = 1;
+            end_pts  = w->pkt->pts;
+        }
+
+        ret = avcodec_send_packet(w->dec, w->pkt);
+        av_packet_unref(w->pkt);
+        if ((ret = check_error(w, ret)) < 0)
+            return ret;
+
+        ret = receive_frames(w, start_pts, end_pts, &done);
+        if (ret < 0)
+            return ret;
+    }
+
+    if (done)
+        return 0;
+
+    /* drain the decoder */
+    ret = avcodec_send_packet(w->dec, NULL);
+    if (ret < 0)
+        return ret;
+    return receive_frames(w, start_pts, end_pts, &done);
+}
+
+static void *worker_thread(void *arg)
+{
+    SegmentWorker *w = arg;
+    SegmentDecoder *sd = w->sd;
+    int ret = 0;
+
+    for (int seg = w->index; seg < sd->nb_segments; seg += sd->nb_workers) {
+        ret = decode_segment(w, seg);
+        if (ret < 0)
+            break;
+
+        ret = queue_frame(w, NULL);
+        if (ret < 0)
+            break;
+    }
+
+    if (ret < 0 && ret != AVERROR_EXIT)
+        av_log(NULL, AV_LOG_ERROR, "Segment decoder %d for stream #%d:%d failed: %s\n",
+               w->index, sd->ist->file_index, sd->ist->st->index, av_err2str(ret));
+
+    pthread_mutex_lock(&sd->lock);
+    w->err      = ret;
+    w->finished = 1;
+    pthread_cond_broadcast(&sd->cond);
+    pthread_mutex_unlock(&sd->lock);
+
+    return NULL;
+}
+
+static int worker_init(SegmentDecoder *sd, SegmentWorker *w)
+{
+    InputStream *ist = sd->ist;
+    InputFile *f = input_files[ist->file_index];
+    AVDictionary *opts = NULL;
+    int ret;
+
+    w->sd = sd;
+
+    w->fmt = avformat_alloc_context();
+    if (!w->fmt)
+        return AVERROR(ENOMEM);
+    w->fmt->interrupt_callback = int_cb;
+
+    ret = av_dict_copy(&opts, f->format_opts, 0);
+    if (ret >= 0)
+        ret = avformat_open_input(&w->fmt, f->ctx->url, f->ctx->iformat, &opts);
+    av_dict_free(&opts);
+    if (ret < 0)
+        return ret;
+    if (w->fmt->nb_streams <= ist->st->index ||
+        w->fmt->streams[ist->st->index]->codecpar->codec_id != ist->par->codec_id)
+        return AVERROR(EINVAL);
+    for (int i = 0; i < w->fmt->nb_streams; i++)
+        w->fmt->streams[i]->discard = i == ist->st->index ? AVDISCARD_DEFAULT :
+                                                           AVDISCARD_ALL;
+
+    w->dec = avcodec_alloc_context3(ist->dec);
+    if (!w->dec)
+        return AVERROR(ENOMEM);
+    ret = avcodec_parameters_to_context(w->dec, ist->par);
+    if (ret < 0)
+        return ret;
+    w->dec->pkt_timebase = ist->st->time_base;
+    w->dec->framerate    = ist->dec_ctx->framerate;
+    w->dec->flags       |= ist->dec_ctx->flags;
+    w->dec->flags2      |= ist->dec_ctx->flags2;
+
+    /* the segments are the unit of parallelism */
+    ret = av_dict_copy(&opts, sd->dec_opts, 0);
+    if (ret >= 0)
+        ret = av_dict_set(&opts, "threads", "1", 0);
+    if (ret >= 0)
+        ret = avcodec_open2(w->dec, ist->dec, &opts);
+    av_dict_free(&opts);
+    if (ret < 0)
+        return ret;
+
+    w->pkt   = av_packet_alloc();
+    w->frame = av_frame_alloc();
+    w->queue = av_fifo_alloc2(SEGMENT_QUEUE_SIZE + 1, sizeof(AVFrame*), 0);
+    if (!w->pkt || !w->frame || !w->queue)
+        return AVERROR(ENOMEM);
+
+    return 0;
+}
+
+/* segment boundaries are found by the pts of keyframes */
+static int probe_pts(SegmentDecoder *sd)
+{
+    InputStream *ist = sd->ist;
+    InputFile *f = input_files[ist->file_index];
+    AVFormatContext *fmt;
+    AVDictionary *opts = NULL;
+    AVPacket *pkt;
+    int ret;
+
+    fmt = avformat_alloc_context();
+    pkt = av_packet_alloc();
+    if (!fmt || !pkt) {
+        avformat_free_context(fmt);
+        av_packet_free(&pkt);
+        return AVERROR(ENOMEM);
+    }
+    fmt->interrupt_callback = int_cb;
+
+    ret = av_dict_copy(&opts, f->format_opts, 0);
+    if (ret >= 0)
+        ret = avformat_open_input(&fmt, f->ctx->url, f->ctx->iformat, &opts);
+    av_dict_free(&opts);
+    while (ret >= 0) {
+        ret = av_read_frame(fmt, pkt);
+        if (ret >= 0 && pkt->stream_index == ist->st->index &&
+            pkt->flags & AV_PKT_FLAG_KEY) {
+            ret = pkt->pts != AV_NOPTS_VALUE;
+            break;
+        }
+        av_packet_unref(pkt);
+    }
+
+    av_packet_free(&pkt);
+    avformat_close_input(&fmt);
+    return ret == AVERROR_EOF ? 0 : ret;
+}
+
+static int plan_segments(SegmentDecoder *sd)
+{
+    AVStream *st = sd->ist->st;
+    int nb_entries = avformat_index_get_entries_count(st);
+    int64_t min_dist = av_rescale_q(SEGMENT_MIN_DURATION * AV_TIME_BASE,
+                                    AV_TIME_BASE_Q, st->time_base);
+    int64_t last = AV_NOPTS_VALUE;
+
+    sd->seg_start = av_calloc(nb_entries + 1, sizeof(*sd->seg_start));
+    if (!sd->seg_start)
+        return AVERROR(ENOMEM);
+    sd->seg_start[sd->nb_segments++] = AV_NOPTS_VALUE;
+
+    for (int i = 0; i < nb_entries; i++) {
+        const AVIndexEntry *e = avformat_index_get_entry(st, i);
+
+        if (!(e->flags & AVINDEX_KEYFRAME) || (e->flags & AVINDEX_DISCARD_FRAME))
+            continue;
+
+        /* the first keyframe is in the first segment */
+        if (last != AV_NOPTS_VALUE && e->timestamp - last < min_dist)
+            continue;
+        if (last != AV_NOPTS_VALUE)
+            sd->seg_start[sd->nb_segments++] = e->timestamp;
+        last = e->timestamp;
+    }
+
+    return 0;
+}
+
+int segdec_open(InputStream *ist)
+{
+    AVFormatContext *ic = input_files[ist->file_index]->ctx;
+    SegmentDecoder *sd;
+    int ret;
+
+    if (ist->hwaccel_id != HWACCEL_NONE) {
+        av_log(NULL, AV_LOG_WARNING, "Segment-parallel decoding is not supported "
+               "with hardware acceleration, disabling it for stream #%d:%d\n",
+               ist->file_index, ist->st->index);
+        return 0;
+    }
+
+    /* the workers open the input again and read it concurrently */
+    if (!ic->pb || !(ic->pb->seekable & AVIO_SEEKABLE_NORMAL) ||
+        !strcmp(ic->url, "-") || av_strstart(ic->url, "pipe:", NULL)) {
+        av_log(NULL, AV_LOG_WARNING, "Segment-parallel decoding requires a "
+               "seekable input that can be opened again, disabling it for "
+               "stream #%d:%d\n", ist->file_index, ist->st->index);
+        return 0;
+    }
+
+    sd = av_mallocz(sizeof(*sd));
+    if (!sd)
+        return AVERROR(ENOMEM);
+    sd->ist = ist;
+
+    ret = plan_segments(sd);
+    if (ret < 0)
+        goto fail;
+    if (sd->nb_segments < 2) {
+        av_log(NULL, AV_LOG_WARNING, "Not enough keyframes in the index of stream "
+               "#%d:%d for segment-parallel decoding, disabling it\n",
+               ist->file_index, ist->st->index);
+        goto fail;
+    }
+
+    ret = probe_pts(sd);
+    if (ret < 0)
+        goto fail;
+    if (!ret) {
+        av_log(NULL, AV_LOG_WARNING, "Keyframes of stream #%d:%d have no pts, "
+               "disabling segment-parallel decoding\n",
+               ist->file_index, ist->st->index);
+        goto fail;
+    }
+
+    ret = av_dict_copy(&sd->dec_opts, ist->decoder_opts, 0);
+    if (ret < 0)
+        goto fail;
+
+    ret = pthread_mutex_init(&sd->lock, NULL);
+    if (ret) {
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    ret = pthread_cond_init(&sd->cond, NULL);
+    if (ret) {
+        pthread_mutex_destroy(&sd->lock);
+        ret = AVERROR(ret);
+        goto fail;
+    }
+
+    sd->nb_workers = FFMIN(ist->segment_parallel, sd->nb_segments);
+    sd->workers    = av_calloc(sd->nb_workers, sizeof(*sd->workers));
+    if (!sd->workers) {
+        ret = AVERROR(ENOMEM);
+        goto fail_threads;
+    }
+
+    for (int i = 0; i < sd->nb_workers; i++) {
+        SegmentWorker *w = &sd->workers[i];
+
+        w->index = i;
+        ret = worker_init(sd, w);
+        if (ret < 0) {
+            av_log(NULL, AV_LOG_ERROR, "Error initializing segment decoder for "
+                   "stream #%d:%d: %s\n", ist->file_index, ist->st->index,
+                   av_err2str(ret));
+            goto fail_threads;
+        }
+
+        ret = pthread_create(&w->thread, NULL, worker_thread, w);
+        if (ret) {
+            ret = AVERROR(ret);
+            goto fail_threads;
+        }
+        w->thread_started = 1;
+    }
+
+    av_log(NULL, AV_LOG_VERBOSE, "Decoding stream #%d:%d in %d segments with %d workers\n",
+           ist->file_index, ist->st->index, sd->nb_segments, sd->nb_workers);
+
+    ist->segdec = sd;
+    return 0;
+
+fail_threads:
+    ist->segdec = sd;
+    segdec_free(&ist->segdec);
+    return ret;
+fail:
+    av_dict_free(&sd->dec_opts);
+    av_freep(&sd->seg_start);
+    av_freep(&sd);
+    return ret;
+}
+
+int segdec_decode(SegmentDecoder *sd, AVFrame *frame, int *got_frame,
+                  const AVPacket *pkt, int eof)
+{
+    /* the packet only paces the output, the workers read their own */
+    int block = eof || (pkt && pkt->size);
+    int ret = 0;
+
+    *got_frame = 0;
+
+    pthread_mutex_lock(&sd->lock);
+    while (1) {
+        SegmentWorker *w;
+        AVFrame *f;
+
+        if (sd->cur_segment >= sd->nb_segments) {
+            ret = AVERROR_EOF;
+            break;
+        }
+
+        w = &sd->workers[sd->cur_segment % sd->nb_workers];
+        if (av_fifo_read(w->queue, &f, 1) >= 0) {
+            pthread_cond_broadcast(&sd->cond);
+            if (!f) {
+                sd->cur_segment++;
+                continue;
+            }
+            av_frame_move_ref(frame, f);
+            av_frame_free(&f);
+            *got_frame = 1;
+            break;
+        }
+
+        if (w->finished) {
+            /* only a failed worker stops before the end of its segments */
+            av_assert0(w->err < 0);
+            ret = w->err;
+            sd->cur_segment = sd->nb_segments;
+            break;
+        }
+        if (!block)
+            break;
+
+        pthread_cond_wait(&sd->cond, &sd->lock);
+    }
+    pthread_mutex_unlock(&sd->lock);
+
+    return ret;
+}
+
+void segdec_free(SegmentDecoder **psd)
+{
+    SegmentDecoder *sd = *psd;
+
+    if (!sd)
+        return;
+
+    pthread_mutex_lock(&sd->lock);
+    sd->abort = 1;
+    pthread_cond_broadcast(&sd->cond);
+    pthread_mutex_unlock(&sd->lock);
+
+    for (int i = 0; i < sd->nb_workers; i++) {
+        SegmentWorker *w = &sd->workers[i];
+        AVFrame *f;
+
+        if (w->thread_started)
+            pthread_join(w->thread, NULL);
+
+        while (w->queue && av_fifo_read(w->queue, &f, 1) >= 0)
+            av_frame_free(&f);
+        av_fifo_freep2(&w->queue);
+
+        avformat_close_input(&w->fmt);
+        avcodec_free_context(&w->dec);
+        av_packet_free(&w->pkt);
+        av_frame_free(&w->frame);
+    }
+    av_freep(&sd->workers);
+
+    pthread_cond_destroy(&sd->cond);
+    pthread_mutex_destroy(&sd->lock);
+
+    av_dict_free(&sd->dec_opts);
+    av_freep(&sd->seg_start);
+    av_freep(psd);
+}
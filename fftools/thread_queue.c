@@ -16,10 +16,12 @@
  * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
  */
 
+#include <stdatomic.h>
 #include <stdint.h>
 #include <string.h>
 
 #include "libavutil/avassert.h"
+#include "libavutil/cpu.h"
 #include "libavutil/error.h"
 #include "libavutil/fifo.h"
 #include "libavutil/intreadwrite.h"
@@ -34,13 +36,16 @@ enum {
     FINISHED_RECV = (1 << 1),
 };
 
+/* number of times a thread polls the ring buffer before going to sleep */
+#define SPSC_SPIN_COUNT 1024
+
 typedef struct FifoElem {
     void        *obj;
     unsigned int stream_idx;
 } FifoElem;
 
 struct ThreadQueue {
-    int              *finished;
+    atomic_int       *finished;
     unsigned int    nb_streams;
 
     AVFifo  *fifo;
@@ -50,8 +55,33 @@ struct ThreadQueue {
 
     pthread_mutex_t lock;
     pthread_cond_t  cond;
+
+    /* lock-free ring buffer, only used with TQ_FLAG_SPSC;
+     * every element owns an object from obj_pool for the whole lifetime
+     * of the queue, so the pool is never touched after allocation */
+    FifoElem       *ring;
+    size_t          ring_mask;
+    /* index of the next element to be read, only written by the receiver */
+    atomic_size_t   ring_head;
+    /* index of the next element to be written, only written by the sender */
+    atomic_size_t   ring_tail;
+
+    /* set while the corresponding side sleeps on cond */
+    atomic_int      recv_waiting;
+    atomic_int      send_waiting;
+
+    int             spin_count;
 };
 
+static void ring_free(ThreadQueue *tq)
+{
+    if (tq->ring) {
+        for (size_t i = 0; i <= tq->ring_mask; i++)
+            objpool_release(tq->obj_pool, &tq->ring[i].obj);
+    }
+    av_freep(&tq->ring);
+}
+
 void tq_free(ThreadQueue **ptq)
 {
     ThreadQueue *tq = *ptq;
@@ -66,6 +96,8 @@ void tq_free(ThreadQueue **ptq)
     }
     av_fifo_freep2(&tq->fifo);
 
+    ring_free(tq);
+
     objpool_free(&tq->obj_pool);
 
     av_freep(&tq->finished);
@@ -76,8 +108,41 @@ void tq_free(ThreadQueue **ptq)
     av_freep(ptq);
 }
 
+static int ring_alloc(ThreadQueue *tq, size_t queue_size)
+{
+    size_t ring_size = 1;
+
+    while (ring_size < queue_size) {
+        if (ring_size > SIZE_MAX / 2 / sizeof(*tq->ring))
+            return AVERROR(EINVAL);
+        ring_size <<= 1;
+    }
+
+    tq->ring = av_calloc(ring_size, sizeof(*tq->ring));
+    if (!tq->ring)
+        return AVERROR(ENOMEM);
+    tq->ring_mask = ring_size - 1;
+
+    for (size_t i = 0; i < ring_size; i++) {
+        int ret = objpool_get(tq->obj_pool, &tq->ring[i].obj);
+        if (ret < 0)
+            return ret;
+    }
+
+    atomic_init(&tq->ring_head, 0);
+    atomic_init(&tq->ring_tail, 0);
+    atomic_init(&tq->recv_waiting, 0);
+    atomic_init(&tq->send_waiting, 0);
+
+    /* spinning only makes sense when the other side can run concurrently */
+    tq->spin_count = av_cpu_count() > 1 ? SPSC_SPIN_COUNT : 0;
+
+    return 0;
+}
+
 ThreadQueue *tq_alloc(unsigned int nb_streams, size_t queue_size,
-                      ObjPool *obj_pool, void (*obj_move)(void *dst, void *src))
+                      ObjPool *obj_pool, void (*obj_move)(void *dst, void *src),
+                      unsigned int flags)
 {
     ThreadQueue *tq;
     int ret;
@@ -103,10 +168,23 @@ ThreadQueue *tq_alloc(unsigned int nb_streams, size_t queue_size,
     if (!tq->finished)
         goto fail;
     tq->nb_streams = nb_streams;
-
-    tq->fifo = av_fifo_alloc2(queue_size, sizeof(FifoElem), 0);
-    if (!tq->fifo)
-        goto fail;
+    for (unsigned int i = 0; i < nb_streams; i++)
+        atomic_init(&tq->finished[i], 0);
+
+    if (flags & TQ_FLAG_SPSC) {
+        tq->obj_pool = obj_pool;
+        ret = ring_alloc(tq, queue_size);
+        if (ret < 0) {
+            /* the pool only becomes owned by the queue on success */
+            ring_free(tq);
+            tq->obj_pool = NULL;
+            goto fail;
+        }
+    } else {
+        tq->fifo = av_fifo_alloc2(queue_size, sizeof(FifoElem), 0);
+        if (!tq->fifo)
+            goto fail;
+    }
 
     tq->obj_pool = obj_pool;
     tq->obj_move = obj_move;
@@ -117,12 +195,72 @@ fail:
     return NULL;
 }
 
+/* wake up the other side if it is sleeping on the condition variable */
+static void ring_wake(ThreadQueue *tq, atomic_int *waiting)
+{
+    /* the sequentially consistent store of the ring index or finished flag
+     * that precedes this load pairs with the store to waiting done by the
+     * other side before its final check, so either we see it waiting or it
+     * sees our update */
+    if (atomic_load(waiting)) {
+        pthread_mutex_lock(&tq->lock);
+        pthread_cond_broadcast(&tq->cond);
+        pthread_mutex_unlock(&tq->lock);
+    }
+}
+
+static int ring_can_write(ThreadQueue *tq, size_t tail)
+{
+    return tail - atomic_load(&tq->ring_head) <= tq->ring_mask;
+}
+
+static int ring_send(ThreadQueue *tq, unsigned int stream_idx, void *data)
+{
+    atomic_int *finished = &tq->finished[stream_idx];
+    size_t tail = atomic_load_explicit(&tq->ring_tail, memory_order_relaxed);
+    FifoElem *elem;
+
+    if (atomic_load(finished) & FINISHED_SEND)
+        return AVERROR(EINVAL);
+
+    for (int spin = 0; !(atomic_load(finished) & FINISHED_RECV) &&
+                       !ring_can_write(tq, tail); spin++) {
+        if (spin < tq->spin_count)
+            continue;
+
+        pthread_mutex_lock(&tq->lock);
+        atomic_store(&tq->send_waiting, 1);
+        if (!(atomic_load(finished) & FINISHED_RECV) && !ring_can_write(tq, tail))
+            pthread_cond_wait(&tq->cond, &tq->lock);
+        atomic_store(&tq->send_waiting, 0);
+        pthread_mutex_unlock(&tq->lock);
+    }
+
+    if (atomic_load(finished) & FINISHED_RECV) {
+        atomic_fetch_or(finished, FINISHED_SEND);
+        return AVERROR_EOF;
+    }
+
+    elem = &tq->ring[tail & tq->ring_mask];
+    tq->obj_move(elem->obj, data);
+    elem->stream_idx = stream_idx;
+
+    atomic_store(&tq->ring_tail, tail + 1);
+    ring_wake(tq, &tq->recv_waiting);
+
+    return 0;
+}
+
 int tq_send(ThreadQueue *tq, unsigned int stream_idx, void *data)
 {
-    int *finished;
+    atomic_int *finished;
     int ret;
 
     av_assert0(stream_idx < tq->nb_streams);
+
+    if (tq->ring)
+        return ring_send(tq, stream_idx, data);
+
     finished = &tq->finished[stream_idx];
 
     pthread_mutex_lock(&tq->lock);
@@ -137,7 +275,7 @@ int tq_send(ThreadQueue *tq, unsigned int stream_idx, void *data)
 
     if (*finished & FINISHED_RECV) {
         ret = AVERROR_EOF;
-        *finished |= FINISHED_SEND;
+        atomic_fetch_or(finished, FINISHED_SEND);
     } else {
         FifoElem elem = { .stream_idx = stream_idx };
 
@@ -177,7 +315,7 @@ static int receive_locked(ThreadQueue *tq, int *stream_idx,
 
         /* return EOF to the consumer at most once for each stream */
         if (!(tq->finished[i] & FINISHED_RECV)) {
-            tq->finished[i] |= FINISHED_RECV;
+            atomic_fetch_or(&tq->finished[i], FINISHED_RECV);
             *stream_idx   = i;
             return AVERROR_EOF;
         }
@@ -188,12 +326,94 @@ static int receive_locked(ThreadQueue *tq, int *stream_idx,
     return nb_finished == tq->nb_streams ? AVERROR_EOF : AVERROR(EAGAIN);
 }
 
+static int ring_try_receive(ThreadQueue *tq, int *stream_idx, void *data)
+{
+    size_t head = atomic_load_explicit(&tq->ring_head, memory_order_relaxed);
+    unsigned int nb_finished = 0;
+    FifoElem *elem;
+
+    if (atomic_load(&tq->ring_tail) != head)
+        goto read;
+
+    for (unsigned int i = 0; i < tq->nb_streams; i++) {
+        int finished = atomic_load(&tq->finished[i]);
+
+        if (!(finished & FINISHED_SEND))
+            continue;
+
+        if (!(finished & FINISHED_RECV)) {
+            /* the sender marks a stream as finished only after all of its
+             * items were written, so make sure none arrived meanwhile */
+            if (atomic_load(&tq->ring_tail) != head)
+                goto read;
+
+            /* return EOF to the consumer at most once for each stream */
+            atomic_fetch_or(&tq->finished[i], FINISHED_RECV);
+            *stream_idx = i;
+            return AVERROR_EOF;
+        }
+
+        nb_finished++;
+    }
+
+    return nb_finished == tq->nb_streams ? AVERROR_EOF : AVERROR(EAGAIN);
+
+read:
+    elem = &tq->ring[head & tq->ring_mask];
+    tq->obj_move(data, elem->obj);
+    *stream_idx = elem->stream_idx;
+
+    atomic_store(&tq->ring_head, head + 1);
+    ring_wake(tq, &tq->send_waiting);
+
+    return 0;
+}
+
+static int ring_can_read(ThreadQueue *tq)
+{
+    if (atomic_load(&tq->ring_tail) !=
+        atomic_load_explicit(&tq->ring_head, memory_order_relaxed))
+        return 1;
+
+    for (unsigned int i = 0; i < tq->nb_streams; i++) {
+        int finished = atomic_load(&tq->finished[i]);
+        if ((finished & FINISHED_SEND) && !(finished & FINISHED_RECV))
+            return 1;
+    }
+
+    return 0;
+}
+
+static int ring_receive(ThreadQueue *tq, int *stream_idx, void *data)
+{
+    int ret;
+
+    for (int spin = 0;; spin++) {
+        ret = ring_try_receive(tq, stream_idx, data);
+        if (ret != AVERROR(EAGAIN))
+            return ret;
+
+        if (spin < tq->spin_count)
+            continue;
+
+        pthread_mutex_lock(&tq->lock);
+        atomic_store(&tq->recv_waiting, 1);
+        if (!ring_can_read(tq))
+            pthread_cond_wait(&tq->cond, &tq->lock);
+        atomic_store(&tq->recv_waiting, 0);
+        pthread_mutex_unlock(&tq->lock);
+    }
+}
+
 int tq_receive(ThreadQueue *tq, int *stream_idx, void *data)
 {
     int ret;
 
     *stream_idx = -1;
 
+    if (tq->ring)
+        return ring_receive(tq, stream_idx, data);
+
     pthread_mutex_lock(&tq->lock);
 
     while (1) {
@@ -218,12 +438,18 @@ void tq_send_finish(ThreadQueue *tq, unsigned int stream_idx)
 {
     av_assert0(stream_idx < tq->nb_streams);
 
+    if (tq->ring) {
+        atomic_fetch_or(&tq->finished[stream_idx], FINISHED_SEND);
+        ring_wake(tq, &tq->recv_waiting);
+        return;
+    }
+
     pthread_mutex_lock(&tq->lock);
 
     /* mark the stream as send-finished;
      * next time the consumer thread tries to read this stream it will get
      * an EOF and recv-finished flag will be set */
-    tq->finished[stream_idx] |= FINISHED_SEND;
+    atomic_fetch_or(&tq->finished[stream_idx], FINISHED_SEND);
     pthread_cond_broadcast(&tq->cond);
 
     pthread_mutex_unlock(&tq->lock);
@@ -233,12 +459,18 @@ void tq_receive_finish(ThreadQueue *tq, unsigned int stream_idx)
 {
     av_assert0(stream_idx < tq->nb_streams);
 
+    if (tq->ring) {
+        atomic_fetch_or(&tq->finished[stream_idx], FINISHED_RECV);
+        ring_wake(tq, &tq->send_waiting);
+        return;
+    }
+
     pthread_mutex_lock(&tq->lock);
 
     /* mark the stream as recv-finished;
      * next time the producer thread tries to send for this stream, it will
      * get an EOF and send-finished flag will be set */
-    tq->finished[stream_idx] |= FINISHED_RECV;
+    atomic_fetch_or(&tq->finished[stream_idx], FINISHED_RECV);
     pthread_cond_broadcast(&tq->cond);
 
     pthread_mutex_unlock(&tq->lock);
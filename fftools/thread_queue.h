@@ -25,6 +25,16 @@
 
 typedef struct ThreadQueue ThreadQueue;
 
+enum ThreadQueueFlags {
+    /**
+     * The queue will only ever be used by a single sending thread and a
+     * single receiving thread. Items are then exchanged through a lock-free
+     * ring buffer and a thread only sleeps when it has to wait for the other
+     * side, after spinning for a short while.
+     */
+    TQ_FLAG_SPSC = (1 << 0),
+};
+
 /**
  * Allocate a queue for sending data between threads.
  *
@@ -35,9 +45,11 @@ typedef struct ThreadQueue ThreadQueue;
  * @param obj_pool object pool that will be used to allocate items stored in the
  *                 queue; the pool becomes owned by the queue
  * @param callback that moves the contents between two data pointers
+ * @param flags a combination of ThreadQueueFlags
  */
 ThreadQueue *tq_alloc(unsigned int nb_streams, size_t queue_size,
-                      ObjPool *obj_pool, void (*obj_move)(void *dst, void *src));
+                      ObjPool *obj_pool, void (*obj_move)(void *dst, void *src),
+                      unsigned int flags);
 void         tq_free(ThreadQueue **tq);
 
 /**
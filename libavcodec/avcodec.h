@@ -329,6 +329,12 @@ typedef struct RcOverride{
  * Show all frames before the first keyframe
  */
 #define AV_CODEC_FLAG2_SHOW_ALL       (1 << 22)
+/**
+ * Fail instead of copying decoded images internally, so that all output is
+ * written directly into buffers returned by get_buffer2().
+ * @see AVCodecContext.plane_copies
+ */
+#define AV_CODEC_FLAG2_ZERO_COPY      (1 << 23)
 /**
  * Export motion vectors through frame side data
  */
@@ -2057,6 +2063,17 @@ typedef struct AVCodecContext {
      *             The decoder can then override during decoding as needed.
      */
     AVChannelLayout ch_layout;
+
+    /**
+     * Number of image planes the decoder copied into output frames instead
+     * of decoding into them directly, e.g. from a buffer owned by an external
+     * library or because a frame it updates in place was not writable.
+     * With AV_CODEC_FLAG2_ZERO_COPY, such copies fail instead.
+     *
+     * - decoding: set by libavcodec
+     * - encoding: unused
+     */
+    int64_t plane_copies;
 } AVCodecContext;
 
 /**
@@ -1528,6 +1528,10 @@ static int reget_buffer_internal(AVCodecContext *avctx, AVFrame *frame, int flag
     if ((flags & FF_REGET_BUFFER_FLAG_READONLY) || av_frame_is_writable(frame))
         return ff_decode_frame_props(avctx, frame);
 
+    ret = ff_decode_count_plane_copies(avctx, av_pix_fmt_count_planes(frame->format));
+    if (ret < 0)
+        return ret;
+
     tmp = av_frame_alloc();
     if (!tmp)
         return AVERROR(ENOMEM);
@@ -1554,6 +1558,17 @@ int ff_reget_buffer(AVCodecContext *avctx, AVFrame *frame, int flags)
     return ret;
 }
 
+int ff_decode_count_plane_copies(AVCodecContext *avctx, int nb_planes)
+{
+    if (avctx->flags2 & AV_CODEC_FLAG2_ZERO_COPY) {
+        av_log(avctx, AV_LOG_ERROR, "The decoder needs to copy the decoded "
+               "image, which is not allowed in zero-copy mode\n");
+        return AVERROR(ENOSYS);
+    }
+    avctx->plane_copies += nb_planes;
+    return 0;
+}
+
 int ff_decode_preinit(AVCodecContext *avctx)
 {
     AVCodecInternal *avci = avctx->internal;
@@ -1629,6 +1644,13 @@ FF_ENABLE_DEPRECATION_WARNINGS
     if (avctx->flags2 & AV_CODEC_FLAG2_EXPORT_MVS) {
         avctx->export_side_data |= AV_CODEC_EXPORT_DATA_MVS;
     }
+    if (avctx->flags2 & AV_CODEC_FLAG2_ZERO_COPY &&
+        avctx->codec_type == AVMEDIA_TYPE_VIDEO &&
+        !(avctx->codec->capabilities & AV_CODEC_CAP_DR1)) {
+        av_log(avctx, AV_LOG_ERROR, "Zero-copy decoding requested, but the "
+               "decoder does not decode into user-supplied buffers\n");
+        return AVERROR(ENOSYS);
+    }
 
     avci->in_pkt         = av_packet_alloc();
     avci->last_pkt_props = av_packet_alloc();
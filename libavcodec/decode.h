@@ -143,6 +143,15 @@ int ff_get_buffer(AVCodecContext *avctx, AVFrame *frame, int flags);
  */
 int ff_reget_buffer(AVCodecContext *avctx, AVFrame *frame, int flags);
 
+/**
+ * Account for nb_planes image planes about to be copied into an output frame
+ * instead of being decoded into it directly.
+ *
+ * @return 0 if the copy may be done, a negative AVERROR code if it is not
+ *         allowed (AV_CODEC_FLAG2_ZERO_COPY)
+ */
+int ff_decode_count_plane_copies(AVCodecContext *avctx, int nb_planes);
+
 /**
  * Add or update AV_FRAME_DATA_MATRIXENCODING side data.
  */
@@ -24,6 +24,7 @@
 
 #include "libavutil/avassert.h"
 #include "libavutil/cpu.h"
+#include "libavutil/fifo.h"
 #include "libavutil/opt.h"
 #include "libavutil/thread.h"
 #include "avcodec.h"
@@ -44,6 +45,12 @@ typedef struct{
     int       return_code;
     int       finished;
     int       got_packet;
+
+    /* GOP mode: the frames of one GOP and the packets they were coded to */
+    AVFrame  **frames;
+    AVPacket **pkts;
+    int        nb_frames;
+    int        nb_pkts;
 } Task;
 
 typedef struct{
@@ -67,6 +74,13 @@ typedef struct{
 
     pthread_t worker[MAX_THREADS];
     atomic_int exit;
+
+    /* GOP mode: whole GOPs are encoded by each worker instead of frames */
+    int       gop_mode;
+    int       gop_size;
+    uint64_t  nb_submitted;  /* number of GOPs handed to the workers */
+    unsigned  nb_workers;    /* used to number the workers on startup */
+    AVFifo   *out_pkts;      /* packets of finished GOPs not yet returned */
 } ThreadContext;
 
 #define OFF(member) offsetof(ThreadContext, member)
@@ -81,9 +95,76 @@ DEFINE_OFFSET_ARRAY(ThreadContext, thread_ctx, pthread_init_cnt,
 #endif
 #undef OFF
 
+static int encode_gop_frame(AVCodecContext *avctx, ThreadContext *c,
+                            Task *task, AVFrame *frame, int *got_packet)
+{
+    AVPacket *pkt;
+    int ret;
+
+    /* The encoders supporting GOP mode return at most one packet per frame,
+     * the last packet is only used by the final draining call. */
+    if (task->nb_pkts > c->gop_size)
+        return AVERROR_BUG;
+    if (!task->pkts[task->nb_pkts] &&
+        !(task->pkts[task->nb_pkts] = av_packet_alloc()))
+        return AVERROR(ENOMEM);
+    pkt = task->pkts[task->nb_pkts];
+
+    *got_packet = 0;
+    ret = ff_encode_encode_cb(avctx, pkt, frame, got_packet);
+    if (ret >= 0 && *got_packet)
+        task->nb_pkts++;
+#if FF_API_THREAD_SAFE_CALLBACKS
+    if (frame) {
+        pthread_mutex_lock(&c->buffer_mutex);
+        av_frame_unref(frame);
+        pthread_mutex_unlock(&c->buffer_mutex);
+    }
+#endif
+    return ret;
+}
+
+/**
+ * Encode one GOP and drain the encoder, so that the next GOP handed to
+ * this worker starts from an empty reordering buffer. The first frame of
+ * every GOP has been marked as an I-frame by the main thread.
+ */
+static int encode_gop(AVCodecContext *avctx, ThreadContext *c, Task *task)
+{
+    int got_packet, ret = 0;
+
+    for (int i = 0; i < task->nb_frames && ret >= 0; i++)
+        ret = encode_gop_frame(avctx, c, task, task->frames[i], &got_packet);
+
+    while (ret >= 0) {
+        ret = encode_gop_frame(avctx, c, task, NULL, &got_packet);
+        if (!got_packet)
+            break;
+    }
+
+#if FF_API_THREAD_SAFE_CALLBACKS
+    pthread_mutex_lock(&c->buffer_mutex);
+#endif
+    for (int i = 0; i < task->nb_frames; i++)
+        av_frame_unref(task->frames[i]);
+#if FF_API_THREAD_SAFE_CALLBACKS
+    pthread_mutex_unlock(&c->buffer_mutex);
+#endif
+
+    return ret;
+}
+
 static void * attribute_align_arg worker(void *v){
     AVCodecContext *avctx = v;
     ThreadContext *c = avctx->internal->frame_thread_encoder;
+    uint64_t gop_index;
+
+    /* In GOP mode, the n-th worker encodes GOPs n, n + thread_count, ...
+     * This keeps the output deterministic, as the state each worker carries
+     * over from one GOP to its next one does not depend on scheduling. */
+    pthread_mutex_lock(&c->task_fifo_mutex);
+    gop_index = c->nb_workers++;
+    pthread_mutex_unlock(&c->task_fifo_mutex);
 
     while (!atomic_load(&c->exit)) {
         int ret;
@@ -93,30 +174,42 @@ static void * attribute_align_arg worker(void *v){
         unsigned task_index;
 
         pthread_mutex_lock(&c->task_fifo_mutex);
-        while (c->next_task_index == c->task_index || atomic_load(&c->exit)) {
+        while ((c->gop_mode ? gop_index >= c->nb_submitted
+                            : c->next_task_index == c->task_index) ||
+               atomic_load(&c->exit)) {
             if (atomic_load(&c->exit)) {
                 pthread_mutex_unlock(&c->task_fifo_mutex);
                 goto end;
             }
             pthread_cond_wait(&c->task_fifo_cond, &c->task_fifo_mutex);
         }
-        task_index         = c->next_task_index;
-        c->next_task_index = (c->next_task_index + 1) % c->max_tasks;
+        if (c->gop_mode) {
+            task_index = gop_index % c->max_tasks;
+            gop_index += c->parent_avctx->thread_count;
+        } else {
+            task_index         = c->next_task_index;
+            c->next_task_index = (c->next_task_index + 1) % c->max_tasks;
+        }
         pthread_mutex_unlock(&c->task_fifo_mutex);
         /* The main thread ensures that any two outstanding tasks have
          * different indices, ergo each worker thread owns its element
          * of c->tasks with the exception of finished, which is shared
          * with the main thread and guarded by finished_task_mutex. */
         task  = &c->tasks[task_index];
-        frame = task->indata;
-        pkt   = task->outdata;
 
-        ret = ff_encode_encode_cb(avctx, pkt, frame, &task->got_packet);
+        if (c->gop_mode) {
+            ret = encode_gop(avctx, c, task);
+        } else {
+            frame = task->indata;
+            pkt   = task->outdata;
+
+            ret = ff_encode_encode_cb(avctx, pkt, frame, &task->got_packet);
 #if FF_API_THREAD_SAFE_CALLBACKS
-        pthread_mutex_lock(&c->buffer_mutex);
-        av_frame_unref(frame);
-        pthread_mutex_unlock(&c->buffer_mutex);
+            pthread_mutex_lock(&c->buffer_mutex);
+            av_frame_unref(frame);
+            pthread_mutex_unlock(&c->buffer_mutex);
 #endif
+        }
         pthread_mutex_lock(&c->finished_task_mutex);
         task->return_code = ret;
         task->finished    = 1;
@@ -140,12 +233,42 @@ av_cold int ff_frame_thread_encoder_init(AVCodecContext *avctx)
     int i=0;
     ThreadContext *c;
     AVCodecContext *thread_avctx = NULL;
+    int gop_mode = 0;
     int ret;
 
-    if(   !(avctx->thread_type & FF_THREAD_FRAME)
-       || !(avctx->codec->capabilities & AV_CODEC_CAP_FRAME_THREADS))
+    if (!(avctx->thread_type & FF_THREAD_FRAME))
         return 0;
 
+    if (!(avctx->codec->capabilities & AV_CODEC_CAP_FRAME_THREADS)) {
+        int64_t tmp;
+
+        /* Encoders with inter-frame dependencies may support encoding
+         * closed GOPs in parallel: each worker then encodes whole GOPs,
+         * draining the encoder after each of them. */
+        if (!(avctx->codec->capabilities & AV_CODEC_CAP_DELAY) ||
+            av_opt_get_int(avctx->priv_data, "gop_threads", 0, &tmp) < 0 ||
+            !tmp)
+            return 0;
+
+        if (avctx->gop_size <= 1) {
+            av_log(avctx, AV_LOG_WARNING,
+                   "GOP threading requires a GOP size larger than 1, "
+                   "disabling it\n");
+            return 0;
+        }
+        if (avctx->flags & (AV_CODEC_FLAG_PASS1 | AV_CODEC_FLAG_PASS2)) {
+            av_log(avctx, AV_LOG_WARNING,
+                   "GOP threading is not supported with two-pass encoding, "
+                   "disabling it\n");
+            return 0;
+        }
+        if (avctx->rc_buffer_size)
+            av_log(avctx, AV_LOG_WARNING,
+                   "Each GOP thread runs its own rate control, VBV compliance "
+                   "of the combined stream is not guaranteed\n");
+        gop_mode = 1;
+    }
+
     if(   !avctx->thread_count
        && avctx->codec_id == AV_CODEC_ID_MJPEG
        && !(avctx->flags & AV_CODEC_FLAG_QSCALE)) {
@@ -213,6 +336,24 @@ av_cold int ff_frame_thread_encoder_init(AVCodecContext *avctx)
         }
     }
 
+    if (gop_mode) {
+        c->gop_mode = 1;
+        c->gop_size = avctx->gop_size;
+        c->out_pkts = av_fifo_alloc2(c->gop_size, sizeof(AVPacket*),
+                                     AV_FIFO_FLAG_AUTO_GROW);
+        if (!c->out_pkts) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+        for (unsigned j = 0; j < c->max_tasks; j++) {
+            if (!(c->tasks[j].frames = av_calloc(c->gop_size, sizeof(*c->tasks[j].frames))) ||
+                !(c->tasks[j].pkts   = av_calloc(c->gop_size + 1, sizeof(*c->tasks[j].pkts)))) {
+                ret = AVERROR(ENOMEM);
+                goto fail;
+            }
+        }
+    }
+
     for(i=0; i<avctx->thread_count ; i++){
         void *tmpv;
         thread_avctx = avcodec_alloc_context3(avctx->codec);
@@ -276,14 +417,135 @@ av_cold void ff_frame_thread_encoder_free(AVCodecContext *avctx)
     }
 
     for (unsigned i = 0; i < c->max_tasks; i++) {
-        av_frame_free(&c->tasks[i].indata);
-        av_packet_free(&c->tasks[i].outdata);
+        Task *task = &c->tasks[i];
+
+        av_frame_free(&task->indata);
+        av_packet_free(&task->outdata);
+
+        for (int j = 0; task->frames && j < c->gop_size; j++)
+            av_frame_free(&task->frames[j]);
+        for (int j = 0; task->pkts && j <= c->gop_size; j++)
+            av_packet_free(&task->pkts[j]);
+        av_freep(&task->frames);
+        av_freep(&task->pkts);
+    }
+
+    if (c->out_pkts) {
+        AVPacket *pkt;
+
+        while (av_fifo_read(c->out_pkts, &pkt, 1) >= 0)
+            av_packet_free(&pkt);
+        av_fifo_freep2(&c->out_pkts);
     }
 
     ff_pthread_free(c, thread_ctx_offsets);
     av_freep(&avctx->internal->frame_thread_encoder);
 }
 
+/**
+ * Move the packets of finished GOPs to the output queue, in order.
+ * If wait is set, block until the oldest outstanding GOP is finished.
+ */
+static int gop_collect(ThreadContext *c, int wait)
+{
+    while (c->finished_task_index != c->task_index) {
+        Task *task = &c->tasks[c->finished_task_index];
+        int finished, ret;
+
+        pthread_mutex_lock(&c->finished_task_mutex);
+        while (wait && !task->finished)
+            pthread_cond_wait(&c->finished_task_cond, &c->finished_task_mutex);
+        finished = task->finished;
+        pthread_mutex_unlock(&c->finished_task_mutex);
+        if (!finished)
+            break;
+        wait = 0;
+
+        task->finished = 0;
+        ret = task->return_code;
+        for (int i = 0; i < task->nb_pkts; i++) {
+            AVPacket *pkt = NULL;
+
+            if (ret >= 0) {
+                pkt = av_packet_alloc();
+                if (!pkt)
+                    ret = AVERROR(ENOMEM);
+            }
+            if (pkt) {
+                av_packet_move_ref(pkt, task->pkts[i]);
+                av_fifo_write(c->out_pkts, &pkt, 1);
+            } else
+                av_packet_unref(task->pkts[i]);
+        }
+        task->nb_pkts   = 0;
+        task->nb_frames = 0;
+        c->finished_task_index = (c->finished_task_index + 1) % c->max_tasks;
+
+        if (ret < 0)
+            return ret;
+    }
+
+    return 0;
+}
+
+static int gop_thread_encode_frame(AVCodecContext *avctx, AVPacket *pkt,
+                                   AVFrame *frame, int *got_packet_ptr)
+{
+    ThreadContext *c = avctx->internal->frame_thread_encoder;
+    Task *task = &c->tasks[c->task_index];
+    AVPacket *out;
+    int ret;
+
+    /* A GOP ends when it is full, when the caller forces a keyframe
+     * or when flushing. */
+    if (task->nb_frames &&
+        (!frame || task->nb_frames >= c->gop_size ||
+         frame->pict_type == AV_PICTURE_TYPE_I)) {
+        /* Keep one task free for gathering the next GOP. */
+        if ((c->task_index - c->finished_task_index + c->max_tasks) % c->max_tasks ==
+            c->max_tasks - 1) {
+            ret = gop_collect(c, 1);
+            if (ret < 0)
+                return ret;
+        }
+
+        pthread_mutex_lock(&c->task_fifo_mutex);
+        c->task_index = (c->task_index + 1) % c->max_tasks;
+        c->nb_submitted++;
+        pthread_cond_broadcast(&c->task_fifo_cond);
+        pthread_mutex_unlock(&c->task_fifo_mutex);
+
+        task = &c->tasks[c->task_index];
+    }
+
+    if (frame) {
+        AVFrame **dst = &task->frames[task->nb_frames];
+
+        if (!*dst && !(*dst = av_frame_alloc()))
+            return AVERROR(ENOMEM);
+        av_frame_move_ref(*dst, frame);
+        if (!task->nb_frames)
+            (*dst)->pict_type = AV_PICTURE_TYPE_I;
+        task->nb_frames++;
+    }
+
+    /* When flushing, wait until a packet is available or all GOPs are done. */
+    do {
+        ret = gop_collect(c, !frame && !av_fifo_can_read(c->out_pkts));
+        if (ret < 0)
+            return ret;
+    } while (!frame && !av_fifo_can_read(c->out_pkts) &&
+             c->finished_task_index != c->task_index);
+
+    if (av_fifo_read(c->out_pkts, &out, 1) >= 0) {
+        av_packet_move_ref(pkt, out);
+        av_packet_free(&out);
+        *got_packet_ptr = 1;
+    }
+
+    return 0;
+}
+
 int ff_thread_video_encode_frame(AVCodecContext *avctx, AVPacket *pkt,
                                  AVFrame *frame, int *got_packet_ptr)
 {
@@ -292,6 +554,9 @@ int ff_thread_video_encode_frame(AVCodecContext *avctx, AVPacket *pkt,
 
     av_assert1(!*got_packet_ptr);
 
+    if (c->gop_mode)
+        return gop_thread_encode_frame(avctx, pkt, frame, got_packet_ptr);
+
     if(frame){
         av_frame_move_ref(c->tasks[c->task_index].indata, frame);
 
@@ -941,8 +941,11 @@ static int hls_slice_header(HEVCContext *s)
                 sh->entry_point_offset[i] = val + 1; // +1; // +1 to get the size
             }
             if (s->threads_number > 1 && (s->ps.pps->num_tile_rows > 1 || s->ps.pps->num_tile_columns > 1)) {
-                s->enable_parallel_tiles = 0; // TODO: you can enable tiles in parallel here
-                s->threads_number = 1;
+                if (s->ps.pps->entropy_coding_sync_enabled_flag) {
+                    s->enable_parallel_tiles = 0; // TODO: tiles and WPP together
+                    s->threads_number = 1;
+                } else
+                    s->enable_parallel_tiles = 1;
             } else
                 s->enable_parallel_tiles = 0;
         } else
@@ -2633,6 +2636,123 @@ error:
     return ret;
 }
 
+static int hls_decode_entry_tile(AVCodecContext *avctxt, void *hevc_lclist,
+                                 int job, int self_id)
+{
+    HEVCLocalContext *lc = ((HEVCLocalContext**)hevc_lclist)[self_id];
+    const HEVCContext *const s = lc->parent;
+    const HEVCPPS *const pps = s->ps.pps;
+    int more_data   = 1;
+    int ctb_addr_ts = pps->ctb_addr_rs_to_ts[s->sh.slice_ctb_addr_rs];
+    int ctb_addr_rs = s->sh.slice_ctb_addr_rs;
+    int tile        = pps->tile_id[ctb_addr_ts] + job;
+    int end_ts      = tile + 1 < pps->num_tile_columns * pps->num_tile_rows ?
+                      pps->ctb_addr_rs_to_ts[pps->tile_pos_rs[tile + 1]] :
+                      s->ps.sps->ctb_size;
+    int ret;
+
+    if (job) {
+        ctb_addr_rs = pps->tile_pos_rs[tile];
+        ctb_addr_ts = pps->ctb_addr_rs_to_ts[ctb_addr_rs];
+        ret = init_get_bits8(&lc->gb, s->data + s->sh.offset[job - 1], s->sh.size[job - 1]);
+        if (ret < 0)
+            goto error;
+    }
+
+    while (more_data && ctb_addr_ts < end_ts) {
+        int x_ctb, y_ctb;
+
+        ctb_addr_rs = pps->ctb_addr_ts_to_rs[ctb_addr_ts];
+        x_ctb = (ctb_addr_rs % s->ps.sps->ctb_width) << s->ps.sps->log2_ctb_size;
+        y_ctb = (ctb_addr_rs / s->ps.sps->ctb_width) << s->ps.sps->log2_ctb_size;
+
+        /* Casting const away here is safe, because it is an atomic operation. */
+        if (atomic_load((atomic_int*)&s->wpp_err))
+            return 0;
+
+        hls_decode_neighbour(lc, x_ctb, y_ctb, ctb_addr_ts);
+
+        ret = ff_hevc_cabac_init(lc, ctb_addr_ts);
+        if (ret < 0)
+            goto error;
+
+        hls_sao_param(lc, x_ctb >> s->ps.sps->log2_ctb_size, y_ctb >> s->ps.sps->log2_ctb_size);
+
+        s->deblock[ctb_addr_rs].beta_offset = s->sh.beta_offset;
+        s->deblock[ctb_addr_rs].tc_offset   = s->sh.tc_offset;
+        s->filter_slice_edges[ctb_addr_rs]  = s->sh.slice_loop_filter_across_slices_enabled_flag;
+
+        more_data = hls_coding_quadtree(lc, x_ctb, y_ctb, s->ps.sps->log2_ctb_size, 0);
+        if (more_data < 0) {
+            ret = more_data;
+            goto error;
+        }
+        ctb_addr_ts++;
+
+        /* only the last tile of the slice segment may end it */
+        if (!more_data && ctb_addr_ts < end_ts && job != s->sh.num_entry_point_offsets) {
+            ret = AVERROR_INVALIDDATA;
+            goto error;
+        }
+    }
+
+    return ctb_addr_ts;
+error:
+    s->tab_slice_address[ctb_addr_rs] = -1;
+    /* Casting const away here is safe, because it is an atomic operation. */
+    atomic_store((atomic_int*)&s->wpp_err, 1);
+    return ret;
+}
+
+/**
+ * Run the in-loop filters over the tiles decoded by hls_decode_entry_tile(),
+ * in the order hls_decode_entry() would have run them.
+ */
+static int hls_filter_tiles(HEVCContext *s, const int *ret)
+{
+    HEVCLocalContext *const lc = s->HEVClc;
+    const HEVCPPS *const pps = s->ps.pps;
+    const HEVCSPS *const sps = s->ps.sps;
+    int ctb_size = 1 << sps->log2_ctb_size;
+    int start_ts = pps->ctb_addr_rs_to_ts[s->sh.slice_ctb_addr_rs];
+    int end_ts   = ret[s->sh.num_entry_point_offsets];
+    int x_ctb = 0, y_ctb = 0;
+    int i, ctb_addr_ts;
+
+    for (i = 0; i <= s->sh.num_entry_point_offsets; i++)
+        if (ret[i] < 0)
+            return ret[i];
+    if (atomic_load(&s->wpp_err))
+        return AVERROR_INVALIDDATA;
+
+    /* the slice segment ended inside its last tile */
+    for (ctb_addr_ts = end_ts; ctb_addr_ts < sps->ctb_size &&
+         pps->tile_id[ctb_addr_ts] == pps->tile_id[end_ts - 1]; ctb_addr_ts++)
+        s->tab_slice_address[pps->ctb_addr_ts_to_rs[ctb_addr_ts]] = -1;
+
+    for (ctb_addr_ts = start_ts; ctb_addr_ts < end_ts; ctb_addr_ts++) {
+        int ctb_addr_rs = pps->ctb_addr_ts_to_rs[ctb_addr_ts];
+
+        x_ctb = (ctb_addr_rs % sps->ctb_width) << sps->log2_ctb_size;
+        y_ctb = (ctb_addr_rs / sps->ctb_width) << sps->log2_ctb_size;
+        ff_hevc_deblocking_boundary_strengths_tile(lc, x_ctb, y_ctb);
+    }
+
+    for (ctb_addr_ts = start_ts; ctb_addr_ts < end_ts; ctb_addr_ts++) {
+        int ctb_addr_rs = pps->ctb_addr_ts_to_rs[ctb_addr_ts];
+
+        x_ctb = (ctb_addr_rs % sps->ctb_width) << sps->log2_ctb_size;
+        y_ctb = (ctb_addr_rs / sps->ctb_width) << sps->log2_ctb_size;
+        ff_hevc_hls_filters(lc, x_ctb, y_ctb, ctb_size);
+    }
+
+    if (x_ctb + ctb_size >= sps->width &&
+        y_ctb + ctb_size >= sps->height)
+        ff_hevc_hls_filter(lc, x_ctb, y_ctb, ctb_size);
+
+    return end_ts;
+}
+
 static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
 {
     const uint8_t *data = nal->data;
@@ -2643,7 +2763,8 @@ static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
     int64_t startheader, cmpt = 0;
     int i, j, res = 0;
 
-    if (s->sh.slice_ctb_addr_rs + s->sh.num_entry_point_offsets * s->ps.sps->ctb_width >= s->ps.sps->ctb_width * s->ps.sps->ctb_height) {
+    if (s->ps.pps->entropy_coding_sync_enabled_flag &&
+        s->sh.slice_ctb_addr_rs + s->sh.num_entry_point_offsets * s->ps.sps->ctb_width >= s->ps.sps->ctb_width * s->ps.sps->ctb_height) {
         av_log(s->avctx, AV_LOG_ERROR, "WPP ctb addresses are wrong (%d %d %d %d)\n",
             s->sh.slice_ctb_addr_rs, s->sh.num_entry_point_offsets,
             s->ps.sps->ctb_width, s->ps.sps->ctb_height
@@ -2651,6 +2772,25 @@ static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
         return AVERROR_INVALIDDATA;
     }
 
+    if (s->enable_parallel_tiles) {
+        const HEVCPPS *const pps = s->ps.pps;
+        int start_ts = pps->ctb_addr_rs_to_ts[s->sh.slice_ctb_addr_rs];
+
+        if (pps->tile_id[start_ts] + s->sh.num_entry_point_offsets >=
+            pps->num_tile_columns * pps->num_tile_rows) {
+            av_log(s->avctx, AV_LOG_ERROR, "Tile entry points are wrong (%d %d %d)\n",
+                   s->sh.slice_ctb_addr_rs, s->sh.num_entry_point_offsets,
+                   pps->num_tile_columns * pps->num_tile_rows);
+            return AVERROR_INVALIDDATA;
+        }
+        if (s->sh.dependent_slice_segment_flag &&
+            (!start_ts ||
+             s->tab_slice_address[pps->ctb_addr_ts_to_rs[start_ts - 1]] != s->sh.slice_addr)) {
+            av_log(s->avctx, AV_LOG_ERROR, "Previous slice segment missing\n");
+            return AVERROR_INVALIDDATA;
+        }
+    }
+
     for (i = 1; i < s->threads_number; i++) {
         if (s->HEVClcList[i])
             continue;
@@ -2702,19 +2842,38 @@ static int hls_slice_data_wpp(HEVCContext *s, const H2645NAL *nal)
     }
 
     atomic_store(&s->wpp_err, 0);
-    res = ff_slice_thread_allocz_entries(s->avctx, s->sh.num_entry_point_offsets + 1);
-    if (res < 0)
-        return res;
+    if (s->ps.pps->entropy_coding_sync_enabled_flag) {
+        res = ff_slice_thread_allocz_entries(s->avctx, s->sh.num_entry_point_offsets + 1);
+        if (res < 0)
+            return res;
+    } else {
+        /* Tiles only predict from themselves, but the slice boundaries
+         * seen by hls_decode_neighbour() cross tiles, so mark all tiles
+         * of the slice segment as belonging to it before decoding any. */
+        const HEVCPPS *const pps = s->ps.pps;
+        int start_ts = pps->ctb_addr_rs_to_ts[s->sh.slice_ctb_addr_rs];
+        int tile     = pps->tile_id[start_ts] + s->sh.num_entry_point_offsets + 1;
+        int end_ts   = tile < pps->num_tile_columns * pps->num_tile_rows ?
+                       pps->ctb_addr_rs_to_ts[pps->tile_pos_rs[tile]] :
+                       s->ps.sps->ctb_size;
+
+        for (i = start_ts; i < end_ts; i++)
+            s->tab_slice_address[pps->ctb_addr_ts_to_rs[i]] = s->sh.slice_addr;
+    }
 
     ret = av_calloc(s->sh.num_entry_point_offsets + 1, sizeof(*ret));
     if (!ret)
         return AVERROR(ENOMEM);
 
-    if (s->ps.pps->entropy_coding_sync_enabled_flag)
+    if (s->ps.pps->entropy_coding_sync_enabled_flag) {
         s->avctx->execute2(s->avctx, hls_decode_entry_wpp, s->HEVClcList, ret, s->sh.num_entry_point_offsets + 1);
 
-    for (i = 0; i <= s->sh.num_entry_point_offsets; i++)
-        res += ret[i];
+        for (i = 0; i <= s->sh.num_entry_point_offsets; i++)
+            res += ret[i];
+    } else {
+        s->avctx->execute2(s->avctx, hls_decode_entry_tile, s->HEVClcList, ret, s->sh.num_entry_point_offsets + 1);
+        res = hls_filter_tiles(s, ret);
+    }
 
     av_free(ret);
     return res;
@@ -177,6 +177,9 @@ static int aom_decode(AVCodecContext *avctx, AVFrame *picture,
             if (ret < 0)
                 return ret;
         }
+        // libaom does not decode into user-supplied buffers
+        if ((ret = ff_decode_count_plane_copies(avctx, av_pix_fmt_count_planes(avctx->pix_fmt))) < 0)
+            return ret;
         if ((ret = ff_get_buffer(avctx, picture, 0)) < 0)
             return ret;
 
@@ -133,6 +133,9 @@ static int svc_decode_frame(AVCodecContext *avctx, AVFrame *avframe,
         return ret;
     // The decoder doesn't (currently) support decoding into a user
     // provided buffer, so do a copy instead.
+    ret = ff_decode_count_plane_copies(avctx, av_pix_fmt_count_planes(avctx->pix_fmt));
+    if (ret < 0)
+        return ret;
     if (ff_get_buffer(avctx, avframe, 0) < 0) {
         av_log(avctx, AV_LOG_ERROR, "Unable to allocate buffer\n");
         return AVERROR(ENOMEM);
@@ -327,6 +327,8 @@ static int vpx_decode(AVCodecContext *avctx, AVFrame *picture,
                 picture->linesize[i] = linesizes[i];
             }
         } else {
+            if ((ret = ff_decode_count_plane_copies(avctx, av_pix_fmt_count_planes(avctx->pix_fmt))) < 0)
+                return ret;
             if ((ret = ff_get_buffer(avctx, picture, 0)) < 0)
                 return ret;
             av_image_copy(picture->data, picture->linesize, (const uint8_t**)planes,
@@ -42,6 +42,7 @@
 #include "libavutil/buffer.h"
 #include "libavutil/common.h"
 #include "libavutil/imgutils.h"
+#include "libavutil/pixdesc.h"
 #include "libavutil/opt.h"
 #include "libavutil/log.h"
 
@@ -640,6 +641,8 @@ static int ffmal_copy_frame(AVCodecContext *avctx,  AVFrame *frame,
         uint8_t *src[4];
         int linesize[4];
 
+        if ((ret = ff_decode_count_plane_copies(avctx, av_pix_fmt_count_planes(avctx->pix_fmt))) < 0)
+            goto done;
         if ((ret = ff_get_buffer(avctx, frame, 0)) < 0)
             goto done;
 
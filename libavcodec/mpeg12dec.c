@@ -57,6 +57,7 @@
 #include "profiles.h"
 #include "startcode.h"
 #include "thread.h"
+#include "threadframe.h"
 
 #define A53_MAX_CC_COUNT 2000
 
@@ -1072,21 +1073,48 @@ static av_cold int mpeg_decode_init(AVCodecContext *avctx)
 static int mpeg_decode_update_thread_context(AVCodecContext *avctx,
                                              const AVCodecContext *avctx_from)
 {
-    Mpeg1Context *ctx = avctx->priv_data, *ctx_from = avctx_from->priv_data;
-    MpegEncContext *s = &ctx->mpeg_enc_ctx, *s1 = &ctx_from->mpeg_enc_ctx;
+    Mpeg1Context *ctx = avctx->priv_data;
+    const Mpeg1Context *ctx_from = avctx_from->priv_data;
+    MpegEncContext *s = &ctx->mpeg_enc_ctx;
+    const MpegEncContext *s1 = &ctx_from->mpeg_enc_ctx;
     int err;
 
-    if (avctx == avctx_from               ||
-        !ctx_from->mpeg_enc_ctx_allocated ||
-        !s1->context_initialized)
+    if (avctx == avctx_from)
         return 0;
 
-    err = ff_mpeg_update_thread_context(avctx, avctx_from);
-    if (err)
-        return err;
+    if (ctx_from->mpeg_enc_ctx_allocated && s1->context_initialized) {
+        err = ff_mpeg_update_thread_context(avctx, avctx_from);
+        if (err)
+            return err;
+        ctx->mpeg_enc_ctx_allocated = s->context_initialized;
+    }
 
-    if (!ctx->mpeg_enc_ctx_allocated)
-        memcpy(s + 1, s1 + 1, sizeof(Mpeg1Context) - sizeof(MpegEncContext));
+    /* Sequence level state is only sent with the sequence header and
+     * its extensions, so carry it over for the packets without one. */
+    avctx->codec_id         = avctx_from->codec_id;
+    s->codec_id             = s1->codec_id;
+    s->out_format           = s1->out_format;
+    s->bit_rate             = s1->bit_rate;
+    s->progressive_sequence = s1->progressive_sequence;
+    s->chroma_format        = s1->chroma_format;
+    memcpy(s->intra_matrix,        s1->intra_matrix,        sizeof(s->intra_matrix));
+    memcpy(s->inter_matrix,        s1->inter_matrix,        sizeof(s->inter_matrix));
+    memcpy(s->chroma_intra_matrix, s1->chroma_intra_matrix, sizeof(s->chroma_intra_matrix));
+    memcpy(s->chroma_inter_matrix, s1->chroma_inter_matrix, sizeof(s->chroma_inter_matrix));
+
+    ctx->pan_scan             = ctx_from->pan_scan;
+    ctx->aspect_ratio_info    = ctx_from->aspect_ratio_info;
+    ctx->save_aspect          = ctx_from->save_aspect;
+    ctx->save_width           = ctx_from->save_width;
+    ctx->save_height          = ctx_from->save_height;
+    ctx->save_progressive_seq = ctx_from->save_progressive_seq;
+    ctx->rc_buffer_size       = ctx_from->rc_buffer_size;
+    ctx->frame_rate_ext       = ctx_from->frame_rate_ext;
+    ctx->frame_rate_index     = ctx_from->frame_rate_index;
+    ctx->sync                 = ctx_from->sync;
+    ctx->closed_gop           = ctx_from->closed_gop;
+    ctx->tmpgexs              = ctx_from->tmpgexs;
+    ctx->extradata_decoded    = ctx_from->extradata_decoded;
 
     return 0;
 }
@@ -1638,7 +1666,10 @@ static int mpeg_field_start(MpegEncContext *s, const uint8_t *buf, int buf_size)
             s1->has_afd = 0;
         }
 
-        if (HAVE_THREADS && (avctx->active_thread_type & FF_THREAD_FRAME))
+        /* The header of the second field still changes the context,
+         * so a field pair is set up only once both fields started. */
+        if (HAVE_THREADS && (avctx->active_thread_type & FF_THREAD_FRAME) &&
+            s->picture_structure == PICT_FRAME)
             ff_thread_finish_setup(avctx);
     } else { // second field
         int i;
@@ -1648,6 +1679,9 @@ static int mpeg_field_start(MpegEncContext *s, const uint8_t *buf, int buf_size)
             return AVERROR_INVALIDDATA;
         }
 
+        if (HAVE_THREADS && (avctx->active_thread_type & FF_THREAD_FRAME))
+            ff_thread_finish_setup(avctx);
+
         if (s->avctx->hwaccel) {
             if ((ret = s->avctx->hwaccel->end_frame(s->avctx)) < 0) {
                 av_log(avctx, AV_LOG_ERROR,
@@ -1832,7 +1866,9 @@ static int mpeg_decode_slice(MpegEncContext *s, int mb_y,
             int left;
 
             ff_mpeg_draw_horiz_band(s, mb_size * (s->mb_y >> field_pic), mb_size);
-            ff_mpv_report_decode_progress(s);
+            /* the rows of a field pair are complete only in its second field */
+            if (!field_pic || !s->first_field)
+                ff_mpv_report_decode_progress(s);
 
             s->mb_x  = 0;
             s->mb_y += 1 << field_pic;
@@ -2784,6 +2820,7 @@ static int mpeg_decode_frame(AVCodecContext *avctx, AVFrame *picture,
     int buf_size = avpkt->size;
     Mpeg1Context *s = avctx->priv_data;
     MpegEncContext *s2 = &s->mpeg_enc_ctx;
+    const Picture *cur_pic;
 
     if (buf_size == 0 || (buf_size == 4 && AV_RB32(buf) == SEQ_END_CODE)) {
         /* special case for last picture */
@@ -2832,8 +2869,13 @@ static int mpeg_decode_frame(AVCodecContext *avctx, AVFrame *picture,
         }
     }
 
+    cur_pic = s2->current_picture_ptr;
     ret = decode_chunks(avctx, picture, got_output, buf, buf_size);
     if (ret<0 || *got_output) {
+        /* do not leave frame threads waiting for rows which will never come */
+        if (HAVE_THREADS && ret < 0 && s2->current_picture_ptr &&
+            s2->current_picture_ptr != cur_pic)
+            ff_thread_report_progress(&s2->current_picture_ptr->tf, INT_MAX, 0);
         s2->current_picture_ptr = NULL;
 
         if (s->timecode_frame_start != -1 && *got_output) {
@@ -2889,8 +2931,10 @@ const FFCodec ff_mpeg1video_decoder = {
 #if FF_API_FLAG_TRUNCATED
                              AV_CODEC_CAP_TRUNCATED |
 #endif
-                             AV_CODEC_CAP_DELAY | AV_CODEC_CAP_SLICE_THREADS,
-    .caps_internal         = FF_CODEC_CAP_SKIP_FRAME_FILL_PARAM,
+                             AV_CODEC_CAP_DELAY | AV_CODEC_CAP_SLICE_THREADS |
+                             AV_CODEC_CAP_FRAME_THREADS,
+    .caps_internal         = FF_CODEC_CAP_SKIP_FRAME_FILL_PARAM |
+                             FF_CODEC_CAP_ALLOCATE_PROGRESS,
     .flush                 = flush,
     .p.max_lowres          = 3,
     UPDATE_THREAD_CONTEXT(mpeg_decode_update_thread_context),
@@ -2921,11 +2965,14 @@ const FFCodec ff_mpeg2video_decoder = {
 #if FF_API_FLAG_TRUNCATED
                       AV_CODEC_CAP_TRUNCATED |
 #endif
-                      AV_CODEC_CAP_DELAY | AV_CODEC_CAP_SLICE_THREADS,
-    .caps_internal  = FF_CODEC_CAP_SKIP_FRAME_FILL_PARAM,
+                      AV_CODEC_CAP_DELAY | AV_CODEC_CAP_SLICE_THREADS |
+                      AV_CODEC_CAP_FRAME_THREADS,
+    .caps_internal  = FF_CODEC_CAP_SKIP_FRAME_FILL_PARAM |
+                      FF_CODEC_CAP_ALLOCATE_PROGRESS,
     .flush          = flush,
     .p.max_lowres   = 3,
     .p.profiles     = NULL_IF_CONFIG_SMALL(ff_mpeg2_video_profiles),
+    UPDATE_THREAD_CONTEXT(mpeg_decode_update_thread_context),
     .hw_configs     = (const AVCodecHWConfigInternal *const []) {
 #if CONFIG_MPEG2_DXVA2_HWACCEL
                         HWACCEL_DXVA2(mpeg2),
@@ -2966,10 +3013,13 @@ const FFCodec ff_mpegvideo_decoder = {
 #if FF_API_FLAG_TRUNCATED
                       AV_CODEC_CAP_TRUNCATED |
 #endif
-                      AV_CODEC_CAP_DELAY | AV_CODEC_CAP_SLICE_THREADS,
-    .caps_internal  = FF_CODEC_CAP_SKIP_FRAME_FILL_PARAM,
+                      AV_CODEC_CAP_DELAY | AV_CODEC_CAP_SLICE_THREADS |
+                      AV_CODEC_CAP_FRAME_THREADS,
+    .caps_internal  = FF_CODEC_CAP_SKIP_FRAME_FILL_PARAM |
+                      FF_CODEC_CAP_ALLOCATE_PROGRESS,
     .flush          = flush,
     .p.max_lowres   = 3,
+    UPDATE_THREAD_CONTEXT(mpeg_decode_update_thread_context),
 };
 
 typedef struct IPUContext {
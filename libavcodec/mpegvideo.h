@@ -534,6 +534,7 @@ typedef struct MpegEncContext {
     AVFrame *tmp_frames[MAX_B_FRAMES + 2];
     int b_frame_strategy;
     int b_sensitivity;
+    int gop_threads;    ///< encode whole GOPs in parallel with frame threads
 
     /* frame skip options for encoding */
     int frame_skip_threshold;
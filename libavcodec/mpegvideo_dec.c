@@ -978,6 +978,11 @@ static int lowest_referenced_row(MpegEncContext *s, int dir)
         case MV_TYPE_8X8:
             mvs = 4;
             break;
+        case MV_TYPE_FIELD:
+            if (s->quarter_sample)
+                goto unhandled;
+            mvs = 2;
+            break;
         default:
             goto unhandled;
     }
@@ -988,6 +993,13 @@ static int lowest_referenced_row(MpegEncContext *s, int dir)
         my_min = FFMIN(my_min, my);
     }
 
+    if (s->mv_type == MV_TYPE_FIELD) {
+        /* Field vectors are in field lines; allow for the interpolation
+         * and the opposite parity field, two frame lines in total. */
+        my_max = 2 * my_max + 4;
+        my_min = 2 * my_min - 4;
+    }
+
     off = ((FFMAX(-my_min, my_max) << qpel_shift) + 63) >> 6;
 
     return av_clip(s->mb_y + off, 0, s->mb_height - 1);
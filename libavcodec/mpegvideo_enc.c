@@ -1953,7 +1953,8 @@ vbv_retry:
 
         pkt->pts = s->current_picture.f->pts;
         if (!s->low_delay && s->pict_type != AV_PICTURE_TYPE_B) {
-            if (!s->current_picture.f->coded_picture_number)
+            if (!s->current_picture.f->coded_picture_number ||
+                s->reordered_pts == AV_NOPTS_VALUE)
                 pkt->dts = pkt->pts - s->dts_delta;
             else
                 pkt->dts = s->reordered_pts;
@@ -1966,6 +1967,11 @@ vbv_retry:
             av_packet_shrink_side_data(pkt, AV_PKT_DATA_H263_MB_INFO, s->mb_info_size);
     } else {
         s->frame_bits = 0;
+        /* The encoder has been drained; when it is fed again (as done by
+         * GOP threading), restart the dts sequence like for the first
+         * picture. */
+        if (!pic_arg)
+            s->reordered_pts = AV_NOPTS_VALUE;
     }
 
     /* release non-reference frames */
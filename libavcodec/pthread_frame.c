@@ -600,6 +600,9 @@ int ff_thread_decode_frame(AVCodecContext *avctx,
 
         av_frame_move_ref(picture, p->frame);
         *got_picture_ptr = p->got_frame;
+        /* each thread counts its own copies, collect them for the user */
+        avctx->plane_copies   += p->avctx->plane_copies;
+        p->avctx->plane_copies = 0;
         picture->pkt_dts = p->avpkt->dts;
         err = p->result;
 
@@ -26,6 +26,7 @@
  */
 
 #include "libavutil/avassert.h"
+#include "libavutil/pixdesc.h"
 
 #include "avcodec.h"
 #include "bytestream.h"
@@ -204,6 +205,9 @@ static int roq_decode_frame(AVCodecContext *avctx, AVFrame *rframe,
         return ret;
 
     if (copy) {
+        ret = ff_decode_count_plane_copies(avctx, av_pix_fmt_count_planes(s->current_frame->format));
+        if (ret < 0)
+            return ret;
         ret = av_frame_copy(s->current_frame, s->last_frame);
         if (ret < 0)
             return ret;
@@ -23,6 +23,7 @@
 
 #include "avcodec.h"
 #include "codec_internal.h"
+#include "decode.h"
 #include "v210dec.h"
 #include "v210dec_init.h"
 #include "libavutil/bswap.h"
@@ -197,12 +198,22 @@ static int decode_frame(AVCodecContext *avctx, AVFrame *pic,
     } else {
         uint8_t *pointers[4];
         int linesizes[4];
-        int ret = av_image_alloc(pointers, linesizes, avctx->width, avctx->height, avctx->pix_fmt, 1);
-        if (ret < 0)
-            return ret;
-        decode_row((const uint32_t *)psrc, (uint16_t *)pointers[0], (uint16_t *)pointers[1], (uint16_t *)pointers[2], avctx->width * avctx->height, s->unpack_frame);
-        av_image_copy(pic->data, pic->linesize, (const uint8_t **)pointers, linesizes, avctx->pix_fmt, avctx->width, avctx->height);
-        av_freep(&pointers[0]);
+        av_image_fill_linesizes(linesizes, avctx->pix_fmt, avctx->width);
+        if (pic->linesize[0] == linesizes[0] &&
+            pic->linesize[1] == linesizes[1] &&
+            pic->linesize[2] == linesizes[2]) {
+            /* the planes are unpadded, so the rows can be unpacked in place */
+            decode_row((const uint32_t *)psrc, (uint16_t *)pic->data[0], (uint16_t *)pic->data[1], (uint16_t *)pic->data[2], avctx->width * avctx->height, s->unpack_frame);
+        } else {
+            if ((ret = ff_decode_count_plane_copies(avctx, 3)) < 0)
+                return ret;
+            ret = av_image_alloc(pointers, linesizes, avctx->width, avctx->height, avctx->pix_fmt, 1);
+            if (ret < 0)
+                return ret;
+            decode_row((const uint32_t *)psrc, (uint16_t *)pointers[0], (uint16_t *)pointers[1], (uint16_t *)pointers[2], avctx->width * avctx->height, s->unpack_frame);
+            av_image_copy(pic->data, pic->linesize, (const uint8_t **)pointers, linesizes, avctx->pix_fmt, avctx->width, avctx->height);
+            av_freep(&pointers[0]);
+        }
     }
 
     if (avctx->field_order > AV_FIELD_PROGRESSIVE) {
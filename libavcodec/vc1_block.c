@@ -31,6 +31,7 @@
 #include "mpegvideo.h"
 #include "mpegvideodec.h"
 #include "msmpeg4_vc1_data.h"
+#include "threadframe.h"
 #include "unary.h"
 #include "vc1.h"
 #include "vc1_pred.h"
@@ -2533,6 +2534,46 @@ static int vc1_decode_b_mb_intfr(VC1Context *v)
     return 0;
 }
 
+/* The overlap and loop filters trail the decoding loop by two MB rows, and
+ * the V loop filter of the next row still touches the bottom line of the
+ * row above, so a row is only final three rows later. */
+#define FILTER_DELAY_ROWS 3
+
+/**
+ * Wait for the reference rows that the current MB row can reach with
+ * vertical vectors of up to range_y quarter-pels, when frame threading.
+ */
+static void vc1_await_references(VC1Context *v, int range_y)
+{
+    MpegEncContext *s = &v->s;
+    int row = INT_MAX;
+
+    if (!HAVE_THREADS || !(s->avctx->active_thread_type & FF_THREAD_FRAME))
+        return;
+
+    /* field accesses need the complete reference; otherwise allow for the
+     * bicubic filter taps below the block */
+    if (v->fcm == PROGRESSIVE)
+        row = FFMIN(s->mb_y + ((range_y >> 2) + 4 + 15 >> 4), s->mb_height - 1);
+
+    if (s->last_picture_ptr)
+        ff_thread_await_progress(&s->last_picture_ptr->tf,
+                                 s->last_picture_ptr->f->interlaced_frame ? INT_MAX : row, 0);
+    if (s->pict_type == AV_PICTURE_TYPE_B && s->next_picture_ptr)
+        ff_thread_await_progress(&s->next_picture_ptr->tf,
+                                 s->next_picture_ptr->f->interlaced_frame ? INT_MAX : row, 0);
+}
+
+static void vc1_report_decode_progress(VC1Context *v, int row)
+{
+    MpegEncContext *s = &v->s;
+
+    /* field pictures are only complete once both fields are decoded */
+    if (row >= 0 && !v->field_mode && !s->er.error_occurred &&
+        s->pict_type != AV_PICTURE_TYPE_B)
+        ff_thread_report_progress(&s->current_picture_ptr->tf, row, 0);
+}
+
 /** Decode blocks of I-frame
  */
 static void vc1_decode_i_blocks(VC1Context *v)
@@ -2646,11 +2687,13 @@ static void vc1_decode_i_blocks(VC1Context *v)
         }
 
         s->first_slice_line = 0;
+        vc1_report_decode_progress(v, s->mb_y - FILTER_DELAY_ROWS);
     }
 
     /* This is intentionally mb_height and not end_mb_y - unlike in advanced
      * profile, these only differ are when decoding MSS2 rectangles. */
     ff_er_add_slice(&s->er, 0, 0, s->mb_width - 1, s->mb_height - 1, ER_MB_END);
+    vc1_report_decode_progress(v, s->end_mb_y - 1);
 }
 
 /** Decode blocks of I-frame for advanced profile
@@ -2786,10 +2829,12 @@ static int vc1_decode_i_blocks_adv(VC1Context *v)
             inc_blk_idx(v->cur_blk_idx);
         }
         s->first_slice_line = 0;
+        vc1_report_decode_progress(v, s->mb_y - FILTER_DELAY_ROWS);
     }
 
     ff_er_add_slice(&s->er, 0, s->start_mb_y << v->field_mode, s->mb_width - 1,
                     (s->end_mb_y << v->field_mode) - 1, ER_MB_END);
+    vc1_report_decode_progress(v, s->end_mb_y - 1);
     return 0;
 }
 
@@ -2827,6 +2872,7 @@ static void vc1_decode_p_blocks(VC1Context *v)
     s->first_slice_line = 1;
     memset(v->cbp_base, 0, sizeof(v->cbp_base[0]) * 3 * s->mb_stride);
     for (s->mb_y = s->start_mb_y; s->mb_y < s->end_mb_y; s->mb_y++) {
+        vc1_await_references(v, v->range_y);
         s->mb_x = 0;
         init_block_index(v);
         for (; s->mb_x < s->mb_width; s->mb_x++) {
@@ -2876,9 +2922,11 @@ static void vc1_decode_p_blocks(VC1Context *v)
                 v->luma_mv - s->mb_stride,
                 sizeof(v->luma_mv_base[0]) * 2 * s->mb_stride);
         s->first_slice_line = 0;
+        vc1_report_decode_progress(v, s->mb_y - FILTER_DELAY_ROWS);
     }
     ff_er_add_slice(&s->er, 0, s->start_mb_y << v->field_mode, s->mb_width - 1,
                     (s->end_mb_y << v->field_mode) - 1, ER_MB_END);
+    vc1_report_decode_progress(v, s->end_mb_y - 1);
 }
 
 static void vc1_decode_b_blocks(VC1Context *v)
@@ -2912,6 +2960,9 @@ static void vc1_decode_b_blocks(VC1Context *v)
 
     s->first_slice_line = 1;
     for (s->mb_y = s->start_mb_y; s->mb_y < s->end_mb_y; s->mb_y++) {
+        /* direct mode scales the vectors of the next anchor, which may have
+         * been coded with a larger MV range */
+        vc1_await_references(v, v->extended_mv ? 1024 : v->range_y);
         s->mb_x = 0;
         init_block_index(v);
         for (; s->mb_x < s->mb_width; s->mb_x++) {
@@ -2969,6 +3020,7 @@ static void vc1_decode_skip_blocks(VC1Context *v)
     ff_er_add_slice(&s->er, 0, s->start_mb_y, s->mb_width - 1, s->end_mb_y - 1, ER_MB_END);
     s->first_slice_line = 1;
     for (s->mb_y = s->start_mb_y; s->mb_y < s->end_mb_y; s->mb_y++) {
+        vc1_await_references(v, 0);
         s->mb_x = 0;
         init_block_index(v);
         update_block_index(s);
@@ -2976,6 +3028,7 @@ static void vc1_decode_skip_blocks(VC1Context *v)
         memcpy(s->dest[1], s->last_picture.f->data[1] + s->mb_y *  8 * s->uvlinesize, s->uvlinesize *  8);
         memcpy(s->dest[2], s->last_picture.f->data[2] + s->mb_y *  8 * s->uvlinesize, s->uvlinesize *  8);
         s->first_slice_line = 0;
+        vc1_report_decode_progress(v, s->mb_y);
     }
 }
 
@@ -41,6 +41,8 @@
 #include "msmpeg4_vc1_data.h"
 #include "profiles.h"
 #include "simple_idct.h"
+#include "thread.h"
+#include "threadframe.h"
 #include "vc1.h"
 #include "vc1data.h"
 #include "vc1_vlc_data.h"
@@ -815,6 +817,83 @@ av_cold int ff_vc1_decode_end(AVCodecContext *avctx)
     return 0;
 }
 
+#if HAVE_THREADS
+static int vc1_update_thread_context(AVCodecContext *dst,
+                                     const AVCodecContext *src)
+{
+    VC1Context *const v = dst->priv_data;
+    const VC1Context *const v1 = src->priv_data;
+    MpegEncContext *const s = &v->s;
+    const MpegEncContext *const s1 = &v1->s;
+    int ret;
+
+    if (dst == src)
+        return 0;
+
+    if (s1->context_initialized) {
+        /* the VC-1 tables are sized like the MpegEncContext ones */
+        if (s->context_initialized &&
+            (s->width != s1->width || s->height != s1->height))
+            ff_vc1_decode_end(dst);
+
+        if (!s->context_initialized) {
+            if ((ret = ff_mpeg_update_thread_context(dst, src)) < 0)
+                return ret;
+            if ((ret = vc1_decode_init_alloc_tables(v)) < 0) {
+                ff_vc1_decode_end(dst);
+                return ret;
+            }
+        } else if ((ret = ff_mpeg_update_thread_context(dst, src)) < 0)
+            return ret;
+
+        s->loop_filter = s1->loop_filter;
+        s->h_edge_pos  = s1->h_edge_pos;
+        s->v_edge_pos  = s1->v_edge_pos;
+    }
+
+    // sequence header and entry point
+    memcpy(&v->res_sprite, &v1->res_sprite,
+           (char *) &v1->finterpflag + sizeof(v1->finterpflag) -
+           (char *) &v1->res_sprite);
+    v->hrd_num_leaky_buckets = v1->hrd_num_leaky_buckets;
+    v->bit_rate_exponent     = v1->bit_rate_exponent;
+    v->buffer_size_exponent  = v1->buffer_size_exponent;
+    v->range_mapy_flag       = v1->range_mapy_flag;
+    v->range_mapuv_flag      = v1->range_mapuv_flag;
+    v->range_mapy            = v1->range_mapy;
+    v->range_mapuv           = v1->range_mapuv;
+    v->broken_link           = v1->broken_link;
+    v->closed_entry          = v1->closed_entry;
+
+    // state carried over from the previous pictures
+    v->rnd         = v1->rnd;
+    v->refdist     = v1->refdist;
+    v->last_use_ic = v1->last_use_ic;
+    v->next_use_ic = v1->next_use_ic;
+    v->aux_use_ic  = v1->aux_use_ic;
+    memcpy(v->last_luty,  v1->last_luty,  sizeof(v->last_luty));
+    memcpy(v->last_lutuv, v1->last_lutuv, sizeof(v->last_lutuv));
+    memcpy(v->next_luty,  v1->next_luty,  sizeof(v->next_luty));
+    memcpy(v->next_lutuv, v1->next_lutuv, sizeof(v->next_lutuv));
+    memcpy(v->aux_luty,   v1->aux_luty,   sizeof(v->aux_luty));
+    memcpy(v->aux_lutuv,  v1->aux_lutuv,  sizeof(v->aux_lutuv));
+
+    /* field MV flags of the last anchor field picture, used by B fields;
+     * mv_f and mv_f_next swap between mv_f_base and mv_f_next_base, so copy
+     * the whole allocation mv_f_next[0] currently points into */
+    if (s1->context_initialized && v->interlace) {
+        int mb_height = FFALIGN(s->mb_height, 2);
+        int size = 2 * (s->b8_stride * (mb_height * 2 + 1) +
+                        s->mb_stride * (mb_height + 1) * 2);
+
+        memcpy(v->mv_f_next[0]  - s->b8_stride - 1,
+               v1->mv_f_next[0] - s->b8_stride - 1, size);
+    }
+
+    return 0;
+}
+#endif
+
 
 /** Decode a VC1/WMV3 frame
  * @todo TODO: Handle VC-1 IDUs (Transport level?)
@@ -828,7 +907,8 @@ static int vc1_decode_frame(AVCodecContext *avctx, AVFrame *pict,
     MpegEncContext *s = &v->s;
     uint8_t *buf2 = NULL;
     const uint8_t *buf_start = buf, *buf_start_second_field = NULL;
-    int mb_height, n_slices1=-1;
+    const Picture *cur_pic = s->current_picture_ptr;
+    int mb_height, n_slices1=-1, late_setup;
     struct {
         uint8_t *buf;
         GetBitContext gb;
@@ -1088,6 +1168,15 @@ static int vc1_decode_frame(AVCodecContext *avctx, AVFrame *pict,
         s->current_picture_ptr->f->repeat_pict = v->rptfrm * 2;
     }
 
+    /* The second field header and slices repeating the picture header
+     * update the state the next frame thread copies, so setup can only be
+     * finished once they have been parsed. */
+    late_setup = v->field_mode;
+    for (i = 0; i < n_slices && !late_setup; i++)
+        late_setup = show_bits1(&slices[i].gb);
+    if (!late_setup)
+        ff_thread_finish_setup(avctx);
+
     if (avctx->hwaccel) {
         s->mb_y = 0;
         if (v->field_mode && buf_start_second_field) {
@@ -1210,6 +1299,8 @@ static int vc1_decode_frame(AVCodecContext *avctx, AVFrame *pict,
             if ((ret = avctx->hwaccel->end_frame(avctx)) < 0)
                 goto err;
         }
+        if (late_setup)
+            ff_thread_finish_setup(avctx);
     } else {
         int header_ret = 0;
 
@@ -1304,6 +1395,8 @@ static int vc1_decode_frame(AVCodecContext *avctx, AVFrame *pict,
                 FFSWAP(uint8_t *, v->mv_f_next[1], v->mv_f[1]);
             }
         }
+        if (late_setup)
+            ff_thread_finish_setup(avctx);
         ff_dlog(s->avctx, "Consumed %i/%i bits\n",
                 get_bits_count(&s->gb), s->gb.size_in_bits);
 //  if (get_bits_count(&s->gb) > buf_size * 8)
@@ -1362,6 +1455,9 @@ end:
     return buf_size;
 
 err:
+    /* do not leave frame threads waiting for rows which will never come */
+    if (s->current_picture_ptr && s->current_picture_ptr != cur_pic)
+        ff_thread_report_progress(&s->current_picture_ptr->tf, INT_MAX, 0);
     av_free(buf2);
     for (i = 0; i < n_slices; i++)
         av_free(slices[i].buf);
@@ -1401,7 +1497,11 @@ const FFCodec ff_vc1_decoder = {
     .close          = ff_vc1_decode_end,
     FF_CODEC_DECODE_CB(vc1_decode_frame),
     .flush          = ff_mpeg_flush,
+    UPDATE_THREAD_CONTEXT(vc1_update_thread_context),
+    /* AV_CODEC_CAP_FRAME_THREADS is left out until the vc1-frame-threads
+     * FATE tests have been run on the conformance samples */
     .p.capabilities = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_DELAY,
+    .caps_internal  = FF_CODEC_CAP_ALLOCATE_PROGRESS,
     .p.pix_fmts     = vc1_hwaccel_pixfmt_list_420,
     .hw_configs     = (const AVCodecHWConfigInternal *const []) {
 #if CONFIG_VC1_DXVA2_HWACCEL
@@ -1438,7 +1538,11 @@ const FFCodec ff_wmv3_decoder = {
     .close          = ff_vc1_decode_end,
     FF_CODEC_DECODE_CB(vc1_decode_frame),
     .flush          = ff_mpeg_flush,
+    UPDATE_THREAD_CONTEXT(vc1_update_thread_context),
+    /* AV_CODEC_CAP_FRAME_THREADS is left out until the vc1-frame-threads
+     * FATE tests have been run on the conformance samples */
     .p.capabilities = AV_CODEC_CAP_DR1 | AV_CODEC_CAP_DELAY,
+    .caps_internal  = FF_CODEC_CAP_ALLOCATE_PROGRESS,
     .p.pix_fmts     = vc1_hwaccel_pixfmt_list_420,
     .hw_configs     = (const AVCodecHWConfigInternal *const []) {
 #if CONFIG_WMV3_DXVA2_HWACCEL
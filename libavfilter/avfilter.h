@@ -409,6 +409,13 @@ unsigned avfilter_filter_pad_count(const AVFilter *filter, int is_output);
  */
 #define AVFILTER_THREAD_SLICE (1 << 0)
 
+/**
+ * Activate filters that do not share any link concurrently, e.g. the
+ * independent branches following a split filter. Only meaningful for
+ * AVFilterGraph.thread_type, and not enabled by default.
+ */
+#define AVFILTER_THREAD_GRAPH (1 << 1)
+
 typedef struct AVFilterInternal AVFilterInternal;
 
 /** An instance of a filter */
@@ -887,7 +894,9 @@ typedef struct AVFilterGraph {
      * of AVFILTER_THREAD_* flags.
      *
      * May be set by the caller at any point, the setting will apply to all
-     * filters initialized after that. The default is allowing everything.
+     * filters initialized after that. The default is allowing slice threading.
+     * AVFILTER_THREAD_GRAPH must be set before adding any filters to the
+     * graph and is ignored if a custom execute callback is used.
      *
      * When a filter in this graph is initialized, this field is combined using
      * bit AND with AVFilterContext.thread_type to get the final mask used for
@@ -48,6 +48,7 @@ static const AVOption filtergraph_options[] = {
     { "thread_type", "Allowed thread types", OFFSET(thread_type), AV_OPT_TYPE_FLAGS,
         { .i64 = AVFILTER_THREAD_SLICE }, 0, INT_MAX, F|V|A, "thread_type" },
         { "slice", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_SLICE }, .flags = F|V|A, .unit = "thread_type" },
+        { "graph", NULL, 0, AV_OPT_TYPE_CONST, { .i64 = AVFILTER_THREAD_GRAPH }, .flags = F|V|A, .unit = "thread_type" },
     { "threads",     "Maximum number of threads", OFFSET(nb_threads), AV_OPT_TYPE_INT,
         { .i64 = 0 }, 0, INT_MAX, F|V|A, "threads"},
         {"auto", "autodetect a suitable number of threads to use", 0, AV_OPT_TYPE_CONST, {.i64 = 0 }, .flags = F|V|A, .unit = "threads"},
@@ -77,6 +78,12 @@ int ff_graph_thread_init(AVFilterGraph *graph)
     graph->nb_threads  = 1;
     return 0;
 }
+
+int ff_graph_activate_filters(AVFilterGraph *graph, AVFilterContext **filters,
+                              int nb_filters)
+{
+    return AVERROR(ENOSYS);
+}
 #endif
 
 AVFilterGraph *avfilter_graph_alloc(void)
@@ -1337,6 +1344,76 @@ int avfilter_graph_request_oldest(AVFilterGraph *graph)
     return 0;
 }
 
+static int can_activate_concurrently(AVFilterContext *filter)
+{
+    /* Sinks update the graph-wide heap of sink links. */
+    return filter->nb_outputs &&
+           !(filter->filter->flags_internal & FF_FILTER_FLAG_GRAPH_ACCESS);
+}
+
+static int neighbourhood_marked(AVFilterContext *filter, unsigned mark)
+{
+    if (filter->internal->activate_mark == mark)
+        return 1;
+    for (unsigned i = 0; i < filter->nb_inputs; i++)
+        if (filter->inputs[i] && filter->inputs[i]->src->internal->activate_mark == mark)
+            return 1;
+    for (unsigned i = 0; i < filter->nb_outputs; i++)
+        if (filter->outputs[i] && filter->outputs[i]->dst->internal->activate_mark == mark)
+            return 1;
+    return 0;
+}
+
+static void mark_neighbourhood(AVFilterContext *filter, unsigned mark)
+{
+    filter->internal->activate_mark = mark;
+    for (unsigned i = 0; i < filter->nb_inputs; i++)
+        if (filter->inputs[i])
+            filter->inputs[i]->src->internal->activate_mark = mark;
+    for (unsigned i = 0; i < filter->nb_outputs; i++)
+        if (filter->outputs[i])
+            filter->outputs[i]->dst->internal->activate_mark = mark;
+}
+
+/**
+ * Select ready filters to activate together with the given one. An
+ * activation only touches the links of the filter and the readiness of its
+ * neighbours, so filters whose neighbourhoods do not overlap can run
+ * concurrently.
+ */
+static int select_activate_batch(AVFilterGraph *graph, AVFilterContext *first)
+{
+    AVFilterGraphInternal *gi = graph->internal;
+    unsigned mark = ++gi->activate_mark;
+    int nb = 0;
+
+    if (!can_activate_concurrently(first))
+        return 0;
+
+    /* the marks of all filters are reset once the counter wraps around */
+    if (!mark) {
+        for (unsigned i = 0; i < graph->nb_filters; i++)
+            graph->filters[i]->internal->activate_mark = 0;
+        mark = ++gi->activate_mark;
+    }
+
+    gi->activate_batch[nb++] = first;
+    mark_neighbourhood(first, mark);
+
+    for (unsigned i = 0; i < graph->nb_filters && nb < gi->nb_activate_threads; i++) {
+        AVFilterContext *filter = graph->filters[i];
+
+        if (!filter->ready || !can_activate_concurrently(filter) ||
+            neighbourhood_marked(filter, mark))
+            continue;
+
+        gi->activate_batch[nb++] = filter;
+        mark_neighbourhood(filter, mark);
+    }
+
+    return nb;
+}
+
 int ff_filter_graph_run_once(AVFilterGraph *graph)
 {
     AVFilterContext *filter;
@@ -1349,5 +1426,13 @@ int ff_filter_graph_run_once(AVFilterGraph *graph)
             filter = graph->filters[i];
     if (!filter->ready)
         return AVERROR(EAGAIN);
+
+    if (graph->internal->nb_activate_threads > 1 &&
+        (graph->thread_type & AVFILTER_THREAD_GRAPH)) {
+        int nb = select_activate_batch(graph, filter);
+        if (nb > 1)
+            return ff_graph_activate_filters(graph, graph->internal->activate_batch, nb);
+    }
+
     return ff_filter_activate(filter);
 }
@@ -133,10 +133,20 @@ struct AVFilterGraphInternal {
     void *thread;
     avfilter_execute_func *thread_execute;
     FFFrameQueueGlobal frame_queues;
+
+    /* AVFILTER_THREAD_GRAPH: maximum number of concurrent activations,
+     * and the filters selected for the next one */
+    int nb_activate_threads;
+    AVFilterContext **activate_batch;
+    unsigned activate_mark;
 };
 
 struct AVFilterInternal {
     avfilter_execute_func *execute;
+
+    /* the graph activate_mark of the last batch this filter or one of its
+     * neighbours was selected for */
+    unsigned activate_mark;
 };
 
 static av_always_inline int ff_filter_execute(AVFilterContext *ctx, avfilter_action_func *func,
@@ -369,6 +379,13 @@ void ff_filter_graph_remove_filter(AVFilterGraph *graph, AVFilterContext *filter
  */
 #define FF_FILTER_FLAG_HWFRAME_AWARE (1 << 0)
 
+/**
+ * The filter accesses other filters of its graph, e.g. to send them
+ * commands. It is never activated concurrently with other filters when
+ * AVFILTER_THREAD_GRAPH is enabled.
+ */
+#define FF_FILTER_FLAG_GRAPH_ACCESS (1 << 1)
+
 /**
  * Run one round of processing on a filter graph.
  */
@@ -27,6 +27,7 @@
 #include "libavutil/macros.h"
 #include "libavutil/mem.h"
 #include "libavutil/slicethread.h"
+#include "libavutil/thread.h"
 
 #include "avfilter.h"
 #include "internal.h"
@@ -41,6 +42,16 @@ typedef struct ThreadContext {
     AVFilterContext *ctx;
     void *arg;
     int   *rets;
+
+    /* Filters activated concurrently may both use slice threading,
+     * which can only run one set of jobs at a time. */
+    pthread_mutex_t execute_lock;
+
+    /* graph threading: a separate pool, as the filters activated on it
+     * may themselves use the slice threading pool */
+    AVSliceThread *graph_thread;
+    AVFilterContext **activate_filters;
+    int              *activate_rets;
 } ThreadContext;
 
 static void worker_func(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads)
@@ -51,9 +62,18 @@ static void worker_func(void *priv, int jobnr, int threadnr, int nb_jobs, int nb
         c->rets[jobnr] = ret;
 }
 
+static void activate_func(void *priv, int jobnr, int threadnr, int nb_jobs, int nb_threads)
+{
+    ThreadContext *c = priv;
+    c->activate_rets[jobnr] = ff_filter_activate(c->activate_filters[jobnr]);
+}
+
 static void slice_thread_uninit(ThreadContext *c)
 {
     avpriv_slicethread_free(&c->thread);
+    avpriv_slicethread_free(&c->graph_thread);
+    av_freep(&c->activate_rets);
+    pthread_mutex_destroy(&c->execute_lock);
 }
 
 static int thread_execute(AVFilterContext *ctx, avfilter_action_func *func,
@@ -63,15 +83,35 @@ static int thread_execute(AVFilterContext *ctx, avfilter_action_func *func,
 
     if (nb_jobs <= 0)
         return 0;
+
+    pthread_mutex_lock(&c->execute_lock);
     c->ctx         = ctx;
     c->arg         = arg;
     c->func        = func;
     c->rets        = ret;
 
     avpriv_slicethread_execute(c->thread, nb_jobs, 0);
+    pthread_mutex_unlock(&c->execute_lock);
     return 0;
 }
 
+int ff_graph_activate_filters(AVFilterGraph *graph, AVFilterContext **filters,
+                              int nb_filters)
+{
+    ThreadContext *c = graph->internal->thread;
+    int ret = 0;
+
+    c->activate_filters = filters;
+    avpriv_slicethread_execute(c->graph_thread, nb_filters, 0);
+
+    for (int i = 0; i < nb_filters; i++)
+        if (c->activate_rets[i] < 0) {
+            ret = c->activate_rets[i];
+            break;
+        }
+    return ret;
+}
+
 static int thread_init_internal(ThreadContext *c, int nb_threads)
 {
     nb_threads = avpriv_slicethread_create(&c->thread, c, worker_func, NULL, nb_threads);
@@ -80,8 +120,30 @@ static int thread_init_internal(ThreadContext *c, int nb_threads)
     return FFMAX(nb_threads, 1);
 }
 
+static int graph_thread_init(ThreadContext *c, AVFilterGraph *graph)
+{
+    int nb_threads;
+
+    c->activate_rets = av_calloc(graph->nb_threads, sizeof(*c->activate_rets));
+    graph->internal->activate_batch = av_calloc(graph->nb_threads,
+                                                sizeof(*graph->internal->activate_batch));
+    if (!c->activate_rets || !graph->internal->activate_batch)
+        return AVERROR(ENOMEM);
+
+    nb_threads = avpriv_slicethread_create(&c->graph_thread, c, activate_func,
+                                           NULL, graph->nb_threads);
+    if (nb_threads <= 1) {
+        avpriv_slicethread_free(&c->graph_thread);
+        return nb_threads < 0 ? nb_threads : 0;
+    }
+    graph->internal->nb_activate_threads = FFMIN(nb_threads, graph->nb_threads);
+
+    return 0;
+}
+
 int ff_graph_thread_init(AVFilterGraph *graph)
 {
+    ThreadContext *c;
     int ret;
 
     if (graph->nb_threads == 1) {
@@ -89,12 +151,19 @@ int ff_graph_thread_init(AVFilterGraph *graph)
         return 0;
     }
 
-    graph->internal->thread = av_mallocz(sizeof(ThreadContext));
-    if (!graph->internal->thread)
+    c = graph->internal->thread = av_mallocz(sizeof(ThreadContext));
+    if (!c)
         return AVERROR(ENOMEM);
 
-    ret = thread_init_internal(graph->internal->thread, graph->nb_threads);
+    ret = pthread_mutex_init(&c->execute_lock, NULL);
+    if (ret) {
+        av_freep(&graph->internal->thread);
+        return AVERROR(ret);
+    }
+
+    ret = thread_init_internal(c, graph->nb_threads);
     if (ret <= 1) {
+        slice_thread_uninit(c);
         av_freep(&graph->internal->thread);
         graph->thread_type = 0;
         graph->nb_threads  = 1;
@@ -104,6 +173,9 @@ int ff_graph_thread_init(AVFilterGraph *graph)
 
     graph->internal->thread_execute = thread_execute;
 
+    if (graph->thread_type & AVFILTER_THREAD_GRAPH)
+        return graph_thread_init(c, graph);
+
     return 0;
 }
 
@@ -112,4 +184,5 @@ void ff_graph_thread_free(AVFilterGraph *graph)
     if (graph->internal->thread)
         slice_thread_uninit(graph->internal->thread);
     av_freep(&graph->internal->thread);
+    av_freep(&graph->internal->activate_batch);
 }
@@ -25,4 +25,13 @@ int ff_graph_thread_init(AVFilterGraph *graph);
 
 void ff_graph_thread_free(AVFilterGraph *graph);
 
+/**
+ * Activate the given filters concurrently on the graph threads.
+ * The filters must not share any link or neighbour.
+ *
+ * @return the first error returned by an activation, 0 otherwise
+ */
+int ff_graph_activate_filters(AVFilterGraph *graph, AVFilterContext **filters,
+                              int nb_filters);
+
 #endif /* AVFILTER_THREAD_H */
@@ -0,0 +1,347 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * scale a video stream to several sizes in a single pass over each frame
+ */
+
+#include "libavutil/avstring.h"
+#include "libavutil/internal.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+#include "libavutil/parseutils.h"
+#include "libavutil/pixdesc.h"
+#include "libswscale/swscale.h"
+
+#include "avfilter.h"
+#include "filters.h"
+#include "formats.h"
+#include "internal.h"
+#include "video.h"
+
+typedef struct MultiScaleContext {
+    const AVClass *class;
+
+    char *sizes_str;
+    char *flags_str;
+
+    int *w, *h;
+    struct SwsContext **sws;
+
+    /* scratch arrays for the outputs still open */
+    struct SwsContext **cur_sws;
+    AVFrame **cur_out;
+    int *cur_idx;
+} MultiScaleContext;
+
+static int config_output(AVFilterLink *outlink);
+
+static av_cold int init(AVFilterContext *ctx)
+{
+    MultiScaleContext *s = ctx->priv;
+    char *sizes, *size, *saveptr = NULL;
+    int nb_sizes = 0, ret = 0;
+
+    if (!s->sizes_str || !*s->sizes_str) {
+        av_log(ctx, AV_LOG_ERROR, "No output sizes specified\n");
+        return AVERROR(EINVAL);
+    }
+
+    sizes = av_strdup(s->sizes_str);
+    if (!sizes)
+        return AVERROR(ENOMEM);
+
+    for (size = av_strtok(sizes, "|", &saveptr); size;
+         size = av_strtok(NULL, "|", &saveptr)) {
+        AVFilterPad pad = { 0 };
+        int w, h;
+
+        if ((ret = av_parse_video_size(&w, &h, size)) < 0) {
+            av_log(ctx, AV_LOG_ERROR, "Invalid size '%s'\n", size);
+            goto fail;
+        }
+
+        if ((ret = av_reallocp_array(&s->w, nb_sizes + 1, sizeof(*s->w))) < 0 ||
+            (ret = av_reallocp_array(&s->h, nb_sizes + 1, sizeof(*s->h))) < 0)
+            goto fail;
+        s->w[nb_sizes] = w;
+        s->h[nb_sizes] = h;
+
+        pad.type         = AVMEDIA_TYPE_VIDEO;
+        pad.config_props = config_output;
+        pad.name         = av_asprintf("output%d", nb_sizes);
+        if (!pad.name) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+
+        if ((ret = ff_append_outpad_free_name(ctx, &pad)) < 0)
+            goto fail;
+        nb_sizes++;
+    }
+
+    if (!nb_sizes) {
+        av_log(ctx, AV_LOG_ERROR, "No output sizes specified\n");
+        ret = AVERROR(EINVAL);
+        goto fail;
+    }
+
+    s->sws     = av_calloc(nb_sizes, sizeof(*s->sws));
+    s->cur_sws = av_calloc(nb_sizes, sizeof(*s->cur_sws));
+    s->cur_out = av_calloc(nb_sizes, sizeof(*s->cur_out));
+    s->cur_idx = av_calloc(nb_sizes, sizeof(*s->cur_idx));
+    if (!s->sws || !s->cur_sws || !s->cur_out || !s->cur_idx)
+        ret = AVERROR(ENOMEM);
+
+fail:
+    av_freep(&sizes);
+    return ret;
+}
+
+static av_cold void uninit(AVFilterContext *ctx)
+{
+    MultiScaleContext *s = ctx->priv;
+
+    for (int i = 0; s->sws && i < ctx->nb_outputs; i++)
+        sws_freeContext(s->sws[i]);
+
+    av_freep(&s->sws);
+    av_freep(&s->cur_sws);
+    av_freep(&s->cur_out);
+    av_freep(&s->cur_idx);
+    av_freep(&s->w);
+    av_freep(&s->h);
+}
+
+static int query_formats(AVFilterContext *ctx)
+{
+    AVFilterFormats *formats;
+    const AVPixFmtDescriptor *desc;
+    enum AVPixelFormat pix_fmt;
+    int ret;
+
+    desc    = NULL;
+    formats = NULL;
+    while ((desc = av_pix_fmt_desc_next(desc))) {
+        pix_fmt = av_pix_fmt_desc_get_id(desc);
+        if (sws_isSupportedInput(pix_fmt) &&
+            (ret = ff_add_format(&formats, pix_fmt)) < 0)
+            return ret;
+    }
+    if ((ret = ff_formats_ref(formats, &ctx->inputs[0]->outcfg.formats)) < 0)
+        return ret;
+
+    for (int i = 0; i < ctx->nb_outputs; i++) {
+        desc    = NULL;
+        formats = NULL;
+        while ((desc = av_pix_fmt_desc_next(desc))) {
+            pix_fmt = av_pix_fmt_desc_get_id(desc);
+            if (sws_isSupportedOutput(pix_fmt) &&
+                (ret = ff_add_format(&formats, pix_fmt)) < 0)
+                return ret;
+        }
+        if ((ret = ff_formats_ref(formats, &ctx->outputs[i]->incfg.formats)) < 0)
+            return ret;
+    }
+
+    return 0;
+}
+
+static int config_output(AVFilterLink *outlink)
+{
+    AVFilterContext *ctx = outlink->src;
+    AVFilterLink *inlink = ctx->inputs[0];
+    MultiScaleContext *s = ctx->priv;
+    int idx = FF_OUTLINK_IDX(outlink);
+    struct SwsContext *sws;
+    int ret;
+
+    outlink->w = s->w[idx];
+    outlink->h = s->h[idx];
+
+    if (inlink->sample_aspect_ratio.num)
+        outlink->sample_aspect_ratio = av_mul_q((AVRational){ outlink->h * inlink->w,
+                                                              outlink->w * inlink->h },
+                                                inlink->sample_aspect_ratio);
+    else
+        outlink->sample_aspect_ratio = inlink->sample_aspect_ratio;
+
+    sws_freeContext(s->sws[idx]);
+    s->sws[idx] = sws = sws_alloc_context();
+    if (!sws)
+        return AVERROR(ENOMEM);
+
+    av_opt_set_int(sws, "srcw",       inlink->w,       0);
+    av_opt_set_int(sws, "srch",       inlink->h,       0);
+    av_opt_set_int(sws, "src_format", inlink->format,  0);
+    av_opt_set_int(sws, "dstw",       outlink->w,      0);
+    av_opt_set_int(sws, "dsth",       outlink->h,      0);
+    av_opt_set_int(sws, "dst_format", outlink->format, 0);
+    if (s->flags_str && *s->flags_str &&
+        (ret = av_opt_set(sws, "sws_flags", s->flags_str, 0)) < 0)
+        return ret;
+
+    /* use the MPEG-2 chroma positions like the scale filter does */
+    if (inlink->format == AV_PIX_FMT_YUV420P)
+        av_opt_set_int(sws, "src_v_chr_pos", 128, 0);
+    if (outlink->format == AV_PIX_FMT_YUV420P)
+        av_opt_set_int(sws, "dst_v_chr_pos", 128, 0);
+
+    if ((ret = sws_init_context(sws, NULL, NULL)) < 0)
+        return ret;
+
+    av_log(ctx, AV_LOG_VERBOSE, "output%d: w:%d h:%d fmt:%s -> w:%d h:%d fmt:%s\n",
+           idx, inlink->w, inlink->h, av_get_pix_fmt_name(inlink->format),
+           outlink->w, outlink->h, av_get_pix_fmt_name(outlink->format));
+
+    return 0;
+}
+
+static int scale_frame(AVFilterContext *ctx, AVFrame *in)
+{
+    MultiScaleContext *s = ctx->priv;
+    int nb_out = 0, ret = 0;
+
+    for (int i = 0; i < ctx->nb_outputs; i++) {
+        AVFilterLink *outlink = ctx->outputs[i];
+        AVFrame *out;
+
+        if (ff_outlink_get_status(outlink))
+            continue;
+
+        out = ff_get_video_buffer(outlink, outlink->w, outlink->h);
+        if (!out) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+        ret = av_frame_copy_props(out, in);
+        if (ret < 0) {
+            av_frame_free(&out);
+            goto fail;
+        }
+        out->width  = outlink->w;
+        out->height = outlink->h;
+        out->sample_aspect_ratio = outlink->sample_aspect_ratio;
+
+        s->cur_sws[nb_out] = s->sws[i];
+        s->cur_out[nb_out] = out;
+        s->cur_idx[nb_out] = i;
+        nb_out++;
+    }
+
+    ret = sws_scale_frames(s->cur_sws, s->cur_out, nb_out, in);
+    if (ret < 0)
+        goto fail;
+
+    for (int i = 0; i < nb_out; i++) {
+        ret = ff_filter_frame(ctx->outputs[s->cur_idx[i]], s->cur_out[i]);
+        s->cur_out[i] = NULL;
+        if (ret < 0)
+            goto fail;
+    }
+
+fail:
+    for (int i = 0; i < nb_out; i++)
+        av_frame_free(&s->cur_out[i]);
+    av_frame_free(&in);
+    return ret;
+}
+
+static int activate(AVFilterContext *ctx)
+{
+    AVFilterLink *inlink = ctx->inputs[0];
+    AVFrame *in;
+    int status, ret, nb_closed = 0;
+    int64_t pts;
+
+    /* a rendition that is closed must not stop the others */
+    for (int i = 0; i < ctx->nb_outputs; i++) {
+        int out_status = ff_outlink_get_status(ctx->outputs[i]);
+        if (out_status) {
+            status = out_status;
+            nb_closed++;
+        }
+    }
+    if (nb_closed == ctx->nb_outputs) {
+        ff_inlink_set_status(inlink, status);
+        return 0;
+    }
+
+    ret = ff_inlink_consume_frame(inlink, &in);
+    if (ret < 0)
+        return ret;
+    if (ret > 0) {
+        ret = scale_frame(ctx, in);
+        if (ret < 0)
+            return ret;
+    }
+
+    if (ff_inlink_acknowledge_status(inlink, &status, &pts)) {
+        for (int i = 0; i < ctx->nb_outputs; i++) {
+            if (ff_outlink_get_status(ctx->outputs[i]))
+                continue;
+            ff_outlink_set_status(ctx->outputs[i], status, pts);
+        }
+        return 0;
+    }
+
+    for (int i = 0; i < ctx->nb_outputs; i++) {
+        if (ff_outlink_get_status(ctx->outputs[i]))
+            continue;
+
+        if (ff_outlink_frame_wanted(ctx->outputs[i])) {
+            ff_inlink_request_frame(inlink);
+            return 0;
+        }
+    }
+
+    return FFERROR_NOT_READY;
+}
+
+#define OFFSET(x) offsetof(MultiScaleContext, x)
+#define FLAGS AV_OPT_FLAG_VIDEO_PARAM|AV_OPT_FLAG_FILTERING_PARAM
+
+static const AVOption multiscale_options[] = {
+    { "sizes", "set the '|'-separated list of output sizes", OFFSET(sizes_str), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, FLAGS },
+    { "flags", "set libswscale flags",                        OFFSET(flags_str), AV_OPT_TYPE_STRING, { .str = "" },   0, 0, FLAGS },
+    { NULL }
+};
+
+AVFILTER_DEFINE_CLASS(multiscale);
+
+static const AVFilterPad multiscale_inputs[] = {
+    {
+        .name         = "default",
+        .type         = AVMEDIA_TYPE_VIDEO,
+    },
+};
+
+const AVFilter ff_vf_multiscale = {
+    .name          = "multiscale",
+    .description   = NULL_IF_CONFIG_SMALL("Scale the input video to several sizes at once."),
+    .priv_size     = sizeof(MultiScaleContext),
+    .priv_class    = &multiscale_class,
+    .init          = init,
+    .uninit        = uninit,
+    .activate      = activate,
+    FILTER_INPUTS(multiscale_inputs),
+    .outputs       = NULL,
+    FILTER_QUERY_FUNC(query_formats),
+    .flags         = AVFILTER_FLAG_DYNAMIC_OUTPUTS,
+};
@@ -0,0 +1,268 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+
+#include "config.h"
+
+#include "libavutil/error.h"
+#include "libavutil/fifo.h"
+#include "libavutil/macros.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+
+#include "asyncwriter.h"
+
+#if HAVE_THREADS
+
+struct AsyncWriter {
+    AsyncWriteFunc  write;
+    void           *opaque;
+
+    pthread_t       thread;
+    pthread_mutex_t lock;
+    pthread_cond_t  cond;
+
+    AVFifo         *queue;
+    size_t          queued;
+    size_t          max_queued;
+
+    int             err;
+    int             finish;
+};
+
+static int write_batch(AsyncWriter *w, AsyncWriteBuf *bufs, int nb_bufs)
+{
+    while (nb_bufs > 0) {
+        int ret = w->write(w->opaque, bufs, nb_bufs);
+        if (ret == AVERROR(EINTR))
+            continue;
+        if (ret < 0)
+            return ret;
+        if (!ret)
+            return AVERROR(EIO);
+
+        /* skip what was written, possibly in the middle of a buffer */
+        while (ret > 0) {
+            int len = FFMIN(ret, bufs->size);
+
+            bufs->data += len;
+            bufs->size -= len;
+            ret        -= len;
+            if (!bufs->size) {
+                bufs++;
+                nb_bufs--;
+            }
+        }
+    }
+
+    return 0;
+}
+
+static void *writer_thread(void *arg)
+{
+    AsyncWriter *w = arg;
+    AsyncWriteBuf batch[ASYNC_WRITER_MAX_BATCH], pending[ASYNC_WRITER_MAX_BATCH];
+
+    pthread_mutex_lock(&w->lock);
+    while (1) {
+        size_t nb, bytes = 0;
+        int ret = 0;
+
+        while (!av_fifo_can_read(w->queue) && !w->finish)
+            pthread_cond_wait(&w->cond, &w->lock);
+        if (!av_fifo_can_read(w->queue))
+            break;
+
+        nb = FFMIN(av_fifo_can_read(w->queue), ASYNC_WRITER_MAX_BATCH);
+        av_fifo_peek(w->queue, batch, nb, 0);
+        for (size_t i = 0; i < nb; i++)
+            bytes += batch[i].size;
+
+        /* after a failure, queued data is only discarded */
+        if (!w->err) {
+            pthread_mutex_unlock(&w->lock);
+
+            memcpy(pending, batch, nb * sizeof(*batch));
+            ret = write_batch(w, pending, nb);
+
+            pthread_mutex_lock(&w->lock);
+        }
+
+        av_fifo_drain2(w->queue, nb);
+        for (size_t i = 0; i < nb; i++)
+            av_buffer_unref(&batch[i].buf);
+        w->queued -= bytes;
+        if (ret < 0 && !w->err)
+            w->err = ret;
+
+        pthread_cond_broadcast(&w->cond);
+    }
+    pthread_mutex_unlock(&w->lock);
+
+    return NULL;
+}
+
+int ff_async_writer_alloc(AsyncWriter **pw, AsyncWriteFunc write, void *opaque,
+                          size_t max_queued)
+{
+    AsyncWriter *w;
+    int ret;
+
+    w = av_mallocz(sizeof(*w));
+    if (!w)
+        return AVERROR(ENOMEM);
+
+    w->write      = write;
+    w->opaque     = opaque;
+    w->max_queued = max_queued;
+
+    w->queue = av_fifo_alloc2(ASYNC_WRITER_MAX_BATCH, sizeof(AsyncWriteBuf),
+                              AV_FIFO_FLAG_AUTO_GROW);
+    if (!w->queue) {
+        av_freep(&w);
+        return AVERROR(ENOMEM);
+    }
+
+    if ((ret = pthread_mutex_init(&w->lock, NULL))) {
+        av_fifo_freep2(&w->queue);
+        av_freep(&w);
+        return AVERROR(ret);
+    }
+    if ((ret = pthread_cond_init(&w->cond, NULL))) {
+        pthread_mutex_destroy(&w->lock);
+        av_fifo_freep2(&w->queue);
+        av_freep(&w);
+        return AVERROR(ret);
+    }
+    if ((ret = pthread_create(&w->thread, NULL, writer_thread, w))) {
+        pthread_cond_destroy(&w->cond);
+        pthread_mutex_destroy(&w->lock);
+        av_fifo_freep2(&w->queue);
+        av_freep(&w);
+        return AVERROR(ret);
+    }
+
+    *pw = w;
+    return 0;
+}
+
+int ff_async_writer_write(AsyncWriter *w, const AVBufferRef *buf,
+                          const uint8_t *data, int size)
+{
+    AsyncWriteBuf entry = { .data = data, .size = size };
+    int ret;
+
+    if (size <= 0)
+        return 0;
+
+    if (buf) {
+        entry.buf = av_buffer_ref(buf);
+    } else {
+        entry.buf = av_buffer_alloc(size);
+        if (entry.buf) {
+            memcpy(entry.buf->data, data, size);
+            entry.data = entry.buf->data;
+        }
+    }
+    if (!entry.buf)
+        return AVERROR(ENOMEM);
+
+    pthread_mutex_lock(&w->lock);
+
+    while (!w->err && w->queued && w->queued + size > w->max_queued)
+        pthread_cond_wait(&w->cond, &w->lock);
+
+    ret = w->err;
+    if (!ret)
+        ret = av_fifo_write(w->queue, &entry, 1);
+    if (ret < 0) {
+        pthread_mutex_unlock(&w->lock);
+        av_buffer_unref(&entry.buf);
+        return ret;
+    }
+    w->queued += size;
+
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+
+    return 0;
+}
+
+int ff_async_writer_flush(AsyncWriter *w)
+{
+    int ret;
+
+    pthread_mutex_lock(&w->lock);
+    while (av_fifo_can_read(w->queue))
+        pthread_cond_wait(&w->cond, &w->lock);
+    ret = w->err;
+    pthread_mutex_unlock(&w->lock);
+
+    return ret;
+}
+
+int ff_async_writer_free(AsyncWriter **pw)
+{
+    AsyncWriter *w = *pw;
+    int ret;
+
+    if (!w)
+        return 0;
+
+    pthread_mutex_lock(&w->lock);
+    w->finish = 1;
+    pthread_cond_broadcast(&w->cond);
+    pthread_mutex_unlock(&w->lock);
+
+    pthread_join(w->thread, NULL);
+    ret = w->err;
+
+    pthread_cond_destroy(&w->cond);
+    pthread_mutex_destroy(&w->lock);
+    av_fifo_freep2(&w->queue);
+    av_freep(pw);
+
+    return ret;
+}
+
+#else
+
+int ff_async_writer_alloc(AsyncWriter **pw, AsyncWriteFunc write, void *opaque,
+                          size_t max_queued)
+{
+    return AVERROR(ENOSYS);
+}
+
+int ff_async_writer_write(AsyncWriter *w, const AVBufferRef *buf,
+                          const uint8_t *data, int size)
+{
+    return AVERROR(ENOSYS);
+}
+
+int ff_async_writer_flush(AsyncWriter *w)
+{
+    return AVERROR(ENOSYS);
+}
+
+int ff_async_writer_free(AsyncWriter **pw)
+{
+    return 0;
+}
+
+#endif /* HAVE_THREADS */
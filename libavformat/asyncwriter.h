@@ -0,0 +1,86 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_ASYNCWRITER_H
+#define AVFORMAT_ASYNCWRITER_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "libavutil/buffer.h"
+
+/**
+ * Maximum number of buffers passed to a single AsyncWriteFunc call.
+ * This is the minimum IOV_MAX guaranteed by POSIX.
+ */
+#define ASYNC_WRITER_MAX_BATCH 16
+
+typedef struct AsyncWriteBuf {
+    AVBufferRef   *buf;
+    const uint8_t *data;
+    int            size;
+} AsyncWriteBuf;
+
+/**
+ * Write out a batch of buffers, in order, blocking if needed.
+ *
+ * @return the number of bytes written, which may be less than the total size
+ *         of the batch, or a negative error code
+ */
+typedef int (*AsyncWriteFunc)(void *opaque, const AsyncWriteBuf *bufs, int nb_bufs);
+
+/**
+ * A background thread writing out data queued by the caller, so that the
+ * caller does not block on the storage or network latency. Consecutive
+ * queued buffers are handed to the write callback in batches, which lets it
+ * use vectored I/O.
+ */
+typedef struct AsyncWriter AsyncWriter;
+
+/**
+ * @param max_queued the queue is bounded to this many bytes; a single write
+ *                   larger than that is still accepted once the queue is empty
+ */
+int ff_async_writer_alloc(AsyncWriter **pw, AsyncWriteFunc write, void *opaque,
+                          size_t max_queued);
+
+/**
+ * Queue data for writing, waiting for room in the queue if needed.
+ *
+ * @param buf if not NULL, data must lie in buf and a new reference to it is
+ *            queued; otherwise data is copied
+ * @return 0 on success, or the error of a previous failed write
+ */
+int ff_async_writer_write(AsyncWriter *w, const AVBufferRef *buf,
+                          const uint8_t *data, int size);
+
+/**
+ * Wait until all queued data is written out.
+ *
+ * @return 0 on success, or the error of a failed write
+ */
+int ff_async_writer_flush(AsyncWriter *w);
+
+/**
+ * Write out all queued data, stop the thread and free the writer.
+ *
+ * @return 0 on success, or the error of a failed write
+ */
+int ff_async_writer_free(AsyncWriter **pw);
+
+#endif /* AVFORMAT_ASYNCWRITER_H */
@@ -1823,6 +1823,18 @@ typedef struct AVFormatContext {
      * @return 0 on success, a negative AVERROR code on failure
      */
     int (*io_close2)(struct AVFormatContext *s, AVIOContext *pb);
+
+    /**
+     * Path of a sidecar file caching the index of the input.
+     *
+     * For demuxers that support it, the index entries are restored from
+     * this file by avformat_find_stream_info() if it matches the input, and
+     * written back by avformat_close_input() when they changed.
+     *
+     * - encoding: unused
+     * - decoding: set by user
+     */
+    char *index_cache;
 } AVFormatContext;
 
 /**
@@ -425,6 +425,17 @@ int ffurl_write(URLContext *h, const unsigned char *buf, int size)
                                   h->prot->url_write);
 }
 
+int ffurl_write_buffer(URLContext *h, const AVBufferRef *buf,
+                       const unsigned char *data, int size)
+{
+    if (!(h->flags & AVIO_FLAG_WRITE))
+        return AVERROR(EIO);
+    if (ff_check_interrupt(&h->interrupt_callback))
+        return AVERROR_EXIT;
+
+    return h->prot->url_write_buffer(h, buf, data, size);
+}
+
 int64_t ffurl_seek(URLContext *h, int64_t pos, int whence)
 {
     int64_t ret;
@@ -30,6 +30,7 @@
 #include <stdio.h>
 
 #include "libavutil/attributes.h"
+#include "libavutil/buffer.h"
 #include "libavutil/dict.h"
 #include "libavutil/log.h"
 
@@ -430,6 +431,22 @@ void avio_context_free(AVIOContext **s);
 
 void avio_w8(AVIOContext *s, int b);
 void avio_write(AVIOContext *s, const unsigned char *buf, int size);
+
+/**
+ * Write size bytes from data, which must lie in the buffer referenced by buf,
+ * e.g. the payload of a reference-counted AVPacket.
+ *
+ * The result is the same as with avio_write(), but payloads at least as large
+ * as the internal buffer are handed to the underlying write callback directly,
+ * without being copied into the internal buffer first. The IO layer may keep
+ * a reference to buf after the call returns, so the data must not be modified
+ * afterwards.
+ *
+ * @param buf  reference to the buffer data lies in; may be NULL, in which case
+ *             this function behaves exactly like avio_write()
+ */
+void avio_write_buffer_ref(AVIOContext *s, const AVBufferRef *buf,
+                           const unsigned char *data, int size);
 void avio_wl64(AVIOContext *s, uint64_t val);
 void avio_wb64(AVIOContext *s, uint64_t val);
 void avio_wl32(AVIOContext *s, unsigned int val);
@@ -77,6 +77,13 @@ typedef struct FFIOContext {
      * is updated each time a successful writeout ends up further position-wise
      */
     int64_t written_output_size;
+
+    /**
+     * A callback that is used by avio_write_buffer_ref() to hand a buffer
+     * reference to the protocol, bypassing max_packet_size.
+     */
+    int (*write_buffer)(void *opaque, const AVBufferRef *buf,
+                        const uint8_t *data, int size);
 } FFIOContext;
 
 static av_always_inline FFIOContext *ffiocontext(AVIOContext *ctx)
@@ -154,12 +154,15 @@ void avio_context_free(AVIOContext **ps)
     av_freep(ps);
 }
 
-static void writeout(AVIOContext *s, const uint8_t *data, int len)
+static void writeout(AVIOContext *s, const AVBufferRef *buf,
+                     const uint8_t *data, int len)
 {
     FFIOContext *const ctx = ffiocontext(s);
     if (!s->error) {
         int ret = 0;
-        if (s->write_data_type)
+        if (buf)
+            ret = ctx->write_buffer(s->opaque, buf, data, len);
+        else if (s->write_data_type)
             ret = s->write_data_type(s->opaque, (uint8_t *)data,
                                      len,
                                      ctx->current_type,
@@ -195,7 +198,7 @@ static void flush_buffer(AVIOContext *s)
 {
     s->buf_ptr_max = FFMAX(s->buf_ptr, s->buf_ptr_max);
     if (s->write_flag && s->buf_ptr_max > s->buffer) {
-        writeout(s, s->buffer, s->buf_ptr_max - s->buffer);
+        writeout(s, NULL, s->buffer, s->buf_ptr_max - s->buffer);
         if (s->update_checksum) {
             s->checksum     = s->update_checksum(s->checksum, s->checksum_ptr,
                                                  s->buf_ptr_max - s->checksum_ptr);
@@ -235,7 +238,7 @@ void avio_write(AVIOContext *s, const unsigned char *buf, int size)
         return;
     if (s->direct && !s->update_checksum) {
         avio_flush(s);
-        writeout(s, buf, size);
+        writeout(s, NULL, buf, size);
         return;
     }
     do {
@@ -251,6 +254,26 @@ void avio_write(AVIOContext *s, const unsigned char *buf, int size)
     } while (size > 0);
 }
 
+void avio_write_buffer_ref(AVIOContext *s, const AVBufferRef *buf,
+                           const unsigned char *data, int size)
+{
+    FFIOContext *const ctx = ffiocontext(s);
+
+    /* Smaller payloads are cheaper to copy than to write separately, and
+     * packetized contexts need every write split to max_packet_size, unless
+     * the protocol takes the buffer reference itself. */
+    if (!buf || size < s->buffer_size || s->update_checksum ||
+        (s->max_packet_size && !ctx->write_buffer)) {
+        avio_write(s, data, size);
+        return;
+    }
+
+    av_assert2(data >= buf->data && data + size <= buf->data + buf->size);
+
+    avio_flush(s);
+    writeout(s, ctx->write_buffer ? buf : NULL, data, size);
+}
+
 void avio_flush(AVIOContext *s)
 {
     int seekback = s->write_flag ? FFMIN(0, s->buf_ptr - s->buf_ptr_max) : 0;
@@ -1007,6 +1030,9 @@ int ffio_fdopen(AVIOContext **s, URLContext *h)
             (*s)->seekable |= AVIO_SEEKABLE_TIME;
     }
     ((FFIOContext*)(*s))->short_seek_get = (int (*)(void *))ffurl_get_short_seek;
+    if (h->prot && h->prot->url_write_buffer)
+        ((FFIOContext*)(*s))->write_buffer =
+            (int (*)(void *, const AVBufferRef *, const uint8_t *, int))ffurl_write_buffer;
     (*s)->av_class = &ff_avio_class;
     return 0;
 }
@@ -1025,7 +1051,8 @@ URLContext* ffio_geturlcontext(AVIOContext *s)
 int ffio_copy_url_options(AVIOContext* pb, AVDictionary** avio_opts)
 {
     const char *opts[] = {
-        "headers", "user_agent", "cookies", "http_proxy", "referer", "rw_timeout", "icy", NULL };
+        "headers", "user_agent", "cookies", "http_proxy", "referer", "rw_timeout", "icy",
+        "connection_pool", "pool_idle_timeout", "pool_max_idle", NULL };
     const char **opt = opts;
     uint8_t *buf = NULL;
     int ret = 0;
@@ -27,10 +27,23 @@
  *      support filling with a background thread
  */
 
+/*
+ * The input is cached in blocks of block_size bytes, filled from their
+ * start. Recently used blocks are kept in memory; when the memory limit is
+ * exceeded the least recently used ones move to a temporary file, from which
+ * the least recently used ones are dropped when the disk limit is exceeded.
+ *
+ * A store holds the blocks of one input. With the shared option, all cache
+ * contexts opened for the same URL in the process use the same store, each
+ * with its own connection to the input for the blocks not cached yet.
+ */
+
 #include "libavutil/avassert.h"
 #include "libavutil/avstring.h"
 #include "libavutil/file_open.h"
+#include "libavutil/mem.h"
 #include "libavutil/opt.h"
+#include "libavutil/thread.h"
 #include "libavutil/tree.h"
 #include "avio.h"
 #include <fcntl.h>
@@ -45,189 +58,533 @@
 #include "os_support.h"
 #include "url.h"
 
-typedef struct CacheEntry {
-    int64_t logical_pos;
-    int64_t physical_pos;
-    int size;
-} CacheEntry;
+enum CacheTier {
+    CACHE_MEMORY,
+    CACHE_DISK,
+    CACHE_NB_TIERS,
+};
+
+typedef struct CacheBlock {
+    int64_t index;              ///< must be first, used as the tree key
+    int filled;                 ///< bytes read from the input, from the block start
+    int busy;                   ///< being filled by a reader
+    uint8_t *data;              ///< memory copy, NULL if the block is only on disk
+    int64_t disk_pos;           ///< offset of the disk copy, -1 if none
+    int disk_size;              ///< bytes in the disk copy
+    struct CacheBlock *prev[CACHE_NB_TIERS], *next[CACHE_NB_TIERS];
+} CacheBlock;
+
+typedef struct CacheStore {
+    char *url;
+    int shared;
+    int refcount;
+    struct CacheStore *next_store;
+
+    AVMutex mutex;
+#if HAVE_THREADS
+    pthread_cond_t cond;
+#endif
+
+    int block_size;
+    int64_t limit[CACHE_NB_TIERS];  ///< bytes, negative for unlimited
+    int64_t used[CACHE_NB_TIERS];
+    CacheBlock *head[CACHE_NB_TIERS], *tail[CACHE_NB_TIERS];  ///< LRU lists, most recent first
+    struct AVTreeNode *root;
 
-typedef struct Context {
-    AVClass *class;
     int fd;
     char *filename;
-    struct AVTreeNode *root;
-    int64_t logical_pos;
-    int64_t cache_pos;
-    int64_t inner_pos;
+    int64_t disk_end;
+    int64_t *free_slots;
+    int nb_free_slots;
+    unsigned free_slots_size;
+
     int64_t end;
     int is_true_eof;
+} CacheStore;
+
+typedef struct Context {
+    AVClass *class;
+    CacheStore *store;
+    int64_t logical_pos;
+    int64_t inner_pos;
     URLContext *inner;
     int64_t cache_hit, cache_miss;
     int read_ahead_limit;
+    int block_size;
+    int64_t memory_limit;
+    int64_t disk_limit;
+    int shared;
 } Context;
 
+static AVMutex cache_stores_mutex = AV_MUTEX_INITIALIZER;
+static CacheStore *cache_stores;
+
 static int cmp(const void *key, const void *node)
 {
-    return FFDIFFSIGN(*(const int64_t *)key, ((const CacheEntry *) node)->logical_pos);
+    return FFDIFFSIGN(*(const int64_t *)key, ((const CacheBlock *) node)->index);
 }
 
-static int cache_open(URLContext *h, const char *arg, int flags, AVDictionary **options)
+static void lru_remove(CacheStore *s, CacheBlock *b, enum CacheTier tier)
 {
-    int ret;
-    char *buffername;
-    Context *c= h->priv_data;
+    if (b->prev[tier])
+        b->prev[tier]->next[tier] = b->next[tier];
+    else
+        s->head[tier] = b->next[tier];
+    if (b->next[tier])
+        b->next[tier]->prev[tier] = b->prev[tier];
+    else
+        s->tail[tier] = b->prev[tier];
+    b->prev[tier] = b->next[tier] = NULL;
+}
 
-    av_strstart(arg, "cache:", &arg);
+static void lru_push(CacheStore *s, CacheBlock *b, enum CacheTier tier)
+{
+    b->prev[tier] = NULL;
+    b->next[tier] = s->head[tier];
+    if (s->head[tier])
+        s->head[tier]->prev[tier] = b;
+    else
+        s->tail[tier] = b;
+    s->head[tier] = b;
+}
 
-    c->fd = avpriv_tempfile("ffcache", &buffername, 0, h);
-    if (c->fd < 0){
-        av_log(h, AV_LOG_ERROR, "Failed to create tempfile\n");
-        return c->fd;
+static void lru_touch(CacheStore *s, CacheBlock *b, enum CacheTier tier)
+{
+    if (s->head[tier] != b) {
+        lru_remove(s, b, tier);
+        lru_push(s, b, tier);
     }
+}
 
-    ret = unlink(buffername);
+static void cache_wait(CacheStore *s)
+{
+#if HAVE_THREADS
+    pthread_cond_wait(&s->cond, &s->mutex);
+#endif
+}
 
-    if (ret >= 0)
-        av_freep(&buffername);
-    else
-        c->filename = buffername;
+static void cache_wakeup(CacheStore *s)
+{
+#if HAVE_THREADS
+    pthread_cond_broadcast(&s->cond);
+#endif
+}
 
-    return ffurl_open_whitelist(&c->inner, arg, flags, &h->interrupt_callback,
-                                options, h->protocol_whitelist, h->protocol_blacklist, h);
+static CacheBlock *block_find(CacheStore *s, int64_t index)
+{
+    return av_tree_find(s->root, &index, cmp, NULL);
 }
 
-static int add_entry(URLContext *h, const unsigned char *buf, int size)
+static CacheBlock *block_alloc(CacheStore *s, int64_t index)
+{
+    struct AVTreeNode *node = av_tree_node_alloc();
+    CacheBlock *b = av_mallocz(sizeof(*b));
+
+    if (!node || !b || !(b->data = av_malloc(s->block_size))) {
+        av_free(node);
+        if (b)
+            av_free(b->data);
+        av_free(b);
+        return NULL;
+    }
+    b->index    = index;
+    b->disk_pos = -1;
+    av_tree_insert(&s->root, b, cmp, &node);
+    lru_push(s, b, CACHE_MEMORY);
+    s->used[CACHE_MEMORY] += s->block_size;
+    return b;
+}
+
+/* Remove a block which has neither a memory nor a disk copy anymore. */
+static void block_free(CacheStore *s, CacheBlock *b)
 {
-    Context *c= h->priv_data;
-    int64_t pos = -1;
-    int ret;
-    CacheEntry *entry = NULL, *next[2] = {NULL, NULL};
-    CacheEntry *entry_ret;
     struct AVTreeNode *node = NULL;
 
-    //FIXME avoid lseek
-    pos = lseek(c->fd, 0, SEEK_END);
-    if (pos < 0) {
-        ret = AVERROR(errno);
-        av_log(h, AV_LOG_ERROR, "seek in cache failed\n");
-        goto fail;
+    av_assert0(!b->data && b->disk_pos < 0);
+    av_tree_insert(&s->root, b, cmp, &node);
+    av_free(node);
+    av_free(b);
+}
+
+static int disk_io(CacheStore *s, int64_t pos, uint8_t *buf, int size, int write_data)
+{
+    //FIXME use pread/pwrite
+    if (lseek(s->fd, pos, SEEK_SET) < 0)
+        return AVERROR(errno);
+    while (size > 0) {
+        int ret = write_data ? write(s->fd, buf, size) : read(s->fd, buf, size);
+        if (ret < 0)
+            return AVERROR(errno);
+        if (!ret)
+            return AVERROR(EIO);
+        buf  += ret;
+        size -= ret;
+    }
+    return 0;
+}
+
+static void disk_drop(CacheStore *s, CacheBlock *b)
+{
+    if (b->disk_pos < 0)
+        return;
+    /* the slot array never outgrows the number of slots in the file */
+    s->free_slots[s->nb_free_slots++] = b->disk_pos;
+    b->disk_pos  = -1;
+    b->disk_size = 0;
+    lru_remove(s, b, CACHE_DISK);
+    s->used[CACHE_DISK] -= s->block_size;
+    if (!b->data)
+        block_free(s, b);
+}
+
+static int disk_store(URLContext *h, CacheStore *s, CacheBlock *b)
+{
+    int ret;
+
+    if (!s->limit[CACHE_DISK])
+        return AVERROR(ENOSPC);
+
+    if (b->disk_pos < 0) {
+        while (s->limit[CACHE_DISK] > 0 &&
+               s->used[CACHE_DISK] + s->block_size > s->limit[CACHE_DISK]) {
+            CacheBlock *victim = s->tail[CACHE_DISK];
+            while (victim && victim->busy)
+                victim = victim->prev[CACHE_DISK];
+            if (!victim)
+                return AVERROR(ENOSPC);
+            disk_drop(s, victim);
+        }
+
+        if (s->fd < 0) {
+            char *filename;
+            s->fd = avpriv_tempfile("ffcache", &filename, 0, h);
+            if (s->fd < 0) {
+                av_log(h, AV_LOG_ERROR, "Failed to create tempfile\n");
+                s->limit[CACHE_DISK] = 0;
+                return s->fd;
+            }
+            if (unlink(filename) >= 0)
+                av_freep(&filename);
+            else
+                s->filename = filename;
+        }
+
+        if (!s->nb_free_slots) {
+            int64_t *slots = av_fast_realloc(s->free_slots, &s->free_slots_size,
+                                             (s->disk_end / s->block_size + 1) * sizeof(*slots));
+            if (!slots)
+                return AVERROR(ENOMEM);
+            s->free_slots = slots;
+            s->free_slots[s->nb_free_slots++] = s->disk_end;
+            s->disk_end += s->block_size;
+        }
+        b->disk_pos = s->free_slots[--s->nb_free_slots];
+        lru_push(s, b, CACHE_DISK);
+        s->used[CACHE_DISK] += s->block_size;
+    } else {
+        lru_touch(s, b, CACHE_DISK);
     }
-    c->cache_pos = pos;
 
-    ret = write(c->fd, buf, size);
+    ret = disk_io(s, b->disk_pos, b->data, b->filled, 1);
     if (ret < 0) {
-        ret = AVERROR(errno);
         av_log(h, AV_LOG_ERROR, "write in cache failed\n");
-        goto fail;
+        disk_drop(s, b);
+        return ret;
     }
-    c->cache_pos += ret;
-
-    entry = av_tree_find(c->root, &c->logical_pos, cmp, (void**)next);
-
-    if (!entry)
-        entry = next[0];
-
-    if (!entry ||
-        entry->logical_pos  + entry->size != c->logical_pos ||
-        entry->physical_pos + entry->size != pos
-    ) {
-        entry = av_malloc(sizeof(*entry));
-        node = av_tree_node_alloc();
-        if (!entry || !node) {
-            ret = AVERROR(ENOMEM);
-            goto fail;
-        }
-        entry->logical_pos = c->logical_pos;
-        entry->physical_pos = pos;
-        entry->size = ret;
-
-        entry_ret = av_tree_insert(&c->root, entry, cmp, &node);
-        if (entry_ret && entry_ret != entry) {
-            ret = -1;
-            av_log(h, AV_LOG_ERROR, "av_tree_insert failed\n");
-            goto fail;
+    b->disk_size = b->filled;
+    return 0;
+}
+
+/* Move least recently used blocks out of memory until the limit is met. */
+static void enforce_memory_limit(URLContext *h, CacheStore *s)
+{
+    CacheBlock *b = s->tail[CACHE_MEMORY];
+
+    while (b && s->limit[CACHE_MEMORY] >= 0 &&
+           s->used[CACHE_MEMORY] > s->limit[CACHE_MEMORY]) {
+        CacheBlock *prev = b->prev[CACHE_MEMORY];
+
+        if (!b->busy) {
+            if (b->disk_pos < 0 || b->disk_size != b->filled)
+                disk_store(h, s, b);
+            av_freep(&b->data);
+            lru_remove(s, b, CACHE_MEMORY);
+            s->used[CACHE_MEMORY] -= s->block_size;
+            if (b->disk_pos < 0)
+                block_free(s, b);
         }
-    } else
-        entry->size += ret;
+        b = prev;
+    }
+}
+
+/* Bring the disk copy of a block back into memory. */
+static int block_load(URLContext *h, CacheStore *s, CacheBlock *b)
+{
+    int ret;
+
+    if (b->data) {
+        lru_touch(s, b, CACHE_MEMORY);
+        return 0;
+    }
+
+    b->data = av_malloc(s->block_size);
+    if (!b->data) {
+        ret = AVERROR(ENOMEM);
+    } else if ((ret = disk_io(s, b->disk_pos, b->data, b->disk_size, 0)) < 0) {
+        av_log(h, AV_LOG_ERROR, "read in cache failed\n");
+        av_freep(&b->data);
+    }
+    if (ret < 0) {
+        disk_drop(s, b);
+        return ret;
+    }
 
+    b->filled = b->disk_size;
+    lru_push(s, b, CACHE_MEMORY);
+    lru_touch(s, b, CACHE_DISK);
+    s->used[CACHE_MEMORY] += s->block_size;
     return 0;
-fail:
-    //we could truncate the file to pos here if pos >=0 but ftruncate isn't available in VS so
-    //for simplicty we just leave the file a bit larger
-    av_free(entry);
-    av_free(node);
-    return ret;
 }
 
-static int cache_read(URLContext *h, unsigned char *buf, int size)
+static void store_free(CacheStore *s)
 {
-    Context *c= h->priv_data;
-    CacheEntry *entry, *next[2] = {NULL, NULL};
-    int64_t r;
+    CacheBlock *b;
+
+    while ((b = s->head[CACHE_MEMORY])) {
+        av_freep(&b->data);
+        lru_remove(s, b, CACHE_MEMORY);
+        if (b->disk_pos >= 0)
+            lru_remove(s, b, CACHE_DISK);
+        b->disk_pos = -1;
+        block_free(s, b);
+    }
+    while ((b = s->head[CACHE_DISK])) {
+        lru_remove(s, b, CACHE_DISK);
+        b->disk_pos = -1;
+        block_free(s, b);
+    }
+    av_tree_destroy(s->root);
+
+    if (s->fd >= 0)
+        close(s->fd);
+    if (s->filename) {
+        if (unlink(s->filename) < 0)
+            av_log(NULL, AV_LOG_ERROR, "Could not delete %s.\n", s->filename);
+        av_freep(&s->filename);
+    }
+    av_freep(&s->free_slots);
+#if HAVE_THREADS
+    pthread_cond_destroy(&s->cond);
+#endif
+    ff_mutex_destroy(&s->mutex);
+    av_freep(&s->url);
+    av_free(s);
+}
 
-    entry = av_tree_find(c->root, &c->logical_pos, cmp, (void**)next);
+static CacheStore *store_alloc(Context *c, const char *url)
+{
+    CacheStore *s = av_mallocz(sizeof(*s));
+
+    if (!s)
+        return NULL;
+    s->url = av_strdup(url);
+    if (!s->url) {
+        av_free(s);
+        return NULL;
+    }
+    if (ff_mutex_init(&s->mutex, NULL)) {
+        av_free(s->url);
+        av_free(s);
+        return NULL;
+    }
+#if HAVE_THREADS
+    if (pthread_cond_init(&s->cond, NULL)) {
+        ff_mutex_destroy(&s->mutex);
+        av_free(s->url);
+        av_free(s);
+        return NULL;
+    }
+#endif
+    s->shared              = c->shared;
+    s->refcount            = 1;
+    s->block_size          = c->block_size;
+    /* the block being read from is always kept in memory */
+    s->limit[CACHE_MEMORY] = c->memory_limit < 0 ? -1 : FFMAX(c->memory_limit, c->block_size);
+    s->limit[CACHE_DISK]   = c->disk_limit;
+    s->fd                  = -1;
+    return s;
+}
 
-    if (!entry)
-        entry = next[0];
+static int store_open(URLContext *h, const char *url)
+{
+    Context *c = h->priv_data;
+    CacheStore *s;
 
-    if (entry) {
-        int64_t in_block_pos = c->logical_pos - entry->logical_pos;
-        av_assert0(entry->logical_pos <= c->logical_pos);
-        if (in_block_pos < entry->size) {
-            int64_t physical_target = entry->physical_pos + in_block_pos;
+    if (!c->shared) {
+        c->store = store_alloc(c, url);
+        return c->store ? 0 : AVERROR(ENOMEM);
+    }
 
-            if (c->cache_pos != physical_target) {
-                r = lseek(c->fd, physical_target, SEEK_SET);
-            } else
-                r = c->cache_pos;
+    ff_mutex_lock(&cache_stores_mutex);
+    for (s = cache_stores; s; s = s->next_store) {
+        if (!strcmp(s->url, url)) {
+            s->refcount++;
+            break;
+        }
+    }
+    if (!s && (s = store_alloc(c, url))) {
+        s->next_store = cache_stores;
+        cache_stores  = s;
+    }
+    ff_mutex_unlock(&cache_stores_mutex);
 
-            if (r >= 0) {
-                c->cache_pos = r;
-                r = read(c->fd, buf, FFMIN(size, entry->size - in_block_pos));
-            }
+    if (!s)
+        return AVERROR(ENOMEM);
+    if (s->refcount > 1)
+        av_log(h, AV_LOG_VERBOSE, "Sharing the cache of %s\n", url);
+    c->store = s;
+    return 0;
+}
 
-            if (r > 0) {
-                c->cache_pos += r;
-                c->logical_pos += r;
-                c->cache_hit ++;
-                return r;
-            }
+static void store_close(CacheStore *s)
+{
+    if (s->shared) {
+        ff_mutex_lock(&cache_stores_mutex);
+        if (!--s->refcount) {
+            CacheStore **p = &cache_stores;
+            while (*p != s)
+                p = &(*p)->next_store;
+            *p = s->next_store;
         }
+        ff_mutex_unlock(&cache_stores_mutex);
+        if (s->refcount)
+            return;
     }
+    store_free(s);
+}
 
-    // Cache miss or some kind of fault with the cache
+static int cache_open(URLContext *h, const char *arg, int flags, AVDictionary **options)
+{
+    int ret;
+    Context *c= h->priv_data;
 
-    if (c->logical_pos != c->inner_pos) {
-        r = ffurl_seek(c->inner, c->logical_pos, SEEK_SET);
-        if (r<0) {
-            av_log(h, AV_LOG_ERROR, "Failed to perform internal seek\n");
-            return r;
-        }
-        c->inner_pos = r;
+    av_strstart(arg, "cache:", &arg);
+
+    ret = store_open(h, arg);
+    if (ret < 0)
+        return ret;
+
+    ret = ffurl_open_whitelist(&c->inner, arg, flags, &h->interrupt_callback,
+                               options, h->protocol_whitelist, h->protocol_blacklist, h);
+    if (ret < 0) {
+        store_close(c->store);
+        c->store = NULL;
     }
+    return ret;
+}
 
-    r = ffurl_read(c->inner, buf, size);
-    if (r == AVERROR_EOF && size>0) {
-        c->is_true_eof = 1;
-        av_assert0(c->end >= c->logical_pos);
+/* Read more of a block from the input, with the store locked. */
+static int fill_block(URLContext *h, CacheBlock *b, int64_t index)
+{
+    Context *c = h->priv_data;
+    CacheStore *s = c->store;
+    int64_t pos;
+    int64_t r = 0;
+
+    if (!b && !(b = block_alloc(s, index)))
+        return AVERROR(ENOMEM);
+    if ((r = block_load(h, s, b)) < 0)
+        return 0; /* the block is gone, retry */
+
+    b->busy = 1;
+    pos = index * s->block_size + b->filled;
+    ff_mutex_unlock(&s->mutex);
+
+    if (c->inner_pos != pos) {
+        r = ffurl_seek(c->inner, pos, SEEK_SET);
+        if (r < 0)
+            av_log(h, AV_LOG_ERROR, "Failed to perform internal seek\n");
+        else
+            c->inner_pos = r;
     }
-    if (r<=0)
+    if (r >= 0)
+        r = ffurl_read(c->inner, b->data + b->filled, s->block_size - b->filled);
+
+    ff_mutex_lock(&s->mutex);
+    b->busy = 0;
+    cache_wakeup(s);
+
+    if (r > 0) {
+        b->filled    += r;
+        c->inner_pos += r;
+        c->cache_miss++;
+        s->end = FFMAX(s->end, pos + r);
         return r;
-    c->inner_pos += r;
+    }
+
+    if (r == AVERROR_EOF) {
+        s->is_true_eof = 1;
+        s->end = FFMAX(s->end, pos);
+    }
+    if (!b->filled) {
+        av_freep(&b->data);
+        lru_remove(s, b, CACHE_MEMORY);
+        s->used[CACHE_MEMORY] -= s->block_size;
+        if (b->disk_pos >= 0)
+            disk_drop(s, b);
+        else
+            block_free(s, b);
+    }
+    return r ? r : AVERROR_EOF;
+}
 
-    c->cache_miss ++;
+static int cache_read(URLContext *h, unsigned char *buf, int size)
+{
+    Context *c= h->priv_data;
+    CacheStore *s = c->store;
+    int64_t index = c->logical_pos / s->block_size;
+    int offset    = c->logical_pos % s->block_size;
+    int fetched   = 0;
+    int r;
+
+    ff_mutex_lock(&s->mutex);
+
+    while (1) {
+        CacheBlock *b = block_find(s, index);
+
+        if (b && b->filled > offset && !b->data && block_load(h, s, b) < 0)
+            continue;
+        if (b && b->filled > offset) {
+            r = FFMIN(size, b->filled - offset);
+            memcpy(buf, b->data + offset, r);
+            lru_touch(s, b, CACHE_MEMORY);
+            c->logical_pos += r;
+            if (!fetched)
+                c->cache_hit++;
+            break;
+        }
+        if (b && b->busy) {
+            cache_wait(s);
+            continue;
+        }
 
-    add_entry(h, buf, r);
-    c->logical_pos += r;
-    c->end = FFMAX(c->end, c->logical_pos);
+        r = fill_block(h, b, index);
+        if (r < 0)
+            break;
+        fetched = 1;
+    }
 
+    enforce_memory_limit(h, s);
+    ff_mutex_unlock(&s->mutex);
     return r;
 }
 
 static int64_t cache_seek(URLContext *h, int64_t pos, int whence)
 {
     Context *c= h->priv_data;
-    int64_t ret;
+    CacheStore *s = c->store;
+    int64_t ret, end;
+    int is_true_eof;
 
     if (whence == AVSEEK_SIZE) {
         pos= ffurl_seek(c->inner, pos, whence);
@@ -236,22 +593,29 @@ static int64_t cache_seek(URLContext *h, int64_t pos, int whence)
             if (ffurl_seek(c->inner, c->inner_pos, SEEK_SET) < 0)
                 av_log(h, AV_LOG_ERROR, "Inner protocol failed to seekback end : %"PRId64"\n", pos);
         }
+        ff_mutex_lock(&s->mutex);
         if (pos > 0)
-            c->is_true_eof = 1;
-        c->end = FFMAX(c->end, pos);
+            s->is_true_eof = 1;
+        s->end = FFMAX(s->end, pos);
+        ff_mutex_unlock(&s->mutex);
         return pos;
     }
 
+    ff_mutex_lock(&s->mutex);
+    end         = s->end;
+    is_true_eof = s->is_true_eof;
+    ff_mutex_unlock(&s->mutex);
+
     if (whence == SEEK_CUR) {
         whence = SEEK_SET;
         pos += c->logical_pos;
-    } else if (whence == SEEK_END && c->is_true_eof) {
+    } else if (whence == SEEK_END && is_true_eof) {
 resolve_eof:
         whence = SEEK_SET;
-        pos += c->end;
+        pos += end;
     }
 
-    if (whence == SEEK_SET && pos >= 0 && pos < c->end) {
+    if (whence == SEEK_SET && pos >= 0 && pos < end) {
         //Seems within filesize, assume it will not fail.
         c->logical_pos = pos;
         return pos;
@@ -270,7 +634,10 @@ resolve_eof:
                     size = FFMIN(sizeof(tmp), pos - c->logical_pos);
                 ret = cache_read(h, tmp, size);
                 if (ret == AVERROR_EOF && whence == SEEK_END) {
-                    av_assert0(c->is_true_eof);
+                    ff_mutex_lock(&s->mutex);
+                    av_assert0(s->is_true_eof);
+                    end = s->end;
+                    ff_mutex_unlock(&s->mutex);
                     goto resolve_eof;
                 }
                 if (ret < 0) {
@@ -283,36 +650,25 @@ resolve_eof:
 
     if (ret >= 0) {
         c->logical_pos = ret;
-        c->end = FFMAX(c->end, ret);
+        c->inner_pos   = ret;
+        ff_mutex_lock(&s->mutex);
+        s->end = FFMAX(s->end, ret);
+        ff_mutex_unlock(&s->mutex);
     }
 
     return ret;
 }
 
-static int enu_free(void *opaque, void *elem)
-{
-    av_free(elem);
-    return 0;
-}
-
 static int cache_close(URLContext *h)
 {
     Context *c= h->priv_data;
-    int ret;
 
     av_log(h, AV_LOG_INFO, "Statistics, cache hits:%"PRId64" cache misses:%"PRId64"\n",
            c->cache_hit, c->cache_miss);
 
-    close(c->fd);
-    if (c->filename) {
-        ret = unlink(c->filename);
-        if (ret < 0)
-            av_log(h, AV_LOG_ERROR, "Could not delete %s.\n", c->filename);
-        av_freep(&c->filename);
-    }
     ffurl_closep(&c->inner);
-    av_tree_enumerate(c->root, NULL, NULL, enu_free);
-    av_tree_destroy(c->root);
+    store_close(c->store);
+    c->store = NULL;
 
     return 0;
 }
@@ -322,6 +678,10 @@ static int cache_close(URLContext *h)
 
 static const AVOption options[] = {
     { "read_ahead_limit", "Amount in bytes that may be read ahead when seeking isn't supported, -1 for unlimited", OFFSET(read_ahead_limit), AV_OPT_TYPE_INT, { .i64 = 65536 }, -1, INT_MAX, D },
+    { "block_size", "size in bytes of the cached blocks", OFFSET(block_size), AV_OPT_TYPE_INT, { .i64 = 65536 }, 4096, INT_MAX, D },
+    { "memory_limit", "amount in bytes of blocks kept in memory, -1 for unlimited", OFFSET(memory_limit), AV_OPT_TYPE_INT64, { .i64 = 8 << 20 }, -1, INT64_MAX, D },
+    { "disk_limit", "amount in bytes of blocks kept in a temporary file, -1 for unlimited, 0 to disable", OFFSET(disk_limit), AV_OPT_TYPE_INT64, { .i64 = -1 }, -1, INT64_MAX, D },
+    { "shared", "share the cached blocks with the other cache contexts for the same URL", OFFSET(shared), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, D },
     {NULL},
 };
 
@@ -381,6 +381,8 @@ void avformat_close_input(AVFormatContext **ps)
         (s->flags & AVFMT_FLAG_CUSTOM_IO))
         pb = NULL;
 
+    ff_index_cache_save(s);
+
     if (s->iformat)
         if (s->iformat->read_close)
             s->iformat->read_close(s);
@@ -1521,6 +1523,10 @@ return_packet:
     if ((s->iformat->flags & AVFMT_GENERIC_INDEX) && pkt->flags & AV_PKT_FLAG_KEY) {
         ff_reduce_index(s, st->index);
         av_add_index_entry(st, pkt->pos, pkt->dts, 0, 0, AVINDEX_KEYFRAME);
+    } else if (si->index_cache.collect && pkt->flags & AV_PKT_FLAG_KEY &&
+               pkt->pos >= 0 && pkt->dts != AV_NOPTS_VALUE && !is_relative(pkt->dts)) {
+        ff_reduce_index(s, st->index);
+        av_add_index_entry(st, pkt->pos, pkt->dts, 0, 0, AVINDEX_KEYFRAME);
     }
 
     if (is_relative(pkt->dts))
@@ -1874,6 +1880,7 @@ static const char *duration_estimate_name(enum AVDurationEstimationMethod method
 
 static void estimate_timings(AVFormatContext *ic, int64_t old_offset)
 {
+    FFFormatContext *const si = ffformatcontext(ic);
     int64_t file_size;
 
     /* get the file size, if possible */
@@ -1886,7 +1893,8 @@ static void estimate_timings(AVFormatContext *ic, int64_t old_offset)
 
     if ((!strcmp(ic->iformat->name, "mpeg") ||
          !strcmp(ic->iformat->name, "mpegts")) &&
-        file_size && (ic->pb->seekable & AVIO_SEEKABLE_NORMAL)) {
+        file_size && (ic->pb->seekable & AVIO_SEEKABLE_NORMAL) &&
+        !(si->index_cache.loaded && has_duration(ic))) {
         /* get accurate estimate from the PTSes */
         estimate_timings_from_pts(ic, old_offset);
         ic->duration_estimation_method = AVFMT_DURATION_FROM_PTS;
@@ -2898,6 +2906,8 @@ int avformat_find_stream_info(AVFormatContext *ic, AVDictionary **options)
         }
     }
 
+    ff_index_cache_load(ic);
+
     if (probesize)
         estimate_timings(ic, old_offset);
 
@@ -157,6 +157,22 @@ int ff_rfps_add_frame(AVFormatContext *ic, AVStream *st, int64_t dts);
 
 void ff_rfps_calculate(AVFormatContext *ic);
 
+/**
+ * Identify the input and restore the index entries from
+ * AVFormatContext.index_cache if it matches the input.
+ *
+ * @return 0 if the cache was loaded or is not usable, AVERROR_xxx on error
+ */
+int ff_index_cache_load(AVFormatContext *s);
+
+/**
+ * Write the index entries to AVFormatContext.index_cache if they changed
+ * since they were loaded.
+ *
+ * @return 0 on success or if there is nothing to write, AVERROR_xxx on error
+ */
+int ff_index_cache_save(AVFormatContext *s);
+
 /**
  * Rescales a timestamp and the endpoints of an interval to which the temstamp
  * belongs, from a timebase `tb_in` to a timebase `tb_out`.
@@ -37,8 +37,13 @@
 #include <unistd.h>
 #endif
 #include <sys/stat.h>
+#if HAVE_WRITEV
+#include <sys/uio.h>
+#endif
 #include <stdlib.h>
+#include "asyncwriter.h"
 #include "os_support.h"
+#include "readahead.h"
 #include "url.h"
 
 /* Some systems may not have S_ISFIFO */
@@ -77,6 +82,11 @@ typedef struct FileContext {
     int blocksize;
     int follow;
     int seekable;
+    int write_queue_size;
+    AsyncWriter *writer;
+    int readahead_blocks;
+    int readahead_block_size;
+    ReadAhead *readahead;
 #if HAVE_DIRENT_H
     DIR *dir;
 #endif
@@ -87,11 +97,15 @@ static const AVOption file_options[] = {
     { "blocksize", "set I/O operation maximum block size", offsetof(FileContext, blocksize), AV_OPT_TYPE_INT, { .i64 = INT_MAX }, 1, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM },
     { "follow", "Follow a file as it is being written", offsetof(FileContext, follow), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
     { "seekable", "Sets if the file is seekable", offsetof(FileContext, seekable), AV_OPT_TYPE_INT, { .i64 = -1 }, -1, 0, AV_OPT_FLAG_DECODING_PARAM | AV_OPT_FLAG_ENCODING_PARAM },
+    { "write_queue_size", "write from a background thread, queueing up to this many bytes", offsetof(FileContext, write_queue_size), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM },
+    { "readahead_blocks", "number of blocks read ahead in the background", offsetof(FileContext, readahead_blocks), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, 64, AV_OPT_FLAG_DECODING_PARAM },
+    { "readahead_block_size", "size of a block read ahead", offsetof(FileContext, readahead_block_size), AV_OPT_TYPE_INT, { .i64 = 1 << 20 }, 4096, 1 << 28, AV_OPT_FLAG_DECODING_PARAM },
     { NULL }
 };
 
 static const AVOption pipe_options[] = {
     { "blocksize", "set I/O operation maximum block size", offsetof(FileContext, blocksize), AV_OPT_TYPE_INT, { .i64 = INT_MAX }, 1, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM },
+    { "write_queue_size", "write from a background thread, queueing up to this many bytes", offsetof(FileContext, write_queue_size), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, AV_OPT_FLAG_ENCODING_PARAM },
     { NULL }
 };
 
@@ -114,6 +128,8 @@ static int file_read(URLContext *h, unsigned char *buf, int size)
     FileContext *c = h->priv_data;
     int ret;
     size = FFMIN(size, c->blocksize);
+    if (c->readahead)
+        return ff_readahead_read(c->readahead, buf, size);
     ret = read(c->fd, buf, size);
     if (ret == 0 && c->follow)
         return AVERROR(EAGAIN);
@@ -122,15 +138,83 @@ static int file_read(URLContext *h, unsigned char *buf, int size)
     return (ret == -1) ? AVERROR(errno) : ret;
 }
 
+static int file_write_bufs(void *opaque, const AsyncWriteBuf *bufs, int nb_bufs)
+{
+    FileContext *c = opaque;
+    int ret;
+#if HAVE_WRITEV
+    struct iovec iov[ASYNC_WRITER_MAX_BATCH];
+    int nb_iov = 0, total = 0;
+
+    /* the first buffer is always written, even if it exceeds blocksize */
+    for (int i = 0; i < FFMIN(nb_bufs, ASYNC_WRITER_MAX_BATCH); i++) {
+        if (nb_iov && bufs[i].size > c->blocksize - total)
+            break;
+        iov[nb_iov].iov_base = (void *)bufs[i].data;
+        iov[nb_iov].iov_len  = FFMIN(bufs[i].size, c->blocksize);
+        total += iov[nb_iov++].iov_len;
+    }
+    ret = writev(c->fd, iov, nb_iov);
+#else
+    ret = write(c->fd, bufs[0].data, FFMIN(bufs[0].size, c->blocksize));
+#endif
+    return (ret == -1) ? AVERROR(errno) : ret;
+}
+
+static int file_init_writer(URLContext *h)
+{
+    FileContext *c = h->priv_data;
+
+    if (c->writer || !c->write_queue_size || h->flags & AVIO_FLAG_NONBLOCK)
+        return 0;
+
+    return ff_async_writer_alloc(&c->writer, file_write_bufs, c,
+                                 c->write_queue_size);
+}
+
 static int file_write(URLContext *h, const unsigned char *buf, int size)
 {
     FileContext *c = h->priv_data;
     int ret;
+
+    if ((ret = file_init_writer(h)) < 0)
+        return ret;
+    if (c->writer) {
+        ret = ff_async_writer_write(c->writer, NULL, buf, size);
+        return ret < 0 ? ret : size;
+    }
+
     size = FFMIN(size, c->blocksize);
     ret = write(c->fd, buf, size);
     return (ret == -1) ? AVERROR(errno) : ret;
 }
 
+static int file_write_buffer(URLContext *h, const AVBufferRef *buf,
+                             const unsigned char *data, int size)
+{
+    FileContext *c = h->priv_data;
+    int ret, len = 0;
+
+    if ((ret = file_init_writer(h)) < 0)
+        return ret;
+    if (c->writer) {
+        ret = ff_async_writer_write(c->writer, buf, data, size);
+        return ret < 0 ? ret : size;
+    }
+
+    while (len < size) {
+        ret = write(c->fd, data + len, FFMIN(size - len, c->blocksize));
+        if (ret == -1 && errno == EINTR)
+            continue;
+        if (ret == -1)
+            return AVERROR(errno);
+        if (!ret)
+            return AVERROR(EIO);
+        len += ret;
+    }
+    return size;
+}
+
 static int file_get_handle(URLContext *h)
 {
     FileContext *c = h->priv_data;
@@ -168,6 +252,15 @@ static int file_check(URLContext *h, int mask)
 
 #if CONFIG_FILE_PROTOCOL
 
+#if HAVE_PREAD
+static int file_pread(void *opaque, uint8_t *buf, int size, int64_t pos)
+{
+    FileContext *c = opaque;
+    int ret = pread(c->fd, buf, size, pos);
+    return (ret == -1) ? AVERROR(errno) : ret;
+}
+#endif
+
 static int file_delete(URLContext *h)
 {
 #if HAVE_UNISTD_H
@@ -242,6 +335,19 @@ static int file_open(URLContext *h, const char *filename, int flags)
     if (c->seekable >= 0)
         h->is_streamed = !c->seekable;
 
+#if HAVE_PREAD
+    /* only regular files opened for reading have a fixed size to read ahead */
+    if (c->readahead_blocks && !(flags & AVIO_FLAG_WRITE) && !c->follow &&
+        !fstat(fd, &st) && S_ISREG(st.st_mode)) {
+        int ret = ff_readahead_alloc(&c->readahead, file_pread, c,
+                                     c->readahead_block_size,
+                                     c->readahead_blocks, 0);
+        if (ret < 0)
+            av_log(h, AV_LOG_WARNING, "Could not enable read-ahead: %s\n",
+                   av_err2str(ret));
+    }
+#endif
+
     return 0;
 }
 
@@ -251,12 +357,32 @@ static int64_t file_seek(URLContext *h, int64_t pos, int whence)
     FileContext *c = h->priv_data;
     int64_t ret;
 
+    if (c->writer && (ret = ff_async_writer_flush(c->writer)) < 0)
+        return ret;
+
     if (whence == AVSEEK_SIZE) {
         struct stat st;
         ret = fstat(c->fd, &st);
         return ret < 0 ? AVERROR(errno) : (S_ISFIFO(st.st_mode) ? 0 : st.st_size);
     }
 
+    if (c->readahead) {
+        if (whence == SEEK_CUR) {
+            pos += ff_readahead_tell(c->readahead);
+        } else if (whence == SEEK_END) {
+            struct stat st;
+            if (fstat(c->fd, &st) < 0)
+                return AVERROR(errno);
+            pos += st.st_size;
+        } else if (whence != SEEK_SET) {
+            return AVERROR(EINVAL);
+        }
+        if (pos < 0)
+            return AVERROR(EINVAL);
+        ff_readahead_seek(c->readahead, pos);
+        return pos;
+    }
+
     ret = lseek(c->fd, pos, whence);
 
     return ret < 0 ? AVERROR(errno) : ret;
@@ -265,7 +391,12 @@ static int64_t file_seek(URLContext *h, int64_t pos, int whence)
 static int file_close(URLContext *h)
 {
     FileContext *c = h->priv_data;
-    int ret = close(c->fd);
+    int err = ff_async_writer_free(&c->writer);
+    int ret;
+    ff_readahead_free(&c->readahead);
+    ret = close(c->fd);
+    if (err < 0)
+        return err;
     return (ret == -1) ? AVERROR(errno) : 0;
 }
 
@@ -358,6 +489,7 @@ const URLProtocol ff_file_protocol = {
     .url_open            = file_open,
     .url_read            = file_read,
     .url_write           = file_write,
+    .url_write_buffer    = file_write_buffer,
     .url_seek            = file_seek,
     .url_close           = file_close,
     .url_get_file_handle = file_get_handle,
@@ -399,11 +531,19 @@ static int pipe_open(URLContext *h, const char *filename, int flags)
     return 0;
 }
 
+static int pipe_close(URLContext *h)
+{
+    FileContext *c = h->priv_data;
+    return ff_async_writer_free(&c->writer);
+}
+
 const URLProtocol ff_pipe_protocol = {
     .name                = "pipe",
     .url_open            = pipe_open,
     .url_read            = file_read,
     .url_write           = file_write,
+    .url_write_buffer    = file_write_buffer,
+    .url_close           = pipe_close,
     .url_get_file_handle = file_get_handle,
     .url_check           = file_check,
     .priv_data_size      = sizeof(FileContext),
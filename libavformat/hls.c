@@ -33,6 +33,7 @@
 #include "libavutil/aes.h"
 #include "libavutil/avstring.h"
 #include "libavutil/avassert.h"
+#include "libavutil/bprint.h"
 #include "libavutil/intreadwrite.h"
 #include "libavutil/mathematics.h"
 #include "libavutil/opt.h"
@@ -44,6 +45,7 @@
 #include "avio_internal.h"
 #include "id3v2.h"
 
+#include "hls_download.h"
 #include "hls_sample_encryption.h"
 
 #define INITIAL_BUFFER_SIZE 32768
@@ -86,6 +88,11 @@ struct segment {
 
 struct rendition;
 
+struct prefetched_segment {
+    int64_t seq_no;
+    HLSDownload *download;
+};
+
 enum PlaylistType {
     PLS_TYPE_UNSPECIFIED,
     PLS_TYPE_EVENT,
@@ -105,6 +112,12 @@ struct playlist {
     int input_read_done;
     AVIOContext *input_next;
     int input_next_requested;
+    /* set instead of input if the current segment was prefetched */
+    HLSDownload *input_download;
+    /* downloads of the segments following the current one */
+    struct prefetched_segment *prefetch;
+    /* pending background reload of the playlist */
+    HLSDownload *reload;
     AVFormatContext *parent;
     int index;
     AVFormatContext *ctx;
@@ -225,6 +238,8 @@ typedef struct HLSContext {
     int http_persistent;
     int http_multiple;
     int http_seekable;
+    int prefetch_segments;
+    int prefetch_buffer_size;
     AVIOContext *playlist_pb;
     HLSCryptoContext  crypto_ctx;
 } HLSContext;
@@ -258,6 +273,13 @@ static void free_init_section_list(struct playlist *pls)
     pls->n_init_sections = 0;
 }
 
+static void free_prefetched_segments(HLSContext *c, struct playlist *pls)
+{
+    ff_hls_download_free(&pls->input_download);
+    for (int i = 0; pls->prefetch && i < c->prefetch_segments; i++)
+        ff_hls_download_free(&pls->prefetch[i].download);
+}
+
 static void free_playlist_list(HLSContext *c)
 {
     int i;
@@ -277,6 +299,9 @@ static void free_playlist_list(HLSContext *c)
         pls->input_read_done = 0;
         ff_format_io_close(c->ctx, &pls->input_next);
         pls->input_next_requested = 0;
+        free_prefetched_segments(c, pls);
+        av_freep(&pls->prefetch);
+        ff_hls_download_free(&pls->reload);
         if (pls->ctx) {
             pls->ctx->pb = NULL;
             avformat_close_input(&pls->ctx);
@@ -636,13 +661,10 @@ static int open_url_keepalive(AVFormatContext *s, AVIOContext **pb,
 #endif
 }
 
-static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
-                    AVDictionary **opts, AVDictionary *opts2, int *is_http_out)
+static int check_url(AVFormatContext *s, const char *url, int *is_http_out)
 {
     HLSContext *c = s->priv_data;
-    AVDictionary *tmp = NULL;
     const char *proto_name = NULL;
-    int ret;
     int is_http = 0;
 
     if (av_strstart(url, "crypto", NULL)) {
@@ -684,6 +706,22 @@ static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
     else if (strcmp(proto_name, "file") || !strncmp(url, "file,", 5))
         return AVERROR_INVALIDDATA;
 
+    *is_http_out = is_http;
+    return 0;
+}
+
+static int open_url(AVFormatContext *s, AVIOContext **pb, const char *url,
+                    AVDictionary **opts, AVDictionary *opts2, int *is_http_out)
+{
+    HLSContext *c = s->priv_data;
+    AVDictionary *tmp = NULL;
+    int ret;
+    int is_http;
+
+    ret = check_url(s, url, &is_http);
+    if (ret < 0)
+        return ret;
+
     av_dict_copy(&tmp, *opts, 0);
     av_dict_copy(&tmp, opts2, 0);
 
@@ -1064,7 +1102,10 @@ static int read_from_url(struct playlist *pls, struct segment *seg,
     if (seg->size >= 0)
         buf_size = FFMIN(buf_size, seg->size - pls->cur_seg_offset);
 
-    ret = avio_read(pls->input, buf, buf_size);
+    if (pls->input_download)
+        ret = ff_hls_download_read(pls->input_download, buf, buf_size);
+    else
+        ret = avio_read(pls->input, buf, buf_size);
     if (ret > 0)
         pls->cur_seg_offset += ret;
 
@@ -1355,6 +1396,142 @@ cleanup:
     return ret;
 }
 
+static int64_t default_reload_interval(struct playlist *pls)
+{
+    return pls->n_segments > 0 ?
+                          pls->segments[pls->n_segments - 1]->duration :
+                          pls->target_duration;
+}
+
+static int prefetch_segment(HLSContext *c, struct playlist *pls,
+                            struct segment *seg, HLSDownload **pd)
+{
+    AVDictionary *opts = NULL;
+    int is_http, ret;
+
+    ret = check_url(pls->parent, seg->url, &is_http);
+    if (ret < 0)
+        return ret;
+
+    av_dict_copy(&opts, c->avio_opts, 0);
+    if (seg->size >= 0) {
+        av_dict_set_int(&opts, "offset", seg->url_offset, 0);
+        av_dict_set_int(&opts, "end_offset", seg->url_offset + seg->size, 0);
+    }
+
+    av_log(pls->parent, AV_LOG_VERBOSE, "HLS prefetch for url '%s', offset %"PRId64", playlist %d\n",
+           seg->url, seg->url_offset, pls->index);
+
+    /* as in open_input(), the offset option takes care of the seek for HTTP */
+    ret = ff_hls_download_start(pd, pls->parent, seg->url, opts,
+                                is_http ? 0 : seg->url_offset, seg->size,
+                                c->prefetch_buffer_size, 0);
+    av_dict_free(&opts);
+    return ret;
+}
+
+/* Start downloading the segments following the current one, and drop the
+ * downloads that are no longer ahead of the reader. Encrypted segments are
+ * left to open_input(), which keeps track of the current key. */
+static void prefetch_segments(HLSContext *c, struct playlist *pls)
+{
+    int64_t last = FFMIN(pls->cur_seq_no + c->prefetch_segments,
+                         pls->start_seq_no + pls->n_segments - 1);
+
+    for (int i = 0; i < c->prefetch_segments; i++) {
+        struct prefetched_segment *p = &pls->prefetch[i];
+        if (p->download && (p->seq_no <= pls->cur_seq_no || p->seq_no > last))
+            ff_hls_download_free(&p->download);
+    }
+
+    for (int64_t seq_no = pls->cur_seq_no + 1; seq_no <= last; seq_no++) {
+        struct segment *seg = pls->segments[seq_no - pls->start_seq_no];
+        struct prefetched_segment *slot = NULL;
+        int i, ret;
+
+        if (seg->key_type != KEY_NONE)
+            continue;
+        for (i = 0; i < c->prefetch_segments; i++) {
+            struct prefetched_segment *p = &pls->prefetch[i];
+            if (p->download && p->seq_no == seq_no)
+                break;
+            if (!p->download && !slot)
+                slot = p;
+        }
+        if (i < c->prefetch_segments || !slot)
+            continue;
+
+        ret = prefetch_segment(c, pls, seg, &slot->download);
+        if (ret < 0) {
+            av_log(pls->parent, AV_LOG_WARNING, "Failed to prefetch segment %"PRId64" of playlist %d: %s\n",
+                   seq_no, pls->index, av_err2str(ret));
+            continue;
+        }
+        slot->seq_no = seq_no;
+    }
+}
+
+static HLSDownload *take_prefetched_segment(HLSContext *c, struct playlist *pls)
+{
+    for (int i = 0; pls->prefetch && i < c->prefetch_segments; i++) {
+        struct prefetched_segment *p = &pls->prefetch[i];
+        if (p->download && p->seq_no == pls->cur_seq_no) {
+            HLSDownload *d = p->download;
+            p->download = NULL;
+            return d;
+        }
+    }
+    return NULL;
+}
+
+/* fetch the playlist again in the background once it is due for a reload */
+static void schedule_playlist_reload(HLSContext *c, struct playlist *pls)
+{
+    int ret = ff_hls_download_start(&pls->reload, pls->parent, pls->url, c->avio_opts,
+                                    0, -1, c->prefetch_buffer_size,
+                                    pls->last_load_time + default_reload_interval(pls));
+    if (ret < 0)
+        av_log(pls->parent, AV_LOG_WARNING, "Failed to schedule the reload of playlist %d: %s\n",
+               pls->index, av_err2str(ret));
+}
+
+static int reload_playlist(HLSContext *c, struct playlist *pls)
+{
+    HLSDownload *d = pls->reload;
+    FFIOContext pb;
+    AVBPrint buf;
+    uint8_t tmp[4096];
+    int ret;
+
+    if (!d) {
+        ret = parse_playlist(c, pls->url, pls, NULL);
+        goto end;
+    }
+
+    pls->reload = NULL;
+    av_bprint_init(&buf, 0, AV_BPRINT_SIZE_UNLIMITED);
+    while ((ret = ff_hls_download_read(d, tmp, sizeof(tmp))) > 0)
+        av_bprint_append_data(&buf, tmp, ret);
+    if (ret == AVERROR_EOF)
+        ret = av_bprint_is_complete(&buf) ? 0 : AVERROR(ENOMEM);
+
+    if (ret >= 0) {
+        const char *location = ff_hls_download_location(d);
+        ffio_init_context(&pb, (uint8_t *)buf.str, buf.len, 0, NULL, NULL, NULL, NULL);
+        ret = parse_playlist(c, location ? location : pls->url, pls, &pb.pub);
+        /* the data is as old as the request */
+        if (ret >= 0)
+            pls->last_load_time = ff_hls_download_start_time(d);
+    }
+    av_bprint_finalize(&buf, NULL);
+    ff_hls_download_free(&d);
+
+end:
+    if (ret >= 0 && c->prefetch_segments && !pls->finished)
+        schedule_playlist_reload(c, pls);
+    return ret;
+}
+
 static int update_init_section(struct playlist *pls, struct segment *seg)
 {
     static const int max_init_section_size = 1024*1024;
@@ -1412,13 +1589,6 @@ static int update_init_section(struct playlist *pls, struct segment *seg)
     return 0;
 }
 
-static int64_t default_reload_interval(struct playlist *pls)
-{
-    return pls->n_segments > 0 ?
-                          pls->segments[pls->n_segments - 1]->duration :
-                          pls->target_duration;
-}
-
 static int playlist_needed(struct playlist *pls)
 {
     AVFormatContext *s = pls->parent;
@@ -1478,7 +1648,7 @@ restart:
     if (!v->needed)
         return AVERROR_EOF;
 
-    if (!v->input || (c->http_persistent && v->input_read_done)) {
+    if ((!v->input && !v->input_download) || (c->http_persistent && v->input_read_done)) {
         int64_t reload_interval;
 
         /* Check that the playlist is still needed before opening a new
@@ -1495,13 +1665,16 @@ restart:
          * the last playlist reload, reload the playlists now. */
         reload_interval = default_reload_interval(v);
 
+        if (c->prefetch_segments && !v->finished && !v->reload)
+            schedule_playlist_reload(c, v);
+
 reload:
         reload_count++;
         if (reload_count > c->max_reload)
             return AVERROR_EOF;
         if (!v->finished &&
             av_gettime_relative() - v->last_load_time >= reload_interval) {
-            if ((ret = parse_playlist(c, v->url, v, NULL)) < 0) {
+            if ((ret = reload_playlist(c, v)) < 0) {
                 if (ret != AVERROR_EXIT)
                     av_log(v->parent, AV_LOG_WARNING, "Failed to reload playlist %d\n",
                            v->index);
@@ -1554,6 +1727,9 @@ reload:
             v->cur_seg_offset = 0;
             v->input_next_requested = 0;
             ret = 0;
+        } else if ((v->input_download = take_prefetched_segment(c, v))) {
+            v->cur_seg_offset = 0;
+            ret = 0;
         } else {
             ret = open_input(c, v, seg, &v->input);
         }
@@ -1567,9 +1743,18 @@ reload:
             goto reload;
         }
         just_opened = 1;
+
+        if (c->prefetch_segments) {
+            if (!v->prefetch) {
+                v->prefetch = av_calloc(c->prefetch_segments, sizeof(*v->prefetch));
+                if (!v->prefetch)
+                    return AVERROR(ENOMEM);
+            }
+            prefetch_segments(c, v);
+        }
     }
 
-    if (c->http_multiple == -1) {
+    if (c->http_multiple == -1 && v->input) {
         uint8_t *http_version_opt = NULL;
         int r = av_opt_get(v->input, "http_version", AV_OPT_SEARCH_CHILDREN, &http_version_opt);
         if (r >= 0) {
@@ -1579,7 +1764,7 @@ reload:
     }
 
     seg = next_segment(v);
-    if (c->http_multiple == 1 && !v->input_next_requested &&
+    if (c->http_multiple == 1 && !c->prefetch_segments && !v->input_next_requested &&
         seg && seg->key_type == KEY_NONE && av_strstart(seg->url, "http", NULL)) {
         ret = open_input(c, v, seg, &v->input_next);
         if (ret < 0) {
@@ -1612,7 +1797,12 @@ reload:
 
         return ret;
     }
-    if (c->http_persistent &&
+    if (v->input_download) {
+        ff_hls_download_free(&v->input_download);
+        /* keep a persistent connection around for the next segments */
+        if (v->input)
+            v->input_read_done = 1;
+    } else if (c->http_persistent &&
         seg->key_type == KEY_NONE && av_strstart(seg->url, "http", NULL)) {
         v->input_read_done = 1;
     } else {
@@ -2076,6 +2266,7 @@ static int hls_read_header(AVFormatContext *s)
             ff_format_io_close(pls->parent, &pls->input_next);
             pls->input_next = NULL;
             pls->input_next_requested = 0;
+            free_prefetched_segments(c, pls);
             pls->cur_seg_offset = 0;
             pls->cur_init_section = NULL;
             /* Reset EOF flag */
@@ -2228,6 +2419,7 @@ static int recheck_discard_flags(AVFormatContext *s, int first)
             pls->input_read_done = 0;
             ff_format_io_close(pls->parent, &pls->input_next);
             pls->input_next_requested = 0;
+            free_prefetched_segments(c, pls);
             pls->needed = 0;
             changed = 1;
             av_log(s, AV_LOG_INFO, "No longer receiving playlist %d\n", i);
@@ -2484,6 +2676,7 @@ static int hls_read_seek(AVFormatContext *s, int stream_index,
         pls->input_read_done = 0;
         ff_format_io_close(pls->parent, &pls->input_next);
         pls->input_next_requested = 0;
+        free_prefetched_segments(c, pls);
         av_packet_unref(pls->pkt);
         pb->eof_reached = 0;
         /* Clear any buffered data */
@@ -2549,6 +2742,10 @@ static const AVOption hls_options[] = {
         OFFSET(http_seekable), AV_OPT_TYPE_BOOL, { .i64 = -1}, -1, 1, FLAGS},
     {"seg_format_options", "Set options for segment demuxer",
         OFFSET(seg_format_opts), AV_OPT_TYPE_DICT, {.str = NULL}, 0, 0, FLAGS},
+    {"prefetch_segments", "Number of segments downloaded ahead in background threads, 0 = disable",
+        OFFSET(prefetch_segments), AV_OPT_TYPE_INT, {.i64 = 0}, 0, 16, FLAGS},
+    {"prefetch_buffer_size", "Maximum amount of data buffered for each prefetched segment",
+        OFFSET(prefetch_buffer_size), AV_OPT_TYPE_INT, {.i64 = 4 << 20}, 65536, INT_MAX, FLAGS},
     {NULL}
 };
 
@@ -0,0 +1,308 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "config.h"
+
+#include "libavutil/error.h"
+#include "libavutil/fifo.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+
+#include "avio_internal.h"
+#include "hls_download.h"
+#include "url.h"
+
+#if HAVE_THREADS
+
+#define DOWNLOAD_CHUNK_SIZE 32768
+
+struct HLSDownload {
+    AVFormatContext *s;
+    char            *url;
+    AVDictionary    *opts;
+    int64_t          offset;
+    int64_t          size;
+    char            *location;
+
+    pthread_t        thread;
+    pthread_mutex_t  lock;
+    pthread_cond_t   cond;
+
+    AVFifo          *fifo;
+    int64_t          start_time;
+    /* data was requested, start_time no longer matters */
+    int              requested;
+    /* AVERROR_EOF once complete */
+    int              err;
+    int              finished;
+    int              abort;
+};
+
+static int download_interrupt(void *opaque)
+{
+    HLSDownload *d = opaque;
+    int abort;
+
+    pthread_mutex_lock(&d->lock);
+    abort = d->abort;
+    pthread_mutex_unlock(&d->lock);
+
+    return abort || ff_check_interrupt(&d->s->interrupt_callback);
+}
+
+static int wait_start_time(HLSDownload *d)
+{
+    pthread_mutex_lock(&d->lock);
+    while (!d->abort && !d->requested && d->start_time > av_gettime_relative()) {
+        int64_t t = av_gettime() + FFMIN(d->start_time - av_gettime_relative(), 100000);
+        struct timespec tv = { .tv_sec  =  t / 1000000,
+                               .tv_nsec = (t % 1000000) * 1000 };
+        pthread_cond_timedwait(&d->cond, &d->lock, &tv);
+    }
+    d->start_time = av_gettime_relative();
+    pthread_mutex_unlock(&d->lock);
+
+    return download_interrupt(d) ? AVERROR_EXIT : 0;
+}
+
+static void *download_thread(void *arg)
+{
+    HLSDownload *d = arg;
+    const AVIOInterruptCB int_cb = { download_interrupt, d };
+    AVIOContext *pb = NULL;
+    uint8_t buf[DOWNLOAD_CHUNK_SIZE];
+    char *location = NULL;
+    int64_t done = 0;
+    int ret;
+
+    ret = wait_start_time(d);
+    if (ret < 0)
+        goto end;
+
+    ret = ffio_open_whitelist(&pb, d->url, AVIO_FLAG_READ, &int_cb, &d->opts,
+                              d->s->protocol_whitelist, d->s->protocol_blacklist);
+    if (ret < 0)
+        goto end;
+
+    if (d->offset) {
+        int64_t pos = avio_seek(pb, d->offset, SEEK_SET);
+        if (pos < 0) {
+            ret = pos;
+            goto end;
+        }
+    }
+
+    av_opt_get(pb, "location", AV_OPT_SEARCH_CHILDREN, (uint8_t **)&location);
+
+    while (1) {
+        int len = sizeof(buf);
+
+        if (d->size >= 0)
+            len = FFMIN(len, d->size - done);
+        if (!len) {
+            ret = AVERROR_EOF;
+            break;
+        }
+
+        ret = avio_read(pb, buf, len);
+        if (ret <= 0) {
+            ret = ret ? ret : AVERROR_EOF;
+            break;
+        }
+        done += ret;
+
+        pthread_mutex_lock(&d->lock);
+        while (!d->abort && av_fifo_can_write(d->fifo) < ret)
+            pthread_cond_wait(&d->cond, &d->lock);
+        if (!d->abort) {
+            av_fifo_write(d->fifo, buf, ret);
+            pthread_cond_broadcast(&d->cond);
+        }
+        pthread_mutex_unlock(&d->lock);
+    }
+
+end:
+    avio_closep(&pb);
+
+    pthread_mutex_lock(&d->lock);
+    d->location = location;
+    d->err      = ret;
+    d->finished = 1;
+    pthread_cond_broadcast(&d->cond);
+    pthread_mutex_unlock(&d->lock);
+
+    return NULL;
+}
+
+int ff_hls_download_start(HLSDownload **pd, AVFormatContext *s, const char *url,
+                          AVDictionary *opts, int64_t offset, int64_t size,
+                          size_t max_buffered, int64_t start_time)
+{
+    HLSDownload *d;
+    int ret;
+
+    d = av_mallocz(sizeof(*d));
+    if (!d)
+        return AVERROR(ENOMEM);
+
+    d->s          = s;
+    d->offset     = offset;
+    d->size       = size;
+    d->start_time = start_time;
+
+    d->url  = av_strdup(url);
+    d->fifo = av_fifo_alloc2(FFMAX(max_buffered, DOWNLOAD_CHUNK_SIZE), 1, 0);
+    if (!d->url || !d->fifo) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    if ((ret = av_dict_copy(&d->opts, opts, 0)) < 0)
+        goto fail;
+
+    if ((ret = pthread_mutex_init(&d->lock, NULL))) {
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    if ((ret = pthread_cond_init(&d->cond, NULL))) {
+        pthread_mutex_destroy(&d->lock);
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    if ((ret = pthread_create(&d->thread, NULL, download_thread, d))) {
+        pthread_cond_destroy(&d->cond);
+        pthread_mutex_destroy(&d->lock);
+        ret = AVERROR(ret);
+        goto fail;
+    }
+
+    *pd = d;
+    return 0;
+
+fail:
+    av_dict_free(&d->opts);
+    av_fifo_freep2(&d->fifo);
+    av_freep(&d->url);
+    av_freep(&d);
+    return ret;
+}
+
+int ff_hls_download_read(HLSDownload *d, uint8_t *buf, int size)
+{
+    size_t len;
+    int ret;
+
+    pthread_mutex_lock(&d->lock);
+
+    if (!d->requested) {
+        d->requested = 1;
+        pthread_cond_broadcast(&d->cond);
+    }
+
+    while (!av_fifo_can_read(d->fifo) && !d->finished)
+        pthread_cond_wait(&d->cond, &d->lock);
+
+    len = FFMIN(av_fifo_can_read(d->fifo), size);
+    if (len) {
+        av_fifo_read(d->fifo, buf, len);
+        pthread_cond_broadcast(&d->cond);
+        ret = len;
+    } else {
+        ret = d->err;
+    }
+
+    pthread_mutex_unlock(&d->lock);
+
+    return ret;
+}
+
+const char *ff_hls_download_location(HLSDownload *d)
+{
+    const char *location;
+
+    pthread_mutex_lock(&d->lock);
+    location = d->location;
+    pthread_mutex_unlock(&d->lock);
+
+    return location;
+}
+
+int64_t ff_hls_download_start_time(HLSDownload *d)
+{
+    int64_t start_time;
+
+    pthread_mutex_lock(&d->lock);
+    start_time = d->start_time;
+    pthread_mutex_unlock(&d->lock);
+
+    return start_time;
+}
+
+void ff_hls_download_free(HLSDownload **pd)
+{
+    HLSDownload *d = *pd;
+
+    if (!d)
+        return;
+
+    pthread_mutex_lock(&d->lock);
+    d->abort = 1;
+    pthread_cond_broadcast(&d->cond);
+    pthread_mutex_unlock(&d->lock);
+
+    pthread_join(d->thread, NULL);
+
+    pthread_cond_destroy(&d->cond);
+    pthread_mutex_destroy(&d->lock);
+    av_dict_free(&d->opts);
+    av_fifo_freep2(&d->fifo);
+    av_freep(&d->location);
+    av_freep(&d->url);
+    av_freep(pd);
+}
+
+#else
+
+int ff_hls_download_start(HLSDownload **pd, AVFormatContext *s, const char *url,
+                          AVDictionary *opts, int64_t offset, int64_t size,
+                          size_t max_buffered, int64_t start_time)
+{
+    return AVERROR(ENOSYS);
+}
+
+int ff_hls_download_read(HLSDownload *d, uint8_t *buf, int size)
+{
+    return AVERROR(ENOSYS);
+}
+
+const char *ff_hls_download_location(HLSDownload *d)
+{
+    return NULL;
+}
+
+int64_t ff_hls_download_start_time(HLSDownload *d)
+{
+    return 0;
+}
+
+void ff_hls_download_free(HLSDownload **pd)
+{
+}
+
+#endif /* HAVE_THREADS */
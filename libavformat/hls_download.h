@@ -0,0 +1,78 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_HLS_DOWNLOAD_H
+#define AVFORMAT_HLS_DOWNLOAD_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "libavutil/dict.h"
+#include "avformat.h"
+
+/**
+ * A resource downloaded by a background thread into a bounded buffer,
+ * used by the HLS demuxer to fetch segments and playlists ahead of the
+ * reader.
+ */
+typedef struct HLSDownload HLSDownload;
+
+/**
+ * Start downloading a resource.
+ *
+ * The url is opened directly with the protocol layer, honouring the
+ * protocol lists and the interrupt callback of s.
+ *
+ * @param opts         protocol options, copied
+ * @param offset       position to seek to after opening, unless 0
+ * @param size         number of bytes to download, or -1 for all of them
+ * @param max_buffered number of bytes buffered ahead of the reader
+ * @param start_time   time (in av_gettime_relative() units) before which
+ *                     the download must not start, unless data is read
+ */
+int ff_hls_download_start(HLSDownload **pd, AVFormatContext *s, const char *url,
+                          AVDictionary *opts, int64_t offset, int64_t size,
+                          size_t max_buffered, int64_t start_time);
+
+/**
+ * Read downloaded data, waiting for it if needed. Starts the download
+ * right away if it was scheduled for later.
+ *
+ * @return the number of bytes read, AVERROR_EOF once all data was read,
+ *         or the error that stopped the download
+ */
+int ff_hls_download_read(HLSDownload *d, uint8_t *buf, int size);
+
+/**
+ * @return the url the data was actually fetched from after redirections,
+ *         or NULL if unknown; only valid once ff_hls_download_read()
+ *         returned AVERROR_EOF
+ */
+const char *ff_hls_download_location(HLSDownload *d);
+
+/**
+ * @return the time the download started at, or is scheduled to start at
+ */
+int64_t ff_hls_download_start_time(HLSDownload *d);
+
+/**
+ * Abort the download if still running and free it.
+ */
+void ff_hls_download_free(HLSDownload **pd);
+
+#endif /* AVFORMAT_HLS_DOWNLOAD_H */
@@ -75,6 +75,12 @@ typedef enum {
 #define BUFSIZE (16 * 1024)
 #define POSTFIX_PATTERN "_%d"
 
+typedef struct HLSPart {
+    char *filename;
+    double duration; /* in seconds */
+    int independent;
+} HLSPart;
+
 typedef struct HLSSegment {
     char filename[MAX_URL_SIZE];
     char sub_filename[MAX_URL_SIZE];
@@ -91,6 +97,10 @@ typedef struct HLSSegment {
 
     struct HLSSegment *next;
     double discont_program_date_time;
+
+    /* partial segments, kept while close enough to the live edge */
+    HLSPart *parts;
+    int nb_parts;
 } HLSSegment;
 
 typedef enum HLSFlags {
@@ -155,6 +165,13 @@ typedef struct VariantStream {
     HLSSegment *last_segment;
     HLSSegment *old_segments;
 
+    HLSPart *parts;       // parts of the segment being written
+    int nb_parts;
+    int64_t part_start_pts;
+    int part_independent; // current part starts with a keyframe
+    int part_pos;         // current part position in the segment buffer
+    double part_max_duration; // longest part written so far
+
     char *basename_tmp;
     char *basename;
     char *vtt_basename;
@@ -214,6 +231,7 @@ typedef struct HLSContext {
     int allowcache;
     int64_t recording_time;
     int64_t max_seg_size; // every segment file max size
+    int64_t part_time;    // Set by a private option.
 
     char *baseurl;
     char *vtt_format_options_str;
@@ -585,6 +603,160 @@ static int hls_delete_file(HLSContext *hls, AVFormatContext *avf,
     return 0;
 }
 
+static void hls_free_parts(HLSPart **parts, int *nb_parts)
+{
+    for (int i = 0; i < *nb_parts; i++)
+        av_freep(&(*parts)[i].filename);
+    av_freep(parts);
+    *nb_parts = 0;
+}
+
+static const char *get_part_uri(HLSContext *hls, const char *filename)
+{
+    return hls->use_localtime_mkdir ? filename : av_basename(filename);
+}
+
+/* Name the parts of seg.m4s seg.part0.m4s, seg.part1.m4s, ... */
+static char *get_part_filename(HLSContext *hls, VariantStream *vs, int index)
+{
+    const char *url = vs->avf->url;
+    const char *proto = avio_find_protocol_name(url);
+    const char *ext;
+    int len = strlen(url);
+
+    if (proto && !strcmp(proto, "file") && (hls->flags & HLS_TEMP_FILE) &&
+        len > 4 && !strcmp(url + len - 4, ".tmp"))
+        len -= 4;
+    ext = strrchr(av_basename(url), '.');
+    if (!ext || ext >= url + len)
+        ext = url + len;
+
+    return av_asprintf("%.*s.part%d%.*s", (int)(ext - url), url, index,
+                       (int)(url + len - ext), ext);
+}
+
+static void hls_drop_parts(AVFormatContext *s, HLSContext *hls,
+                           VariantStream *vs, HLSSegment *en)
+{
+    if (hls->flags & HLS_DELETE_SEGMENTS) {
+        const char *proto = avio_find_protocol_name(s->url);
+        for (int i = 0; i < en->nb_parts; i++)
+            hls_delete_file(hls, vs->avf, en->parts[i].filename, proto);
+    }
+    hls_free_parts(&en->parts, &en->nb_parts);
+}
+
+/* Drop the parts of the segments which are no longer close to the live edge */
+static void hls_prune_parts(AVFormatContext *s, HLSContext *hls, VariantStream *vs)
+{
+    double total = 0, end = 0;
+    HLSSegment *en;
+
+    for (en = vs->segments; en; en = en->next)
+        total += en->duration;
+
+    for (en = vs->segments; en; en = en->next) {
+        end += en->duration;
+        if (total - end < 3.0 * hls->time / AV_TIME_BASE)
+            break;
+        hls_drop_parts(s, hls, vs, en);
+    }
+}
+
+/**
+ * Write what the segment buffer got since the last part as a new part.
+ * This flushes the fragment being built by the mp4 muxer.
+ */
+static int hls_write_part(AVFormatContext *s, VariantStream *vs, double duration)
+{
+    HLSContext *hls = s->priv_data;
+    AVFormatContext *oc = vs->avf;
+    AVDictionary *options = NULL;
+    AVIOContext *out = NULL;
+    const char *proto;
+    char *filename, *temp_filename;
+    HLSPart *part;
+    uint8_t *buf;
+    int size, ret;
+
+    av_write_frame(oc, NULL); /* Flush any buffered data */
+    size = avio_get_dyn_buf(oc->pb, &buf);
+    if (size <= vs->part_pos)
+        return 0;
+
+    filename = get_part_filename(hls, vs, vs->nb_parts);
+    if (!filename)
+        return AVERROR(ENOMEM);
+    proto = avio_find_protocol_name(filename);
+    if (proto && !strcmp(proto, "file") && (hls->flags & HLS_TEMP_FILE))
+        temp_filename = av_asprintf("%s.tmp", filename);
+    else
+        temp_filename = av_strdup(filename);
+    if (!temp_filename) {
+        av_freep(&filename);
+        return AVERROR(ENOMEM);
+    }
+
+    set_http_options(s, &options, hls);
+    ret = hlsenc_io_open(s, &out, temp_filename, &options);
+    av_dict_free(&options);
+    if (ret < 0) {
+        av_log(s, hls->ignore_io_errors ? AV_LOG_WARNING : AV_LOG_ERROR,
+               "Failed to open file '%s'\n", temp_filename);
+        goto fail;
+    }
+    avio_write(out, buf + vs->part_pos, size - vs->part_pos);
+    ret = hlsenc_io_close(s, &out, temp_filename);
+    if (ret < 0) {
+        av_log(s, AV_LOG_WARNING, "upload part failed\n");
+        goto fail;
+    }
+    if (strcmp(temp_filename, filename))
+        ff_rename(temp_filename, filename, s);
+
+    part = av_dynarray2_add((void **)&vs->parts, &vs->nb_parts, sizeof(*part), NULL);
+    if (!part) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    part->filename    = filename;
+    part->duration    = duration;
+    part->independent = vs->part_independent;
+    filename = NULL;
+    vs->part_max_duration = FFMAX(vs->part_max_duration, duration);
+
+fail:
+    vs->part_pos = size;
+    vs->part_start_pts = AV_NOPTS_VALUE;
+    av_freep(&temp_filename);
+    av_freep(&filename);
+    return ret < 0 && !hls->ignore_io_errors ? ret : 0;
+}
+
+/* Move what the segment buffer got so far (the moov) to the init file */
+static int hls_write_init_buffer(AVFormatContext *s, VariantStream *vs)
+{
+    HLSContext *hls = s->priv_data;
+    AVFormatContext *oc = vs->avf;
+    int byterange_mode = (hls->flags & HLS_SINGLE_FILE) || (hls->max_seg_size > 0);
+    int range_length = avio_close_dyn_buf(oc->pb, &vs->init_buffer);
+
+    if (range_length <= 0)
+        return AVERROR(EINVAL);
+    avio_write(vs->out, vs->init_buffer, range_length);
+    if (!hls->resend_init_file)
+        av_freep(&vs->init_buffer);
+    vs->init_range_length = range_length;
+    avio_open_dyn_buf(&oc->pb);
+    vs->packets_written = 0;
+    vs->start_pos = range_length;
+    vs->part_pos = 0;
+    if (!byterange_mode) {
+        hlsenc_io_close(s, &vs->out, vs->base_output_dirname);
+    }
+    return 0;
+}
+
 static int hls_delete_old_segments(AVFormatContext *s, HLSContext *hls,
                                    VariantStream *vs)
 {
@@ -685,6 +857,7 @@ static int hls_delete_old_segments(AVFormatContext *s, HLSContext *hls,
         av_bprint_clear(&path);
         previous_segment = segment;
         segment = previous_segment->next;
+        hls_free_parts(&previous_segment->parts, &previous_segment->nb_parts);
         av_freep(&previous_segment);
     }
 
@@ -1145,6 +1318,10 @@ static int hls_append_segment(struct AVFormatContext *s, HLSContext *hls,
     en->next     = NULL;
     en->discont  = 0;
     en->discont_program_date_time = 0;
+    en->parts    = vs->parts;
+    en->nb_parts = vs->nb_parts;
+    vs->parts    = NULL;
+    vs->nb_parts = 0;
 
     if (vs->discontinuity) {
         en->discont = 1;
@@ -1174,15 +1351,21 @@ static int hls_append_segment(struct AVFormatContext *s, HLSContext *hls,
         vs->segments = en->next;
         if (en && hls->flags & HLS_DELETE_SEGMENTS &&
                 !(hls->flags & HLS_SINGLE_FILE)) {
+            hls_drop_parts(s, hls, vs, en);
             en->next = vs->old_segments;
             vs->old_segments = en;
             if ((ret = hls_delete_old_segments(s, hls, vs)) < 0)
                 return ret;
-        } else
+        } else {
+            hls_free_parts(&en->parts, &en->nb_parts);
             av_freep(&en);
+        }
     } else
         vs->nb_entries++;
 
+    if (hls->part_time > 0)
+        hls_prune_parts(s, hls, vs);
+
     if (hls->max_seg_size > 0) {
         return 0;
     }
@@ -1311,6 +1494,7 @@ static void hls_free_segments(HLSSegment *p)
     while (p) {
         en = p;
         p = p->next;
+        hls_free_parts(&en->parts, &en->nb_parts);
         av_freep(&en);
     }
 }
@@ -1551,6 +1735,7 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
     double prog_date_time = vs->initial_prog_date_time;
     double *prog_date_time_p = (hls->flags & HLS_PROGRAM_DATE_TIME) ? &prog_date_time : NULL;
     int byterange_mode = (hls->flags & HLS_SINGLE_FILE) || (hls->max_seg_size > 0);
+    int i;
 
     hls->version = 2;
     if (!(hls->flags & HLS_ROUND_DURATIONS)) {
@@ -1601,6 +1786,13 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
     if (vs->has_video && (hls->flags & HLS_INDEPENDENT_SEGMENTS)) {
         avio_printf(byterange_mode ? hls->m3u8_out : vs->out, "#EXT-X-INDEPENDENT-SEGMENTS\n");
     }
+    if (hls->part_time > 0) {
+        /* parts are cut before reaching hls_part_time, unless the packets
+         * lack a duration; never advertise less than the longest one */
+        double part_target = FFMAX((double)hls->part_time / AV_TIME_BASE,
+                                   ceil(vs->part_max_duration * 1000) / 1000);
+        ff_hls_write_part_info(vs->out, part_target);
+    }
     for (en = vs->segments; en; en = en->next) {
         if ((hls->encrypt || hls->key_info_file) && (!key_uri || strcmp(en->key_uri, key_uri) ||
                                     av_strcasecmp(en->iv_string, iv_string))) {
@@ -1617,6 +1809,10 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
                                    hls->flags & HLS_SINGLE_FILE, vs->init_range_length, 0);
         }
 
+        for (i = 0; i < en->nb_parts; i++)
+            ff_hls_write_part(vs->out, en->parts[i].duration, hls->baseurl,
+                              get_part_uri(hls, en->parts[i].filename), en->parts[i].independent);
+
         ret = ff_hls_write_file_entry(byterange_mode ? hls->m3u8_out : vs->out, en->discont, byterange_mode,
                                       en->duration, hls->flags & HLS_ROUND_DURATIONS,
                                       en->size, en->pos, hls->baseurl,
@@ -1630,6 +1826,17 @@ static int hls_window(AVFormatContext *s, int last, VariantStream *vs)
         }
     }
 
+    if (hls->part_time > 0 && !last) {
+        char *next_part = get_part_filename(hls, vs, vs->nb_parts);
+
+        for (i = 0; i < vs->nb_parts; i++)
+            ff_hls_write_part(vs->out, vs->parts[i].duration, hls->baseurl,
+                              get_part_uri(hls, vs->parts[i].filename), vs->parts[i].independent);
+        if (next_part)
+            ff_hls_write_preload_hint(vs->out, hls->baseurl, get_part_uri(hls, next_part));
+        av_free(next_part);
+    }
+
     if (last && (hls->flags & HLS_OMIT_ENDLIST)==0)
         ff_hls_write_end_list(byterange_mode ? hls->m3u8_out : vs->out);
 
@@ -2504,19 +2711,15 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
         avio_flush(oc->pb);
         if (hls->segment_type == SEGMENT_TYPE_FMP4) {
             if (!vs->init_range_length) {
-                range_length = avio_close_dyn_buf(oc->pb, &vs->init_buffer);
-                if (range_length <= 0)
-                    return AVERROR(EINVAL);
-                avio_write(vs->out, vs->init_buffer, range_length);
-                if (!hls->resend_init_file)
-                    av_freep(&vs->init_buffer);
-                vs->init_range_length = range_length;
-                avio_open_dyn_buf(&oc->pb);
-                vs->packets_written = 0;
-                vs->start_pos = range_length;
-                if (!byterange_mode) {
-                    hlsenc_io_close(s, &vs->out, vs->base_output_dirname);
-                }
+                ret = hls_write_init_buffer(s, vs);
+                if (ret < 0)
+                    return ret;
+            }
+            if (hls->part_time > 0) {
+                ret = hls_write_part(s, vs, vs->part_start_pts == AV_NOPTS_VALUE ? 0 :
+                                     (double)(pkt->pts - vs->part_start_pts) * st->time_base.num / st->time_base.den);
+                if (ret < 0)
+                    return ret;
             }
         }
         if (!byterange_mode) {
@@ -2614,7 +2817,8 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
         }
 
         // if we're building a VOD playlist, skip writing the manifest multiple times, and just wait until the end
-        if (hls->pl_type != PLAYLIST_TYPE_VOD) {
+        // with partial segments, wait until the next segment is opened so that it can be hinted
+        if (hls->pl_type != PLAYLIST_TYPE_VOD && !hls->part_time) {
             if ((ret = hls_window(s, 0, vs)) < 0) {
                 av_log(s, AV_LOG_WARNING, "upload playlist failed, will retry with a new http session.\n");
                 ff_format_io_close(s, &vs->out);
@@ -2662,6 +2866,37 @@ static int hls_write_packet(AVFormatContext *s, AVPacket *pkt)
         if (ret < 0) {
             return ret;
         }
+
+        if (hls->part_time > 0) {
+            vs->part_pos = 0;
+            if (hls->pl_type != PLAYLIST_TYPE_VOD && (ret = hls_window(s, 0, vs)) < 0)
+                return ret;
+        }
+    } else if (hls->part_time > 0 && is_ref_pkt && vs->packets_written &&
+               vs->part_start_pts != AV_NOPTS_VALUE && pkt->pts > vs->part_start_pts &&
+               av_compare_ts(pkt->pts + pkt->duration - vs->part_start_pts, st->time_base,
+                             hls->part_time, AV_TIME_BASE_Q) > 0) {
+        /* cut before the packet which would make the part exceed hls_part_time */
+        double part_duration = (double)(pkt->pts - vs->part_start_pts) * st->time_base.num / st->time_base.den;
+
+        if (!vs->init_range_length) {
+            /* The first flush only writes the moov, unless some track has
+             * no sample yet; then the part is retried on the next packet. */
+            av_write_frame(oc, NULL);
+            if (avio_tell(oc->pb) > 0 && (ret = hls_write_init_buffer(s, vs)) < 0)
+                return ret;
+        }
+        if (vs->init_range_length) {
+            if ((ret = hls_write_part(s, vs, part_duration)) < 0)
+                return ret;
+            if (hls->pl_type != PLAYLIST_TYPE_VOD && (ret = hls_window(s, 0, vs)) < 0)
+                return ret;
+        }
+    }
+
+    if (hls->part_time > 0 && is_ref_pkt && vs->part_start_pts == AV_NOPTS_VALUE) {
+        vs->part_start_pts   = pkt->pts;
+        vs->part_independent = !vs->has_video || (pkt->flags & AV_PKT_FLAG_KEY);
     }
 
     vs->packets_written++;
@@ -2701,6 +2936,7 @@ static void hls_deinit(AVFormatContext *s)
             av_freep(&vs->init_buffer);
         hls_free_segments(vs->segments);
         hls_free_segments(vs->old_segments);
+        hls_free_parts(&vs->parts, &vs->nb_parts);
         av_freep(&vs->m3u8_name);
         av_freep(&vs->streams);
     }
@@ -2769,6 +3005,12 @@ static int hls_write_trailer(struct AVFormatContext *s)
                     hlsenc_io_close(s, &vs->out, vs->base_output_dirname);
                 }
             }
+            if (hls->part_time > 0) {
+                double part_duration = vs->duration + vs->dpp;
+                for (int j = 0; j < vs->nb_parts; j++)
+                    part_duration -= vs->parts[j].duration;
+                hls_write_part(s, vs, FFMAX(part_duration, 0));
+            }
         }
         if (!(hls->flags & HLS_SINGLE_FILE)) {
             set_http_options(s, &options, hls);
@@ -2940,6 +3182,23 @@ static int hls_init(AVFormatContext *s)
 
     hls->recording_time = hls->init_time ? hls->init_time : hls->time;
 
+    if (hls->part_time > 0) {
+        if (hls->segment_type != SEGMENT_TYPE_FMP4) {
+            av_log(s, AV_LOG_ERROR, "Partial segments require hls_segment_type fmp4\n");
+            return AVERROR(EINVAL);
+        }
+        if ((hls->flags & HLS_SINGLE_FILE) || hls->max_seg_size > 0 ||
+            hls->key_info_file || hls->encrypt) {
+            av_log(s, AV_LOG_ERROR, "Partial segments are not supported with "
+                   "single_file, hls_segment_size or encryption\n");
+            return AVERROR(EINVAL);
+        }
+        if (hls->part_time >= hls->time) {
+            av_log(s, AV_LOG_ERROR, "hls_part_time must be shorter than hls_time\n");
+            return AVERROR(EINVAL);
+        }
+    }
+
     if (hls->flags & HLS_SPLIT_BY_TIME && hls->flags & HLS_INDEPENDENT_SEGMENTS) {
         // Independent segments cannot be guaranteed when splitting by time
         hls->flags &= ~HLS_INDEPENDENT_SEGMENTS;
@@ -2958,6 +3217,7 @@ static int hls_init(AVFormatContext *s)
         vs->sequence  = hls->start_sequence;
         vs->start_pts = AV_NOPTS_VALUE;
         vs->end_pts   = AV_NOPTS_VALUE;
+        vs->part_start_pts = AV_NOPTS_VALUE;
         vs->current_segment_final_filename_fmt[0] = '\0';
         vs->initial_prog_date_time = initial_program_date_time;
 
@@ -3109,6 +3369,7 @@ static const AVOption options[] = {
     {"start_number",  "set first number in the sequence",        OFFSET(start_sequence),AV_OPT_TYPE_INT64,  {.i64 = 0},     0, INT64_MAX, E},
     {"hls_time",      "set segment length",                      OFFSET(time),          AV_OPT_TYPE_DURATION, {.i64 = 2000000}, 0, INT64_MAX, E},
     {"hls_init_time", "set segment length at init list",         OFFSET(init_time),     AV_OPT_TYPE_DURATION, {.i64 = 0},       0, INT64_MAX, E},
+    {"hls_part_time", "set partial segment length (low latency mode)", OFFSET(part_time), AV_OPT_TYPE_DURATION, {.i64 = 0},       0, INT64_MAX, E},
     {"hls_list_size", "set maximum number of playlist entries",  OFFSET(max_nb_segments),    AV_OPT_TYPE_INT,    {.i64 = 5},     0, INT_MAX, E},
     {"hls_delete_threshold", "set number of unreferenced segments to keep before deleting",  OFFSET(hls_delete_threshold),    AV_OPT_TYPE_INT,    {.i64 = 1},     1, INT_MAX, E},
 #if FF_HLS_TS_OPTIONS
@@ -186,6 +186,37 @@ int ff_hls_write_file_entry(AVIOContext *out, int insert_discont,
     return 0;
 }
 
+void ff_hls_write_part_info(AVIOContext *out, double part_target)
+{
+    if (!out)
+        return;
+    avio_printf(out, "#EXT-X-SERVER-CONTROL:CAN-BLOCK-RELOAD=YES,PART-HOLD-BACK=%0.3f\n",
+                3 * part_target);
+    avio_printf(out, "#EXT-X-PART-INF:PART-TARGET=%0.3f\n", part_target);
+}
+
+void ff_hls_write_part(AVIOContext *out, double duration,
+                       const char *baseurl, const char *filename,
+                       int independent)
+{
+    if (!out || !filename)
+        return;
+    avio_printf(out, "#EXT-X-PART:DURATION=%0.3f,URI=\"%s%s\"",
+                duration, baseurl ? baseurl : "", filename);
+    if (independent)
+        avio_printf(out, ",INDEPENDENT=YES");
+    avio_printf(out, "\n");
+}
+
+void ff_hls_write_preload_hint(AVIOContext *out, const char *baseurl,
+                               const char *filename)
+{
+    if (!out || !filename)
+        return;
+    avio_printf(out, "#EXT-X-PRELOAD-HINT:TYPE=PART,URI=\"%s%s\"\n",
+                baseurl ? baseurl : "", filename);
+}
+
 void ff_hls_write_end_list(AVIOContext *out)
 {
     if (!out)
@@ -33,6 +33,7 @@
 #include "libavutil/opt.h"
 #include "libavutil/time.h"
 #include "libavutil/parseutils.h"
+#include "libavutil/thread.h"
 
 #include "avformat.h"
 #include "http.h"
@@ -56,6 +57,7 @@
 #define HTTP_MUTLI    2
 #define MAX_EXPIRY    19
 #define WHITESPACES " \n\t\r"
+#define HTTP_POOL_MAX_IDLE 64
 typedef enum {
     LOWER_PROTO,
     READ_HEADERS,
@@ -63,6 +65,24 @@ typedef enum {
     FINISH
 }HandshakeState;
 
+/**
+ * A connection that can be shared between HTTPContexts through the
+ * process-wide pool of idle connections.
+ */
+typedef struct HTTPPoolConn {
+    URLContext *hd;
+    /* The lower protocol is opened with an interrupt callback forwarding to
+     * this one, so that it can be set to the one of the current owner. */
+    AVIOInterruptCB int_cb;
+    char *key;
+    int64_t idle_since;
+    int64_t idle_timeout;
+    struct HTTPPoolConn *next;
+} HTTPPoolConn;
+
+static AVMutex http_pool_mutex = AV_MUTEX_INITIALIZER;
+static HTTPPoolConn *http_pool;     ///< idle connections, most recently used first
+
 typedef struct HTTPContext {
     const AVClass *class;
     URLContext *hd;
@@ -136,6 +156,14 @@ typedef struct HTTPContext {
     char *new_location;
     AVDictionary *redirect_cache;
     uint64_t filesize_from_content_range;
+    /* Content-Length of the current reply and offset at which its body
+     * starts, to know when a connection can be reused. */
+    uint64_t content_length, body_start;
+    int connection_pool;
+    int pool_idle_timeout;
+    int pool_max_idle;
+    /* Set if hd is managed by the connection pool. */
+    HTTPPoolConn *conn;
 } HTTPContext;
 
 #define OFFSET(x) offsetof(HTTPContext, x)
@@ -178,6 +206,9 @@ static const AVOption options[] = {
     { "resource", "The resource requested by a client", OFFSET(resource), AV_OPT_TYPE_STRING, { .str = NULL }, 0, 0, E },
     { "reply_code", "The http status code to return to a client", OFFSET(reply_code), AV_OPT_TYPE_INT, { .i64 = 200}, INT_MIN, 599, E},
     { "short_seek_size", "Threshold to favor readahead over seek.", OFFSET(short_seek_size), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, D },
+    { "connection_pool", "share persistent connections with other HTTP contexts", OFFSET(connection_pool), AV_OPT_TYPE_BOOL, { .i64 = 0 }, 0, 1, D },
+    { "pool_idle_timeout", "close pooled connections idle for longer than this many seconds", OFFSET(pool_idle_timeout), AV_OPT_TYPE_INT, { .i64 = 30 }, 0, INT_MAX, D },
+    { "pool_max_idle", "maximum number of idle pooled connections per host", OFFSET(pool_max_idle), AV_OPT_TYPE_INT, { .i64 = 4 }, 0, HTTP_POOL_MAX_IDLE, D },
     { NULL }
 };
 
@@ -197,6 +228,190 @@ void ff_http_init_auth_state(URLContext *dest, const URLContext *src)
            sizeof(HTTPAuthState));
 }
 
+static int http_pool_interrupt_cb(void *opaque)
+{
+    HTTPPoolConn *conn = opaque;
+    return ff_check_interrupt(&conn->int_cb);
+}
+
+static void http_pool_conn_free(HTTPPoolConn *conn)
+{
+    while (conn) {
+        HTTPPoolConn *next = conn->next;
+        ffurl_closep(&conn->hd);
+        av_free(conn->key);
+        av_free(conn);
+        conn = next;
+    }
+}
+
+/* Unlink the connections idle for too long, must be called with the lock held */
+static void http_pool_expire(HTTPPoolConn **expired, int64_t now)
+{
+    HTTPPoolConn **p = &http_pool;
+
+    while (*p) {
+        HTTPPoolConn *conn = *p;
+        if (now - conn->idle_since > conn->idle_timeout) {
+            *p = conn->next;
+            conn->next = *expired;
+            *expired   = conn;
+        } else {
+            p = &conn->next;
+        }
+    }
+}
+
+/*
+ * Pooled connections are only reused for the same lower protocol URL, opened
+ * with the same options (TLS verification, CA and client certificates, ...)
+ * and under the same protocol white- and blacklists.
+ */
+static char *http_pool_key(URLContext *h, const char *url, AVDictionary *options)
+{
+    char *opts, *key;
+
+    if (av_dict_get_string(options, &opts, '=', ',') < 0)
+        return NULL;
+    key = av_asprintf("%s|%s|%s|%s", url,
+                      h->protocol_whitelist ? h->protocol_whitelist : "",
+                      h->protocol_blacklist ? h->protocol_blacklist : "", opts);
+    av_free(opts);
+    return key;
+}
+
+/* Take an idle connection matching the given key from the pool. */
+static int http_pool_get(URLContext *h, const char *key)
+{
+    HTTPContext *s = h->priv_data;
+    HTTPPoolConn **p, *expired = NULL;
+
+    ff_mutex_lock(&http_pool_mutex);
+    http_pool_expire(&expired, av_gettime_relative());
+    for (p = &http_pool; *p; p = &(*p)->next) {
+        if (!strcmp((*p)->key, key)) {
+            s->conn = *p;
+            *p = s->conn->next;
+            break;
+        }
+    }
+    ff_mutex_unlock(&http_pool_mutex);
+    http_pool_conn_free(expired);
+
+    if (!s->conn)
+        return 0;
+    s->conn->next   = NULL;
+    s->conn->int_cb = h->interrupt_callback;
+    s->hd           = s->conn->hd;
+    av_log(h, AV_LOG_DEBUG, "Reusing pooled connection to %s\n", s->hd->filename);
+    return 1;
+}
+
+static int http_pool_open(URLContext *h, const char *key, const char *url,
+                          AVDictionary **options)
+{
+    HTTPContext *s = h->priv_data;
+    AVIOInterruptCB int_cb;
+    int ret;
+
+    if (!(s->conn = av_mallocz(sizeof(*s->conn))))
+        return AVERROR(ENOMEM);
+    s->conn->int_cb = h->interrupt_callback;
+    if (!(s->conn->key = av_strdup(key))) {
+        av_freep(&s->conn);
+        return AVERROR(ENOMEM);
+    }
+    int_cb = (AVIOInterruptCB){ http_pool_interrupt_cb, s->conn };
+
+    ret = ffurl_open_whitelist(&s->hd, url, AVIO_FLAG_READ_WRITE,
+                               &int_cb, options,
+                               h->protocol_whitelist, h->protocol_blacklist, h);
+    if (ret < 0) {
+        av_freep(&s->conn->key);
+        av_freep(&s->conn);
+        return ret;
+    }
+    s->conn->hd = s->hd;
+    return 0;
+}
+
+static void http_close_cnx(HTTPContext *s)
+{
+    ffurl_closep(&s->hd);
+    if (s->conn)
+        av_freep(&s->conn->key);
+    av_freep(&s->conn);
+}
+
+/* Whether the reply was read entirely, leaving the connection idle. */
+static int http_cnx_reusable(URLContext *h)
+{
+    HTTPContext *s = h->priv_data;
+
+    if (!s->conn || s->willclose || (h->flags & AVIO_FLAG_WRITE) || s->post_data ||
+        s->buf_ptr != s->buf_end)
+        return 0;
+    if (s->chunksize != UINT64_MAX)
+        return s->chunkend;
+    return s->content_length != UINT64_MAX &&
+           s->off - s->body_start == s->content_length;
+}
+
+/* Return the connection to the pool if it can be reused, close it otherwise. */
+static void http_release_cnx(URLContext *h)
+{
+    HTTPContext *s = h->priv_data;
+    HTTPPoolConn *conn = s->conn, *expired = NULL, **p;
+    int nb_idle = 0, nb_host = 0;
+
+    if (!s->hd)
+        return;
+    if (!http_cnx_reusable(h)) {
+        http_close_cnx(s);
+        return;
+    }
+
+    s->hd   = NULL;
+    s->conn = NULL;
+    conn->int_cb       = (AVIOInterruptCB){ 0 };
+    conn->idle_since   = av_gettime_relative();
+    conn->idle_timeout = s->pool_idle_timeout * INT64_C(1000000);
+
+    ff_mutex_lock(&http_pool_mutex);
+    http_pool_expire(&expired, conn->idle_since);
+    conn->next = http_pool;
+    http_pool  = conn;
+    /* drop the least recently used connections beyond the limits */
+    for (p = &http_pool; *p;) {
+        HTTPPoolConn *cur = *p;
+        int same_host = !strcmp(cur->key, conn->key);
+        nb_idle++;
+        nb_host += same_host;
+        if (nb_idle > HTTP_POOL_MAX_IDLE || (same_host && nb_host > s->pool_max_idle)) {
+            *p = cur->next;
+            cur->next = expired;
+            expired   = cur;
+            nb_idle--;
+            nb_host -= same_host;
+        } else {
+            p = &cur->next;
+        }
+    }
+    ff_mutex_unlock(&http_pool_mutex);
+    http_pool_conn_free(expired);
+}
+
+void ff_http_pool_flush(void)
+{
+    HTTPPoolConn *idle;
+
+    ff_mutex_lock(&http_pool_mutex);
+    idle      = http_pool;
+    http_pool = NULL;
+    ff_mutex_unlock(&http_pool_mutex);
+    http_pool_conn_free(idle);
+}
+
 static int http_open_cnx_internal(URLContext *h, AVDictionary **options)
 {
     const char *path, *proxy_path, *lower_proto = "tcp", *local_path;
@@ -205,9 +420,10 @@ static int http_open_cnx_internal(URLContext *h, AVDictionary **options)
     char hostname[1024], hoststr[1024], proto[10];
     char auth[1024], proxyauth[1024] = "";
     char path1[MAX_URL_SIZE], sanitized_path[MAX_URL_SIZE + 1];
-    char buf[1024], urlbuf[MAX_URL_SIZE];
-    int port, use_proxy, err = 0;
+    char buf[1024], urlbuf[MAX_URL_SIZE], *pool_key = NULL;
+    int port, use_proxy, err = 0, reused = 0;
     HTTPContext *s = h->priv_data;
+    uint64_t off = s->off;
 
     av_url_split(proto, sizeof(proto), auth, sizeof(auth),
                  hostname, sizeof(hostname), &port,
@@ -262,16 +478,39 @@ static int http_open_cnx_internal(URLContext *h, AVDictionary **options)
 
     ff_url_join(buf, sizeof(buf), lower_proto, NULL, hostname, port, NULL);
 
+    if (!s->hd && s->connection_pool) {
+        if (!(pool_key = http_pool_key(h, buf, *options))) {
+            err = AVERROR(ENOMEM);
+            goto end;
+        }
+        reused = http_pool_get(h, pool_key);
+    }
     if (!s->hd) {
-        err = ffurl_open_whitelist(&s->hd, buf, AVIO_FLAG_READ_WRITE,
-                                   &h->interrupt_callback, options,
-                                   h->protocol_whitelist, h->protocol_blacklist, h);
+        if (s->connection_pool)
+            err = http_pool_open(h, pool_key, buf, options);
+        else
+            err = ffurl_open_whitelist(&s->hd, buf, AVIO_FLAG_READ_WRITE,
+                                       &h->interrupt_callback, options,
+                                       h->protocol_whitelist, h->protocol_blacklist, h);
+    }
+    if (err < 0)
+        goto end;
+
+    s->line_count = 0;
+    err = http_connect(h, path, local_path, hoststr, auth, proxyauth);
+    if (err < 0 && reused && !s->line_count) {
+        /* the server closed the idle connection, retry on a new one */
+        av_log(h, AV_LOG_DEBUG, "Pooled connection to %s failed, reconnecting\n", buf);
+        http_close_cnx(s);
+        s->off = off;
+        if ((err = http_pool_open(h, pool_key, buf, options)) >= 0)
+            err = http_connect(h, path, local_path, hoststr, auth, proxyauth);
     }
 
 end:
+    av_free(pool_key);
     freeenv_utf8(env_http_proxy);
-    return err < 0 ? err : http_connect(
-        h, path, local_path, hoststr, auth, proxyauth);
+    return err;
 }
 
 static int http_should_reconnect(HTTPContext *s, int err)
@@ -392,7 +631,7 @@ redo:
         /* restore the offset (http_connect resets it) */
         s->off = off;
 
-        ffurl_closep(&s->hd);
+        http_close_cnx(s);
         goto redo;
     }
 
@@ -400,7 +639,7 @@ redo:
     if (s->http_code == 401) {
         if ((cur_auth_type == HTTP_AUTH_NONE || s->auth_state.stale) &&
             s->auth_state.auth_type != HTTP_AUTH_NONE && attempts < 4) {
-            ffurl_closep(&s->hd);
+            http_release_cnx(h);
             goto redo;
         } else
             goto fail;
@@ -408,7 +647,7 @@ redo:
     if (s->http_code == 407) {
         if ((cur_proxy_auth_type == HTTP_AUTH_NONE || s->proxy_auth_state.stale) &&
             s->proxy_auth_state.auth_type != HTTP_AUTH_NONE && attempts < 4) {
-            ffurl_closep(&s->hd);
+            http_release_cnx(h);
             goto redo;
         } else
             goto fail;
@@ -417,7 +656,7 @@ redo:
          s->http_code == 303 || s->http_code == 307 || s->http_code == 308) &&
         s->new_location) {
         /* url moved, get next */
-        ffurl_closep(&s->hd);
+        http_release_cnx(h);
         if (redirects++ >= MAX_REDIRECTS)
             return AVERROR(EIO);
 
@@ -443,7 +682,7 @@ redo:
 
 fail:
     if (s->hd)
-        ffurl_closep(&s->hd);
+        http_close_cnx(s);
     if (ret < 0)
         return ret;
     return ff_http_averror(s->http_code, AVERROR(EIO));
@@ -1175,9 +1414,10 @@ static int process_line(URLContext *h, char *line, int line_count)
         if (!av_strcasecmp(tag, "Location")) {
             if ((ret = parse_location(s, p)) < 0)
                 return ret;
-        } else if (!av_strcasecmp(tag, "Content-Length") &&
-                   s->filesize == UINT64_MAX) {
-            s->filesize = strtoull(p, NULL, 10);
+        } else if (!av_strcasecmp(tag, "Content-Length")) {
+            s->content_length = strtoull(p, NULL, 10);
+            if (s->filesize == UINT64_MAX)
+                s->filesize = s->content_length;
         } else if (!av_strcasecmp(tag, "Content-Range")) {
             parse_content_range(h, p);
         } else if (!av_strcasecmp(tag, "Accept-Ranges") &&
@@ -1336,6 +1576,7 @@ static int http_read_header(URLContext *h)
     s->expires = 0;
     s->chunksize = UINT64_MAX;
     s->filesize_from_content_range = UINT64_MAX;
+    s->content_length = UINT64_MAX;
 
     for (;;) {
         if ((err = http_get_line(s, line, sizeof(line))) < 0)
@@ -1354,6 +1595,7 @@ static int http_read_header(URLContext *h)
     // filesize from Content-Range can always be used, even if using chunked Transfer-Encoding
     if (s->filesize_from_content_range != UINT64_MAX)
         s->filesize = s->filesize_from_content_range;
+    s->body_start = s->off;
 
     if (s->seekable == -1 && s->is_mediagateway && s->filesize == 2000000000)
         h->is_streamed = 1; /* we can in fact _not_ seek */
@@ -1475,7 +1717,8 @@ static int http_connect(URLContext *h, const char *path, const char *local_path,
         av_bprintf(&request, "Expect: 100-continue\r\n");
 
     if (!has_header(s->headers, "\r\nConnection: "))
-        av_bprintf(&request, "Connection: %s\r\n", s->multiple_requests ? "keep-alive" : "close");
+        av_bprintf(&request, "Connection: %s\r\n",
+                   s->multiple_requests || s->connection_pool ? "keep-alive" : "close");
 
     if (!has_header(s->headers, "\r\nHost: "))
         av_bprintf(&request, "Host: %s\r\n", hoststr);
@@ -1580,14 +1823,14 @@ static int http_buf_read(URLContext *h, uint8_t *buf, int size)
                    "Chunked encoding data size: %"PRIu64"\n",
                     s->chunksize);
 
-            if (!s->chunksize && s->multiple_requests) {
+            if (!s->chunksize && (s->multiple_requests || s->connection_pool)) {
                 http_get_line(s, line, sizeof(line)); // read empty chunk
                 s->chunkend = 1;
                 return 0;
             }
             else if (!s->chunksize) {
                 av_log(h, AV_LOG_DEBUG, "Last chunk received, closing conn\n");
-                ffurl_closep(&s->hd);
+                http_close_cnx(s);
                 return 0;
             }
             else if (s->chunksize == UINT64_MAX) {
@@ -1886,7 +2129,7 @@ static int http_close(URLContext *h)
         ret = http_shutdown(h, h->flags);
 
     if (s->hd)
-        ffurl_closep(&s->hd);
+        http_release_cnx(h);
     av_dict_free(&s->chained_options);
     av_dict_free(&s->cookie_dict);
     av_dict_free(&s->redirect_cache);
@@ -1899,6 +2142,7 @@ static int64_t http_seek_internal(URLContext *h, int64_t off, int whence, int fo
 {
     HTTPContext *s = h->priv_data;
     URLContext *old_hd = s->hd;
+    HTTPPoolConn *old_conn = s->conn;
     uint64_t old_off = s->off;
     uint8_t old_buf[BUFFER_SIZE];
     int old_buf_size, ret;
@@ -1946,7 +2190,8 @@ static int64_t http_seek_internal(URLContext *h, int64_t off, int whence, int fo
     /* we save the old context in case the seek fails */
     old_buf_size = s->buf_end - s->buf_ptr;
     memcpy(old_buf, s->buf_ptr, old_buf_size);
-    s->hd = NULL;
+    s->hd   = NULL;
+    s->conn = NULL;
 
     /* if it fails, continue on old connection */
     if ((ret = http_open_cnx(h, &options)) < 0) {
@@ -1955,11 +2200,15 @@ static int64_t http_seek_internal(URLContext *h, int64_t off, int whence, int fo
         s->buf_ptr = s->buffer;
         s->buf_end = s->buffer + old_buf_size;
         s->hd      = old_hd;
+        s->conn    = old_conn;
         s->off     = old_off;
         return ret;
     }
     av_dict_free(&options);
     ffurl_close(old_hd);
+    if (old_conn)
+        av_free(old_conn->key);
+    av_free(old_conn);
     return off;
 }
 
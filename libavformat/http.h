@@ -62,4 +62,10 @@ int ff_http_do_new_request2(URLContext *h, const char *uri, AVDictionary **optio
 
 int ff_http_averror(int status_code, int default_averror);
 
+/**
+ * Close all the idle connections kept in the pool of the connection_pool
+ * option. Connections currently in use are not affected.
+ */
+void ff_http_pool_flush(void);
+
 #endif /* AVFORMAT_HTTP_H */
@@ -0,0 +1,271 @@
+/*
+ * Persistent index cache
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Sidecar file holding the index entries of an input, so that formats
+ * without a complete index need not rebuild it by scanning on every open.
+ *
+ * All fields are big-endian:
+ *   tag 'FIDX', version
+ *   input size, CRC of the first and last INDEX_CACHE_PROBE bytes
+ *   demuxer name (zero-terminated), number of streams
+ *   per stream: codec type and id, time base, duration, number of entries,
+ *               then per entry: pos, timestamp, size, min_distance, flags
+ */
+
+#include "libavutil/avstring.h"
+#include "libavutil/crc.h"
+#include "libavutil/intreadwrite.h"
+#include "libavutil/mem.h"
+
+#include "avformat.h"
+#include "avio_internal.h"
+#include "demux.h"
+#include "internal.h"
+
+#define INDEX_CACHE_TAG     MKBETAG('F', 'I', 'D', 'X')
+#define INDEX_CACHE_VERSION 1
+#define INDEX_CACHE_PROBE   (64 * 1024)
+#define INDEX_CACHE_HEADER_SIZE 20
+#define INDEX_CACHE_ENTRY_SIZE  28
+
+static int index_cache_supported(const AVFormatContext *s)
+{
+    return s->index_cache && s->index_cache[0] && s->iformat &&
+           (s->iformat->flags_internal & FF_FMT_INDEX_CACHE) &&
+           !(s->iformat->flags & AVFMT_NOFILE) &&
+           s->pb && (s->pb->seekable & AVIO_SEEKABLE_NORMAL);
+}
+
+static int index_cache_nb_entries(const AVFormatContext *s)
+{
+    int nb_entries = 0;
+
+    for (unsigned i = 0; i < s->nb_streams; i++)
+        nb_entries += ffstream(s->streams[i])->nb_index_entries;
+    return nb_entries;
+}
+
+/* Identify the input by its size and a CRC of its head and tail. */
+static int index_cache_compute_key(AVFormatContext *s)
+{
+    FFFormatContext *const si = ffformatcontext(s);
+    const AVCRC *crc_table = av_crc_get_table(AV_CRC_32_IEEE_LE);
+    int64_t pos  = avio_tell(s->pb);
+    int64_t size = avio_size(s->pb);
+    uint32_t crc = UINT32_MAX;
+    uint8_t *buf;
+    int ret = 0;
+
+    if (size <= 0)
+        return size < 0 ? size : AVERROR(EINVAL);
+
+    buf = av_malloc(INDEX_CACHE_PROBE);
+    if (!buf)
+        return AVERROR(ENOMEM);
+
+    for (int i = 0; i < 2; i++) {
+        int64_t start = i ? FFMAX(size - INDEX_CACHE_PROBE, 0) : 0;
+
+        if ((ret = avio_seek(s->pb, start, SEEK_SET)) < 0)
+            break;
+        if ((ret = avio_read(s->pb, buf, INDEX_CACHE_PROBE)) < 0)
+            break;
+        crc = av_crc(crc_table, crc, buf, ret);
+    }
+    av_free(buf);
+
+    if (avio_seek(s->pb, pos, SEEK_SET) < 0 && ret >= 0)
+        ret = AVERROR(EIO);
+    if (ret < 0)
+        return ret;
+
+    si->index_cache.size = size;
+    si->index_cache.crc  = crc;
+    return 0;
+}
+
+static int index_cache_read(AVFormatContext *s, AVIOContext *pb)
+{
+    FFFormatContext *const si = ffformatcontext(s);
+    char name[64];
+    unsigned nb_streams;
+
+    if (avio_rb32(pb) != INDEX_CACHE_TAG ||
+        avio_rb32(pb) != INDEX_CACHE_VERSION)
+        return AVERROR_INVALIDDATA;
+    if (avio_rb64(pb) != si->index_cache.size ||
+        avio_rb32(pb) != si->index_cache.crc)
+        return AVERROR_INVALIDDATA;
+    avio_get_str(pb, INT_MAX, name, sizeof(name));
+    if (strcmp(name, s->iformat->name))
+        return AVERROR_INVALIDDATA;
+    nb_streams = avio_rb32(pb);
+    if (nb_streams != s->nb_streams)
+        return AVERROR_INVALIDDATA;
+
+    /* validate all streams before touching any of them */
+    for (unsigned i = 0; i < nb_streams; i++) {
+        AVStream *st = s->streams[i];
+        unsigned nb_entries;
+
+        if (avio_rb32(pb) != st->codecpar->codec_type ||
+            avio_rb32(pb) != st->codecpar->codec_id    ||
+            avio_rb32(pb) != st->time_base.num         ||
+            avio_rb32(pb) != st->time_base.den)
+            return AVERROR_INVALIDDATA;
+        avio_skip(pb, 8);
+        nb_entries = avio_rb32(pb);
+        if (nb_entries >= INT_MAX / sizeof(AVIndexEntry))
+            return AVERROR_INVALIDDATA;
+        if (avio_skip(pb, nb_entries * (int64_t)INDEX_CACHE_ENTRY_SIZE) < 0)
+            return AVERROR_INVALIDDATA;
+    }
+    if (avio_tell(pb) != avio_size(pb))
+        return AVERROR_INVALIDDATA;
+
+    if (avio_seek(pb, INDEX_CACHE_HEADER_SIZE, SEEK_SET) < 0)
+        return AVERROR(EIO);
+    avio_get_str(pb, INT_MAX, name, sizeof(name));
+    avio_skip(pb, 4);
+
+    for (unsigned i = 0; i < nb_streams; i++) {
+        AVStream *st = s->streams[i];
+        int64_t duration;
+        unsigned nb_entries;
+
+        avio_skip(pb, 16);
+        duration   = avio_rb64(pb);
+        nb_entries = avio_rb32(pb);
+        if (st->duration == AV_NOPTS_VALUE && duration != AV_NOPTS_VALUE)
+            st->duration = duration;
+
+        for (unsigned j = 0; j < nb_entries; j++) {
+            int64_t pos       = avio_rb64(pb);
+            int64_t timestamp = avio_rb64(pb);
+            int size          = avio_rb32(pb);
+            int distance      = avio_rb32(pb);
+            int flags         = avio_rb32(pb);
+            int ret;
+
+            if ((ret = av_add_index_entry(st, pos, timestamp, size, distance, flags)) < 0)
+                return ret;
+        }
+    }
+    return 0;
+}
+
+int ff_index_cache_load(AVFormatContext *s)
+{
+    FFFormatContext *const si = ffformatcontext(s);
+    AVIOContext *pb = NULL;
+    int ret;
+
+    if (!index_cache_supported(s))
+        return 0;
+
+    if ((ret = index_cache_compute_key(s)) < 0) {
+        av_log(s, AV_LOG_WARNING, "Cannot identify the input for the index cache\n");
+        return ret;
+    }
+    si->index_cache.collect = !!(s->iformat->flags_internal & FF_FMT_INDEX_CACHE_GENERIC);
+
+    if (s->io_open(s, &pb, s->index_cache, AVIO_FLAG_READ, NULL) < 0)
+        return 0;
+    ret = index_cache_read(s, pb);
+    ff_format_io_close(s, &pb);
+
+    if (ret < 0) {
+        /* a stale or broken cache is replaced when closing */
+        av_log(s, AV_LOG_VERBOSE, "Ignoring index cache '%s': %s\n",
+               s->index_cache, av_err2str(ret));
+        return 0;
+    }
+
+    si->index_cache.loaded     = 1;
+    si->index_cache.nb_entries = index_cache_nb_entries(s);
+    av_log(s, AV_LOG_VERBOSE, "Loaded %d index entries from '%s'\n",
+           si->index_cache.nb_entries, s->index_cache);
+    return 0;
+}
+
+int ff_index_cache_save(AVFormatContext *s)
+{
+    FFFormatContext *const si = ffformatcontext(s);
+    AVIOContext *pb = NULL;
+    char *tmp;
+    int nb_entries, ret;
+
+    if (!index_cache_supported(s) || !si->index_cache.size)
+        return 0;
+    nb_entries = index_cache_nb_entries(s);
+    if (!nb_entries || nb_entries == si->index_cache.nb_entries)
+        return 0;
+
+    tmp = av_asprintf("%s.tmp", s->index_cache);
+    if (!tmp)
+        return AVERROR(ENOMEM);
+    if ((ret = s->io_open(s, &pb, tmp, AVIO_FLAG_WRITE, NULL)) < 0) {
+        av_log(s, AV_LOG_WARNING, "Cannot write index cache '%s'\n", tmp);
+        av_free(tmp);
+        return ret;
+    }
+
+    avio_wb32(pb, INDEX_CACHE_TAG);
+    avio_wb32(pb, INDEX_CACHE_VERSION);
+    avio_wb64(pb, si->index_cache.size);
+    avio_wb32(pb, si->index_cache.crc);
+    avio_put_str(pb, s->iformat->name);
+    avio_wb32(pb, s->nb_streams);
+    for (unsigned i = 0; i < s->nb_streams; i++) {
+        const AVStream *st = s->streams[i];
+        const FFStream *sti = cffstream(st);
+
+        avio_wb32(pb, st->codecpar->codec_type);
+        avio_wb32(pb, st->codecpar->codec_id);
+        avio_wb32(pb, st->time_base.num);
+        avio_wb32(pb, st->time_base.den);
+        avio_wb64(pb, st->duration);
+        avio_wb32(pb, sti->nb_index_entries);
+        for (int j = 0; j < sti->nb_index_entries; j++) {
+            const AVIndexEntry *e = &sti->index_entries[j];
+            avio_wb64(pb, e->pos);
+            avio_wb64(pb, e->timestamp);
+            avio_wb32(pb, e->size);
+            avio_wb32(pb, e->min_distance);
+            avio_wb32(pb, e->flags);
+        }
+    }
+    avio_flush(pb);
+    ret = pb->error;
+    ff_format_io_close(s, &pb);
+
+    if (ret >= 0)
+        ret = ff_rename(tmp, s->index_cache, s);
+    av_free(tmp);
+    if (ret < 0)
+        return ret;
+
+    si->index_cache.nb_entries = nb_entries;
+    av_log(s, AV_LOG_VERBOSE, "Wrote %d index entries to '%s'\n",
+           nb_entries, s->index_cache);
+    return 0;
+}
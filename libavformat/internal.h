@@ -46,6 +46,19 @@
  */
 #define FF_FMT_INIT_CLEANUP                             (1 << 0)
 
+/**
+ * The index entries of an AVInputFormat with this flag set can be stored in
+ * and restored from AVFormatContext.index_cache.
+ */
+#define FF_FMT_INDEX_CACHE                              (1 << 1)
+
+/**
+ * For an AVInputFormat with this flag set, keyframes of the returned packets
+ * are added to the index as with AVFMT_GENERIC_INDEX while
+ * AVFormatContext.index_cache is in use, so that the cache is populated.
+ */
+#define FF_FMT_INDEX_CACHE_GENERIC                      (1 << 2)
+
 typedef struct AVCodecTag {
     enum AVCodecID id;
     unsigned int tag;
@@ -186,6 +199,17 @@ typedef struct FFFormatContext {
      * Contexts and child contexts do not contain a metadata option
      */
     int metafree;
+
+    /**
+     * State of AVFormatContext.index_cache, see indexcache.c
+     */
+    struct {
+        int64_t  size;       ///< size of the input, 0 if it was not identified
+        uint32_t crc;        ///< CRC of the head and tail of the input
+        int      loaded;     ///< entries were restored from the cache
+        int      collect;    ///< add keyframes of returned packets to the index
+        int      nb_entries; ///< number of entries when loaded or last written
+    } index_cache;
 } FFFormatContext;
 
 static av_always_inline FFFormatContext *ffformatcontext(AVFormatContext *s)
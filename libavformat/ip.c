@@ -43,7 +43,7 @@ static int compare_addr(const struct sockaddr_storage *a,
     return 1;
 }
 
-int ff_ip_check_source_lists(struct sockaddr_storage *source_addr_ptr, IPSourceFilters *s)
+int ff_ip_check_source_lists(const struct sockaddr_storage *source_addr_ptr, IPSourceFilters *s)
 {
     int i;
     if (s->nb_exclude_addrs) {
@@ -38,7 +38,7 @@ typedef struct IPSourceFilters {
  * @return 0 if packet should be processed based on the filter, 1 if the packet
  *         can be dropped.
  */
-int ff_ip_check_source_lists(struct sockaddr_storage *source_addr_ptr, IPSourceFilters *s);
+int ff_ip_check_source_lists(const struct sockaddr_storage *source_addr_ptr, IPSourceFilters *s);
 
 /**
  * Resolves hostname into an addrinfo structure.
@@ -158,6 +158,23 @@ typedef struct MOVFragmentIndex {
     MOVFragmentIndexItem * item;
 } MOVFragmentIndex;
 
+/**
+ * Position in the sample tables, used to build index entries on demand.
+ */
+typedef struct MOVIndexCursor {
+    unsigned int sample;       ///< sample the cursor points to
+    unsigned int chunk;        ///< chunk containing the sample
+    unsigned int chunk_sample; ///< index of the sample in its chunk
+    unsigned int stsc_index;
+    unsigned int stts_index;
+    unsigned int stts_sample;
+    unsigned int stss_index;
+    unsigned int stps_index;
+    unsigned int distance;     ///< samples since the previous keyframe
+    int64_t dts;
+    int64_t offset;
+} MOVIndexCursor;
+
 typedef struct MOVIndexRange {
     int64_t start;
     int64_t end;
@@ -260,6 +277,15 @@ typedef struct MOVStreamContext {
         AVEncryptionInfo *default_encrypted_sample;
         MOVEncryptionIndex *encryption_index;
     } cenc;
+
+    /* With lazy_index, index_entries only holds a window of the samples. */
+    struct {
+        int enabled;
+        unsigned int nb_samples; ///< number of samples the tables describe
+        unsigned int base;       ///< sample number of index_entries[0]
+        MOVIndexCursor start;    ///< state at the first sample
+        MOVIndexCursor next;     ///< state at the sample following the window
+    } lazy;
 } MOVStreamContext;
 
 typedef struct MOVContext {
@@ -286,6 +312,7 @@ typedef struct MOVContext {
     int use_absolute_path;
     int ignore_editlist;
     int advanced_editlist;
+    int lazy_index;
     int ignore_chapters;
     int seek_individually;
     int64_t next_root_atom; ///< offset of the next root atom
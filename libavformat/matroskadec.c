@@ -49,6 +49,7 @@
 #include "libavutil/pixdesc.h"
 #include "libavutil/time_internal.h"
 #include "libavutil/spherical.h"
+#include "libavutil/thread.h"
 
 #include "libavcodec/bytestream.h"
 #include "libavcodec/flac.h"
@@ -370,6 +371,40 @@ typedef struct MatroskaLevel1Element {
     int parsed;
 } MatroskaLevel1Element;
 
+enum MatroskaClusterScanMode {
+    CLUSTER_SCAN_NONE,
+    CLUSTER_SCAN_SEEK,
+    CLUSTER_SCAN_BACKGROUND,
+};
+
+typedef struct MatroskaScanEntry {
+    int     stream_index;
+    int64_t pos;
+    int64_t timestamp;
+} MatroskaScanEntry;
+
+/* Index builder for files without Cues, reading only the headers of the
+ * clusters and of the blocks inside them. */
+typedef struct MatroskaClusterScan {
+    AVIOContext *pb;            ///< private context in background mode
+    int64_t pos;                ///< position of the next element to scan
+    int64_t end;                ///< end of the segment, INT64_MAX if unknown
+    uint64_t cluster_time;      ///< timestamp of the last cluster scanned
+    int done;
+
+    MatroskaScanEntry *entries; ///< keyframes not added to the index yet
+    int nb_entries;
+    unsigned entries_size;
+
+#if HAVE_THREADS
+    pthread_t thread;
+    pthread_mutex_t mutex;
+    pthread_cond_t cond;
+    int thread_started;
+    int abort;
+#endif
+} MatroskaClusterScan;
+
 typedef struct MatroskaDemuxContext {
     const AVClass *class;
     AVFormatContext *ctx;
@@ -423,6 +458,9 @@ typedef struct MatroskaDemuxContext {
 
     /* Bandwidth value for WebM DASH Manifest */
     int bandwidth;
+
+    int cluster_scan;
+    MatroskaClusterScan scan;
 } MatroskaDemuxContext;
 
 #define CHILD_OF(parent) { .def = { .n = parent } }
@@ -3000,6 +3038,358 @@ static int matroska_parse_tracks(AVFormatContext *s)
     return 0;
 }
 
+static void cluster_scan_lock(MatroskaClusterScan *scan)
+{
+#if HAVE_THREADS
+    if (scan->thread_started)
+        pthread_mutex_lock(&scan->mutex);
+#endif
+}
+
+static void cluster_scan_unlock(MatroskaClusterScan *scan)
+{
+#if HAVE_THREADS
+    if (scan->thread_started) {
+        pthread_cond_broadcast(&scan->cond);
+        pthread_mutex_unlock(&scan->mutex);
+    }
+#endif
+}
+
+static int cluster_scan_read_id(MatroskaDemuxContext *matroska, AVIOContext *pb,
+                                uint32_t *id)
+{
+    uint64_t num;
+    int res = ebml_read_num(matroska, pb, 4, &num, 0);
+
+    if (res < 0)
+        return res;
+    *id = num | 1 << 7 * res;
+    return res;
+}
+
+/* Read the header of a (Simple)Block and queue an index entry if it is a keyframe. */
+static int cluster_scan_block(MatroskaDemuxContext *matroska, AVIOContext *pb,
+                              uint64_t length, int64_t cluster_pos,
+                              uint64_t cluster_time, int is_keyframe)
+{
+    MatroskaClusterScan *scan = &matroska->scan;
+    MatroskaTrack *track;
+    MatroskaScanEntry *entries;
+    int16_t block_time;
+    uint64_t num;
+    int n, flags;
+
+    if ((n = ebml_read_num(matroska, pb, 8, &num, 1)) < 0)
+        return n;
+    if (length < n + 3)
+        return AVERROR_INVALIDDATA;
+    block_time = sign_extend(avio_rb16(pb), 16);
+    flags      = avio_r8(pb);
+    if (pb->eof_reached)
+        return AVERROR(EIO);
+    if (is_keyframe == -1)
+        is_keyframe = flags & 0x80;
+
+    if (!is_keyframe || cluster_time == (uint64_t)-1 ||
+        (block_time < 0 && cluster_time < -block_time))
+        return 0;
+    track = matroska_find_track_by_num(matroska, num);
+    if (!track || !track->stream || track->type == MATROSKA_TRACK_TYPE_SUBTITLE)
+        return 0;
+
+    cluster_scan_lock(scan);
+    entries = av_fast_realloc(scan->entries, &scan->entries_size,
+                              (scan->nb_entries + 1) * sizeof(*entries));
+    if (entries) {
+        uint64_t timecode_cluster_in_track_tb = (double) cluster_time / track->time_scale;
+        scan->entries = entries;
+        entries[scan->nb_entries++] = (MatroskaScanEntry) {
+            .stream_index = track->stream->index,
+            .pos          = cluster_pos,
+            .timestamp    = timecode_cluster_in_track_tb + block_time -
+                            track->codec_delay_in_track_tb,
+        };
+    }
+    cluster_scan_unlock(scan);
+
+    return entries ? 0 : AVERROR(ENOMEM);
+}
+
+static int cluster_scan_blockgroup(MatroskaDemuxContext *matroska, AVIOContext *pb,
+                                   int64_t end, int64_t cluster_pos,
+                                   uint64_t cluster_time)
+{
+    int64_t block_pos = -1;
+    uint64_t block_length = 0;
+    int reference = 0;
+
+    while (avio_tell(pb) < end) {
+        uint32_t id;
+        uint64_t length;
+        int res;
+
+        if ((res = cluster_scan_read_id(matroska, pb, &id)) < 0 ||
+            (res = ebml_read_length(matroska, pb, &length)) < 0)
+            return res;
+        if (length == EBML_UNKNOWN_LENGTH)
+            return AVERROR_INVALIDDATA;
+
+        if (id == MATROSKA_ID_BLOCK) {
+            block_pos    = avio_tell(pb);
+            block_length = length;
+        } else if (id == MATROSKA_ID_BLOCKREFERENCE) {
+            reference = 1;
+        }
+        if (avio_skip(pb, length) < 0)
+            return AVERROR(EIO);
+    }
+
+    if (block_pos < 0)
+        return 0;
+    if (avio_seek(pb, block_pos, SEEK_SET) < 0)
+        return AVERROR(EIO);
+    return cluster_scan_block(matroska, pb, block_length, cluster_pos,
+                              cluster_time, !reference);
+}
+
+static int cluster_scan_cluster(MatroskaDemuxContext *matroska, AVIOContext *pb,
+                                int64_t cluster_pos, uint64_t length,
+                                uint64_t *cluster_time)
+{
+    int64_t end = length == EBML_UNKNOWN_LENGTH ? matroska->scan.end
+                                                : avio_tell(pb) + length;
+
+    *cluster_time = -1;
+    while (avio_tell(pb) < end) {
+        int64_t pos = avio_tell(pb), child_end;
+        uint32_t id;
+        int res;
+
+        res = cluster_scan_read_id(matroska, pb, &id);
+        if (res == AVERROR_EOF && length == EBML_UNKNOWN_LENGTH)
+            return 0;
+        if (res < 0)
+            return res;
+        if (length == EBML_UNKNOWN_LENGTH &&
+            ebml_parse_id(matroska_segment, id)->id) {
+            /* An unknown-length cluster ends with the next level 1 element. */
+            return avio_seek(pb, pos, SEEK_SET) < 0 ? AVERROR(EIO) : 0;
+        }
+        if ((res = ebml_read_length(matroska, pb, &length)) < 0)
+            return res;
+        if (length == EBML_UNKNOWN_LENGTH)
+            return AVERROR_INVALIDDATA;
+        child_end = avio_tell(pb) + length;
+
+        switch (id) {
+        case MATROSKA_ID_CLUSTERTIMECODE:
+            if (length > 8)
+                return AVERROR_INVALIDDATA;
+            ebml_read_uint(pb, length, 0, cluster_time);
+            break;
+        case MATROSKA_ID_SIMPLEBLOCK:
+            res = cluster_scan_block(matroska, pb, length, cluster_pos,
+                                     *cluster_time, -1);
+            break;
+        case MATROSKA_ID_BLOCKGROUP:
+            res = cluster_scan_blockgroup(matroska, pb, child_end, cluster_pos,
+                                          *cluster_time);
+            break;
+        }
+        if (res < 0)
+            return res;
+        if (avio_seek(pb, child_end, SEEK_SET) < 0)
+            return AVERROR(EIO);
+        if (avio_feof(pb))
+            return AVERROR_EOF;
+    }
+    return 0;
+}
+
+/* Scan the next level 1 element. */
+static int cluster_scan_step(MatroskaDemuxContext *matroska, AVIOContext *pb)
+{
+    MatroskaClusterScan *scan = &matroska->scan;
+    uint64_t length, cluster_time = -1;
+    int64_t pos = scan->pos, next;
+    uint32_t id;
+    int res;
+
+    if (pos >= scan->end)
+        return AVERROR_EOF;
+    if (avio_seek(pb, pos, SEEK_SET) < 0)
+        return AVERROR(EIO);
+    if ((res = cluster_scan_read_id(matroska, pb, &id)) < 0 ||
+        (res = ebml_read_length(matroska, pb, &length)) < 0)
+        return res;
+
+    if (id == MATROSKA_ID_CLUSTER) {
+        if ((res = cluster_scan_cluster(matroska, pb, pos, length, &cluster_time)) < 0)
+            return res;
+        next = avio_tell(pb);
+    } else if (length != EBML_UNKNOWN_LENGTH) {
+        next = avio_tell(pb) + length;
+    } else {
+        return AVERROR_INVALIDDATA;
+    }
+
+    cluster_scan_lock(scan);
+    scan->pos = next;
+    if (cluster_time != (uint64_t)-1)
+        scan->cluster_time = cluster_time;
+    cluster_scan_unlock(scan);
+    return 0;
+}
+
+#if HAVE_THREADS
+static void *cluster_scan_thread(void *arg)
+{
+    MatroskaDemuxContext *matroska = arg;
+    MatroskaClusterScan *scan = &matroska->scan;
+    int abort = 0;
+
+    while (!abort && cluster_scan_step(matroska, scan->pb) >= 0) {
+        pthread_mutex_lock(&scan->mutex);
+        abort = scan->abort;
+        pthread_mutex_unlock(&scan->mutex);
+    }
+
+    pthread_mutex_lock(&scan->mutex);
+    scan->done = 1;
+    pthread_cond_broadcast(&scan->cond);
+    pthread_mutex_unlock(&scan->mutex);
+    return NULL;
+}
+#endif
+
+static void cluster_scan_init(MatroskaDemuxContext *matroska)
+{
+    AVFormatContext *s = matroska->ctx;
+    MatroskaClusterScan *scan = &matroska->scan;
+    int64_t data_offset = ffformatcontext(s)->data_offset;
+
+    scan->done = 1;
+    if (!matroska->cluster_scan || matroska->is_live || !data_offset ||
+        (s->flags & AVFMT_FLAG_IGNIDX) ||
+        !(s->pb->seekable & AVIO_SEEKABLE_NORMAL))
+        return;
+
+    /* Cues read already or to be read when seeking make scanning useless. */
+    if (matroska->index.nb_elem >= 2)
+        return;
+    for (int i = 0; i < matroska->num_level1_elems; i++)
+        if (matroska->level1_elems[i].id == MATROSKA_ID_CUES)
+            return;
+
+    scan->pos          = data_offset;
+    scan->end          = matroska->num_levels &&
+                         matroska->levels[0].length != EBML_UNKNOWN_LENGTH ?
+                         matroska->levels[0].start + matroska->levels[0].length : INT64_MAX;
+    scan->cluster_time = -1;
+    scan->done         = 0;
+
+#if HAVE_THREADS
+    if (matroska->cluster_scan == CLUSTER_SCAN_BACKGROUND) {
+        AVDictionary *opts = NULL;
+        /* open the second handle like the first one, e.g. with the same
+         * HTTP headers, cookies and TLS settings */
+        int ret = ffio_copy_url_options(s->pb, &opts);
+
+        if (ret >= 0)
+            ret = s->io_open(s, &scan->pb, s->url, AVIO_FLAG_READ, &opts);
+        av_dict_free(&opts);
+        if (ret >= 0 && (ret = AVERROR(pthread_mutex_init(&scan->mutex, NULL))) >= 0) {
+            if ((ret = AVERROR(pthread_cond_init(&scan->cond, NULL))) < 0) {
+                pthread_mutex_destroy(&scan->mutex);
+            } else {
+                scan->thread_started = 1;
+                ret = AVERROR(pthread_create(&scan->thread, NULL, cluster_scan_thread, matroska));
+                if (ret < 0) {
+                    scan->thread_started = 0;
+                    pthread_cond_destroy(&scan->cond);
+                    pthread_mutex_destroy(&scan->mutex);
+                }
+            }
+        }
+        if (ret < 0) {
+            av_log(s, AV_LOG_WARNING, "Cannot scan clusters in the background, "
+                   "scanning when seeking: %s\n", av_err2str(ret));
+            ff_format_io_close(s, &scan->pb);
+        }
+    }
+#endif
+}
+
+/* Add the keyframes found by the scan to the index. */
+static void cluster_scan_merge(MatroskaDemuxContext *matroska)
+{
+    AVFormatContext *s = matroska->ctx;
+    MatroskaClusterScan *scan = &matroska->scan;
+
+    cluster_scan_lock(scan);
+    for (int i = 0; i < scan->nb_entries; i++) {
+        const MatroskaScanEntry *e = &scan->entries[i];
+        AVStream *st = s->streams[e->stream_index];
+
+        if (st->discard >= AVDISCARD_ALL)
+            continue;
+        ff_reduce_index(s, st->index);
+        av_add_index_entry(st, e->pos, e->timestamp, 0, 0, AVINDEX_KEYFRAME);
+    }
+    scan->nb_entries = 0;
+    cluster_scan_unlock(scan);
+}
+
+/* Make sure the index covers the given timestamp of the given stream. */
+static void cluster_scan_seek(MatroskaDemuxContext *matroska, AVStream *st,
+                              int64_t timestamp)
+{
+    MatroskaClusterScan *scan = &matroska->scan;
+    MatroskaTrack *tracks = matroska->tracks.elem;
+    uint64_t until = FFMAX(timestamp, 0);
+
+    for (int i = 0; i < matroska->tracks.nb_elem; i++)
+        if (tracks[i].stream == st)
+            until = FFMIN(until * tracks[i].time_scale, (double)(INT64_MAX - 1));
+
+#if HAVE_THREADS
+    if (scan->thread_started) {
+        pthread_mutex_lock(&scan->mutex);
+        while (!scan->done && (scan->cluster_time == (uint64_t)-1 ||
+                               scan->cluster_time <= until))
+            pthread_cond_wait(&scan->cond, &scan->mutex);
+        pthread_mutex_unlock(&scan->mutex);
+    } else
+#endif
+    while (!scan->done && (scan->cluster_time == (uint64_t)-1 ||
+                           scan->cluster_time <= until)) {
+        if (cluster_scan_step(matroska, matroska->ctx->pb) < 0)
+            scan->done = 1;
+    }
+
+    cluster_scan_merge(matroska);
+}
+
+static void cluster_scan_close(MatroskaDemuxContext *matroska)
+{
+    MatroskaClusterScan *scan = &matroska->scan;
+
+#if HAVE_THREADS
+    if (scan->thread_started) {
+        pthread_mutex_lock(&scan->mutex);
+        scan->abort = 1;
+        pthread_mutex_unlock(&scan->mutex);
+        pthread_join(scan->thread, NULL);
+        pthread_cond_destroy(&scan->cond);
+        pthread_mutex_destroy(&scan->mutex);
+        scan->thread_started = 0;
+    }
+#endif
+    ff_format_io_close(matroska->ctx, &scan->pb);
+    av_freep(&scan->entries);
+}
+
 static int matroska_read_header(AVFormatContext *s)
 {
     FFFormatContext *const si = ffformatcontext(s);
@@ -3147,6 +3537,8 @@ static int matroska_read_header(AVFormatContext *s)
 
     matroska_convert_tags(s);
 
+    cluster_scan_init(matroska);
+
     return 0;
 }
 
@@ -3840,6 +4232,58 @@ static int matroska_parse_block(MatroskaDemuxContext *matroska, AVBufferRef *buf
     return 0;
 }
 
+/*
+ * Read a SimpleBlock of a cluster with known length directly, without the
+ * generic syntax table dispatch of ebml_parse(). Returns 1 if the next
+ * element is something else; its ID has been read then and ebml_parse()
+ * continues from there.
+ */
+static int matroska_read_simpleblock(MatroskaDemuxContext *matroska,
+                                     MatroskaBlock *block)
+{
+    AVIOContext *pb = matroska->ctx->pb;
+    MatroskaLevel *level = &matroska->levels[matroska->num_levels - 1];
+    int64_t pos = avio_tell(pb), level_end;
+    uint64_t id, length;
+    int res;
+
+    if (matroska->current_id || level->length == EBML_UNKNOWN_LENGTH)
+        return 1;
+    level_end = level->start + level->length;
+    if (pos >= level_end)
+        return 1;
+
+    if ((res = ebml_read_num(matroska, pb, 4, &id, 1)) < 0)
+        return res;
+    matroska->current_id = id | 1 << 7 * res;
+    if (matroska->current_id != MATROSKA_ID_SIMPLEBLOCK)
+        return 1;
+    matroska->current_id = 0;
+
+    if ((res = ebml_read_length(matroska, pb, &length)) < 0)
+        return res;
+    if (length > 0x10000000 || avio_tell(pb) + length > level_end) {
+        av_log(matroska->ctx, AV_LOG_ERROR, "Invalid SimpleBlock at 0x%"PRIx64
+               " in cluster ending at 0x%"PRIx64"\n", pos, level_end);
+        return AVERROR_INVALIDDATA;
+    }
+    matroska->resync_pos    = pos;
+    matroska->unknown_count = 0;
+
+    res = ebml_read_binary(pb, length, avio_tell(pb), &block->bin);
+    if (res == NEEDS_CHECKING) {
+        av_log(matroska->ctx, AV_LOG_ERROR, "File ended prematurely\n");
+        return pb->error ? pb->error : AVERROR(EIO);
+    } else if (res < 0)
+        return res;
+
+    while (matroska->num_levels && avio_tell(pb) == level->start + level->length) {
+        matroska->num_levels--;
+        level--;
+    }
+    return 0;
+}
+
 static int matroska_parse_cluster(MatroskaDemuxContext *matroska)
 {
     MatroskaCluster *cluster = &matroska->current_cluster;
@@ -3863,7 +4307,9 @@ static int matroska_parse_cluster(MatroskaDemuxContext *matroska)
 
     if (matroska->num_levels == 2) {
         /* We are inside a cluster. */
-        res = ebml_parse(matroska, matroska_cluster_parsing, cluster);
+        res = matroska_read_simpleblock(matroska, block);
+        if (res == 1)
+            res = ebml_parse(matroska, matroska_cluster_parsing, cluster);
 
         if (res >= 0 && block->bin.size > 0) {
             int is_keyframe = block->non_simple ? block->reference.count == 0 : -1;
@@ -3906,6 +4352,11 @@ static int matroska_read_packet(AVFormatContext *s, AVPacket *pkt)
         matroska->resync_pos = avio_tell(s->pb);
     }
 
+#if HAVE_THREADS
+    if (matroska->scan.thread_started)
+        cluster_scan_merge(matroska);
+#endif
+
     while (matroska_deliver_packet(matroska, pkt)) {
         if (matroska->done)
             return (ret < 0) ? ret : AVERROR_EOF;
@@ -3931,6 +4382,9 @@ static int matroska_read_seek(AVFormatContext *s, int stream_index,
         matroska_parse_cues(matroska);
     }
 
+    if (matroska->scan.pos)
+        cluster_scan_seek(matroska, st, timestamp);
+
     if (!sti->nb_index_entries)
         goto err;
     timestamp = FFMAX(timestamp, sti->index_entries[0].timestamp);
@@ -3990,6 +4444,7 @@ static int matroska_read_close(AVFormatContext *s)
     MatroskaTrack *tracks = matroska->tracks.elem;
     int n;
 
+    cluster_scan_close(matroska);
     matroska_clear_queue(matroska);
 
     for (n = 0; n < matroska->tracks.nb_elem; n++)
@@ -4000,6 +4455,8 @@ static int matroska_read_close(AVFormatContext *s)
     return 0;
 }
 
+#define OFFSET(x) offsetof(MatroskaDemuxContext, x)
+
 #if CONFIG_WEBM_DASH_MANIFEST_DEMUXER
 typedef struct {
     int64_t start_time_ns;
@@ -4415,7 +4872,6 @@ static int webm_dash_manifest_read_packet(AVFormatContext *s, AVPacket *pkt)
     return AVERROR_EOF;
 }
 
-#define OFFSET(x) offsetof(MatroskaDemuxContext, x)
 static const AVOption options[] = {
     { "live", "flag indicating that the input is a live file that only has the headers.", OFFSET(is_live), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, AV_OPT_FLAG_DECODING_PARAM },
     { "bandwidth", "bandwidth of this stream to be specified in the DASH manifest.", OFFSET(bandwidth), AV_OPT_TYPE_INT, {.i64 = 0}, 0, INT_MAX, AV_OPT_FLAG_DECODING_PARAM },
@@ -4441,12 +4897,28 @@ const AVInputFormat ff_webm_dash_manifest_demuxer = {
 };
 #endif
 
+static const AVOption matroska_options[] = {
+    { "cluster_scan", "build the index of files without Cues from cluster and block headers", OFFSET(cluster_scan), AV_OPT_TYPE_INT, { .i64 = CLUSTER_SCAN_NONE }, CLUSTER_SCAN_NONE, CLUSTER_SCAN_BACKGROUND, AV_OPT_FLAG_DECODING_PARAM, "cluster_scan" },
+        { "none",       "parse whole clusters when seeking",       0, AV_OPT_TYPE_CONST, { .i64 = CLUSTER_SCAN_NONE },       0, 0, AV_OPT_FLAG_DECODING_PARAM, "cluster_scan" },
+        { "seek",       "scan up to the target when seeking",      0, AV_OPT_TYPE_CONST, { .i64 = CLUSTER_SCAN_SEEK },       0, 0, AV_OPT_FLAG_DECODING_PARAM, "cluster_scan" },
+        { "background", "scan the whole file in a separate thread", 0, AV_OPT_TYPE_CONST, { .i64 = CLUSTER_SCAN_BACKGROUND }, 0, 0, AV_OPT_FLAG_DECODING_PARAM, "cluster_scan" },
+    { NULL },
+};
+
+static const AVClass matroska_class = {
+    .class_name = "matroska,webm demuxer",
+    .item_name  = av_default_item_name,
+    .option     = matroska_options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
 const AVInputFormat ff_matroska_demuxer = {
     .name           = "matroska,webm",
     .long_name      = NULL_IF_CONFIG_SMALL("Matroska / WebM"),
     .extensions     = "mkv,mk3d,mka,mks,webm",
+    .priv_class     = &matroska_class,
     .priv_data_size = sizeof(MatroskaDemuxContext),
-    .flags_internal = FF_FMT_INIT_CLEANUP,
+    .flags_internal = FF_FMT_INIT_CLEANUP | FF_FMT_INDEX_CACHE,
     .read_probe     = matroska_probe,
     .read_header    = matroska_read_header,
     .read_packet    = matroska_read_packet,
@@ -647,7 +647,7 @@ static void ebml_writer_write_block(const EbmlElement *elem, AVIOContext *pb)
     } else {
         const uint8_t *data = pkt->data;
         unsigned offset = track->offset <= pkt->size ? track->offset : 0;
-        avio_write(pb, data + offset, pkt->size - offset);
+        avio_write_buffer_ref(pb, pkt->buf, data + offset, pkt->size - offset);
     }
 }
 
@@ -4025,6 +4025,441 @@ static int build_open_gop_key_points(AVStream *st)
     return 0;
 }
 
+static void mov_check_stsz_sample_size(MOVContext *mov, MOVStreamContext *sc,
+                                       unsigned int chunk, unsigned int stsc_index)
+{
+    int64_t current_offset = sc->chunk_offsets[chunk];
+    int64_t next_offset = chunk + 1 < sc->chunk_count ? sc->chunk_offsets[chunk + 1] : INT64_MAX;
+
+    if (next_offset > current_offset && sc->sample_size>0 && sc->sample_size < sc->stsz_sample_size &&
+        sc->stsc_data[stsc_index].count * (int64_t)sc->stsz_sample_size > next_offset - current_offset) {
+        av_log(mov->fc, AV_LOG_WARNING, "STSZ sample size %d invalid (too large), ignoring\n", sc->stsz_sample_size);
+        sc->stsz_sample_size = sc->sample_size;
+    }
+    if (sc->stsz_sample_size>0 && sc->stsz_sample_size < sc->sample_size) {
+        av_log(mov->fc, AV_LOG_WARNING, "STSZ sample size %d invalid (too small), ignoring\n", sc->stsz_sample_size);
+        sc->stsz_sample_size = sc->sample_size;
+    }
+}
+
+/* Expand ctts entries such that we have a 1-1 mapping with samples */
+static int mov_expand_ctts(MOVStreamContext *sc)
+{
+    MOVCtts *ctts_data_old = sc->ctts_data;
+    unsigned int ctts_count_old = sc->ctts_count;
+
+    if (sc->sample_count >= UINT_MAX / sizeof(*sc->ctts_data))
+        return AVERROR(ENOMEM);
+    sc->ctts_count = 0;
+    sc->ctts_allocated_size = 0;
+    sc->ctts_data = av_fast_realloc(NULL, &sc->ctts_allocated_size,
+                            sc->sample_count * sizeof(*sc->ctts_data));
+    if (!sc->ctts_data) {
+        av_free(ctts_data_old);
+        return AVERROR(ENOMEM);
+    }
+
+    memset((uint8_t*)(sc->ctts_data), 0, sc->ctts_allocated_size);
+
+    for (unsigned int i = 0; i < ctts_count_old &&
+                             sc->ctts_count < sc->sample_count; i++)
+        for (unsigned int j = 0; j < ctts_data_old[i].count &&
+                                 sc->ctts_count < sc->sample_count; j++)
+            add_ctts_entry(&sc->ctts_data, &sc->ctts_count,
+                           &sc->ctts_allocated_size, 1,
+                           ctts_data_old[i].duration);
+    av_free(ctts_data_old);
+    return 0;
+}
+
+/*
+ * Lazy index: instead of one AVIndexEntry per sample, the sample tables are
+ * kept and index_entries only holds a window of MOV_LAZY_INDEX_WINDOW
+ * entries, rebuilt when reading or seeking moves out of it. Sample numbers
+ * (current_sample, seek results) stay absolute.
+ */
+#define MOV_LAZY_INDEX_WINDOW 1024
+
+static int mov_lazy_index_eligible(MOVContext *mov, AVStream *st)
+{
+    MOVStreamContext *sc = st->priv_data;
+
+    if (!mov->lazy_index || ffstream(st)->nb_index_entries ||
+        (st->codecpar->codec_type != AVMEDIA_TYPE_VIDEO &&
+         st->codecpar->codec_type != AVMEDIA_TYPE_AUDIO))
+        return 0;
+    /* uncompressed audio is indexed by chunks, which is already compact */
+    if (st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO &&
+        sc->stts_count == 1 && sc->stts_data[0].duration == 1)
+        return 0;
+    if (!sc->sample_count || !sc->chunk_count || !sc->stsc_count || !sc->stts_count ||
+        (sc->stsz_sample_size <= 0 && !sc->sample_sizes) ||
+        (sc->rap_group_count && sc->rap_group))
+        return 0;
+
+    /* The tables are searched directly, so they must be well-formed */
+    for (unsigned int i = 0; i < sc->stts_count; i++)
+        if (!sc->stts_data[i].count)
+            return 0;
+    for (unsigned int i = 1; i < sc->stsc_count; i++)
+        if (sc->stsc_data[i].first <= sc->stsc_data[i - 1].first)
+            return 0;
+    for (unsigned int i = 1; i < sc->keyframe_count; i++)
+        if (sc->keyframes[i] <= sc->keyframes[i - 1])
+            return 0;
+    for (unsigned int i = 1; i < sc->stps_count; i++)
+        if (sc->stps_data[i] <= sc->stps_data[i - 1])
+            return 0;
+
+    return 1;
+}
+
+static int mov_lazy_index_key_off(const MOVStreamContext *sc)
+{
+    return (sc->keyframe_count && sc->keyframes[0] > 0) || (sc->stps_count && sc->stps_data[0] > 0);
+}
+
+/* Index of the first table entry >= value, or count */
+static unsigned int mov_lazy_index_lower_bound(const unsigned int *table, unsigned int count,
+                                               int64_t value)
+{
+    unsigned int lo = 0, hi = count;
+
+    while (lo < hi) {
+        unsigned int mid = lo + (hi - lo) / 2;
+        if (table[mid] < value)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+    return lo;
+}
+
+/* Make the cursor point to the first sample of the first non-empty chunk from cur->chunk on */
+static void mov_lazy_index_enter_chunk(MOVContext *mov, MOVStreamContext *sc, MOVIndexCursor *cur)
+{
+    cur->chunk_sample = 0;
+    for (; cur->chunk < sc->chunk_count; cur->chunk++) {
+        while (mov_stsc_index_valid(cur->stsc_index, sc->stsc_count) &&
+               cur->chunk + 1 >= sc->stsc_data[cur->stsc_index + 1].first)
+            cur->stsc_index++;
+        cur->offset = sc->chunk_offsets[cur->chunk];
+        if (sc->stsc_data[cur->stsc_index].count) {
+            mov_check_stsz_sample_size(mov, sc, cur->chunk, cur->stsc_index);
+            break;
+        }
+    }
+}
+
+/* Compute the cursor of the given sample from the tables */
+static void mov_lazy_index_locate(MOVContext *mov, AVStream *st, unsigned int sample,
+                                  MOVIndexCursor *cur)
+{
+    MOVStreamContext *sc = st->priv_data;
+    int key_off = mov_lazy_index_key_off(sc);
+    int64_t remaining = sample, first_sample = 0;
+    unsigned int i;
+
+    *cur = sc->lazy.start;
+    if (!sample)
+        return;
+    cur->sample = sample;
+
+    for (i = 0; i + 1 < sc->stts_count && remaining >= sc->stts_data[i].count; i++) {
+        remaining -= sc->stts_data[i].count;
+        cur->dts  += sc->stts_data[i].count * (int64_t)sc->stts_data[i].duration;
+    }
+    cur->stts_index  = i;
+    cur->stts_sample = remaining;
+    cur->dts        += remaining * sc->stts_data[i].duration;
+
+    for (i = 0; i < sc->stsc_count; i++) {
+        int64_t samples = mov_get_stsc_samples(sc, i);
+        if (sample - first_sample < samples || !mov_stsc_index_valid(i, sc->stsc_count))
+            break;
+        first_sample += samples;
+    }
+    cur->stsc_index = i;
+    if (!sc->stsc_data[i].count ||
+        sc->stsc_data[i].first - 1 + (sample - first_sample) / sc->stsc_data[i].count >= sc->chunk_count) {
+        cur->chunk = sc->chunk_count;
+        return;
+    }
+    cur->chunk        = sc->stsc_data[i].first - 1 + (sample - first_sample) / sc->stsc_data[i].count;
+    cur->chunk_sample = (sample - first_sample) % sc->stsc_data[i].count;
+    mov_check_stsz_sample_size(mov, sc, cur->chunk, cur->stsc_index);
+    cur->offset = sc->chunk_offsets[cur->chunk];
+    if (sc->stsz_sample_size > 0)
+        cur->offset += cur->chunk_sample * (int64_t)sc->stsz_sample_size;
+    else
+        for (unsigned int k = sample - cur->chunk_sample; k < sample; k++)
+            cur->offset += sc->sample_sizes[k];
+
+    if (sc->keyframe_count) {
+        unsigned int idx = mov_lazy_index_lower_bound((const unsigned int *)sc->keyframes,
+                                                      sc->keyframe_count, sample + key_off);
+        cur->stss_index = FFMIN(idx, sc->keyframe_count - 1);
+        cur->distance   = idx ? sample - (sc->keyframes[idx - 1] - key_off) : sample;
+    } else if (sc->keyframe_absent && st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO) {
+        cur->distance   = sample;
+    } else {
+        cur->distance   = 1;
+    }
+    if (sc->stps_count) {
+        unsigned int idx = mov_lazy_index_lower_bound(sc->stps_data, sc->stps_count, sample + key_off);
+        cur->stps_index = FFMIN(idx, sc->stps_count - 1);
+    }
+}
+
+/* Fill the index entry of the sample the cursor points to and advance it */
+static int mov_lazy_index_next(MOVContext *mov, AVStream *st, MOVIndexCursor *cur, AVIndexEntry *e)
+{
+    MOVStreamContext *sc = st->priv_data;
+    int key_off = mov_lazy_index_key_off(sc);
+    unsigned int sample_size;
+    int keyframe = 0;
+
+    if (cur->sample >= sc->lazy.nb_samples || cur->chunk >= sc->chunk_count)
+        return AVERROR_EOF;
+
+    if (!sc->keyframe_absent && (!sc->keyframe_count || cur->sample + key_off == sc->keyframes[cur->stss_index])) {
+        keyframe = 1;
+        if (cur->stss_index + 1 < sc->keyframe_count)
+            cur->stss_index++;
+    } else if (sc->stps_count && cur->sample + key_off == sc->stps_data[cur->stps_index]) {
+        keyframe = 1;
+        if (cur->stps_index + 1 < sc->stps_count)
+            cur->stps_index++;
+    }
+    if (sc->keyframe_absent && !sc->stps_count &&
+        (st->codecpar->codec_type == AVMEDIA_TYPE_AUDIO || (!cur->chunk && !cur->chunk_sample)))
+        keyframe = 1;
+    if (keyframe)
+        cur->distance = 0;
+
+    sample_size = sc->stsz_sample_size > 0 ? sc->stsz_sample_size : sc->sample_sizes[cur->sample];
+    if (sample_size > 0x3FFFFFFF) {
+        av_log(mov->fc, AV_LOG_ERROR, "Sample size %u is too large\n", sample_size);
+        return AVERROR_INVALIDDATA;
+    }
+    e->pos          = cur->offset;
+    e->timestamp    = cur->dts;
+    e->size         = sample_size;
+    e->min_distance = cur->distance;
+    e->flags        = keyframe ? AVINDEX_KEYFRAME : 0;
+
+    cur->offset += sample_size;
+    cur->dts    += sc->stts_data[cur->stts_index].duration;
+    cur->distance++;
+    cur->sample++;
+    cur->stts_sample++;
+    if (cur->stts_index + 1 < sc->stts_count && cur->stts_sample == sc->stts_data[cur->stts_index].count) {
+        cur->stts_sample = 0;
+        cur->stts_index++;
+    }
+    if (++cur->chunk_sample >= sc->stsc_data[cur->stsc_index].count) {
+        cur->chunk++;
+        mov_lazy_index_enter_chunk(mov, sc, cur);
+    }
+    return 0;
+}
+
+/* Rebuild the window of index entries so that it starts at the given sample */
+static void mov_lazy_index_fill(MOVContext *mov, AVStream *st, unsigned int sample)
+{
+    MOVStreamContext *sc = st->priv_data;
+    FFStream *const sti = ffstream(st);
+    MOVIndexCursor cur;
+
+    if (sample == sc->lazy.next.sample)
+        cur = sc->lazy.next;
+    else
+        mov_lazy_index_locate(mov, st, sample, &cur);
+
+    sc->lazy.base = sample;
+    sti->nb_index_entries = 0;
+    while (sti->nb_index_entries < MOV_LAZY_INDEX_WINDOW &&
+           mov_lazy_index_next(mov, st, &cur, &sti->index_entries[sti->nb_index_entries]) >= 0)
+        sti->nb_index_entries++;
+    sc->lazy.next = cur;
+}
+
+static int mov_lazy_index_init(MOVContext *mov, AVStream *st, int64_t first_dts)
+{
+    MOVStreamContext *sc = st->priv_data;
+    FFStream *const sti = ffstream(st);
+    int64_t nb_samples = 0;
+
+    for (unsigned int i = 0; i < sc->stsc_count; i++)
+        nb_samples += mov_get_stsc_samples(sc, i);
+
+    av_freep(&sti->index_entries);
+    sti->index_entries = av_malloc_array(MOV_LAZY_INDEX_WINDOW, sizeof(*sti->index_entries));
+    if (!sti->index_entries)
+        return AVERROR(ENOMEM);
+    sti->index_entries_allocated_size = MOV_LAZY_INDEX_WINDOW * sizeof(*sti->index_entries);
+
+    sc->lazy.enabled    = 1;
+    sc->lazy.nb_samples = FFMIN(nb_samples, sc->sample_count);
+    memset(&sc->lazy.start, 0, sizeof(sc->lazy.start));
+    sc->lazy.start.dts  = first_dts;
+    mov_lazy_index_enter_chunk(mov, sc, &sc->lazy.start);
+    sc->lazy.next = sc->lazy.start;
+    mov_lazy_index_fill(mov, st, 0);
+
+    if (st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO)
+        for (int i = 0; i < sti->nb_index_entries && i < 100; i++)
+            ff_rfps_add_frame(mov->fc, st, sti->index_entries[i].timestamp);
+
+    av_log(mov->fc, AV_LOG_DEBUG, "stream %d: lazy index of %u samples\n",
+           st->index, sc->lazy.nb_samples);
+    return 0;
+}
+
+/* Replace the window with the full index, e.g. when fragments add samples */
+static int mov_lazy_index_materialize(MOVContext *mov, AVStream *st)
+{
+    MOVStreamContext *sc = st->priv_data;
+    FFStream *const sti = ffstream(st);
+    MOVIndexCursor cur = sc->lazy.start;
+    AVIndexEntry *entries;
+    int nb_entries = 0;
+
+    if (sc->lazy.nb_samples >= UINT_MAX / sizeof(*entries))
+        return AVERROR(ENOMEM);
+    entries = av_malloc_array(FFMAX(sc->lazy.nb_samples, 1), sizeof(*entries));
+    if (!entries)
+        return AVERROR(ENOMEM);
+    while (mov_lazy_index_next(mov, st, &cur, &entries[nb_entries]) >= 0)
+        nb_entries++;
+
+    av_free(sti->index_entries);
+    sti->index_entries = entries;
+    sti->nb_index_entries = nb_entries;
+    sti->index_entries_allocated_size = FFMAX(sc->lazy.nb_samples, 1) * sizeof(*entries);
+    sc->lazy.enabled = 0;
+
+    if (sc->ctts_data)
+        return mov_expand_ctts(sc);
+    return 0;
+}
+
+/**
+ * Get the index entry of a sample, loading it with lazy_index.
+ * The returned pointer is only valid until the next call for the same stream.
+ */
+static AVIndexEntry *mov_get_index_entry(MOVContext *mov, AVStream *st, int64_t sample)
+{
+    MOVStreamContext *sc = st->priv_data;
+    FFStream *const sti = ffstream(st);
+
+    if (!sc->lazy.enabled)
+        return sample >= 0 && sample < sti->nb_index_entries ? &sti->index_entries[sample] : NULL;
+
+    if (sample < 0 || sample >= sc->lazy.nb_samples)
+        return NULL;
+    if (sample < sc->lazy.base || sample >= sc->lazy.base + sti->nb_index_entries)
+        mov_lazy_index_fill(mov, st, sample);
+    if (sample >= sc->lazy.base + sti->nb_index_entries)
+        return NULL;
+    return &sti->index_entries[sample - sc->lazy.base];
+}
+
+/* av_index_search_timestamp() working on the sample tables */
+static int mov_lazy_index_search_timestamp(AVStream *st, int64_t wanted_timestamp, int flags)
+{
+    MOVStreamContext *sc = st->priv_data;
+    int backward = flags & AVSEEK_FLAG_BACKWARD;
+    int key_off = mov_lazy_index_key_off(sc);
+    int64_t dts = sc->lazy.start.dts;
+    int64_t first = 0, m = -1;
+
+    for (unsigned int i = 0; i < sc->stts_count && first < sc->lazy.nb_samples; i++) {
+        int64_t count = i + 1 < sc->stts_count ? sc->stts_data[i].count : sc->lazy.nb_samples - first;
+        int64_t duration = sc->stts_data[i].duration;
+        int64_t last_dts;
+
+        count = FFMIN(count, sc->lazy.nb_samples - first);
+        last_dts = dts + (count - 1) * duration;
+        if (backward) {
+            if (wanted_timestamp < dts)
+                break;
+            m = first + (duration ? FFMIN(count - 1, (wanted_timestamp - dts) / duration) : count - 1);
+        } else if (last_dts >= wanted_timestamp) {
+            m = first + (wanted_timestamp <= dts ? 0 : (wanted_timestamp - dts + duration - 1) / duration);
+            break;
+        }
+        first += count;
+        dts   += count * duration;
+    }
+    if (m < 0 || (flags & AVSEEK_FLAG_ANY))
+        return m;
+
+    if (sc->keyframe_count || sc->stps_count) {
+        int64_t key = -1;
+        if (sc->keyframe_count && !sc->keyframe_absent) {
+            unsigned int idx = mov_lazy_index_lower_bound((const unsigned int *)sc->keyframes,
+                                                          sc->keyframe_count, m + key_off);
+            if (backward && (idx < sc->keyframe_count && sc->keyframes[idx] == m + key_off))
+                key = m;
+            else if (backward)
+                key = idx ? sc->keyframes[idx - 1] - key_off : -1;
+            else
+                key = idx < sc->keyframe_count ? sc->keyframes[idx] - key_off : -1;
+        }
+        if (sc->stps_count) {
+            unsigned int idx = mov_lazy_index_lower_bound(sc->stps_data, sc->stps_count, m + key_off);
+            int64_t stps_key;
+            if (backward && (idx < sc->stps_count && sc->stps_data[idx] == m + key_off))
+                stps_key = m;
+            else if (backward)
+                stps_key = idx ? sc->stps_data[idx - 1] - key_off : -1;
+            else
+                stps_key = idx < sc->stps_count ? sc->stps_data[idx] - key_off : -1;
+            if (stps_key >= 0 && (key < 0 || (backward ? stps_key > key : stps_key < key)))
+                key = stps_key;
+        }
+        return key < sc->lazy.nb_samples ? key : -1;
+    }
+    if (sc->keyframe_absent && st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO)
+        return backward || !m ? 0 : -1;
+    return m;
+}
+
+/**
+ * Get the smallest pts relative to start_time of the samples presented by a
+ * single edit, as mov_fix_index() computes min_corrected_pts.
+ */
+static int64_t mov_lazy_index_min_pts(MOVStreamContext *sc, int64_t start_time, int64_t duration)
+{
+    int64_t dts = 0, min_pts = INT64_MAX;
+    unsigned int stts_index = 0, stts_sample = 0, ctts_index = 0, ctts_sample = 0;
+
+    for (unsigned int i = 0; i < sc->sample_count && stts_index < sc->stts_count; i++) {
+        int64_t cts = dts + sc->dts_shift;
+
+        /* the pts are not smaller than the dts, so no later sample can be earlier */
+        if (cts - start_time >= min_pts)
+            break;
+        if (sc->ctts_data && ctts_index < sc->ctts_count) {
+            cts += sc->ctts_data[ctts_index].duration;
+            if (++ctts_sample == sc->ctts_data[ctts_index].count) {
+                ctts_index++;
+                ctts_sample = 0;
+            }
+        }
+        if (cts >= start_time && (duration <= 0 || cts < start_time + duration))
+            min_pts = FFMIN(min_pts, cts - start_time);
+
+        dts += sc->stts_data[stts_index].duration;
+        if (++stts_sample == sc->stts_data[stts_index].count) {
+            stts_index++;
+            stts_sample = 0;
+        }
+    }
+    return min_pts == INT64_MAX ? 0 : min_pts;
+}
+
 static void mov_build_index(MOVContext *mov, AVStream *st)
 {
     MOVStreamContext *sc = st->priv_data;
@@ -4037,8 +4472,8 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
     unsigned int stps_index = 0;
     unsigned int i, j;
     uint64_t stream_size = 0;
-    MOVCtts *ctts_data_old = sc->ctts_data;
-    unsigned int ctts_count_old = sc->ctts_count;
+    int lazy = mov_lazy_index_eligible(mov, st);
+    int advanced_editlist = mov->advanced_editlist;
 
     int ret = build_open_gop_key_points(st);
     if (ret < 0)
@@ -4048,6 +4483,7 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
         int i, edit_start_index = 0, multiple_edits = 0;
         int64_t empty_duration = 0; // empty duration of the first edit list entry
         int64_t start_time = 0; // start time of the media
+        int64_t edit_duration = 0;
 
         for (i = 0; i < sc->elst_count; i++) {
             const MOVElst *e = &sc->elst_data[i];
@@ -4058,11 +4494,30 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
                 edit_start_index = 1;
             } else if (i == edit_start_index && e->time >= 0) {
                 start_time = e->time;
+                edit_duration = e->duration;
             } else {
                 multiple_edits = 1;
             }
         }
 
+        /* A single edit is applied to the timestamps without rewriting
+         * the index, like when advanced_editlist is disabled. */
+        if (multiple_edits)
+            lazy = 0;
+        if (lazy && mov->time_scale > 0) {
+            advanced_editlist = 0;
+            /* set the start time, the duration and the pts offset as mov_fix_index() would */
+            st->start_time = av_rescale(empty_duration, sc->time_scale, mov->time_scale);
+            sc->min_corrected_pts = mov_lazy_index_min_pts(sc, start_time,
+                                                           av_rescale(edit_duration, sc->time_scale, mov->time_scale)) -
+                                    st->start_time;
+            if (edit_duration > 0)
+                st->duration = FFMIN(st->duration,
+                                     av_rescale(empty_duration + edit_duration, sc->time_scale, mov->time_scale));
+        } else {
+            lazy = 0;
+        }
+
         if (multiple_edits && !mov->advanced_editlist)
             av_log(mov->fc, AV_LOG_WARNING, "multiple edit list entries, "
                    "Use -advanced_editlist to correctly decode otherwise "
@@ -4077,12 +4532,13 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
                 av_log(mov->fc, AV_LOG_WARNING, "start_time - empty_duration is not representable\n");
 
             sc->time_offset = start_time -  (uint64_t)empty_duration;
-            sc->min_corrected_pts = start_time;
-            if (!mov->advanced_editlist)
+            if (!lazy)
+                sc->min_corrected_pts = start_time;
+            if (!advanced_editlist)
                 current_dts = -sc->time_offset;
         }
 
-        if (!multiple_edits && !mov->advanced_editlist &&
+        if (!multiple_edits && !advanced_editlist &&
             st->codecpar->codec_id == AV_CODEC_ID_AAC && start_time > 0)
             sc->start_pad = start_time;
     }
@@ -4103,6 +4559,16 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
 
         if (!sc->sample_count || sti->nb_index_entries)
             return;
+        /* mov_fix_index() makes the first video pts zero */
+        if (lazy && st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && sc->min_corrected_pts > 0)
+            current_dts -= sc->min_corrected_pts;
+        if (lazy && mov_lazy_index_init(mov, st, current_dts) >= 0) {
+            stream_size = sc->stsz_sample_size > 0 ?
+                          (uint64_t)sc->stsz_sample_size * sc->sample_count : sc->data_size;
+            if (st->duration > 0)
+                st->codecpar->bit_rate = stream_size*8*sc->time_scale/st->duration;
+            goto done;
+        }
         if (sc->sample_count >= UINT_MAX / sizeof(*sti->index_entries) - sti->nb_index_entries)
             return;
         if (av_reallocp_array(&sti->index_entries,
@@ -4113,47 +4579,16 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
         }
         sti->index_entries_allocated_size = (sti->nb_index_entries + sc->sample_count) * sizeof(*sti->index_entries);
 
-        if (ctts_data_old) {
-            // Expand ctts entries such that we have a 1-1 mapping with samples
-            if (sc->sample_count >= UINT_MAX / sizeof(*sc->ctts_data))
-                return;
-            sc->ctts_count = 0;
-            sc->ctts_allocated_size = 0;
-            sc->ctts_data = av_fast_realloc(NULL, &sc->ctts_allocated_size,
-                                    sc->sample_count * sizeof(*sc->ctts_data));
-            if (!sc->ctts_data) {
-                av_free(ctts_data_old);
-                return;
-            }
-
-            memset((uint8_t*)(sc->ctts_data), 0, sc->ctts_allocated_size);
-
-            for (i = 0; i < ctts_count_old &&
-                        sc->ctts_count < sc->sample_count; i++)
-                for (j = 0; j < ctts_data_old[i].count &&
-                            sc->ctts_count < sc->sample_count; j++)
-                    add_ctts_entry(&sc->ctts_data, &sc->ctts_count,
-                                   &sc->ctts_allocated_size, 1,
-                                   ctts_data_old[i].duration);
-            av_free(ctts_data_old);
-        }
+        if (sc->ctts_data && mov_expand_ctts(sc) < 0)
+            return;
 
         for (i = 0; i < sc->chunk_count; i++) {
-            int64_t next_offset = i+1 < sc->chunk_count ? sc->chunk_offsets[i+1] : INT64_MAX;
             current_offset = sc->chunk_offsets[i];
             while (mov_stsc_index_valid(stsc_index, sc->stsc_count) &&
                 i + 1 == sc->stsc_data[stsc_index + 1].first)
                 stsc_index++;
 
-            if (next_offset > current_offset && sc->sample_size>0 && sc->sample_size < sc->stsz_sample_size &&
-                sc->stsc_data[stsc_index].count * (int64_t)sc->stsz_sample_size > next_offset - current_offset) {
-                av_log(mov->fc, AV_LOG_WARNING, "STSZ sample size %d invalid (too large), ignoring\n", sc->stsz_sample_size);
-                sc->stsz_sample_size = sc->sample_size;
-            }
-            if (sc->stsz_sample_size>0 && sc->stsz_sample_size < sc->sample_size) {
-                av_log(mov->fc, AV_LOG_WARNING, "STSZ sample size %d invalid (too small), ignoring\n", sc->stsz_sample_size);
-                sc->stsz_sample_size = sc->sample_size;
-            }
+            mov_check_stsz_sample_size(mov, sc, i, stsc_index);
 
             for (j = 0; j < sc->stsc_data[stsc_index].count; j++) {
                 int keyframe = 0;
@@ -4330,6 +4765,7 @@ static void mov_build_index(MOVContext *mov, AVStream *st)
         mov_fix_index(mov, st);
     }
 
+done:
     // Update start time of the stream.
     if (st->start_time == AV_NOPTS_VALUE && st->codecpar->codec_type == AVMEDIA_TYPE_VIDEO && sti->nb_index_entries > 0) {
         st->start_time = sti->index_entries[0].timestamp + sc->dts_shift;
@@ -4583,12 +5019,14 @@ static int mov_read_trak(MOVContext *c, AVIOContext *pb, MOVAtom atom)
         && sc->time_scale == st->codecpar->sample_rate) {
             ffstream(st)->need_parsing = AVSTREAM_PARSE_FULL;
     }
-    /* Do not need those anymore. */
-    av_freep(&sc->chunk_offsets);
-    av_freep(&sc->sample_sizes);
-    av_freep(&sc->keyframes);
-    av_freep(&sc->stts_data);
-    av_freep(&sc->stps_data);
+    /* Do not need those anymore, unless the index is built from them on demand. */
+    if (!sc->lazy.enabled) {
+        av_freep(&sc->chunk_offsets);
+        av_freep(&sc->sample_sizes);
+        av_freep(&sc->keyframes);
+        av_freep(&sc->stts_data);
+        av_freep(&sc->stps_data);
+    }
     av_freep(&sc->elst_data);
     av_freep(&sc->rap_group);
     av_freep(&sc->sync_group);
@@ -5080,7 +5518,7 @@ static int mov_read_trun(MOVContext *c, AVIOContext *pb, MOVAtom atom)
     int64_t dts, pts = AV_NOPTS_VALUE;
     int data_offset = 0;
     unsigned entries, first_sample_flags = frag->flags;
-    int flags, distance, i;
+    int flags, distance, i, ret;
     int64_t prev_dts = AV_NOPTS_VALUE;
     int next_frag_index = -1, index_entry_pos;
     size_t requested_size;
@@ -5108,6 +5546,9 @@ static int mov_read_trun(MOVContext *c, AVIOContext *pb, MOVAtom atom)
     if (sc->pseudo_stream_id+1 != frag->stsd_id && sc->pseudo_stream_id != -1)
         return 0;
 
+    if (sc->lazy.enabled && (ret = mov_lazy_index_materialize(c, st)) < 0)
+        return ret;
+
     // Find the next frag_index index that has a valid index_entry for
     // the current track_id.
     //
@@ -8633,10 +9074,9 @@ static AVIndexEntry *mov_find_next_sample(AVFormatContext *s, AVStream **st)
     int i;
     for (i = 0; i < s->nb_streams; i++) {
         AVStream *avst = s->streams[i];
-        FFStream *const avsti = ffstream(avst);
         MOVStreamContext *msc = avst->priv_data;
-        if (msc->pb && msc->current_sample < avsti->nb_index_entries) {
-            AVIndexEntry *current_sample = &avsti->index_entries[msc->current_sample];
+        AVIndexEntry *current_sample = msc->pb ? mov_get_index_entry(s->priv_data, avst, msc->current_sample) : NULL;
+        if (current_sample) {
             int64_t dts = av_rescale(current_sample->timestamp, AV_TIME_BASE, msc->time_scale);
             av_log(s, AV_LOG_TRACE, "stream %d, sample %d, dts %"PRId64"\n", i, msc->current_sample, dts);
             if (!sample || (!(s->pb->seekable & AVIO_SEEKABLE_NORMAL) && current_sample->pos < sample->pos) ||
@@ -8839,8 +9279,14 @@ static int mov_read_packet(AVFormatContext *s, AVPacket *pkt)
             sc->ctts_sample = 0;
         }
     } else {
-        int64_t next_dts = (sc->current_sample < ffstream(st)->nb_index_entries) ?
-            ffstream(st)->index_entries[sc->current_sample].timestamp : st->duration;
+        int64_t next_index = sc->current_sample - (sc->lazy.enabled ? sc->lazy.base : 0);
+        int64_t next_dts = (next_index < ffstream(st)->nb_index_entries) ?
+            ffstream(st)->index_entries[next_index].timestamp : st->duration;
+
+        /* the next sample of a lazy index may be just past the window */
+        if (sc->lazy.enabled && next_index == ffstream(st)->nb_index_entries &&
+            sc->current_sample < sc->lazy.nb_samples)
+            next_dts = sc->lazy.next.dts;
 
         if (next_dts >= pkt->dts)
             pkt->duration = next_dts - pkt->dts;
@@ -8922,10 +9368,9 @@ static int is_open_key_sample(const MOVStreamContext *sc, int sample)
  * Some key sample may be key frames but not IDR frames, so a random access to
  * them may not be allowed.
  */
-static int can_seek_to_key_sample(AVStream *st, int sample, int64_t requested_pts)
+static int can_seek_to_key_sample(MOVContext *mov, AVStream *st, int sample, int64_t requested_pts)
 {
     MOVStreamContext *sc = st->priv_data;
-    FFStream *const sti = ffstream(st);
     int64_t key_sample_dts, key_sample_pts;
 
     if (st->codecpar->codec_id != AV_CODEC_ID_HEVC)
@@ -8934,7 +9379,7 @@ static int can_seek_to_key_sample(AVStream *st, int sample, int64_t requested_pt
     if (sample >= sc->sample_offsets_count)
         return 1;
 
-    key_sample_dts = sti->index_entries[sample].timestamp;
+    key_sample_dts = mov_get_index_entry(mov, st, sample)->timestamp;
     key_sample_pts = key_sample_dts + sc->sample_offsets[sample] + sc->dts_shift;
 
     /*
@@ -8950,6 +9395,7 @@ static int can_seek_to_key_sample(AVStream *st, int sample, int64_t requested_pt
 
 static int mov_seek_stream(AVFormatContext *s, AVStream *st, int64_t timestamp, int flags)
 {
+    MOVContext *mov = s->priv_data;
     MOVStreamContext *sc = st->priv_data;
     FFStream *const sti = ffstream(st);
     int sample, time_sample, ret;
@@ -8964,14 +9410,20 @@ static int mov_seek_stream(AVFormatContext *s, AVStream *st, int64_t timestamp,
         return ret;
 
     for (;;) {
-        sample = av_index_search_timestamp(st, timestamp, flags);
+        if (sc->lazy.enabled) {
+            sample = mov_lazy_index_search_timestamp(st, timestamp, flags);
+            if (sample < 0 && timestamp < sc->lazy.start.dts)
+                sample = 0;
+        } else {
+            sample = av_index_search_timestamp(st, timestamp, flags);
+            if (sample < 0 && sti->nb_index_entries && timestamp < sti->index_entries[0].timestamp)
+                sample = 0;
+        }
         av_log(s, AV_LOG_TRACE, "stream %d, timestamp %"PRId64", sample %d\n", st->index, timestamp, sample);
-        if (sample < 0 && sti->nb_index_entries && timestamp < sti->index_entries[0].timestamp)
-            sample = 0;
         if (sample < 0) /* not sure what to do */
             return AVERROR_INVALIDDATA;
 
-        if (!sample || can_seek_to_key_sample(st, sample, timestamp))
+        if (!sample || can_seek_to_key_sample(mov, st, sample, timestamp))
             break;
         timestamp -= FFMAX(sc->min_sample_duration, 1);
     }
@@ -9010,12 +9462,12 @@ static int mov_seek_stream(AVFormatContext *s, AVStream *st, int64_t timestamp,
     return sample;
 }
 
-static int64_t mov_get_skip_samples(AVStream *st, int sample)
+static int64_t mov_get_skip_samples(MOVContext *mov, AVStream *st, int sample)
 {
     MOVStreamContext *sc = st->priv_data;
     FFStream *const sti = ffstream(st);
-    int64_t first_ts = sti->index_entries[0].timestamp;
-    int64_t ts = sti->index_entries[sample].timestamp;
+    int64_t first_ts = sc->lazy.enabled ? sc->lazy.start.dts : sti->index_entries[0].timestamp;
+    int64_t ts = mov_get_index_entry(mov, st, sample)->timestamp;
     int64_t off;
 
     if (st->codecpar->codec_type != AVMEDIA_TYPE_AUDIO)
@@ -9046,8 +9498,8 @@ static int mov_read_seek(AVFormatContext *s, int stream_index, int64_t sample_ti
 
     if (mc->seek_individually) {
         /* adjust seek timestamp to found sample timestamp */
-        int64_t seek_timestamp = sti->index_entries[sample].timestamp;
-        sti->skip_samples = mov_get_skip_samples(st, sample);
+        int64_t seek_timestamp = mov_get_index_entry(mc, st, sample)->timestamp;
+        sti->skip_samples = mov_get_skip_samples(mc, st, sample);
 
         for (i = 0; i < s->nb_streams; i++) {
             AVStream *const st  = s->streams[i];
@@ -9060,7 +9512,7 @@ static int mov_read_seek(AVFormatContext *s, int stream_index, int64_t sample_ti
             timestamp = av_rescale_q(seek_timestamp, s->streams[stream_index]->time_base, st->time_base);
             sample = mov_seek_stream(s, st, timestamp, flags);
             if (sample >= 0)
-                sti->skip_samples = mov_get_skip_samples(st, sample);
+                sti->skip_samples = mov_get_skip_samples(mc, st, sample);
         }
     } else {
         for (i = 0; i < s->nb_streams; i++) {
@@ -9096,6 +9548,10 @@ static const AVOption mov_options[] = {
         0, 1, FLAGS},
     {"ignore_editlist", "Ignore the edit list atom.", OFFSET(ignore_editlist), AV_OPT_TYPE_BOOL, {.i64 = 0},
         0, 1, FLAGS},
+    {"lazy_index",
+        "Build the index entries from the sample tables on demand instead of all at once when opening.",
+        OFFSET(lazy_index), AV_OPT_TYPE_BOOL, {.i64 = 0},
+        0, 1, FLAGS},
     {"advanced_editlist",
         "Modify the AVIndex according to the editlists. Use this option to decode in the order specified by the edits.",
         OFFSET(advanced_editlist), AV_OPT_TYPE_BOOL, {.i64 = 1},
@@ -6120,7 +6120,7 @@ int ff_mov_write_packet(AVFormatContext *s, AVPacket *pkt)
             return size;
         else if (!size)
             goto end;
-        avio_write(pb, pkt->data, size);
+        avio_write_buffer_ref(pb, pkt->buf, pkt->data, size);
     } else if (par->codec_id == AV_CODEC_ID_EIA_608) {
         size = 8;
 
@@ -6153,7 +6153,7 @@ int ff_mov_write_packet(AVFormatContext *s, AVPacket *pkt)
                 goto err;
             }
         } else {
-            avio_write(pb, pkt->data, size);
+            avio_write_buffer_ref(pb, pkt->buf, pkt->data, size);
         }
     }
 
@@ -2905,25 +2905,41 @@ static int mpegts_resync(AVFormatContext *s, int seekback, const uint8_t *curren
 
     avio_seek(pb, -back, SEEK_CUR);
 
-    for (i = 0; i < ts->resync_size; i++) {
-        c = avio_r8(pb);
-        if (avio_feof(pb))
-            return AVERROR_EOF;
-        if (c == 0x47) {
-            int new_packet_size, ret;
-            avio_seek(pb, -1, SEEK_CUR);
-            pos = avio_tell(pb);
-            ret = ffio_ensure_seekback(pb, PROBE_PACKET_MAX_BUF);
-            if (ret < 0)
-                return ret;
-            new_packet_size = get_packet_size(s);
-            if (new_packet_size > 0 && new_packet_size != ts->raw_packet_size) {
-                av_log(ts->stream, AV_LOG_WARNING, "changing packet size to %d\n", new_packet_size);
-                ts->raw_packet_size = new_packet_size;
+    for (i = 0; i < ts->resync_size;) {
+        int new_packet_size, ret, len;
+
+        /* search the buffered data at once, memchr() is vectorized by
+         * the C library; only refill the buffer byte by byte */
+        len = FFMIN(pb->buf_end - pb->buf_ptr, ts->resync_size - i);
+        if (len > 0) {
+            const uint8_t *sync = memchr(pb->buf_ptr, 0x47, len);
+            if (!sync) {
+                avio_skip(pb, len);
+                i += len;
+                continue;
             }
-            avio_seek(pb, pos, SEEK_SET);
-            return 0;
+            avio_skip(pb, sync - pb->buf_ptr);
+        } else {
+            c = avio_r8(pb);
+            if (avio_feof(pb))
+                return AVERROR_EOF;
+            i++;
+            if (c != 0x47)
+                continue;
+            avio_seek(pb, -1, SEEK_CUR);
+        }
+
+        pos = avio_tell(pb);
+        ret = ffio_ensure_seekback(pb, PROBE_PACKET_MAX_BUF);
+        if (ret < 0)
+            return ret;
+        new_packet_size = get_packet_size(s);
+        if (new_packet_size > 0 && new_packet_size != ts->raw_packet_size) {
+            av_log(ts->stream, AV_LOG_WARNING, "changing packet size to %d\n", new_packet_size);
+            ts->raw_packet_size = new_packet_size;
         }
+        avio_seek(pb, pos, SEEK_SET);
+        return 0;
     }
     av_log(s, AV_LOG_ERROR,
            "max resync size reached, could not find sync byte\n");
@@ -3435,6 +3451,7 @@ const AVInputFormat ff_mpegts_demuxer = {
     .read_close     = mpegts_read_close,
     .read_timestamp = mpegts_get_dts,
     .flags          = AVFMT_SHOW_IDS | AVFMT_TS_DISCONT,
+    .flags_internal = FF_FMT_INDEX_CACHE | FF_FMT_INDEX_CACHE_GENERIC,
     .priv_class     = &mpegts_class,
 };
 
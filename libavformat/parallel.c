@@ -0,0 +1,485 @@
+/*
+ * Parallel range download protocol
+ *
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+/**
+ * @file
+ * Split a seekable input of known size into fixed-size chunks and fetch
+ * the chunks ahead of the read position over several connections at once.
+ *
+ * The chunks form a window starting at the chunk holding the read
+ * position. Each slot of the window is reassigned when the read position
+ * moves past it or a seek moves the window; a worker fetching a chunk that
+ * got reassigned in the meantime drops its data. Every chunk is requested
+ * with its own byte range, so HTTP inputs should be combined with the
+ * connection pool to avoid a TCP handshake per chunk.
+ */
+
+#include "libavutil/avstring.h"
+#include "libavutil/common.h"
+#include "libavutil/dict.h"
+#include "libavutil/error.h"
+#include "libavutil/log.h"
+#include "libavutil/mem.h"
+#include "libavutil/opt.h"
+#include "libavutil/thread.h"
+#include "url.h"
+
+#define READ_SIZE   (64 * 1024)
+#define MAX_RETRIES 3
+
+typedef struct Chunk {
+    int64_t  start;         ///< offset of the chunk in the input, -1 if unused
+    int      size;
+    int      filled;        ///< bytes available from start
+    int      busy;          ///< a worker is fetching the chunk
+    int      retries;
+    int      error;
+    unsigned generation;    ///< bumped whenever the slot is reassigned
+    uint8_t *data;
+} Chunk;
+
+typedef struct ParallelContext {
+    AVClass        *class;
+    URLContext     *inner;          ///< only used when passing through
+    char           *url;
+    AVDictionary   *inner_options;
+
+    int64_t         logical_pos;
+    int64_t         logical_size;
+
+    Chunk          *chunks;
+    int             nb_chunks;
+
+    pthread_t      *workers;
+    int             nb_workers;
+    pthread_cond_t  cond;
+    pthread_mutex_t mutex;
+    int             threads_initialized;
+
+    int             abort_request;
+    AVIOInterruptCB interrupt_callback;
+
+    int             connections;
+    int             range_size;
+    int             readahead;
+} ParallelContext;
+
+static int parallel_check_interrupt(void *arg)
+{
+    URLContext      *h = arg;
+    ParallelContext *c = h->priv_data;
+
+    if (c->abort_request)
+        return 1;
+
+    if (ff_check_interrupt(&c->interrupt_callback))
+        c->abort_request = 1;
+
+    return c->abort_request;
+}
+
+/* Assign the slots to the chunks following the read position.
+ * Must be called with the mutex held. */
+static void update_window(ParallelContext *c)
+{
+    int64_t first = c->logical_pos / c->range_size;
+
+    for (int i = 0; i < c->nb_chunks; i++) {
+        int64_t n     = first + i;
+        Chunk  *chunk = &c->chunks[n % c->nb_chunks];
+        int64_t start = n * c->range_size;
+
+        if (start >= c->logical_size)
+            start = -1;
+        if (chunk->start == start)
+            continue;
+
+        chunk->start   = start;
+        chunk->size    = start < 0 ? 0 : FFMIN(c->range_size, c->logical_size - start);
+        chunk->filled  = 0;
+        chunk->busy    = 0;
+        chunk->retries = 0;
+        chunk->error   = 0;
+        chunk->generation++;
+    }
+}
+
+/* Pick the first chunk of the window nobody is fetching.
+ * Must be called with the mutex held. */
+static Chunk *next_chunk(ParallelContext *c)
+{
+    int64_t first = c->logical_pos / c->range_size;
+
+    for (int i = 0; i < c->nb_chunks; i++) {
+        Chunk *chunk = &c->chunks[(first + i) % c->nb_chunks];
+
+        if (chunk->start >= 0 && !chunk->busy && !chunk->error &&
+            chunk->filled < chunk->size)
+            return chunk;
+    }
+    return NULL;
+}
+
+static int open_range(URLContext *h, URLContext **inner, int64_t start, int64_t end)
+{
+    ParallelContext *c = h->priv_data;
+    AVIOInterruptCB  interrupt_callback = { .callback = parallel_check_interrupt, .opaque = h };
+    AVDictionary    *options = NULL;
+    int64_t pos;
+    int ret;
+
+    if ((ret = av_dict_copy(&options, c->inner_options, 0)) < 0 ||
+        (ret = av_dict_set_int(&options, "offset",     start, 0)) < 0 ||
+        (ret = av_dict_set_int(&options, "end_offset", end,   0)) < 0 ||
+        (ret = av_dict_set(&options, "connection_pool", "1", AV_DICT_DONT_OVERWRITE)) < 0 ||
+        (ret = av_dict_set_int(&options, "pool_max_idle", c->connections, AV_DICT_DONT_OVERWRITE)) < 0)
+        goto end;
+
+    ret = ffurl_open_whitelist(inner, c->url, AVIO_FLAG_READ, &interrupt_callback,
+                               &options, h->protocol_whitelist, h->protocol_blacklist, h);
+    if (ret < 0)
+        goto end;
+
+    /* protocols ignoring the offset option start at the beginning */
+    pos = ffurl_seek(*inner, 0, SEEK_CUR);
+    if (pos != start)
+        pos = ffurl_seek(*inner, start, SEEK_SET);
+    if (pos != start) {
+        ret = pos < 0 ? pos : AVERROR(EIO);
+        ffurl_closep(inner);
+    }
+
+end:
+    av_dict_free(&options);
+    return ret;
+}
+
+static void *parallel_worker(void *arg)
+{
+    URLContext      *h = arg;
+    ParallelContext *c = h->priv_data;
+    uint8_t *buf = av_malloc(READ_SIZE);
+
+    pthread_mutex_lock(&c->mutex);
+
+    while (buf && !c->abort_request) {
+        URLContext *inner = NULL;
+        Chunk *chunk = next_chunk(c);
+        unsigned generation;
+        int64_t pos, end;
+        int ret = 0;
+
+        if (!chunk) {
+            pthread_cond_wait(&c->cond, &c->mutex);
+            continue;
+        }
+
+        chunk->busy = 1;
+        generation  = chunk->generation;
+        pos         = chunk->start + chunk->filled;
+        end         = chunk->start + chunk->size;
+        pthread_mutex_unlock(&c->mutex);
+
+        ret = open_range(h, &inner, pos, end);
+
+        while (ret >= 0 && pos < end) {
+            ret = ffurl_read(inner, buf, FFMIN(READ_SIZE, end - pos));
+            if (ret == 0 || ret == AVERROR_EOF)
+                ret = AVERROR(EIO);
+            if (ret < 0)
+                break;
+
+            pthread_mutex_lock(&c->mutex);
+            if (chunk->generation != generation) {
+                pthread_mutex_unlock(&c->mutex);
+                break;
+            }
+            memcpy(chunk->data + chunk->filled, buf, ret);
+            chunk->filled += ret;
+            pos           += ret;
+            pthread_cond_broadcast(&c->cond);
+            pthread_mutex_unlock(&c->mutex);
+        }
+
+        ffurl_closep(&inner);
+
+        pthread_mutex_lock(&c->mutex);
+        if (chunk->generation != generation)
+            continue;
+        chunk->busy = 0;
+        if (ret < 0 && !c->abort_request) {
+            if (chunk->retries++ < MAX_RETRIES) {
+                av_log(h, AV_LOG_WARNING, "Retrying range at %"PRId64": %s\n",
+                       pos, av_err2str(ret));
+            } else {
+                av_log(h, AV_LOG_ERROR, "Failed to read range at %"PRId64": %s\n",
+                       pos, av_err2str(ret));
+                chunk->error = ret;
+            }
+        }
+        pthread_cond_broadcast(&c->cond);
+    }
+
+    pthread_mutex_unlock(&c->mutex);
+    av_free(buf);
+    return NULL;
+}
+
+static int parallel_probe(URLContext *h, const char *url, int flags)
+{
+    ParallelContext *c = h->priv_data;
+    AVIOInterruptCB  interrupt_callback = { .callback = parallel_check_interrupt, .opaque = h };
+    AVDictionary    *probe_options = NULL;
+    URLContext      *probe = NULL;
+    uint8_t byte;
+    int ret;
+
+    /* ask for a single byte, so that the connection can be reused */
+    if ((ret = av_dict_copy(&probe_options, c->inner_options, 0)) < 0 ||
+        (ret = av_dict_set(&probe_options, "end_offset", "1", 0)) < 0 ||
+        (ret = av_dict_set(&probe_options, "connection_pool", "1", AV_DICT_DONT_OVERWRITE)) < 0)
+        goto end;
+
+    ret = ffurl_open_whitelist(&probe, url, flags, &interrupt_callback, &probe_options,
+                               h->protocol_whitelist, h->protocol_blacklist, h);
+    if (ret < 0)
+        goto end;
+
+    c->logical_size = probe->is_streamed ? -1 : ffurl_size(probe);
+    if (c->logical_size > 0)
+        ffurl_read(probe, &byte, 1);
+    ffurl_closep(&probe);
+
+end:
+    av_dict_free(&probe_options);
+    return ret;
+}
+
+static int parallel_close(URLContext *h);
+
+static int parallel_open(URLContext *h, const char *arg, int flags, AVDictionary **options)
+{
+    ParallelContext *c = h->priv_data;
+    AVIOInterruptCB  interrupt_callback = { .callback = parallel_check_interrupt, .opaque = h };
+    int ret;
+
+    av_strstart(arg, "parallel:", &arg);
+
+    c->interrupt_callback = h->interrupt_callback;
+    c->url = av_strdup(arg);
+    if (!c->url)
+        return AVERROR(ENOMEM);
+    if (options && (ret = av_dict_copy(&c->inner_options, *options, 0)) < 0)
+        return ret;
+
+    ret = parallel_probe(h, arg, flags);
+    if (ret < 0) {
+        av_log(h, AV_LOG_ERROR, "Failed to open '%s': %s\n", arg, av_err2str(ret));
+        return ret;
+    }
+
+    if (c->logical_size <= 0 || c->logical_size == INT64_MAX) {
+        av_log(h, AV_LOG_VERBOSE, "Input size unknown, reading sequentially\n");
+        ret = ffurl_open_whitelist(&c->inner, arg, flags, &interrupt_callback, options,
+                                   h->protocol_whitelist, h->protocol_blacklist, h);
+        if (ret < 0)
+            return ret;
+        h->is_streamed = c->inner->is_streamed;
+        return 0;
+    }
+
+    c->chunks  = av_calloc(FFMAX(c->readahead, c->connections), sizeof(*c->chunks));
+    c->workers = av_calloc(c->connections, sizeof(*c->workers));
+    if (!c->chunks || !c->workers) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    for (; c->nb_chunks < FFMAX(c->readahead, c->connections); c->nb_chunks++) {
+        Chunk *chunk = &c->chunks[c->nb_chunks];
+        chunk->start = -1;
+        chunk->data  = av_malloc(c->range_size);
+        if (!chunk->data) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+    }
+    update_window(c);
+
+    ret = pthread_mutex_init(&c->mutex, NULL);
+    if (ret != 0) {
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    ret = pthread_cond_init(&c->cond, NULL);
+    if (ret != 0) {
+        pthread_mutex_destroy(&c->mutex);
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    c->threads_initialized = 1;
+
+    for (; c->nb_workers < c->connections; c->nb_workers++) {
+        ret = pthread_create(&c->workers[c->nb_workers], NULL, parallel_worker, h);
+        if (ret != 0) {
+            ret = AVERROR(ret);
+            av_log(h, AV_LOG_ERROR, "pthread_create failed: %s\n", av_err2str(ret));
+            goto fail;
+        }
+    }
+
+    av_log(h, AV_LOG_VERBOSE, "Fetching %"PRId64" bytes over %d connections\n",
+           c->logical_size, c->connections);
+    return 0;
+
+fail:
+    /* url_close is not called when opening fails */
+    parallel_close(h);
+    return ret;
+}
+
+static int parallel_close(URLContext *h)
+{
+    ParallelContext *c = h->priv_data;
+
+    if (c->threads_initialized) {
+        pthread_mutex_lock(&c->mutex);
+        c->abort_request = 1;
+        pthread_cond_broadcast(&c->cond);
+        pthread_mutex_unlock(&c->mutex);
+
+        for (int i = 0; i < c->nb_workers; i++) {
+            int ret = pthread_join(c->workers[i], NULL);
+            if (ret != 0)
+                av_log(h, AV_LOG_ERROR, "pthread_join(): %s\n", av_err2str(AVERROR(ret)));
+        }
+        pthread_cond_destroy(&c->cond);
+        pthread_mutex_destroy(&c->mutex);
+    }
+
+    for (int i = 0; i < c->nb_chunks; i++)
+        av_freep(&c->chunks[i].data);
+    av_freep(&c->chunks);
+    av_freep(&c->workers);
+    av_freep(&c->url);
+    av_dict_free(&c->inner_options);
+    ffurl_closep(&c->inner);
+    return 0;
+}
+
+static int parallel_read(URLContext *h, unsigned char *buf, int size)
+{
+    ParallelContext *c = h->priv_data;
+    int ret = 0;
+
+    if (c->inner)
+        return ffurl_read(c->inner, buf, size);
+
+    if (c->logical_pos >= c->logical_size)
+        return AVERROR_EOF;
+
+    pthread_mutex_lock(&c->mutex);
+
+    while (1) {
+        Chunk *chunk = &c->chunks[(c->logical_pos / c->range_size) % c->nb_chunks];
+        int avail = chunk->filled - (int)(c->logical_pos - chunk->start);
+
+        if (parallel_check_interrupt(h)) {
+            ret = AVERROR_EXIT;
+            break;
+        }
+        if (avail > 0) {
+            ret = FFMIN(avail, size);
+            memcpy(buf, chunk->data + c->logical_pos - chunk->start, ret);
+            c->logical_pos += ret;
+            if (ret == avail) {
+                /* the chunk was consumed, its slot moves to the end of the window */
+                update_window(c);
+                pthread_cond_broadcast(&c->cond);
+            }
+            break;
+        }
+        if (chunk->error) {
+            ret = chunk->error;
+            break;
+        }
+        pthread_cond_wait(&c->cond, &c->mutex);
+    }
+
+    pthread_mutex_unlock(&c->mutex);
+    return ret;
+}
+
+static int64_t parallel_seek(URLContext *h, int64_t pos, int whence)
+{
+    ParallelContext *c = h->priv_data;
+
+    if (c->inner)
+        return ffurl_seek(c->inner, pos, whence);
+
+    if (whence == AVSEEK_SIZE)
+        return c->logical_size;
+    else if (whence == SEEK_CUR)
+        pos += c->logical_pos;
+    else if (whence == SEEK_END)
+        pos += c->logical_size;
+    else if (whence != SEEK_SET)
+        return AVERROR(EINVAL);
+
+    if (pos < 0 || pos > c->logical_size)
+        return AVERROR(EINVAL);
+
+    pthread_mutex_lock(&c->mutex);
+    c->logical_pos = pos;
+    update_window(c);
+    pthread_cond_broadcast(&c->cond);
+    pthread_mutex_unlock(&c->mutex);
+
+    return pos;
+}
+
+#define OFFSET(x) offsetof(ParallelContext, x)
+#define D AV_OPT_FLAG_DECODING_PARAM
+
+static const AVOption options[] = {
+    { "connections", "number of parallel connections", OFFSET(connections), AV_OPT_TYPE_INT, { .i64 = 4 }, 1, 64, D },
+    { "range_size", "size of the ranges requested by each connection", OFFSET(range_size), AV_OPT_TYPE_INT, { .i64 = 1 << 20 }, 4096, INT_MAX, D },
+    { "readahead", "number of chunks buffered ahead of the read position", OFFSET(readahead), AV_OPT_TYPE_INT, { .i64 = 8 }, 1, 1024, D },
+    { NULL }
+};
+
+#undef D
+#undef OFFSET
+
+static const AVClass parallel_context_class = {
+    .class_name = "Parallel",
+    .item_name  = av_default_item_name,
+    .option     = options,
+    .version    = LIBAVUTIL_VERSION_INT,
+};
+
+const URLProtocol ff_parallel_protocol = {
+    .name                = "parallel",
+    .url_open2           = parallel_open,
+    .url_read            = parallel_read,
+    .url_seek            = parallel_seek,
+    .url_close           = parallel_close,
+    .priv_data_size      = sizeof(ParallelContext),
+    .priv_data_class     = &parallel_context_class,
+};
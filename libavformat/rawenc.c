@@ -30,7 +30,7 @@
 
 int ff_raw_write_packet(AVFormatContext *s, AVPacket *pkt)
 {
-    avio_write(s->pb, pkt->data, pkt->size);
+    avio_write_buffer_ref(s->pb, pkt->buf, pkt->data, pkt->size);
     return 0;
 }
 
@@ -0,0 +1,345 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <string.h>
+
+#include "config.h"
+
+#include "libavutil/error.h"
+#include "libavutil/macros.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+
+#include "readahead.h"
+
+#if HAVE_THREADS
+
+enum BlockState {
+    BLOCK_PENDING,
+    BLOCK_READING,
+    BLOCK_DONE,
+};
+
+typedef struct ReadAheadBlock {
+    uint8_t        *data;
+    int64_t         pos;
+    /* number of bytes read, or an error code */
+    int             size;
+    enum BlockState state;
+    /* retargeted while being read, the result must be dropped */
+    int             stale;
+} ReadAheadBlock;
+
+struct ReadAhead {
+    ReadAheadFunc   read;
+    void           *opaque;
+
+    int             block_size;
+    int             nb_blocks;
+    /* ring of blocks, the one at head covers pos */
+    ReadAheadBlock *blocks;
+    int             head;
+    int64_t         pos;
+
+    pthread_t      *threads;
+    int             nb_threads;
+    pthread_mutex_t lock;
+    pthread_cond_t  work_cond;
+    pthread_cond_t  done_cond;
+    int             finish;
+};
+
+static void assign_block(ReadAhead *r, ReadAheadBlock *b, int64_t pos)
+{
+    b->pos = pos;
+    if (b->state == BLOCK_READING)
+        b->stale = 1;
+    else
+        b->state = BLOCK_PENDING;
+}
+
+/* recycle the head block for the position right after the window */
+static void advance_head(ReadAhead *r)
+{
+    ReadAheadBlock *b = &r->blocks[r->head];
+
+    assign_block(r, b, b->pos + (int64_t)r->nb_blocks * r->block_size);
+    r->head = (r->head + 1) % r->nb_blocks;
+}
+
+static int read_block(ReadAhead *r, uint8_t *buf, int64_t pos)
+{
+    int len = 0;
+
+    while (len < r->block_size) {
+        int ret = r->read(r->opaque, buf + len, r->block_size - len, pos + len);
+        if (ret == AVERROR(EINTR))
+            continue;
+        if (ret < 0)
+            return ret;
+        if (!ret)
+            break;
+        len += ret;
+    }
+
+    return len;
+}
+
+static void *readahead_thread(void *arg)
+{
+    ReadAhead *r = arg;
+
+    pthread_mutex_lock(&r->lock);
+    while (!r->finish) {
+        ReadAheadBlock *b = NULL;
+        int64_t pos;
+        int size;
+
+        /* serve the blocks closest to the read position first */
+        for (int i = 0; i < r->nb_blocks; i++) {
+            ReadAheadBlock *cur = &r->blocks[(r->head + i) % r->nb_blocks];
+            if (cur->state == BLOCK_PENDING) {
+                b = cur;
+                break;
+            }
+        }
+        if (!b) {
+            pthread_cond_wait(&r->work_cond, &r->lock);
+            continue;
+        }
+
+        b->state = BLOCK_READING;
+        b->stale = 0;
+        pos      = b->pos;
+        pthread_mutex_unlock(&r->lock);
+
+        size = read_block(r, b->data, pos);
+
+        pthread_mutex_lock(&r->lock);
+        if (b->stale) {
+            b->state = BLOCK_PENDING;
+            b->stale = 0;
+        } else {
+            b->size  = size;
+            b->state = BLOCK_DONE;
+            pthread_cond_broadcast(&r->done_cond);
+        }
+    }
+    pthread_mutex_unlock(&r->lock);
+
+    return NULL;
+}
+
+int ff_readahead_alloc(ReadAhead **pr, ReadAheadFunc read, void *opaque,
+                       int block_size, int nb_blocks, int64_t pos)
+{
+    ReadAhead *r;
+    int64_t start = pos - pos % block_size;
+    int ret;
+
+    r = av_mallocz(sizeof(*r));
+    if (!r)
+        return AVERROR(ENOMEM);
+
+    r->read       = read;
+    r->opaque     = opaque;
+    r->block_size = block_size;
+    r->nb_blocks  = nb_blocks;
+    r->pos        = pos;
+
+    r->blocks  = av_calloc(nb_blocks, sizeof(*r->blocks));
+    r->threads = av_calloc(nb_blocks, sizeof(*r->threads));
+    if (!r->blocks || !r->threads) {
+        ret = AVERROR(ENOMEM);
+        goto fail;
+    }
+    for (int i = 0; i < nb_blocks; i++) {
+        r->blocks[i].data = av_malloc(block_size);
+        if (!r->blocks[i].data) {
+            ret = AVERROR(ENOMEM);
+            goto fail;
+        }
+        r->blocks[i].pos = start + (int64_t)i * block_size;
+    }
+
+    if ((ret = pthread_mutex_init(&r->lock, NULL))) {
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    if ((ret = pthread_cond_init(&r->work_cond, NULL))) {
+        pthread_mutex_destroy(&r->lock);
+        ret = AVERROR(ret);
+        goto fail;
+    }
+    if ((ret = pthread_cond_init(&r->done_cond, NULL))) {
+        pthread_cond_destroy(&r->work_cond);
+        pthread_mutex_destroy(&r->lock);
+        ret = AVERROR(ret);
+        goto fail;
+    }
+
+    for (; r->nb_threads < nb_blocks; r->nb_threads++) {
+        ret = pthread_create(&r->threads[r->nb_threads], NULL, readahead_thread, r);
+        if (ret) {
+            *pr = r;
+            ff_readahead_free(pr);
+            return AVERROR(ret);
+        }
+    }
+
+    *pr = r;
+    return 0;
+
+fail:
+    for (int i = 0; r->blocks && i < nb_blocks; i++)
+        av_freep(&r->blocks[i].data);
+    av_freep(&r->blocks);
+    av_freep(&r->threads);
+    av_freep(&r);
+    return ret;
+}
+
+int ff_readahead_read(ReadAhead *r, uint8_t *buf, int size)
+{
+    ReadAheadBlock *b;
+    int64_t offset;
+    int ret;
+
+    pthread_mutex_lock(&r->lock);
+
+    b = &r->blocks[r->head];
+    while (b->state != BLOCK_DONE)
+        pthread_cond_wait(&r->done_cond, &r->lock);
+
+    if (b->size < 0) {
+        /* let a later call retry the read */
+        ret = b->size;
+        assign_block(r, b, b->pos);
+        pthread_cond_signal(&r->work_cond);
+        pthread_mutex_unlock(&r->lock);
+        return ret;
+    }
+
+    offset = r->pos - b->pos;
+    if (offset >= b->size) {
+        pthread_mutex_unlock(&r->lock);
+        return AVERROR_EOF;
+    }
+
+    /* done blocks are left alone by the threads until recycled below */
+    pthread_mutex_unlock(&r->lock);
+    ret = FFMIN(size, b->size - offset);
+    memcpy(buf, b->data + offset, ret);
+    pthread_mutex_lock(&r->lock);
+
+    r->pos += ret;
+    if (r->pos == b->pos + r->block_size) {
+        advance_head(r);
+        pthread_cond_signal(&r->work_cond);
+    }
+
+    pthread_mutex_unlock(&r->lock);
+    return ret;
+}
+
+void ff_readahead_seek(ReadAhead *r, int64_t pos)
+{
+    int64_t start = pos - pos % r->block_size;
+    int64_t first;
+
+    pthread_mutex_lock(&r->lock);
+
+    first = r->blocks[r->head].pos;
+    if (start >= first && start < first + (int64_t)r->nb_blocks * r->block_size) {
+        while (r->blocks[r->head].pos != start)
+            advance_head(r);
+    } else {
+        for (int i = 0; i < r->nb_blocks; i++)
+            assign_block(r, &r->blocks[(r->head + i) % r->nb_blocks],
+                         start + (int64_t)i * r->block_size);
+    }
+    r->pos = pos;
+
+    pthread_cond_broadcast(&r->work_cond);
+    pthread_mutex_unlock(&r->lock);
+}
+
+int64_t ff_readahead_tell(ReadAhead *r)
+{
+    int64_t pos;
+
+    pthread_mutex_lock(&r->lock);
+    pos = r->pos;
+    pthread_mutex_unlock(&r->lock);
+
+    return pos;
+}
+
+void ff_readahead_free(ReadAhead **pr)
+{
+    ReadAhead *r = *pr;
+
+    if (!r)
+        return;
+
+    pthread_mutex_lock(&r->lock);
+    r->finish = 1;
+    pthread_cond_broadcast(&r->work_cond);
+    pthread_mutex_unlock(&r->lock);
+
+    for (int i = 0; i < r->nb_threads; i++)
+        pthread_join(r->threads[i], NULL);
+
+    pthread_cond_destroy(&r->done_cond);
+    pthread_cond_destroy(&r->work_cond);
+    pthread_mutex_destroy(&r->lock);
+
+    for (int i = 0; i < r->nb_blocks; i++)
+        av_freep(&r->blocks[i].data);
+    av_freep(&r->blocks);
+    av_freep(&r->threads);
+    av_freep(pr);
+}
+
+#else
+
+int ff_readahead_alloc(ReadAhead **pr, ReadAheadFunc read, void *opaque,
+                       int block_size, int nb_blocks, int64_t pos)
+{
+    return AVERROR(ENOSYS);
+}
+
+int ff_readahead_read(ReadAhead *r, uint8_t *buf, int size)
+{
+    return AVERROR(ENOSYS);
+}
+
+void ff_readahead_seek(ReadAhead *r, int64_t pos)
+{
+}
+
+int64_t ff_readahead_tell(ReadAhead *r)
+{
+    return AVERROR(ENOSYS);
+}
+
+void ff_readahead_free(ReadAhead **pr)
+{
+}
+
+#endif /* HAVE_THREADS */
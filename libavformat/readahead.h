@@ -0,0 +1,71 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef AVFORMAT_READAHEAD_H
+#define AVFORMAT_READAHEAD_H
+
+#include <stdint.h>
+
+/**
+ * Read up to size bytes at offset pos, blocking if needed.
+ *
+ * @return the number of bytes read, 0 at end of file, or a negative error code
+ */
+typedef int (*ReadAheadFunc)(void *opaque, uint8_t *buf, int size, int64_t pos);
+
+/**
+ * A pool of threads reading fixed-size blocks ahead of the current read
+ * position of a seekable resource, keeping several reads in flight so that
+ * the storage queue does not run dry between the caller's small reads.
+ *
+ * Blocks still being read when a seek moves the window elsewhere are
+ * discarded once their read completes, and their slot is reused for the
+ * new position.
+ */
+typedef struct ReadAhead ReadAhead;
+
+/**
+ * @param block_size size of a single background read
+ * @param nb_blocks  number of blocks buffered and of reads kept in flight
+ * @param pos        initial read position
+ */
+int ff_readahead_alloc(ReadAhead **pr, ReadAheadFunc read, void *opaque,
+                       int block_size, int nb_blocks, int64_t pos);
+
+/**
+ * Read data at the current position, waiting for it to be available.
+ *
+ * @return the number of bytes read, AVERROR_EOF at end of file, or a
+ *         negative error code
+ */
+int ff_readahead_read(ReadAhead *r, uint8_t *buf, int size);
+
+/**
+ * Move the read position. Buffered blocks the new position still covers
+ * are kept, all others are retargeted.
+ */
+void ff_readahead_seek(ReadAhead *r, int64_t pos);
+
+/**
+ * @return the current read position
+ */
+int64_t ff_readahead_tell(ReadAhead *r);
+
+void ff_readahead_free(ReadAhead **pr);
+
+#endif /* AVFORMAT_READAHEAD_H */
@@ -24,6 +24,7 @@
 #include "libavutil/opt.h"
 #include "libavutil/time.h"
 
+#include "asyncwriter.h"
 #include "internal.h"
 #include "network.h"
 #include "os_support.h"
@@ -31,6 +32,9 @@
 #if HAVE_POLL_H
 #include <poll.h>
 #endif
+#if HAVE_WRITEV
+#include <sys/uio.h>
+#endif
 
 typedef struct TCPContext {
     const AVClass *class;
@@ -45,6 +49,9 @@ typedef struct TCPContext {
 #if !HAVE_WINSOCK2_H
     int tcp_mss;
 #endif /* !HAVE_WINSOCK2_H */
+    int write_queue_size;
+    AsyncWriter *writer;
+    URLContext *h;
 } TCPContext;
 
 #define OFFSET(x) offsetof(TCPContext, x)
@@ -60,6 +67,7 @@ static const AVOption options[] = {
 #if !HAVE_WINSOCK2_H
     { "tcp_mss",     "Maximum segment size for outgoing TCP packets",          OFFSET(tcp_mss),     AV_OPT_TYPE_INT, { .i64 = -1 },         -1, INT_MAX, .flags = D|E },
 #endif /* !HAVE_WINSOCK2_H */
+    { "write_queue_size", "Send from a background thread, queueing up to this many bytes", OFFSET(write_queue_size), AV_OPT_TYPE_INT, { .i64 = 0 }, 0, INT_MAX, .flags = E },
     { NULL }
 };
 
@@ -111,6 +119,7 @@ static int tcp_open(URLContext *h, const char *uri, int flags)
     char hostname[1024],proto[1024],path[1024];
     char portstr[10];
     s->open_timeout = 5000000;
+    s->h = h;
 
     av_url_split(proto, sizeof(proto), NULL, 0, hostname, sizeof(hostname),
         &port, path, sizeof(path), uri);
@@ -231,6 +240,7 @@ static int tcp_accept(URLContext *s, URLContext **c)
         return ret;
     }
     cc->fd = ret;
+    cc->h  = *c;
     return 0;
 }
 
@@ -250,11 +260,88 @@ static int tcp_read(URLContext *h, uint8_t *buf, int size)
     return ret < 0 ? ff_neterrno() : ret;
 }
 
+static int tcp_write_bufs(void *opaque, const AsyncWriteBuf *bufs, int nb_bufs)
+{
+    TCPContext *s = opaque;
+    URLContext *h = s->h;
+    int ret;
+
+    ret = ff_network_wait_fd_timeout(s->fd, 1, h->rw_timeout, &h->interrupt_callback);
+    if (ret)
+        return ret;
+
+#if HAVE_WRITEV && !HAVE_WINSOCK2_H
+    {
+        struct iovec iov[ASYNC_WRITER_MAX_BATCH];
+        struct msghdr msg = { .msg_iov = iov };
+
+        for (int i = 0; i < FFMIN(nb_bufs, ASYNC_WRITER_MAX_BATCH); i++) {
+            iov[i].iov_base = (void *)bufs[i].data;
+            iov[i].iov_len  = bufs[i].size;
+            msg.msg_iovlen++;
+        }
+        ret = sendmsg(s->fd, &msg, MSG_NOSIGNAL);
+    }
+#else
+    ret = send(s->fd, bufs[0].data, bufs[0].size, MSG_NOSIGNAL);
+#endif
+    if (ret < 0) {
+        ret = ff_neterrno();
+        /* the wait above may race with other writers of the socket */
+        return ret == AVERROR(EAGAIN) ? AVERROR(EINTR) : ret;
+    }
+    return ret;
+}
+
+static int tcp_init_writer(URLContext *h)
+{
+    TCPContext *s = h->priv_data;
+
+    if (s->writer || !s->write_queue_size || h->flags & AVIO_FLAG_NONBLOCK)
+        return 0;
+
+    return ff_async_writer_alloc(&s->writer, tcp_write_bufs, s,
+                                 s->write_queue_size);
+}
+
+static int tcp_write_buffer(URLContext *h, const AVBufferRef *buf,
+                            const uint8_t *data, int size)
+{
+    TCPContext *s = h->priv_data;
+    int ret, len = 0;
+
+    if ((ret = tcp_init_writer(h)) < 0)
+        return ret;
+    if (s->writer) {
+        ret = ff_async_writer_write(s->writer, buf, data, size);
+        return ret < 0 ? ret : size;
+    }
+
+    while (len < size) {
+        AsyncWriteBuf b = { .data = data + len, .size = size - len };
+
+        ret = tcp_write_bufs(s, &b, 1);
+        if (ret == AVERROR(EINTR))
+            continue;
+        if (ret < 0)
+            return ret;
+        len += ret;
+    }
+    return size;
+}
+
 static int tcp_write(URLContext *h, const uint8_t *buf, int size)
 {
     TCPContext *s = h->priv_data;
     int ret;
 
+    if ((ret = tcp_init_writer(h)) < 0)
+        return ret;
+    if (s->writer) {
+        ret = ff_async_writer_write(s->writer, NULL, buf, size);
+        return ret < 0 ? ret : size;
+    }
+
     if (!(h->flags & AVIO_FLAG_NONBLOCK)) {
         ret = ff_network_wait_fd_timeout(s->fd, 1, h->rw_timeout, &h->interrupt_callback);
         if (ret)
@@ -267,7 +354,11 @@ static int tcp_write(URLContext *h, const uint8_t *buf, int size)
 static int tcp_shutdown(URLContext *h, int flags)
 {
     TCPContext *s = h->priv_data;
-    int how;
+    int how, ret;
+
+    if (s->writer && flags & AVIO_FLAG_WRITE &&
+        (ret = ff_async_writer_flush(s->writer)) < 0)
+        return ret;
 
     if (flags & AVIO_FLAG_WRITE && flags & AVIO_FLAG_READ) {
         how = SHUT_RDWR;
@@ -283,8 +374,9 @@ static int tcp_shutdown(URLContext *h, int flags)
 static int tcp_close(URLContext *h)
 {
     TCPContext *s = h->priv_data;
+    int ret = ff_async_writer_free(&s->writer);
     closesocket(s->fd);
-    return 0;
+    return ret;
 }
 
 static int tcp_get_file_handle(URLContext *h)
@@ -319,6 +411,7 @@ const URLProtocol ff_tcp_protocol = {
     .url_accept          = tcp_accept,
     .url_read            = tcp_read,
     .url_write           = tcp_write,
+    .url_write_buffer    = tcp_write_buffer,
     .url_close           = tcp_close,
     .url_get_file_handle = tcp_get_file_handle,
     .url_get_short_seek  = tcp_get_window_size,
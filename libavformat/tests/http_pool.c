@@ -0,0 +1,186 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <pthread.h>
+#include <stdatomic.h>
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/dict.h"
+#include "libavformat/avformat.h"
+#include "libavformat/avio.h"
+#include "libavformat/network.h"
+
+#define MAX_CLIENTS 8
+
+static const char reply[] = "HTTP/1.1 200 OK\r\n"
+                            "Content-Type: text/plain\r\n"
+                            "Content-Length: 6\r\n"
+                            "\r\n"
+                            "pooled";
+
+typedef struct Client {
+    int fd;
+    int len;
+    char buf[4096];
+} Client;
+
+/* A minimal HTTP/1.1 server keeping the connections alive. */
+typedef struct Server {
+    int fd;
+    int port;
+    Client clients[MAX_CLIENTS];
+    int nb_clients;
+    atomic_int nb_connections;
+    atomic_int nb_requests;
+    atomic_int stop;
+} Server;
+
+static void serve_client(Server *srv, Client *c, int *closed)
+{
+    char *end;
+    int n = recv(c->fd, c->buf + c->len, sizeof(c->buf) - 1 - c->len, 0);
+
+    if (n <= 0) {
+        *closed = 1;
+        return;
+    }
+    c->len += n;
+    c->buf[c->len] = 0;
+    while ((end = strstr(c->buf, "\r\n\r\n"))) {
+        int size = end + 4 - c->buf;
+        atomic_fetch_add(&srv->nb_requests, 1);
+        send(c->fd, reply, strlen(reply), 0);
+        memmove(c->buf, c->buf + size, c->len - size + 1);
+        c->len -= size;
+    }
+}
+
+static void *server_thread(void *arg)
+{
+    Server *srv = arg;
+    struct pollfd fds[MAX_CLIENTS + 1];
+
+    while (!atomic_load(&srv->stop)) {
+        fds[0] = (struct pollfd){ .fd = srv->fd, .events = POLLIN };
+        for (int i = 0; i < srv->nb_clients; i++)
+            fds[i + 1] = (struct pollfd){ .fd = srv->clients[i].fd, .events = POLLIN };
+        if (poll(fds, srv->nb_clients + 1, 50) <= 0)
+            continue;
+
+        for (int i = srv->nb_clients - 1; i >= 0; i--) {
+            int closed = 0;
+            if (!fds[i + 1].revents)
+                continue;
+            serve_client(srv, &srv->clients[i], &closed);
+            if (closed) {
+                closesocket(srv->clients[i].fd);
+                srv->clients[i] = srv->clients[--srv->nb_clients];
+            }
+        }
+
+        if ((fds[0].revents & POLLIN) && srv->nb_clients < MAX_CLIENTS) {
+            int fd = accept(srv->fd, NULL, NULL);
+            if (fd >= 0) {
+                srv->clients[srv->nb_clients].fd  = fd;
+                srv->clients[srv->nb_clients].len = 0;
+                srv->nb_clients++;
+                atomic_fetch_add(&srv->nb_connections, 1);
+            }
+        }
+    }
+
+    for (int i = 0; i < srv->nb_clients; i++)
+        closesocket(srv->clients[i].fd);
+    return NULL;
+}
+
+static int server_open(Server *srv)
+{
+    struct sockaddr_in addr = { .sin_family = AF_INET };
+    socklen_t addr_len = sizeof(addr);
+
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    srv->fd = socket(AF_INET, SOCK_STREAM, 0);
+    if (srv->fd < 0)
+        return -1;
+    if (bind(srv->fd, (struct sockaddr *)&addr, sizeof(addr)) < 0 ||
+        listen(srv->fd, MAX_CLIENTS) < 0 ||
+        getsockname(srv->fd, (struct sockaddr *)&addr, &addr_len) < 0) {
+        closesocket(srv->fd);
+        return -1;
+    }
+    srv->port = ntohs(addr.sin_port);
+    return 0;
+}
+
+static void fetch(Server *srv, const char *desc, const char *key, const char *value)
+{
+    AVDictionary *opts = NULL;
+    AVIOContext *pb = NULL;
+    char url[64];
+    unsigned char buf[64];
+    int ret, size = 0;
+
+    snprintf(url, sizeof(url), "http://127.0.0.1:%d/", srv->port);
+    av_dict_set(&opts, "connection_pool", "1", 0);
+    if (key)
+        av_dict_set(&opts, key, value, 0);
+
+    ret = avio_open2(&pb, url, AVIO_FLAG_READ, NULL, &opts);
+    av_dict_free(&opts);
+    if (ret < 0) {
+        printf("%s: open failed\n", desc);
+        return;
+    }
+    while ((ret = avio_read(pb, buf, sizeof(buf))) > 0)
+        size += ret;
+    avio_closep(&pb);
+
+    printf("%s: %d bytes, %d requests on %d connections\n", desc, size,
+           atomic_load(&srv->nb_requests), atomic_load(&srv->nb_connections));
+}
+
+int main(void)
+{
+    Server srv = { 0 };
+    pthread_t thread;
+
+    avformat_network_init();
+    if (server_open(&srv) < 0) {
+        printf("Cannot open the server socket\n");
+        return 1;
+    }
+    if (pthread_create(&thread, NULL, server_thread, &srv)) {
+        closesocket(srv.fd);
+        return 1;
+    }
+
+    fetch(&srv, "first request",         NULL, NULL);
+    fetch(&srv, "same options",          NULL, NULL);
+    fetch(&srv, "other whitelist",       "protocol_whitelist", "http,tcp");
+    fetch(&srv, "other lower option",    "tcp_nodelay", "1");
+    fetch(&srv, "same options again",    NULL, NULL);
+    fetch(&srv, "same whitelist again",  "protocol_whitelist", "http,tcp");
+
+    atomic_store(&srv.stop, 1);
+    pthread_join(thread, NULL);
+    closesocket(srv.fd);
+    avformat_network_deinit();
+    return 0;
+}
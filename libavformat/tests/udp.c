@@ -0,0 +1,139 @@
+/*
+ * This file is part of FFmpeg.
+ *
+ * FFmpeg is free software; you can redistribute it and/or
+ * modify it under the terms of the GNU Lesser General Public
+ * License as published by the Free Software Foundation; either
+ * version 2.1 of the License, or (at your option) any later version.
+ *
+ * FFmpeg is distributed in the hope that it will be useful,
+ * but WITHOUT ANY WARRANTY; without even the implied warranty of
+ * MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the GNU
+ * Lesser General Public License for more details.
+ *
+ * You should have received a copy of the GNU Lesser General Public
+ * License along with FFmpeg; if not, write to the Free Software
+ * Foundation, Inc., 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include <stdio.h>
+#include <string.h>
+
+#include "libavutil/dict.h"
+#include "libavformat/avformat.h"
+#include "libavformat/network.h"
+#include "libavformat/url.h"
+
+#define NB_DATAGRAMS 64
+#define MAX_SIZE     1400
+
+static int datagram_size(int i)
+{
+    return 100 + i * 41 % (MAX_SIZE - 100);
+}
+
+/* Find a free port by binding a socket to an ephemeral one. */
+static int free_port(void)
+{
+    struct sockaddr_in addr = { .sin_family = AF_INET };
+    socklen_t addr_len = sizeof(addr);
+    int port = -1, fd = socket(AF_INET, SOCK_DGRAM, 0);
+
+    if (fd < 0)
+        return -1;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    if (bind(fd, (struct sockaddr *)&addr, sizeof(addr)) >= 0 &&
+        getsockname(fd, (struct sockaddr *)&addr, &addr_len) >= 0)
+        port = ntohs(addr.sin_port);
+    closesocket(fd);
+    return port;
+}
+
+static int send_datagrams(int port)
+{
+    struct sockaddr_in addr = { .sin_family = AF_INET };
+    uint8_t buf[MAX_SIZE];
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+
+    if (fd < 0)
+        return -1;
+    addr.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    addr.sin_port        = htons(port);
+    for (int i = 0; i < NB_DATAGRAMS; i++) {
+        int size = datagram_size(i);
+        for (int j = 0; j < size; j++)
+            buf[j] = i + j;
+        if (sendto(fd, buf, size, 0, (struct sockaddr *)&addr, sizeof(addr)) != size) {
+            closesocket(fd);
+            return -1;
+        }
+    }
+    closesocket(fd);
+    return 0;
+}
+
+/* Receive the datagrams through the receiving thread of the udp protocol,
+ * checking that their boundaries, order and contents are preserved. */
+static void receive(const char *desc, const char *key, const char *value)
+{
+    AVDictionary *opts = NULL;
+    URLContext *uc = NULL;
+    uint8_t buf[MAX_SIZE * 2];
+    int port = free_port(), nb = 0, nb_bad = 0, bytes = 0, ret;
+    char url[64];
+
+    if (port < 0) {
+        printf("%s: cannot find a free port\n", desc);
+        return;
+    }
+    snprintf(url, sizeof(url), "udp://127.0.0.1:%d", port);
+    /* give up on missing datagrams instead of waiting forever */
+    av_dict_set(&opts, "rw_timeout", "2000000", 0);
+    if (key)
+        av_dict_set(&opts, key, value, 0);
+    ret = ffurl_open_whitelist(&uc, url, AVIO_FLAG_READ, NULL, &opts,
+                               NULL, NULL, NULL);
+    av_dict_free(&opts);
+    if (ret < 0) {
+        printf("%s: open failed\n", desc);
+        return;
+    }
+    if (send_datagrams(port) < 0) {
+        printf("%s: send failed\n", desc);
+        ffurl_closep(&uc);
+        return;
+    }
+
+    while (nb < NB_DATAGRAMS) {
+        ret = ffurl_read(uc, buf, sizeof(buf));
+        if (ret < 0)
+            break;
+        if (ret != datagram_size(nb)) {
+            nb_bad++;
+        } else {
+            for (int j = 0; j < ret; j++)
+                if (buf[j] != (uint8_t)(nb + j)) {
+                    nb_bad++;
+                    break;
+                }
+        }
+        bytes += ret;
+        nb++;
+    }
+    ffurl_closep(&uc);
+
+    printf("%s: %d datagrams, %d bytes, %d mismatched\n", desc, nb, bytes, nb_bad);
+}
+
+int main(void)
+{
+    avformat_network_init();
+
+    receive("one at a time",   NULL,         NULL);
+    receive("batches of 16",   "recv_batch", "16");
+    receive("batches of 64",   "recv_batch", "64");
+    receive("receive offload", "gro",        "1");
+
+    avformat_network_deinit();
+    return 0;
+}
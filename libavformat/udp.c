@@ -26,6 +26,7 @@
 
 #define _DEFAULT_SOURCE
 #define _BSD_SOURCE     /* Needed for using struct ip_mreq with recent glibc */
+#define _GNU_SOURCE     /* Needed for recvmmsg() */
 
 #include "avformat.h"
 #include "avio_internal.h"
@@ -47,6 +48,10 @@
 #include "TargetConditionals.h"
 #endif
 
+#if HAVE_RECVMMSG
+#include <netinet/udp.h>
+#endif
+
 #if HAVE_UDPLITE_H
 #include "udplite.h"
 #else
@@ -80,6 +85,17 @@
 #define UDP_MAX_PKT_SIZE 65536
 #define UDP_HEADER_SIZE 8
 
+#if HAVE_RECVMMSG
+typedef struct UDPRecvSlot {
+    struct sockaddr_storage addr;
+    struct iovec iov;
+    union {
+        char buf[CMSG_SPACE(sizeof(int))];
+        struct cmsghdr align;
+    } control;
+} UDPRecvSlot;
+#endif
+
 typedef struct UDPContext {
     const AVClass *class;
     int udp_fd;
@@ -108,6 +124,14 @@ typedef struct UDPContext {
     pthread_mutex_t mutex;
     pthread_cond_t cond;
     int thread_started;
+#endif
+    int recv_batch;
+    int gro;
+#if HAVE_RECVMMSG
+    /* batched reception in the receiving thread */
+    struct mmsghdr *rx_msgs;
+    UDPRecvSlot *rx_slots;
+    uint8_t *rx_buf;
 #endif
     uint8_t tmp[UDP_MAX_PKT_SIZE+4];
     int remaining_in_dg;
@@ -138,6 +162,8 @@ static const AVOption options[] = {
     { "connect",        "set if connect() should be called on socket",     OFFSET(is_connected),   AV_OPT_TYPE_BOOL,   { .i64 =  0 },     0, 1,       .flags = D|E },
     { "fifo_size",      "set the UDP receiving circular buffer size, expressed as a number of packets with size of 188 bytes", OFFSET(circular_buffer_size), AV_OPT_TYPE_INT, {.i64 = 7*4096}, 0, INT_MAX, D },
     { "overrun_nonfatal", "survive in case of UDP receiving circular buffer overrun", OFFSET(overrun_nonfatal), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1,    D },
+    { "recv_batch",     "set the maximum number of datagrams received at once by the receiving thread", OFFSET(recv_batch), AV_OPT_TYPE_INT, {.i64 = 1}, 1, 1024, D },
+    { "gro",            "let the kernel coalesce received datagrams (generic receive offload)", OFFSET(gro), AV_OPT_TYPE_BOOL, {.i64 = 0}, 0, 1, D },
     { "timeout",        "set raise error timeout, in microseconds (only in read mode)",OFFSET(timeout),         AV_OPT_TYPE_INT,  {.i64 = 0}, 0, INT_MAX, D },
     { "sources",        "Source list",                                     OFFSET(sources),        AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
     { "block",          "Block list",                                      OFFSET(block),          AV_OPT_TYPE_STRING, { .str = NULL },               .flags = D|E },
@@ -481,6 +507,108 @@ static int udp_get_file_handle(URLContext *h)
 }
 
 #if HAVE_PTHREAD_CANCEL
+#if HAVE_RECVMMSG
+static int udp_rx_batch_alloc(URLContext *h)
+{
+    UDPContext *s = h->priv_data;
+    int nb = s->recv_batch;
+
+    s->rx_msgs  = av_calloc(nb, sizeof(*s->rx_msgs));
+    s->rx_slots = av_calloc(nb, sizeof(*s->rx_slots));
+    /* only the received bytes of each slot are ever touched */
+    s->rx_buf   = av_malloc_array(nb, UDP_MAX_PKT_SIZE);
+    if (!s->rx_msgs || !s->rx_slots || !s->rx_buf)
+        return AVERROR(ENOMEM);
+
+    for (int i = 0; i < nb; i++) {
+        struct msghdr *hdr = &s->rx_msgs[i].msg_hdr;
+
+        s->rx_slots[i].iov.iov_base = s->rx_buf + i * UDP_MAX_PKT_SIZE;
+        s->rx_slots[i].iov.iov_len  = UDP_MAX_PKT_SIZE;
+        hdr->msg_name    = &s->rx_slots[i].addr;
+        hdr->msg_iov     = &s->rx_slots[i].iov;
+        hdr->msg_iovlen  = 1;
+        hdr->msg_control = s->rx_slots[i].control.buf;
+    }
+    return 0;
+}
+
+static void udp_rx_batch_free(UDPContext *s)
+{
+    av_freep(&s->rx_msgs);
+    av_freep(&s->rx_slots);
+    av_freep(&s->rx_buf);
+}
+
+static int udp_rx_batch_recv(UDPContext *s)
+{
+    for (int i = 0; i < s->recv_batch; i++) {
+        struct msghdr *hdr = &s->rx_msgs[i].msg_hdr;
+
+        hdr->msg_namelen    = sizeof(s->rx_slots[i].addr);
+        hdr->msg_controllen = s->gro ? sizeof(s->rx_slots[i].control) : 0;
+        hdr->msg_flags      = 0;
+    }
+    return recvmmsg(s->udp_fd, s->rx_msgs, s->recv_batch, MSG_WAITFORONE, NULL);
+}
+
+/* size of the datagrams the kernel coalesced into this message, 0 if none */
+static int udp_rx_segment_size(struct msghdr *hdr)
+{
+#ifdef UDP_GRO
+    for (struct cmsghdr *cmsg = CMSG_FIRSTHDR(hdr); cmsg; cmsg = CMSG_NXTHDR(hdr, cmsg)) {
+        if (cmsg->cmsg_level == SOL_UDP && cmsg->cmsg_type == UDP_GRO) {
+            int size;
+            memcpy(&size, CMSG_DATA(cmsg), sizeof(size));
+            return size;
+        }
+    }
+#endif
+    return 0;
+}
+#endif
+
+/**
+ * Queue one received buffer as datagrams of at most segment_size bytes,
+ * the whole buffer being a single datagram if segment_size is 0.
+ * Must be called with the mutex held.
+ */
+static int udp_rx_queue(URLContext *h, const uint8_t *buf, int len,
+                        const struct sockaddr_storage *addr, int segment_size)
+{
+    UDPContext *s = h->priv_data;
+
+    if (ff_ip_check_source_lists(addr, &s->filters))
+        return 0;
+    if (!segment_size)
+        segment_size = len;
+
+    while (len > 0) {
+        int size = FFMIN(len, segment_size);
+        uint8_t hdr[4];
+
+        if (av_fifo_can_write(s->fifo) < size + 4) {
+            /* No Space left */
+            if (s->overrun_nonfatal) {
+                av_log(h, AV_LOG_WARNING, "Circular buffer overrun. "
+                        "Surviving due to overrun_nonfatal option\n");
+                return 0;
+            } else {
+                av_log(h, AV_LOG_ERROR, "Circular buffer overrun. "
+                        "To avoid, increase fifo_size URL option. "
+                        "To survive in such case, use overrun_nonfatal option\n");
+                return AVERROR(EIO);
+            }
+        }
+        AV_WL32(hdr, size);
+        av_fifo_write(s->fifo, hdr, 4);
+        av_fifo_write(s->fifo, buf, size);
+        buf += size;
+        len -= size;
+    }
+    return 0;
+}
+
 static void *circular_buffer_task_rx( void *_URLContext)
 {
     URLContext *h = _URLContext;
@@ -497,7 +625,7 @@ static void *circular_buffer_task_rx( void *_URLContext)
         goto end;
     }
     while(1) {
-        int len;
+        int len, ret;
         struct sockaddr_storage addr;
         socklen_t addr_len = sizeof(addr);
 
@@ -506,7 +634,12 @@ static void *circular_buffer_task_rx( void *_URLContext)
            see "General Information" / "Thread Cancelation Overview"
            in Single Unix. */
         pthread_setcancelstate(PTHREAD_CANCEL_ENABLE, &old_cancelstate);
-        len = recvfrom(s->udp_fd, s->tmp+4, sizeof(s->tmp)-4, 0, (struct sockaddr *)&addr, &addr_len);
+#if HAVE_RECVMMSG
+        if (s->rx_msgs)
+            len = udp_rx_batch_recv(s);
+        else
+#endif
+        len = recvfrom(s->udp_fd, s->tmp, sizeof(s->tmp), 0, (struct sockaddr *)&addr, &addr_len);
         pthread_setcancelstate(PTHREAD_CANCEL_DISABLE, &old_cancelstate);
         pthread_mutex_lock(&s->mutex);
         if (len < 0) {
@@ -516,25 +649,22 @@ static void *circular_buffer_task_rx( void *_URLContext)
             }
             continue;
         }
-        if (ff_ip_check_source_lists(&addr, &s->filters))
-            continue;
-        AV_WL32(s->tmp, len);
 
-        if (av_fifo_can_write(s->fifo) < len + 4) {
-            /* No Space left */
-            if (s->overrun_nonfatal) {
-                av_log(h, AV_LOG_WARNING, "Circular buffer overrun. "
-                        "Surviving due to overrun_nonfatal option\n");
-                continue;
-            } else {
-                av_log(h, AV_LOG_ERROR, "Circular buffer overrun. "
-                        "To avoid, increase fifo_size URL option. "
-                        "To survive in such case, use overrun_nonfatal option\n");
-                s->circular_buffer_error = AVERROR(EIO);
-                goto end;
-            }
+        /* the whole batch is queued under a single lock */
+        ret = 0;
+#if HAVE_RECVMMSG
+        if (s->rx_msgs) {
+            for (int i = 0; i < len && ret >= 0; i++)
+                ret = udp_rx_queue(h, s->rx_slots[i].iov.iov_base, s->rx_msgs[i].msg_len,
+                                   &s->rx_slots[i].addr,
+                                   udp_rx_segment_size(&s->rx_msgs[i].msg_hdr));
+        } else
+#endif
+        ret = udp_rx_queue(h, s->tmp, len, &addr, 0);
+        if (ret < 0) {
+            s->circular_buffer_error = ret;
+            goto end;
         }
-        av_fifo_write(s->fifo, s->tmp, len + 4);
         pthread_cond_signal(&s->cond);
     }
 
@@ -727,6 +857,14 @@ static int udp_open(URLContext *h, const char *uri, int flags)
                        "'circular_buffer_size' option was set but it is not supported "
                        "on this build (pthread support is required)\n");
         }
+        if (av_find_info_tag(buf, sizeof(buf), "recv_batch", p)) {
+            s->recv_batch = strtol(buf, NULL, 10);
+            if (s->recv_batch < 1)
+                s->recv_batch = 1;
+        }
+        if (av_find_info_tag(buf, sizeof(buf), "gro", p)) {
+            s->gro = strtol(buf, NULL, 10);
+        }
         if (av_find_info_tag(buf, sizeof(buf), "bitrate", p)) {
             s->bitrate = strtoll(buf, NULL, 10);
             if (!HAVE_PTHREAD_CANCEL)
@@ -902,6 +1040,18 @@ static int udp_open(URLContext *h, const char *uri, int flags)
             ff_log_net_error(h, AV_LOG_WARNING, "getsockopt(SO_RCVBUF)");
         } else {
             av_log(h, AV_LOG_DEBUG, "end receive buffer size reported is %d\n", tmp);
+#ifdef SO_RCVBUFFORCE
+            /* SO_RCVBUF is capped by net.core.rmem_max, privileged
+             * processes may go beyond that limit */
+            if (tmp < s->buffer_size) {
+                int size = s->buffer_size;
+                if (!setsockopt(udp_fd, SOL_SOCKET, SO_RCVBUFFORCE, &size, sizeof(size)) &&
+                    !getsockopt(udp_fd, SOL_SOCKET, SO_RCVBUF, &size, &len)) {
+                    av_log(h, AV_LOG_DEBUG, "forced receive buffer size to %d\n", size);
+                    tmp = size;
+                }
+            }
+#endif
             if(tmp < s->buffer_size)
                 av_log(h, AV_LOG_WARNING, "attempted to set receive buffer to size %d but it only ended up set as %d\n", s->buffer_size, tmp);
         }
@@ -938,6 +1088,25 @@ static int udp_open(URLContext *h, const char *uri, int flags)
             ret = AVERROR(ENOMEM);
             goto fail;
         }
+        if (!is_output && s->gro) {
+#if HAVE_RECVMMSG && defined(UDP_GRO)
+            tmp = 1;
+            if (setsockopt(udp_fd, SOL_UDP, UDP_GRO, &tmp, sizeof(tmp)) < 0) {
+                ff_log_net_error(h, AV_LOG_WARNING, "setsockopt(UDP_GRO)");
+                s->gro = 0;
+            }
+#else
+            av_log(h, AV_LOG_WARNING, "'gro' option is not supported on this build\n");
+            s->gro = 0;
+#endif
+        }
+#if HAVE_RECVMMSG
+        if (!is_output && (s->recv_batch > 1 || s->gro)) {
+            ret = udp_rx_batch_alloc(h);
+            if (ret < 0)
+                goto fail;
+        }
+#endif
         ret = pthread_mutex_init(&s->mutex, NULL);
         if (ret != 0) {
             av_log(h, AV_LOG_ERROR, "pthread_mutex_init failed : %s\n", strerror(ret));
@@ -971,6 +1140,9 @@ static int udp_open(URLContext *h, const char *uri, int flags)
     if (udp_fd >= 0)
         closesocket(udp_fd);
     av_fifo_freep2(&s->fifo);
+#if HAVE_PTHREAD_CANCEL && HAVE_RECVMMSG
+    udp_rx_batch_free(s);
+#endif
     ff_ip_reset_filters(&s->filters);
     return ret;
 }
@@ -1137,6 +1309,9 @@ static int udp_close(URLContext *h)
         pthread_mutex_destroy(&s->mutex);
         pthread_cond_destroy(&s->cond);
     }
+#if HAVE_RECVMMSG
+    udp_rx_batch_free(s);
+#endif
 #endif
     closesocket(s->udp_fd);
     av_fifo_freep2(&s->fifo);
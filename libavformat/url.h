@@ -76,6 +76,14 @@ typedef struct URLProtocol {
      */
     int     (*url_read)( URLContext *h, unsigned char *buf, int size);
     int     (*url_write)(URLContext *h, const unsigned char *buf, int size);
+    /**
+     * Write all of data, which lies in the buffer referenced by buf.
+     * The protocol may keep a reference to buf instead of copying data.
+     * Unlike url_write, this is not subject to max_packet_size.
+     * Return size on success, a negative AVERROR code on failure.
+     */
+    int     (*url_write_buffer)(URLContext *h, const AVBufferRef *buf,
+                                const unsigned char *data, int size);
     int64_t (*url_seek)( URLContext *h, int64_t pos, int whence);
     int     (*url_close)(URLContext *h);
     int (*url_read_pause)(URLContext *h, int pause);
@@ -198,6 +206,17 @@ int ffurl_read_complete(URLContext *h, unsigned char *buf, int size);
  */
 int ffurl_write(URLContext *h, const unsigned char *buf, int size);
 
+/**
+ * Write size bytes from data, which lies in the buffer referenced by buf,
+ * to the resource accessed by h. The protocol may keep a reference to buf.
+ * Only valid if the protocol implements url_write_buffer.
+ *
+ * @return size on success, or a negative value corresponding to an AVERROR
+ * code in case of failure
+ */
+int ffurl_write_buffer(URLContext *h, const AVBufferRef *buf,
+                       const unsigned char *data, int size);
+
 /**
  * Change the position that will be used by the next read/write
  * operation on the resource accessed by h.
@@ -1196,6 +1196,80 @@ int sws_scale_frame(struct SwsContext *c, AVFrame *dst, const AVFrame *src)
     return ret;
 }
 
+/* number of source lines passed to all the contexts at once by
+ * sws_scale_frames(), small enough for a band to stay in the cache */
+#define MULTI_BAND_LINES 16
+
+static int scale_band(SwsContext *c, const AVFrame *src, int y, int h)
+{
+    const uint8_t *src_band[4];
+
+    for (int i = 0; i < FF_ARRAY_ELEMS(src_band); i++) {
+        int        vsub = ((i + 1) & 2) ? c->chrSrcVSubSample : 0;
+        ptrdiff_t offset = src->linesize[i] * (y >> vsub);
+        src_band[i] = FF_PTR_ADD(src->data[i], offset);
+    }
+    if (usePal(c->srcFormat))
+        src_band[1] = src->data[1];
+
+    return scale_internal(c, src_band, src->linesize, y, h,
+                          c->frame_dst->data, c->frame_dst->linesize, 0, c->dstH);
+}
+
+int sws_scale_frames(struct SwsContext **c, AVFrame **dst, int nb_dst,
+                     const AVFrame *src)
+{
+    int i, nb_started, ret = 0;
+
+    for (i = 0; i < nb_dst; i++) {
+        if (c[i]->srcW != src->width || c[i]->srcH != src->height ||
+            c[i]->srcFormat != src->format) {
+            av_log(c[i], AV_LOG_ERROR, "Source frame does not match the "
+                   "context configuration\n");
+            return AVERROR(EINVAL);
+        }
+    }
+
+    for (nb_started = 0; nb_started < nb_dst; nb_started++) {
+        ret = sws_frame_start(c[nb_started], dst[nb_started], src);
+        if (ret < 0)
+            goto end;
+    }
+
+    /* Contexts with internal slice threads or cascaded scalers only work on
+     * complete frames, run them separately. */
+    for (i = 0; i < nb_dst; i++) {
+        if (!c[i]->slicethread && !c[i]->cascaded_context[0])
+            continue;
+
+        ret = sws_send_slice(c[i], 0, src->height);
+        if (ret >= 0)
+            ret = sws_receive_slice(c[i], 0, dst[i]->height);
+        if (ret < 0)
+            goto end;
+    }
+
+    for (int y = 0; y < src->height; y += MULTI_BAND_LINES) {
+        int h = FFMIN(MULTI_BAND_LINES, src->height - y);
+
+        for (i = 0; i < nb_dst; i++) {
+            if (c[i]->slicethread || c[i]->cascaded_context[0])
+                continue;
+
+            ret = scale_band(c[i], src, y, h);
+            if (ret < 0)
+                goto end;
+        }
+    }
+    ret = 0;
+
+end:
+    for (i = 0; i < nb_started; i++)
+        sws_frame_end(c[i]);
+
+    return ret;
+}
+
 /**
  * swscale wrapper, so we don't need to export the SwsContext.
  * Assumes planar YUV to be in YUV order instead of YVU.
@@ -243,6 +243,28 @@ int sws_scale(struct SwsContext *c, const uint8_t *const srcSlice[],
  */
 int sws_scale_frame(struct SwsContext *c, AVFrame *dst, const AVFrame *src);
 
+/**
+ * Scale source data from src and write the output to several destinations,
+ * e.g. the renditions of an adaptive bitrate ladder.
+ *
+ * The source is walked once from top to bottom in bands of a few lines and
+ * every band is fed to all the scaling contexts before moving on to the next
+ * one, so each source line is fetched from memory only once instead of once
+ * per destination. The output is identical to calling sws_scale_frame() with
+ * each context in turn.
+ *
+ * @param c      array of nb_dst distinct scaling contexts, all configured for
+ *               the dimensions and pixel format of src
+ * @param dst    array of nb_dst destination frames, dst[i] is written by c[i].
+ *               See documentation for sws_frame_start() for more details.
+ * @param nb_dst number of entries in c and dst
+ * @param src    The source frame.
+ *
+ * @return 0 on success, a negative AVERROR code on failure
+ */
+int sws_scale_frames(struct SwsContext **c, AVFrame **dst, int nb_dst,
+                     const AVFrame *src);
+
 /**
  * Initialize the scaling process for a given pair of source/destination frames.
  * Must be called before any calls to sws_send_slice() and sws_receive_slice().
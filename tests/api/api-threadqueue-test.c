@@ -0,0 +1,240 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/**
+ * fftools ThreadQueue test and benchmark
+ *
+ * Usage: api-threadqueue-test nb_streams nb_packets queue_size spsc [early_finish]
+ *
+ * One thread sends nb_packets packets per stream, interleaving the streams,
+ * and another one receives them, checking the order and EOF signalling.
+ * If early_finish is set, the receiver stops reading stream 0 half way
+ * through. The average time per packet is printed at the end.
+ */
+
+#include <inttypes.h>
+#include <stdlib.h>
+
+#include "libavutil/avassert.h"
+#include "libavutil/log.h"
+#include "libavutil/mem.h"
+#include "libavutil/thread.h"
+#include "libavutil/time.h"
+
+#include "libavcodec/packet.h"
+
+#include "fftools/objpool.h"
+#include "fftools/thread_queue.h"
+
+typedef struct TestContext {
+    ThreadQueue *tq;
+    int          nb_streams;
+    int64_t      nb_packets;
+    int          early_finish;
+} TestContext;
+
+static void pkt_move(void *dst, void *src)
+{
+    av_packet_move_ref(dst, src);
+}
+
+static void *sender_thread(void *arg)
+{
+    TestContext *tc = arg;
+    AVPacket   *pkt = av_packet_alloc();
+    int        *eof = av_calloc(tc->nb_streams, sizeof(*eof));
+    intptr_t    ret = 0;
+
+    if (!pkt || !eof) {
+        ret = AVERROR(ENOMEM);
+        goto finish;
+    }
+
+    for (int64_t i = 0; i < tc->nb_packets; i++) {
+        for (int j = 0; j < tc->nb_streams; j++) {
+            if (eof[j])
+                continue;
+
+            pkt->pts          = i;
+            pkt->stream_index = j;
+
+            ret = tq_send(tc->tq, j, pkt);
+            if (ret == AVERROR_EOF) {
+                av_log(NULL, AV_LOG_INFO, "sender: stream %d finished by "
+                       "the receiver\n", j);
+                eof[j] = 1;
+                ret    = 0;
+            } else if (ret < 0) {
+                av_log(NULL, AV_LOG_ERROR, "sender: error %d\n", (int)ret);
+                goto finish;
+            }
+        }
+    }
+
+finish:
+    for (int j = 0; j < tc->nb_streams; j++)
+        tq_send_finish(tc->tq, j);
+
+    av_packet_free(&pkt);
+    av_freep(&eof);
+
+    return (void*)ret;
+}
+
+static int receive_all(TestContext *tc)
+{
+    AVPacket *pkt = av_packet_alloc();
+    int64_t *next = av_calloc(tc->nb_streams, sizeof(*next));
+    int     *eofs = av_calloc(tc->nb_streams, sizeof(*eofs));
+    int ret = 0;
+
+    if (!pkt || !next || !eofs) {
+        ret = AVERROR(ENOMEM);
+        goto finish;
+    }
+
+    while (1) {
+        int stream_idx;
+
+        ret = tq_receive(tc->tq, &stream_idx, pkt);
+        if (stream_idx < 0) {
+            ret = 0;
+            break;
+        }
+
+        if (ret == AVERROR_EOF) {
+            if (eofs[stream_idx]++) {
+                av_log(NULL, AV_LOG_ERROR, "receiver: duplicate EOF for "
+                       "stream %d\n", stream_idx);
+                ret = AVERROR_BUG;
+                goto finish;
+            }
+            if (next[stream_idx] != tc->nb_packets &&
+                !(tc->early_finish && stream_idx == 0)) {
+                av_log(NULL, AV_LOG_ERROR, "receiver: premature EOF for "
+                       "stream %d after %"PRId64" packets\n",
+                       stream_idx, next[stream_idx]);
+                ret = AVERROR_BUG;
+                goto finish;
+            }
+            continue;
+        }
+
+        if (pkt->stream_index != stream_idx ||
+            pkt->pts != next[stream_idx]) {
+            av_log(NULL, AV_LOG_ERROR, "receiver: got packet %"PRId64" for "
+                   "stream %d, expected %"PRId64" for stream %d\n", pkt->pts,
+                   pkt->stream_index, next[stream_idx], stream_idx);
+            ret = AVERROR_BUG;
+            goto finish;
+        }
+        next[stream_idx]++;
+        av_packet_unref(pkt);
+
+        /* packets already in the queue may still arrive after this,
+         * but no EOF will be signalled for the stream */
+        if (tc->early_finish && stream_idx == 0 &&
+            next[0] == tc->nb_packets / 2) {
+            tq_receive_finish(tc->tq, 0);
+            eofs[0] = 1;
+        }
+    }
+
+    for (int j = 0; j < tc->nb_streams; j++) {
+        if (!eofs[j]) {
+            av_log(NULL, AV_LOG_ERROR, "receiver: no EOF for stream %d\n", j);
+            ret = AVERROR_BUG;
+        }
+    }
+
+finish:
+    av_packet_free(&pkt);
+    av_freep(&next);
+    av_freep(&eofs);
+
+    return ret;
+}
+
+int main(int argc, char **argv)
+{
+    TestContext tc = { 0 };
+    ObjPool *op;
+    pthread_t sender;
+    int64_t start, elapsed;
+    void *sender_ret;
+    int queue_size, flags, ret;
+
+    if (argc < 5) {
+        av_log(NULL, AV_LOG_ERROR, "Usage: %s <nb_streams> <nb_packets> "
+               "<queue_size> <spsc> [early_finish]\n", argv[0]);
+        return 1;
+    }
+
+    tc.nb_streams   = strtol(argv[1], NULL, 0);
+    tc.nb_packets   = strtoll(argv[2], NULL, 0);
+    queue_size      = strtol(argv[3], NULL, 0);
+    flags           = strtol(argv[4], NULL, 0) ? TQ_FLAG_SPSC : 0;
+    tc.early_finish = argc > 5 ? strtol(argv[5], NULL, 0) : 0;
+
+    if (tc.nb_streams <= 0 || tc.nb_packets <= 0 || queue_size <= 0) {
+        av_log(NULL, AV_LOG_ERROR, "Invalid parameters\n");
+        return 1;
+    }
+
+    op = objpool_alloc_packets();
+    if (!op)
+        return 1;
+
+    tc.tq = tq_alloc(tc.nb_streams, queue_size, op, pkt_move, flags);
+    if (!tc.tq) {
+        objpool_free(&op);
+        return 1;
+    }
+
+    start = av_gettime_relative();
+
+    ret = pthread_create(&sender, NULL, sender_thread, &tc);
+    if (ret) {
+        tq_free(&tc.tq);
+        return 1;
+    }
+
+    ret = receive_all(&tc);
+    if (ret < 0) {
+        /* unblock the sender */
+        for (int j = 0; j < tc.nb_streams; j++)
+            tq_receive_finish(tc.tq, j);
+    }
+
+    pthread_join(sender, &sender_ret);
+    elapsed = av_gettime_relative() - start;
+
+    tq_free(&tc.tq);
+
+    if (ret < 0 || sender_ret)
+        return 1;
+
+    av_log(NULL, AV_LOG_INFO, "%s queue: %"PRId64" packets in %"PRId64" us, "
+           "%.1f ns/packet\n", flags & TQ_FLAG_SPSC ? "spsc" : "locked",
+           tc.nb_packets * tc.nb_streams, elapsed,
+           1000.0 * elapsed / (tc.nb_packets * tc.nb_streams));
+
+    return 0;
+}
@@ -0,0 +1,188 @@
+/*
+ * Permission is hereby granted, free of charge, to any person obtaining a copy
+ * of this software and associated documentation files (the "Software"), to deal
+ * in the Software without restriction, including without limitation the rights
+ * to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+ * copies of the Software, and to permit persons to whom the Software is
+ * furnished to do so, subject to the following conditions:
+ *
+ * The above copyright notice and this permission notice shall be included in
+ * all copies or substantial portions of the Software.
+ *
+ * THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+ * IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+ * FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL
+ * THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+ * LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+ * OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN
+ * THE SOFTWARE.
+ */
+
+/*
+ * Zero-copy decoding test.
+ * Encodes a few QuickTime RLE frames and decodes them back, checking the
+ * number of planes the decoder copies. The decoder updates its last frame in
+ * place, which requires a copy when the caller still holds a reference to it;
+ * in zero-copy mode, that copy fails instead.
+ */
+
+#include <inttypes.h>
+#include <stdio.h>
+
+#include "libavcodec/avcodec.h"
+#include "libavutil/error.h"
+#include "libavutil/frame.h"
+
+#define WIDTH     64
+#define HEIGHT    64
+#define NB_FRAMES 5
+
+static int encode_frames(AVPacket **pkts, int *nb_pkts)
+{
+    const AVCodec *codec = avcodec_find_encoder(AV_CODEC_ID_QTRLE);
+    AVCodecContext *ctx = NULL;
+    AVFrame *frame = NULL;
+    int ret;
+
+    if (!codec)
+        return AVERROR_ENCODER_NOT_FOUND;
+    ctx   = avcodec_alloc_context3(codec);
+    frame = av_frame_alloc();
+    if (!ctx || !frame) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    ctx->width     = WIDTH;
+    ctx->height    = HEIGHT;
+    ctx->pix_fmt   = AV_PIX_FMT_RGB24;
+    ctx->time_base = (AVRational){ 1, 25 };
+    if ((ret = avcodec_open2(ctx, codec, NULL)) < 0)
+        goto end;
+
+    frame->width  = WIDTH;
+    frame->height = HEIGHT;
+    frame->format = AV_PIX_FMT_RGB24;
+    if ((ret = av_frame_get_buffer(frame, 0)) < 0)
+        goto end;
+
+    for (int i = 0; i <= NB_FRAMES; i++) {
+        if (i < NB_FRAMES) {
+            /* a square moving across a gradient, so that every frame differs */
+            if ((ret = av_frame_make_writable(frame)) < 0)
+                goto end;
+            for (int y = 0; y < HEIGHT; y++) {
+                uint8_t *row = frame->data[0] + y * frame->linesize[0];
+                for (int x = 0; x < WIDTH; x++) {
+                    int in_square = x >= 8 * i && x < 8 * i + 16 && y >= 8 && y < 24;
+                    row[3 * x]     = in_square ? 255 : 4 * x;
+                    row[3 * x + 1] = in_square ? 0   : 4 * y;
+                    row[3 * x + 2] = in_square ? 0   : 128;
+                }
+            }
+            frame->pts = i;
+        }
+        ret = avcodec_send_frame(ctx, i < NB_FRAMES ? frame : NULL);
+        if (ret < 0)
+            goto end;
+        while (1) {
+            AVPacket *pkt = av_packet_alloc();
+            if (!pkt) {
+                ret = AVERROR(ENOMEM);
+                goto end;
+            }
+            ret = avcodec_receive_packet(ctx, pkt);
+            if (ret >= 0 && *nb_pkts == NB_FRAMES)
+                ret = AVERROR_BUG;
+            if (ret < 0) {
+                av_packet_free(&pkt);
+                break;
+            }
+            pkts[(*nb_pkts)++] = pkt;
+        }
+        if (ret != AVERROR(EAGAIN) && ret != AVERROR_EOF)
+            goto end;
+    }
+    ret = 0;
+
+end:
+    av_frame_free(&frame);
+    avcodec_free_context(&ctx);
+    return ret;
+}
+
+static int decode_frames(AVPacket **pkts, int nb_pkts, int zero_copy, int hold_ref)
+{
+    const AVCodec *codec = avcodec_find_decoder(AV_CODEC_ID_QTRLE);
+    AVCodecContext *ctx = NULL;
+    AVFrame *frame = NULL, *held = NULL;
+    int nb_frames = 0, ret;
+
+    if (!codec)
+        return AVERROR_DECODER_NOT_FOUND;
+    ctx   = avcodec_alloc_context3(codec);
+    frame = av_frame_alloc();
+    held  = av_frame_alloc();
+    if (!ctx || !frame || !held) {
+        ret = AVERROR(ENOMEM);
+        goto end;
+    }
+    ctx->width                 = WIDTH;
+    ctx->height                = HEIGHT;
+    ctx->bits_per_coded_sample = 24;
+    if (zero_copy)
+        ctx->flags2 |= AV_CODEC_FLAG2_ZERO_COPY;
+    if ((ret = avcodec_open2(ctx, codec, NULL)) < 0)
+        goto end;
+
+    for (int i = 0; i < nb_pkts; i++) {
+        ret = avcodec_send_packet(ctx, pkts[i]);
+        while (ret >= 0) {
+            ret = avcodec_receive_frame(ctx, frame);
+            if (ret < 0)
+                break;
+            nb_frames++;
+            av_frame_unref(held);
+            if (hold_ref)
+                av_frame_move_ref(held, frame);
+            else
+                av_frame_unref(frame);
+        }
+        if (ret != AVERROR(EAGAIN))
+            break;
+    }
+
+    printf("%-9s %-22s %d frames, %"PRId64" plane copies, %s\n",
+           zero_copy ? "zero-copy" : "default",
+           hold_ref ? "holding the last frame" : "releasing the frames",
+           nb_frames, ctx->plane_copies,
+           ret == AVERROR(EAGAIN) ? "ok" :
+           ret == AVERROR(ENOSYS) ? "copy refused" : "error");
+    ret = 0;
+
+end:
+    av_frame_free(&held);
+    av_frame_free(&frame);
+    avcodec_free_context(&ctx);
+    return ret;
+}
+
+int main(void)
+{
+    AVPacket *pkts[NB_FRAMES] = { NULL };
+    int nb_pkts = 0, ret;
+
+    ret = encode_frames(pkts, &nb_pkts);
+    if (ret < 0) {
+        av_log(NULL, AV_LOG_ERROR, "Encoding failed: %s\n", av_err2str(ret));
+        goto end;
+    }
+
+    for (int zero_copy = 0; zero_copy < 2 && ret >= 0; zero_copy++)
+        for (int hold_ref = 0; hold_ref < 2 && ret >= 0; hold_ref++)
+            ret = decode_frames(pkts, nb_pkts, zero_copy, hold_ref);
+
+end:
+    for (int i = 0; i < nb_pkts; i++)
+        av_packet_free(&pkts[i]);
+    return ret < 0;
+}
@@ -572,6 +572,37 @@ venc_data(){
     run tools/venc_data_dump${EXECSUF} ${file} ${stream} ${frames} ${threads} ${thread_type}
 }
 
+hls_playlist(){
+    playlist=$1
+    cat $playlist
+    for f in $(sed -n 's/.*URI="\([^"]*\)".*/\1/p; t; /^[^#]/p' $playlist); do
+        do_md5sum ${playlist%/*}/$f
+    done
+}
+
+write_queue(){
+    queue_size=$1
+    enc_fmt=$2
+    shift 2
+    syncfile="${outdir}/${test}-sync.${enc_fmt}"
+    encfile="${outdir}/${test}.${enc_fmt}"
+    cleanfiles="$cleanfiles $syncfile $encfile"
+    ffmpeg "$@" -f $enc_fmt -y $(target_path $syncfile) || return
+    ffmpeg "$@" -write_queue_size $queue_size -f $enc_fmt -y $(target_path $encfile) || return
+    do_md5sum $encfile
+    cmp -s $syncfile $encfile && echo "identical to the synchronous output" ||
+        echo "differs from the synchronous output"
+}
+
+index_cache(){
+    cachefile=${outdir}/${test}.idx
+    cleanfiles="$cleanfiles $cachefile"
+    rm -f $cachefile
+    run libavformat/tests/seek${EXECSUF} "$@" -index_cache $(target_path $cachefile) > /dev/null || return
+    test -s $cachefile || return
+    run libavformat/tests/seek${EXECSUF} "$@" -index_cache $(target_path $cachefile)
+}
+
 null(){
     :
 }
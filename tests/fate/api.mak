@@ -22,11 +22,24 @@ fate-lavf-flv: KEEP_FILES ?= 1
 fate-api-seek: CMD = run $(APITESTSDIR)/api-seek-test$(EXESUF) $(TARGET_PATH)/tests/data/lavf/lavf.flv 0 720
 fate-api-seek: CMP = null
 
+FATE_API_LIBAVCODEC-$(call ENCDEC, QTRLE, MOV) += fate-api-zero-copy
+fate-api-zero-copy: $(APITESTSDIR)/api-zero-copy-test$(EXESUF)
+fate-api-zero-copy: CMD = run $(APITESTSDIR)/api-zero-copy-test$(EXESUF)
+
 FATE_API-$(HAVE_THREADS) += fate-api-threadmessage
 fate-api-threadmessage: $(APITESTSDIR)/api-threadmessage-test$(EXESUF)
 fate-api-threadmessage: CMD = run $(APITESTSDIR)/api-threadmessage-test$(EXESUF) 3 10 30 50 2 20 40
 fate-api-threadmessage: CMP = null
 
+FATE_API_LIBAVCODEC-$(HAVE_THREADS) += fate-api-threadqueue fate-api-threadqueue-spsc
+fate-api-threadqueue: $(APITESTSDIR)/api-threadqueue-test$(EXESUF)
+fate-api-threadqueue: CMD = run $(APITESTSDIR)/api-threadqueue-test$(EXESUF) 3 2000 8 0 1
+fate-api-threadqueue: CMP = null
+
+fate-api-threadqueue-spsc: $(APITESTSDIR)/api-threadqueue-test$(EXESUF)
+fate-api-threadqueue-spsc: CMD = run $(APITESTSDIR)/api-threadqueue-test$(EXESUF) 3 2000 8 1 1
+fate-api-threadqueue-spsc: CMP = null
+
 FATE_API_SAMPLES-$(CONFIG_AVFORMAT) += $(FATE_API_SAMPLES_LIBAVFORMAT-yes)
 
 ifdef SAMPLES
@@ -41,6 +41,55 @@ fate-ffmpeg-filter_colorkey: CMD = framecrc -auto_conversion_filters -idct simpl
 FATE_FFMPEG-$(call FILTERFRAMECRC, COLOR) += fate-ffmpeg-lavfi
 fate-ffmpeg-lavfi: CMD = framecrc -lavfi color=d=1:r=5 -fflags +bitexact
 
+FATE_FFMPEG-$(call FILTERFRAMECRC, TESTSRC2 FORMAT SPLIT HFLIP FPS NEGATE CROP VFLIP TRANSPOSE AVGBLUR LUTYUV) += fate-ffmpeg-filter_complex_parallel
+fate-ffmpeg-filter_complex_parallel: CMD = framecrc -filter_complex_threads 4 -filter_complex_parallel \
+  -filter_complex "testsrc2=s=320x240:r=25:d=1,format=yuv420p,split=3[a][b][c]\;[a]hflip,fps=15,negate[o1]\;[b]crop=160:120,vflip,transpose[o2]\;[c]avgblur=4,lutyuv=y=val/2[o3]" \
+  -map "[o1]" -map "[o2]" -map "[o3]" -fflags +bitexact
+
+FATE_FFMPEG-$(call TRANSCODE, MPEG2VIDEO, MOV, RAWVIDEO_DEMUXER) += fate-ffmpeg-segment_parallel
+fate-ffmpeg-segment_parallel: tests/data/vsynth1.yuv
+fate-ffmpeg-segment_parallel: CMD = transcode "rawvideo -s 352x288 -pix_fmt yuv420p -r 5" tests/data/vsynth1.yuv \
+  mov "-c:v mpeg2video -bf 2 -g 6 -qscale 8" "-c:v rawvideo" "" "" "-segment_parallel 3"
+
+FATE_FFMPEG-$(call TRANSCODE, MPEG2VIDEO, MOV, RAWVIDEO_DEMUXER) += fate-ffmpeg-threaded_encoding
+fate-ffmpeg-threaded_encoding: tests/data/vsynth1.yuv
+fate-ffmpeg-threaded_encoding: CMD = transcode "rawvideo -s 352x288 -pix_fmt yuv420p -r 5" tests/data/vsynth1.yuv \
+  mov "-c:v mpeg2video -bf 2 -g 6 -qscale 8" "-c:v rawvideo" "" "" "-threaded_encoding"
+
+# a queue smaller than the packets, and the moov atom written after seeking back
+FATE_FFMPEG-$(call ENCMUX, MPEG2VIDEO, MOV, RAWVIDEO_DEMUXER FILE_PROTOCOL) += fate-ffmpeg-write_queue
+fate-ffmpeg-write_queue: tests/data/vsynth1.yuv
+fate-ffmpeg-write_queue: CMD = write_queue 4096 mov -f rawvideo -s 352x288 -pix_fmt yuv420p -r 5 \
+  -i $(TARGET_PATH)/tests/data/vsynth1.yuv -c:v mpeg2video -bf 2 -g 6 -qscale 8 -fflags +bitexact -flags +bitexact
+
+# small blocks, so that every packet spans several of them
+FATE_FFMPEG-$(call ALLYES, LAVFI_INDEV TESTSRC_FILTER AEVALSRC_FILTER MPEG4_ENCODER MP2FIXED_ENCODER MPEGTS_MUXER MPEGTS_DEMUXER FRAMECRC_MUXER FILE_PROTOCOL) += fate-ffmpeg-readahead-off fate-ffmpeg-readahead
+fate-ffmpeg-readahead-off fate-ffmpeg-readahead: tests/data/seek.ts
+fate-ffmpeg-readahead-off: CMD = framecrc -i $(TARGET_PATH)/tests/data/seek.ts -c copy
+fate-ffmpeg-readahead: CMD = framecrc -readahead_blocks 4 -readahead_block_size 4096 -i $(TARGET_PATH)/tests/data/seek.ts -c copy
+fate-ffmpeg-readahead: REF = $(SRC_PATH)/tests/ref/fate/ffmpeg-readahead-off
+
+FATE_FFMPEG-$(call TRANSCODE, MPEG2VIDEO, MOV, RAWVIDEO_DEMUXER) += fate-ffmpeg-zero_copy
+fate-ffmpeg-zero_copy: tests/data/vsynth1.yuv
+fate-ffmpeg-zero_copy: CMD = transcode "rawvideo -s 352x288 -pix_fmt yuv420p -r 5" tests/data/vsynth1.yuv \
+  mov "-c:v mpeg2video -bf 2 -g 6 -qscale 8" "-c:v rawvideo" "" "" "-threads 2 -thread_type frame -flags2 +zero_copy"
+
+FATE_FFMPEG-$(call FRAMECRC, RAWVIDEO, RAWVIDEO, HFLIP_FILTER SCALE_FILTER SPLIT_FILTER VFLIP_FILTER) += fate-ffmpeg-filter_share_prefix
+fate-ffmpeg-filter_share_prefix: tests/data/vsynth1.yuv
+fate-ffmpeg-filter_share_prefix: CMD = framecrc -filter_share_prefix -f rawvideo -s 352x288 -pix_fmt yuv420p -r 5 \
+  -i $(TARGET_PATH)/tests/data/vsynth1.yuv -map 0:v -map 0:v -map 0:v -sws_flags +accurate_rnd+bitexact \
+  -filter:v:0 hflip,scale=176:144 -filter:v:1 hflip,scale=88:72 -filter:v:2 hflip,vflip -c:v rawvideo
+
+# identical chains also share the conversion to the output size and format
+SHARE_CONV_ARGS = -f rawvideo -s 352x288 -pix_fmt yuv420p -r 5 -i $(TARGET_PATH)/tests/data/vsynth1.yuv \
+  -map 0:v -map 0:v -sws_flags +accurate_rnd+bitexact -vf hflip -s 176x144 -pix_fmt rgb24 -c:v rawvideo
+
+FATE_FFMPEG-$(call FRAMECRC, RAWVIDEO, RAWVIDEO, HFLIP_FILTER SCALE_FILTER FORMAT_FILTER SPLIT_FILTER) += fate-ffmpeg-filter_share_conversions-off fate-ffmpeg-filter_share_conversions
+fate-ffmpeg-filter_share_conversions-off fate-ffmpeg-filter_share_conversions: tests/data/vsynth1.yuv
+fate-ffmpeg-filter_share_conversions-off: CMD = framecrc $(SHARE_CONV_ARGS)
+fate-ffmpeg-filter_share_conversions: CMD = framecrc -filter_share_prefix $(SHARE_CONV_ARGS)
+fate-ffmpeg-filter_share_conversions: REF = $(SRC_PATH)/tests/ref/fate/ffmpeg-filter_share_conversions-off
+
 FATE_SAMPLES_FFMPEG-$(call ENCDEC2, MPEG4, RAWVIDEO, AVI, RAWVIDEO_DEMUXER FRAMECRC_MUXER) += fate-force_key_frames
 fate-force_key_frames: tests/data/vsynth_lena.yuv
 fate-force_key_frames: CMD = enc_dec \
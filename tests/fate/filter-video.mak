@@ -115,6 +115,13 @@ FATE_FILTER-$(call FILTERFRAMECRC, FRAMERATE TESTSRC2 FORMAT SCALE) += fate-filt
 fate-filter-framerate-12bit-up: CMD = framecrc -lavfi testsrc2=r=50:d=1,format=pix_fmts=yuv422p12le,scale,framerate=fps=60,scale -t 1 -pix_fmt yuv422p12le
 fate-filter-framerate-12bit-down: CMD = framecrc -lavfi testsrc2=r=60:d=1,format=pix_fmts=yuv422p12le,scale,framerate=fps=50,scale -t 1 -pix_fmt yuv422p12le
 
+FATE_FILTER-$(call FILTERFRAMECRC, TESTSRC2 FORMAT MULTISCALE) += fate-filter-multiscale
+fate-filter-multiscale: CMD = framecrc -filter_complex "testsrc2=r=5:d=1,format=rgb24,multiscale=sizes=176x144|96x80:flags=bicubic+accurate_rnd+bitexact[a][b]\;[a]format=yuv444p[o1]\;[b]format=yuv420p[o2]" -map "[o1]" -map "[o2]"
+
+# the first output closing early must not stop the second one
+FATE_FILTER-$(call FILTERFRAMECRC, TESTSRC2 FORMAT MULTISCALE TRIM) += fate-filter-multiscale-close
+fate-filter-multiscale-close: CMD = framecrc -filter_complex "testsrc2=r=5:d=1,format=rgb24,multiscale=sizes=176x144|96x80:flags=bicubic+accurate_rnd+bitexact[a][b]\;[a]trim=end_frame=2,format=yuv444p[o1]\;[b]format=yuv420p[o2]" -map "[o1]" -map "[o2]"
+
 FATE_FILTER-$(call FILTERFRAMECRC, MINTERPOLATE TESTSRC2) += fate-filter-minterpolate-up fate-filter-minterpolate-down
 fate-filter-minterpolate-up: CMD = framecrc -lavfi testsrc2=r=2:d=10,minterpolate=fps=10 -t 1
 fate-filter-minterpolate-down: CMD = framecrc -lavfi testsrc2=r=2:d=10,minterpolate=fps=1 -t 1
@@ -210,6 +210,14 @@ FATE_HEVC-$(call FRAMECRC, HEVC, HEVC, HEVC_PARSER SCALE_FILTER) +=         \
                                                     $(HEVC_TESTS_422_10BIN) \
                                                     $(HEVC_TESTS_444_12BIT) \
 
+# the tiled streams again, with the tiles of each picture decoded in parallel
+HEVC_TESTS_TILES_SLICE_THREADS = $(addprefix fate-hevc-slice-threads-, TILES_A_Cisco_2 TILES_B_Cisco_1)
+$(HEVC_TESTS_TILES_SLICE_THREADS): THREADS = 4
+$(HEVC_TESTS_TILES_SLICE_THREADS): THREAD_TYPE = slice
+$(HEVC_TESTS_TILES_SLICE_THREADS): CMD = framecrc -flags unaligned -i $(TARGET_SAMPLES)/hevc-conformance/$(@:fate-hevc-slice-threads-%=%).bit -pix_fmt yuv420p
+$(HEVC_TESTS_TILES_SLICE_THREADS): REF = $(SRC_PATH)/tests/ref/fate/hevc-conformance-$(@:fate-hevc-slice-threads-%=%)
+FATE_HEVC-$(call FRAMECRC, HEVC, HEVC, HEVC_PARSER) += $(HEVC_TESTS_TILES_SLICE_THREADS)
+
 fate-hevc-paramchange-yuv420p-yuv420p10: CMD = framecrc -vsync passthrough -i $(TARGET_SAMPLES)/hevc/paramchange_yuv420p_yuv420p10.hevc -sws_flags area+accurate_rnd+bitexact
 FATE_HEVC-$(call FRAMECRC, HEVC, HEVC, HEVC_PARSER SCALE_FILTER LARGE_TESTS) += fate-hevc-paramchange-yuv420p-yuv420p10
 
@@ -80,6 +80,26 @@ fate-vc1-ism: CMD = framecrc -i $(TARGET_SAMPLES)/isom/vc1-wmapro.ism -an
 FATE_MICROSOFT += $(FATE_VC1-yes)
 fate-vc1: $(FATE_VC1-yes)
 
+# the progressive, interlaced and WMV3 streams again, decoded with frame
+# threads; these must pass before the decoders advertise frame threading
+FATE_VC1_FRAME_THREADS-$(call FRAMECRC, VC1, VC1, VC1_PARSER EXTRACT_EXTRADATA_BSF) += fate-vc1-frame-threads-sa10091 fate-vc1-frame-threads-sa20021 fate-vc1-frame-threads-ilaced_twomv
+fate-vc1-frame-threads-sa10091:      CMD = framecrc -i $(TARGET_SAMPLES)/vc1/SA10091.vc1
+fate-vc1-frame-threads-sa20021:      CMD = framecrc -i $(TARGET_SAMPLES)/vc1/SA20021.vc1
+fate-vc1-frame-threads-ilaced_twomv: CMD = framecrc -flags +bitexact -i $(TARGET_SAMPLES)/vc1/ilaced_twomv.vc1
+
+FATE_VC1_FRAME_THREADS-$(call FRAMECRC, VC1T, WMV3) += fate-vc1-frame-threads-smm0005 fate-vc1-frame-threads-smm0015
+fate-vc1-frame-threads-smm0005: CMD = framecrc -i $(TARGET_SAMPLES)/vc1/SMM0005.rcv
+fate-vc1-frame-threads-smm0015: CMD = framecrc -i $(TARGET_SAMPLES)/vc1/SMM0015.rcv
+
+fate-vc1-frame-threads-%: THREADS     = 4
+fate-vc1-frame-threads-%: THREAD_TYPE = frame
+fate-vc1-frame-threads-sa%:  REF = $(SRC_PATH)/tests/ref/fate/vc1_sa$(@:fate-vc1-frame-threads-sa%=%)
+fate-vc1-frame-threads-ilaced_twomv: REF = $(SRC_PATH)/tests/ref/fate/vc1_ilaced_twomv
+fate-vc1-frame-threads-smm%: REF = $(SRC_PATH)/tests/ref/fate/vc1test_smm$(@:fate-vc1-frame-threads-smm%=%)
+
+FATE_MICROSOFT += $(FATE_VC1_FRAME_THREADS-yes)
+fate-vc1-frame-threads: $(FATE_VC1_FRAME_THREADS-yes)
+
 FATE_MICROSOFT-$(call ALLYES, FILE_PROTOCOL PIPE_PROTOCOL ASF_DEMUXER FRAMECRC_MUXER) += fate-asf-repldata
 fate-asf-repldata: CMD = framecrc -i $(TARGET_SAMPLES)/asf/bug821-2.asf -c copy
 
@@ -165,6 +165,29 @@ FATE_MOV_FFMPEG-$(call TRANSCODE, PCM_S16LE, MOV, WAV_DEMUXER PAN_FILTER) \
 fate-mov-channel-description: tests/data/asynth-44100-1.wav tests/data/filtergraphs/mov-channel-description
 fate-mov-channel-description: CMD = transcode wav $(TARGET_PATH)/tests/data/asynth-44100-1.wav mov "-filter_complex_script $(TARGET_PATH)/tests/data/filtergraphs/mov-channel-description -map [outFL] -map [outFR] -map [outFC] -map [outLFE] -map [outBL] -map [outBR] -map [outDL] -map [outDR] -c:a pcm_s16le" "-map 0 -c copy -frames:a 0"
 
+# more samples than the window of the lazy index, which must give the same
+# packets and seek results as the full index
+tests/data/mov_lazy_index.mov: TAG = GEN
+tests/data/mov_lazy_index.mov: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
+	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< -nostdin \
+	-f lavfi -i "testsrc=size=64x48:rate=100:duration=15" \
+	-f lavfi -i "aevalsrc=sin(2*PI*440*t):s=16000:d=15" \
+	-sws_flags bicubic+bitexact -flags +bitexact -fflags +bitexact -c:v mpeg4 -g 50 -qscale 10 -c:a mp2fixed \
+	-y $(TARGET_PATH)/$@ 2>/dev/null
+
+FATE_MOV_LAZY_INDEX-$(call ALLYES, LAVFI_INDEV TESTSRC_FILTER AEVALSRC_FILTER MPEG4_ENCODER \
+                                   MP2FIXED_ENCODER MOV_MUXER MOV_DEMUXER FRAMECRC_MUXER) += \
+    fate-mov-full-index-ss fate-mov-lazy-index-ss fate-mov-full-index-seek fate-mov-lazy-index-seek
+$(FATE_MOV_LAZY_INDEX-yes): tests/data/mov_lazy_index.mov
+fate-mov-full-index-ss: CMD = framecrc -lazy_index 0 -ss 12.3 -i $(TARGET_PATH)/tests/data/mov_lazy_index.mov -c copy
+fate-mov-lazy-index-ss: CMD = framecrc -lazy_index 1 -ss 12.3 -i $(TARGET_PATH)/tests/data/mov_lazy_index.mov -c copy
+fate-mov-lazy-index-ss: REF = $(SRC_PATH)/tests/ref/fate/mov-full-index-ss
+fate-mov-full-index-seek fate-mov-lazy-index-seek: libavformat/tests/seek$(EXESUF)
+fate-mov-full-index-seek: CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_PATH)/tests/data/mov_lazy_index.mov -lazy_index 0 -duration 15
+fate-mov-lazy-index-seek: CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_PATH)/tests/data/mov_lazy_index.mov -lazy_index 1 -duration 15
+fate-mov-lazy-index-seek: REF = $(SRC_PATH)/tests/ref/fate/mov-full-index-seek
+FATE_MOV_FFMPEG-yes += $(FATE_MOV_LAZY_INDEX-yes)
+
 FATE_FFMPEG += $(FATE_MOV_FFMPEG-yes)
 
 fate-mov: $(FATE_MOV) $(FATE_MOV_FFMPEG-yes) $(FATE_MOV_FFPROBE) $(FATE_MOV_FASTSTART) $(FATE_MOV_FFMPEG_FFPROBE-yes)
@@ -198,13 +198,92 @@ fate-seek-mkv-codec-delay:   CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_
 
 FATE_SEEK_EXTRA += $(FATE_SEEK_EXTRA-yes)
 
+# generated files, seeking in them with their index restored by index_cache
 
-$(FATE_SEEK) $(FATE_SAMPLES_SEEK) $(FATE_SEEK_EXTRA): libavformat/tests/seek$(EXESUF)
+SEEK_GEN_ARGS = -f lavfi -i "testsrc=size=64x48:rate=25:duration=10" \
+                -f lavfi -i "aevalsrc=sin(2*PI*440*t):s=16000:d=10" \
+                -sws_flags bicubic+bitexact -flags +bitexact -fflags +bitexact \
+                -c:v mpeg4 -g 25 -qscale 10 -c:a mp2fixed
+
+tests/data/seek-nocues.mkv tests/data/seek.ts: TAG = GEN
+tests/data/seek-nocues.mkv tests/data/seek.ts: ffmpeg$(PROGSSUF)$(EXESUF) | tests/data
+
+# -live 1 leaves out the Cues
+tests/data/seek-nocues.mkv:
+	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< -nostdin $(SEEK_GEN_ARGS) \
+	-cluster_time_limit 500 -live 1 -y $(TARGET_PATH)/$@ 2>/dev/null
+
+tests/data/seek.ts:
+	$(M)$(TARGET_EXEC) $(TARGET_PATH)/$< -nostdin $(SEEK_GEN_ARGS) \
+	-y $(TARGET_PATH)/$@ 2>/dev/null
+
+SEEK_GEN_DEPS = LAVFI_INDEV TESTSRC_FILTER AEVALSRC_FILTER MPEG4_ENCODER MP2FIXED_ENCODER
+FATE_SEEK_GEN-$(call ALLYES, $(SEEK_GEN_DEPS) MATROSKA_MUXER MATROSKA_DEMUXER) += fate-seek-mkv-nocues fate-seek-mkv-nocues-index-cache
+FATE_SEEK_GEN-$(call ALLYES, $(SEEK_GEN_DEPS) MPEGTS_MUXER MPEGTS_DEMUXER) += fate-seek-mpegts fate-seek-mpegts-index-cache
+
+fate-seek-mkv-nocues fate-seek-mkv-nocues-index-cache: tests/data/seek-nocues.mkv
+fate-seek-mkv-nocues: CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_PATH)/tests/data/seek-nocues.mkv -duration 10
+fate-seek-mkv-nocues-index-cache: CMD = index_cache $(TARGET_PATH)/tests/data/seek-nocues.mkv -duration 10
+fate-seek-mkv-nocues-index-cache: REF = $(SRC_PATH)/tests/ref/seek/mkv-nocues
+
+FATE_SEEK_GEN-$(call ALLYES, $(SEEK_GEN_DEPS) MATROSKA_MUXER MATROSKA_DEMUXER) += fate-seek-mkv-nocues-cluster-scan-seek fate-seek-mkv-nocues-cluster-scan-background
+fate-seek-mkv-nocues-cluster-scan-%: tests/data/seek-nocues.mkv
+fate-seek-mkv-nocues-cluster-scan-%: CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_PATH)/tests/data/seek-nocues.mkv -duration 10 -cluster_scan $(@:fate-seek-mkv-nocues-cluster-scan-%=%)
+fate-seek-mkv-nocues-cluster-scan-%: REF = $(SRC_PATH)/tests/ref/seek/mkv-nocues
+
+fate-seek-mpegts fate-seek-mpegts-index-cache: tests/data/seek.ts
+fate-seek-mpegts: CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_PATH)/tests/data/seek.ts -duration 10
+fate-seek-mpegts-index-cache: CMD = index_cache $(TARGET_PATH)/tests/data/seek.ts -duration 10
+fate-seek-mpegts-index-cache: REF = $(SRC_PATH)/tests/ref/seek/mpegts
+
+# a truncated packet followed by garbage with false sync bytes, the demuxer
+# has to resync both when reading and when seeking
+tests/data/seek-desync.ts: TAG = GEN
+tests/data/seek-desync.ts: tests/data/seek.ts | tests/data
+	$(M)(dd if=$< bs=188 count=200; dd if=$< bs=100 skip=376 count=1; \
+	printf 'G\1\2\3GGxG\107\0\0G'; dd if=$< bs=188 skip=400) 2>/dev/null >$@
+
+FATE_SEEK_GEN-$(call ALLYES, $(SEEK_GEN_DEPS) MPEGTS_MUXER MPEGTS_DEMUXER) += fate-seek-mpegts-desync
+fate-seek-mpegts-desync: tests/data/seek-desync.ts
+fate-seek-mpegts-desync: CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_PATH)/tests/data/seek-desync.ts -duration 10
+
+# ranges smaller than the packets read between seeks
+FATE_SEEK_GEN-$(call ALLYES, $(SEEK_GEN_DEPS) MPEGTS_MUXER MPEGTS_DEMUXER PARALLEL_PROTOCOL FILE_PROTOCOL) += fate-seek-parallel-mpegts
+FATE_SEEK_GEN-$(call ALLYES, $(SEEK_GEN_DEPS) MPEGTS_MUXER MPEGTS_DEMUXER CACHE_PROTOCOL PARALLEL_PROTOCOL FILE_PROTOCOL) += fate-seek-cache-parallel-mpegts
+
+fate-seek-parallel-mpegts fate-seek-cache-parallel-mpegts: tests/data/seek.ts
+fate-seek-parallel-mpegts: CMD = run libavformat/tests/seek$(EXESUF) parallel:$(TARGET_PATH)/tests/data/seek.ts -duration 10 -range_size 4096 -connections 3
+fate-seek-cache-parallel-mpegts: CMD = run libavformat/tests/seek$(EXESUF) cache:parallel:$(TARGET_PATH)/tests/data/seek.ts -duration 10 -range_size 4096 -connections 3
+fate-seek-parallel-mpegts fate-seek-cache-parallel-mpegts: REF = $(SRC_PATH)/tests/ref/seek/mpegts
+
+# seeks both inside and outside of the blocks read ahead
+FATE_SEEK_GEN-$(call ALLYES, $(SEEK_GEN_DEPS) MPEGTS_MUXER MPEGTS_DEMUXER FILE_PROTOCOL) += fate-seek-readahead-mpegts
+fate-seek-readahead-mpegts: tests/data/seek.ts
+fate-seek-readahead-mpegts: CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_PATH)/tests/data/seek.ts -duration 10 -readahead_blocks 4 -readahead_block_size 4096
+fate-seek-readahead-mpegts: REF = $(SRC_PATH)/tests/ref/seek/mpegts
+
+# a single cached block in memory and none on disk, so every seek evicts
+SEEK_CACHE_LIMITS = -block_size 4096 -memory_limit 4096 -disk_limit 0
+FATE_SEEK_GEN-$(call ALLYES, $(SEEK_GEN_DEPS) MATROSKA_MUXER MATROSKA_DEMUXER CACHE_PROTOCOL FILE_PROTOCOL) += fate-seek-cache-limits-mkv-nocues
+FATE_SEEK_GEN-$(call ALLYES, $(SEEK_GEN_DEPS) MPEGTS_MUXER MPEGTS_DEMUXER CACHE_PROTOCOL FILE_PROTOCOL) += fate-seek-cache-limits-mpegts
+
+fate-seek-cache-limits-mkv-nocues: tests/data/seek-nocues.mkv
+fate-seek-cache-limits-mkv-nocues: CMD = run libavformat/tests/seek$(EXESUF) cache:$(TARGET_PATH)/tests/data/seek-nocues.mkv -duration 10 $(SEEK_CACHE_LIMITS)
+fate-seek-cache-limits-mkv-nocues: REF = $(SRC_PATH)/tests/ref/seek/mkv-nocues
+
+fate-seek-cache-limits-mpegts: tests/data/seek.ts
+fate-seek-cache-limits-mpegts: CMD = run libavformat/tests/seek$(EXESUF) cache:$(TARGET_PATH)/tests/data/seek.ts -duration 10 $(SEEK_CACHE_LIMITS)
+fate-seek-cache-limits-mpegts: REF = $(SRC_PATH)/tests/ref/seek/mpegts
+
+FATE_SEEK_GEN += $(FATE_SEEK_GEN-yes)
+
+
+$(FATE_SEEK) $(FATE_SAMPLES_SEEK) $(FATE_SEEK_EXTRA) $(FATE_SEEK_GEN): libavformat/tests/seek$(EXESUF)
 $(FATE_SEEK) $(FATE_SAMPLES_SEEK): CMD = run libavformat/tests/seek$(EXESUF) $(TARGET_PATH)/tests/data/$(SRC)
 $(FATE_SEEK) $(FATE_SAMPLES_SEEK): fate-seek-%: fate-%
 $(subst fate-seek-,fate-,$(FATE_SAMPLES_SEEK) $(FATE_SEEK)): KEEP_FILES ?= 1
 fate-seek-%: REF = $(SRC_PATH)/tests/ref/seek/$(@:fate-seek-%=%)
 
-FATE_AVCONV += $(FATE_SEEK)
+FATE_AVCONV += $(FATE_SEEK) $(FATE_SEEK_GEN)
 FATE_SAMPLES_AVCONV += $(FATE_SAMPLES_SEEK) $(FATE_SEEK_EXTRA)
-fate-seek:     $(FATE_SEEK) $(FATE_SAMPLES_SEEK) $(FATE_SEEK_EXTRA)
+fate-seek:     $(FATE_SEEK) $(FATE_SAMPLES_SEEK) $(FATE_SEEK_EXTRA) $(FATE_SEEK_GEN)
@@ -234,7 +234,7 @@ fate-vsynth%-mjpeg-trell:             ENCOPTS = -qscale 9 -pix_fmt yuvj420p -tre
 fate-vsynth%-mjpeg-huffman:           ENCOPTS = -qscale 9 -pix_fmt yuvj420p -huffman optimal
 fate-vsynth%-mjpeg-trell-huffman:     ENCOPTS = -qscale 9 -pix_fmt yuvj420p -trellis 1 -huffman optimal
 
-FATE_VCODEC-$(call ENCDEC, MPEG1VIDEO, MPEG1VIDEO MPEGVIDEO) += mpeg1 mpeg1b
+FATE_VCODEC-$(call ENCDEC, MPEG1VIDEO, MPEG1VIDEO MPEGVIDEO) += mpeg1 mpeg1b mpeg1-frame-thread
 fate-vsynth%-mpeg1:              FMT     = mpeg1video
 fate-vsynth%-mpeg1:              CODEC   = mpeg1video
 fate-vsynth%-mpeg1:              ENCOPTS = -qscale 10
@@ -243,13 +243,19 @@ fate-vsynth%-mpeg1b:             CODEC   = mpeg1video
 fate-vsynth%-mpeg1b:             ENCOPTS = -qscale 8 -bf 3 -ps 200
 fate-vsynth%-mpeg1b:             FMT     = mpeg1video
 
+fate-vsynth%-mpeg1-frame-thread: CODEC   = mpeg1video
+fate-vsynth%-mpeg1-frame-thread: ENCOPTS = -qscale 8 -bf 3 -ps 200
+fate-vsynth%-mpeg1-frame-thread: FMT     = mpeg1video
+
 FATE_MPEG2 := mpeg2                                                     \
               $(if $(CONFIG_SCALE_FILTER), mpeg2-422)                   \
              mpeg2-idct-int                                             \
+             mpeg2-gop-thread                                           \
              mpeg2-ilace                                                \
              mpeg2-ivlc-qprd                                            \
              mpeg2-thread                                               \
-             mpeg2-thread-ivlc
+             mpeg2-thread-ivlc                                          \
+             mpeg2-frame-thread
 
 FATE_VCODEC-$(call ENCDEC, MPEG2VIDEO, MPEG2VIDEO MPEGVIDEO) += $(FATE_MPEG2)
 
@@ -265,6 +271,8 @@ fate-vsynth%-mpeg2-422:          ENCOPTS = -b:v 1000k                   \
                                            -intra_vlc 1                 \
                                            -mbd rd                      \
                                            -pix_fmt yuv422p
+fate-vsynth%-mpeg2-gop-thread:    ENCOPTS = -qscale 10 -bf 2 -g 12 -threads 3 \
+                                           -thread_type frame -gop_threads 1
 fate-vsynth%-mpeg2-idct-int:     ENCOPTS = -qscale 10 -idct int -dct int
 fate-vsynth%-mpeg2-ilace:        ENCOPTS = -qscale 10 -flags +ildct+ilme
 fate-vsynth%-mpeg2-ivlc-qprd:    ENCOPTS = -b:v 500k                    \
@@ -278,6 +286,11 @@ fate-vsynth%-mpeg2-thread:       ENCOPTS = -qscale 10 -bf 2 -flags +ildct+ilme \
                                            -threads 2 -slices 2
 fate-vsynth%-mpeg2-thread-ivlc:  ENCOPTS = -qscale 10 -bf 2 -flags +ildct+ilme \
                                            -intra_vlc 1 -threads 2 -slices 2
+fate-vsynth%-mpeg2-frame-thread: ENCOPTS = -qscale 10 -bf 2 -flags +ildct+ilme
+
+# decode with frame threads, the output must match single-threaded decoding
+$(foreach T,mpeg1-frame-thread mpeg2-frame-thread,fate-vsynth%-$(T)): THREADS     = 4
+$(foreach T,mpeg1-frame-thread mpeg2-frame-thread,fate-vsynth%-$(T)): THREAD_TYPE = frame
 
 FATE_MPEG4_MP4 = mpeg4
 FATE_MPEG4_AVI = mpeg4-rc                                               \
@@ -464,7 +477,9 @@ FATE_VCODEC += $(FATE_VCODEC-yes)
 FATE_VCODEC := $(if $(call ENCDEC, RAWVIDEO, RAWVIDEO),$(FATE_VCODEC))
 FATE_VSYNTH1 = $(FATE_VCODEC:%=fate-vsynth1-%)
 FATE_VSYNTH2 = $(FATE_VCODEC:%=fate-vsynth2-%)
-FATE_VSYNTH_LENA = $(FATE_VCODEC:%=fate-vsynth_lena-%)
+# Tests without a vsynth_lena reference yet
+LENA_OFF     = mpeg2-gop-thread mpeg1-frame-thread mpeg2-frame-thread
+FATE_VSYNTH_LENA = $(filter-out $(LENA_OFF:%=fate-vsynth_lena-%),$(FATE_VCODEC:%=fate-vsynth_lena-%))
 # Redundant tests because they just resize the input
 RESIZE_OFF   = dnxhd-720p dnxhd-720p-rd dnxhd-720p-10bit dnxhd-1080i \
                dv dv-411 dv-50 avui snow snow-hpel snow-ll vc2-420p \